@@ -6,11 +6,11 @@ if not exist build mkdir build
 
 rem "release" for now is actually a "development" build, just with optimizations
 
-set flags=/nologo /Z7 /WX /W4 /wd4201 /wd4115 /wd4013 /wd4116 /wd4324 /std:c11 /experimental:c11atomics /I..\src /I..\external\include /DUNICODE=1 /D_CRT_SECURE_NO_WARNINGS /DPLATFORM_WIN32=1 /DDREAM_DEVELOPER=1
+set flags=/nologo /Z7 /WX /W4 /wd4201 /wd4115 /wd4013 /wd4116 /wd4324 /std:c11 /experimental:c11atomics /GT /I..\src /I..\external\include /DUNICODE=1 /D_CRT_SECURE_NO_WARNINGS /DPLATFORM_WIN32=1 /DDREAM_DEVELOPER=1
 set debug_flags=/Od /MTd /DDREAM_DEVELOPMENT=1 /DDREAM_SLOW=1
 set release_flags=/O2 /MT /DDREAM_DEVELOPMENT=1
 set linker_flags=/opt:ref /incremental:no /libpath:..\external\lib\x64
-set libraries=user32.lib dxguid.lib d3d11.lib dxgi.lib d3dcompiler.lib gdi32.lib user32.lib ole32.lib ksuser.lib shell32.lib Synchronization.lib DbgHelp.lib d3d12.lib GameInput.lib
+set libraries=user32.lib advapi32.lib dxguid.lib d3d11.lib dxgi.lib d3dcompiler.lib gdi32.lib user32.lib ole32.lib ksuser.lib shell32.lib Synchronization.lib DbgHelp.lib d3d12.lib GameInput.lib
 
 rem copy binaries
 
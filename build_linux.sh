@@ -0,0 +1,49 @@
+#!/bin/bash
+
+# There's no linux version of the engine yet, this builds the parts that do have a linux backend (core)
+# so that they keep compiling, warning free, along with the standalone job queue stress test.
+#
+# usage: build_linux.sh [clean|debug|release|test [rounds] [seed]]
+# test builds both configurations and then runs the stress test on the release build
+
+cd "$(dirname "$0")"
+
+if [ "$1" == "clean" ]; then rm -rf build_linux; fi
+
+mkdir -p build_linux
+
+# "release" for now is actually a "development" build, just with optimizations
+
+# -Wno-missing-braces: { 0 } initializers for nested structs are used all over
+# -Wno-unused-function: headers are full of fn / fn_local helpers that not every translation unit uses
+flags="-std=c11 -g -Wall -Werror -Wno-missing-braces -Wno-unused-function -mavx2 -mfma -Isrc -Iexternal/include -D_GNU_SOURCE -DPLATFORM_LINUX=1 -DDREAM_DEVELOPER=1"
+debug_flags="-O0 -DDREAM_DEVELOPMENT=1 -DDREAM_SLOW=1"
+release_flags="-O2 -DDREAM_DEVELOPMENT=1"
+libraries="-lpthread -lm"
+
+last_error=0
+
+build()
+{
+	local config=$1
+	local config_flags=$2
+
+	echo
+	echo "========================="
+	echo "   RETRO - ${config^^} BUILD"
+	echo "========================="
+	echo
+
+	gcc -c src/core/core.c -o build_linux/core_${config}.o $flags $config_flags || last_error=1
+	gcc src/core/thread_stress_test_main.c -o build_linux/thread_stress_test_${config} $flags $config_flags $libraries || last_error=1
+}
+
+if [ "$1" != "release" ]; then build debug "$debug_flags"; fi
+if [ "$1" != "debug"   ]; then build release "$release_flags"; fi
+
+if [ "$1" == "test" ] && [ $last_error == 0 ]; then
+	echo
+	build_linux/thread_stress_test_release ${2:-16} $3 || last_error=1
+fi
+
+exit $last_error
@@ -17,17 +17,29 @@
 #define alignof _Alignof
 #endif
 
+#ifndef alignas
+#define alignas _Alignas
+#endif
+
 #define meta_struct
 #define meta(...)
 
+#if _MSC_VER
 #define DEPRECATED(details) __declspec(deprecated(details))
+#else
+#define DEPRECATED(details) __attribute__((deprecated(details)))
+#endif
 
 // TODO: Cursed? DON'T DO IT??
 #define USING(type, name) union { type; type name; }
 
 #define fn static
 #define fn_local static inline
+#if _MSC_VER
 #define fn_export extern __declspec(dllexport)
+#else
+#define fn_export extern __attribute__((visibility("default")))
+#endif
 
 #define global static
 #define local_persist static
@@ -236,9 +248,17 @@ typedef struct arena_temp_t
     arena_marker_t marker;
 } arena_temp_t;
 
+typedef uint32_t arena_flags_t;
+typedef enum arena_flags_enum_t
+{
+	ArenaFlag_large_pages       = 0x1, // see m_init_with_flags
+	ArenaFlag_committed_upfront = 0x2, // the OS committed the whole arena when it was reserved, so it never commits or decommits
+} arena_flags_enum_t;
+
 typedef struct arena_t
 {
-    bool owns_memory; // 1
+    bool          owns_memory; // 1
+	arena_flags_t flags;       // 8
 
     char *committed;  // 16
     char *end;        // 24
@@ -246,8 +266,16 @@ typedef struct arena_t
     char *buffer;     // 48
 
 	arena_temp_t *temp; // 56
+
+	struct arena_stats_t *stats; // 64, only set for arenas in the registry, see m_register_arena
 } arena_t;
 
+// the arenas m_get_temp picks from, every thread has a set of its own (see m_swap_temp_arenas)
+typedef struct temp_arenas_t
+{
+	arena_t arenas[4];
+} temp_arenas_t;
+
 //
 // mathy types
 //
@@ -468,13 +496,6 @@ typedef struct cond_t
 	void *opaque; // legal to be zero-initialized
 } cond_t;
 
-typedef struct wait_group_t
-{
-	int64_t counter;
-	mutex_t mutex;
-	cond_t  cond;
-} wait_group_t;
-
 typedef struct hires_time_t
 {
     uint64_t value;
@@ -2,6 +2,23 @@
 // Copyright 2024 by Daniël Cornelisse, All Rights Reserved.
 // ============================================================
 
+fn_local void m_stats_note_used(arena_t *arena)
+{
+	arena_stats_t *stats = arena->stats;
+
+	stats->used            = arena->buffer ? (size_t)(arena->at - arena->buffer) : 0;
+	stats->used_high_water = MAX(stats->used_high_water, stats->used);
+}
+
+fn_local void m_stats_note_committed(arena_t *arena)
+{
+	arena_stats_t *stats = arena->stats;
+
+	stats->reserved             = arena->buffer ? (size_t)(arena->end - arena->buffer) : ARENA_CAPACITY;
+	stats->committed            = arena->buffer ? (size_t)(arena->committed - arena->buffer) : 0;
+	stats->committed_high_water = MAX(stats->committed_high_water, stats->committed);
+}
+
 void m_init_with_memory(arena_t *arena, void *memory, size_t size)
 {
     arena->buffer    = (char *)memory;
@@ -12,6 +29,58 @@ void m_init_with_memory(arena_t *arena, void *memory, size_t size)
     arena->owns_memory = false;
 }
 
+void m_init_with_flags(arena_t *arena, size_t capacity, arena_flags_t flags)
+{
+	ASSERT_MSG(!arena->buffer, "m_init_with_flags has to come before the arena is first used");
+
+	bool committed = false;
+
+	if (flags & ArenaFlag_large_pages)
+	{
+		arena->buffer = (char *)vm_reserve_large(capacity, &committed);
+
+		if (!arena->buffer)
+		{
+			flags &= ~ArenaFlag_large_pages;
+		}
+		else if (committed)
+		{
+			flags |= ArenaFlag_committed_upfront;
+		}
+	}
+
+	if (!arena->buffer)
+	{
+		arena->buffer = (char *)vm_reserve(NULL, capacity);
+		ASSERT_MSG(arena->buffer, "Failed to reserve %zu bytes for an arena", capacity);
+	}
+
+	arena->flags       = flags;
+	arena->at          = arena->buffer;
+	arena->end         = arena->buffer + capacity;
+	arena->committed   = committed ? arena->end : arena->buffer;
+	arena->owns_memory = true;
+
+	if (arena->stats)
+	{
+		arena->stats->released = false;
+		m_stats_note_committed(arena);
+	}
+}
+
+// large pages only turn into large pages if they're committed whole
+fn_local size_t m_commit_chunk_size(const arena_t *arena)
+{
+	size_t result = ARENA_COMMIT_CHUNK_SIZE;
+
+	if (arena->flags & ArenaFlag_large_pages)
+	{
+		result = vm_large_page_size();
+	}
+
+	return result;
+}
+
 arena_t *m_child_arena(arena_t *parent, size_t size)
 {
 	arena_t *result = m_alloc_nozero(parent, size, 64);
@@ -46,6 +115,12 @@ void *m_alloc_nozero(arena_t *arena, size_t size, size_t align)
         arena->committed = arena->buffer;
 
         arena->owns_memory = true;
+
+		if (arena->stats)
+		{
+			arena->stats->released = false;
+			m_stats_note_committed(arena);
+		}
     }
 
     if (size > 0)
@@ -54,18 +129,25 @@ void *m_alloc_nozero(arena_t *arena, size_t size, size_t align)
 
         if (result + size > arena->committed)
         {
-            size_t to_commit = align_forward(result + size - arena->committed, ARENA_COMMIT_CHUNK_SIZE);
+            size_t to_commit = align_forward(result + size - arena->committed, m_commit_chunk_size(arena));
+            to_commit = MIN(to_commit, (size_t)(arena->end - arena->committed));
 
             bool commit_result = vm_commit(arena->committed, to_commit);
 			ASSERT(commit_result);
 
             arena->committed += to_commit;
+
+			if (arena->stats)
+			{
+				arena->stats->commit_count += 1;
+				m_stats_note_committed(arena);
+			}
         }
 
 		ASSERT_MSG(result + size <= arena->end, 
-				   "Arena is out of memory: wanted to allocate %zu bytes with align %zu, "
+				   "Arena '%s' is out of memory: wanted to allocate %zu bytes with align %zu, "
 				   "but after alignment the arena can fit only %zu",
-				   size, align, m_size_remaining_for_align(arena, align));
+				   arena->stats ? arena->stats->name : "(unregistered)", size, align, m_size_remaining_for_align(arena, align));
 
         arena->at = result + size;
 
@@ -144,10 +226,23 @@ void m_pre_commit(arena_t *arena, size_t size)
         size = arena->end - arena->at;
     }
 
-    size_t to_commit = align_forward(arena->at + size - arena->committed, ARENA_COMMIT_CHUNK_SIZE);
+    if (arena->at + size <= arena->committed)
+    {
+        return;
+    }
+
+    size_t to_commit = align_forward(arena->at + size - arena->committed, m_commit_chunk_size(arena));
+    to_commit = MIN(to_commit, (size_t)(arena->end - arena->committed));
+
     vm_commit(arena->committed, to_commit);
 
     arena->committed += to_commit;
+
+	if (arena->stats)
+	{
+		arena->stats->commit_count += 1;
+		m_stats_note_committed(arena);
+	}
 }
 
 void m_check(arena_t *arena)
@@ -159,6 +254,12 @@ void m_reset(arena_t *arena)
 {
 	m_check(arena);
 
+	if (arena->stats)
+	{
+		m_stats_note_used(arena);
+		arena->stats->reset_count += 1;
+	}
+
     arena->at = arena->buffer;
 }
 
@@ -166,16 +267,28 @@ void m_reset_and_decommit(arena_t *arena)
 {
 	m_check(arena);
 
-    if (arena->owns_memory)
+    if (arena->owns_memory && !(arena->flags & ArenaFlag_committed_upfront))
     {
-        char  *decommit_from  = arena->buffer + ARENA_DEFAULT_COMMIT_PRESERVE_THRESHOLD;
+        char  *decommit_from  = arena->buffer + MAX(ARENA_DEFAULT_COMMIT_PRESERVE_THRESHOLD, m_commit_chunk_size(arena));
         size_t decommit_bytes = MAX(0, arena->committed - decommit_from);
 
 		if (decommit_bytes)
 			vm_decommit(decommit_from, decommit_bytes);
 
+		if (arena->stats)
+		{
+			m_stats_note_used(arena);
+			arena->stats->reset_count    += 1;
+			arena->stats->decommit_count += !!decommit_bytes;
+		}
+
         arena->at        = arena->buffer;
         arena->committed = decommit_from;
+
+		if (arena->stats)
+		{
+			m_stats_note_committed(arena);
+		}
     }
     else
     {
@@ -189,14 +302,36 @@ void m_release(arena_t *arena)
 
     if (arena->owns_memory)
     {
+		arena_stats_t *stats = arena->stats;
+
+		if (stats)
+		{
+			m_stats_note_used(arena);
+
+			stats->released       = true;
+			stats->used           = 0;
+			stats->committed      = 0;
+			stats->decommit_count += 1;
+		}
+
         void *buffer = arena->buffer;
         zero_struct(arena);
+
+		// the arena can be used again after release, and it's still the same arena as far as the registry is concerned.
+		// this has to happen before vm_release, bootstrapped arenas live inside their own buffer
+		arena->stats = stats;
+
         vm_release(buffer);
     }
-    else
+    else if (arena->buffer)
     {
         m_reset(arena);
     }
+	else if (arena->stats)
+	{
+		// never used, nothing to release
+		arena->stats->released = true;
+	}
 }
 
 arena_marker_t m_get_marker(arena_t *arena)
@@ -213,6 +348,11 @@ void m_reset_to_marker(arena_t *arena, arena_marker_t marker)
 
     ASSERT(marker.at >= arena->buffer && marker.at < arena->end);
 
+	if (arena->stats)
+	{
+		m_stats_note_used(arena);
+	}
+
     arena->at = marker.at;
 }
 
@@ -238,15 +378,30 @@ void m_scope_end(arena_t *arena)
 	}
 }
 
-global thread_local arena_t temp_arenas[4];
+global thread_local temp_arenas_t  thread_temp_arenas;
+global thread_local temp_arenas_t *tls_temp_arenas; // set by m_swap_temp_arenas, null means thread_temp_arenas
+
+fn_local temp_arenas_t *m_current_temp_arenas(void)
+{
+	return tls_temp_arenas ? tls_temp_arenas : &thread_temp_arenas;
+}
+
+temp_arenas_t *m_swap_temp_arenas(temp_arenas_t *arenas)
+{
+	temp_arenas_t *previous = tls_temp_arenas;
+	tls_temp_arenas = arenas;
+	return previous;
+}
 
 arena_t *m_get_temp(arena_t **conflicts, size_t conflict_count)
 {
 	arena_t *result = NULL;
 
-	for (size_t i = 0; i < ARRAY_COUNT(temp_arenas); i++)
+	temp_arenas_t *temp_arenas = m_current_temp_arenas();
+
+	for (size_t i = 0; i < ARRAY_COUNT(temp_arenas->arenas); i++)
 	{
-		arena_t *candidate = &temp_arenas[i];
+		arena_t *candidate = &temp_arenas->arenas[i];
 
 		bool has_conflict = false;
 
@@ -280,9 +435,21 @@ arena_t *m_get_temp_scope_begin(arena_t **conflicts, size_t conflict_count)
 
 void m_reset_temp_arenas(void)
 {
-	for (size_t i = 0; i < ARRAY_COUNT(temp_arenas); i++)
+	temp_arenas_t *temp_arenas = m_current_temp_arenas();
+
+	for (size_t i = 0; i < ARRAY_COUNT(temp_arenas->arenas); i++)
+	{
+		m_reset_and_decommit(&temp_arenas->arenas[i]);
+	}
+}
+
+void m_release_temp_arenas(void)
+{
+	temp_arenas_t *temp_arenas = m_current_temp_arenas();
+
+	for (size_t i = 0; i < ARRAY_COUNT(temp_arenas->arenas); i++)
 	{
-		m_reset_and_decommit(&temp_arenas[i]);
+		m_release(&temp_arenas->arenas[i]);
 	}
 }
 
@@ -293,3 +460,169 @@ void *m_bootstrap_(size_t size, size_t align, size_t arena_offset)
     copy_memory((char *)result + arena_offset, &arena, sizeof(arena));
     return result;
 }
+
+void *m_bootstrap_with_flags_(size_t size, size_t align, size_t arena_offset, size_t capacity, arena_flags_t flags)
+{
+    arena_t arena = { 0 };
+    m_init_with_flags(&arena, capacity, flags);
+
+    void *result = m_alloc(&arena, size, align);
+    copy_memory((char *)result + arena_offset, &arena, sizeof(arena));
+    return result;
+}
+
+//
+// registry
+//
+
+global struct
+{
+	mutex_t        mutex;
+	arena_t        arena; // not registered itself, it'd have to be registered into itself
+	arena_stats_t *first;
+} g_arena_registry;
+
+arena_stats_t *m_register_arena(arena_t *arena, string_t name)
+{
+	if (arena->stats)
+	{
+		return arena->stats;
+	}
+
+	arena_stats_t *stats = NULL;
+
+	char name_buffer[sizeof(stats->name)];
+	string_format_into_buffer(name_buffer, sizeof(name_buffer), "%cs", name);
+
+	mutex_scoped_lock(&g_arena_registry.mutex)
+	{
+		// arenas that come and go under the same name (like the temp arenas of job workers) share an entry,
+		// which keeps the list from growing forever and keeps their high water marks meaningful
+		arena_stats_t **at = &g_arena_registry.first;
+
+		for (; *at; at = &(*at)->next)
+		{
+			if ((*at)->released && string_match(string_from_cstr((*at)->name), string_from_cstr(name_buffer)))
+			{
+				stats = *at;
+				stats->released = false;
+				break;
+			}
+		}
+
+		if (!stats)
+		{
+			stats = m_alloc_struct(&g_arena_registry.arena, arena_stats_t);
+			copy_memory(stats->name, name_buffer, sizeof(stats->name));
+
+			// new entries go at the end, so the list reads in registration order
+			*at = stats;
+		}
+	}
+
+	arena->stats = stats;
+
+	m_stats_note_used     (arena);
+	m_stats_note_committed(arena);
+
+	return stats;
+}
+
+void m_register_temp_arenas(string_t thread_name)
+{
+	for (size_t i = 0; i < ARRAY_COUNT(thread_temp_arenas.arenas); i++)
+	{
+		m_scoped_temp
+		{
+			string_t name = string_format(temp, "%cs temp %zu", thread_name, i);
+			m_register_arena(&thread_temp_arenas.arenas[i], name);
+		}
+	}
+}
+
+void m_update_arena_stats(arena_t *arena)
+{
+	if (arena->stats)
+	{
+		m_stats_note_used     (arena);
+		m_stats_note_committed(arena);
+	}
+}
+
+arena_stats_t *m_get_first_arena_stats(void)
+{
+	arena_stats_t *result = NULL;
+
+	mutex_scoped_lock(&g_arena_registry.mutex)
+	{
+		result = g_arena_registry.first;
+	}
+
+	return result;
+}
+
+fn_local double m_stats_fraction_used(const arena_stats_t *stats)
+{
+	return stats->reserved ? (double)stats->used_high_water / (double)stats->reserved : 0.0;
+}
+
+fn_local int m_compare_arena_stats(const void *l, const void *r, void *user_data)
+{
+	(void)user_data;
+
+	double fraction_l = m_stats_fraction_used(*(const arena_stats_t **)l);
+	double fraction_r = m_stats_fraction_used(*(const arena_stats_t **)r);
+
+	return (fraction_l < fraction_r) - (fraction_l > fraction_r);
+}
+
+string_t m_format_arena_stats(arena_t *arena)
+{
+	string_list_t list = {0};
+
+	arena_t *temp = m_get_temp(&arena, 1);
+
+	m_scoped(temp)
+	{
+		size_t count = 0;
+
+		for (arena_stats_t *stats = m_get_first_arena_stats(); stats; stats = stats->next)
+		{
+			count += 1;
+		}
+
+		arena_stats_t **sorted = m_alloc_array_nozero(temp, count, arena_stats_t *);
+
+		size_t index = 0;
+
+		for (arena_stats_t *stats = m_get_first_arena_stats(); stats && index < count; stats = stats->next)
+		{
+			sorted[index++] = stats;
+		}
+
+		merge_sort_array(sorted, index, m_compare_arena_stats, NULL);
+
+		slist_appendf(&list, arena, "%-32s %10s %10s %10s %10s %10s %8s %8s %8s %7s\n",
+					  "arena", "used", "peak", "committed", "peak", "reserved", "commits", "decommit", "resets", "peak %");
+
+		for (size_t i = 0; i < index; i++)
+		{
+			arena_stats_t *stats = sorted[i];
+
+			slist_appendf(&list, arena, "%-32s %10cs %10cs %10cs %10cs %10cs %8llu %8llu %8llu %6.2f%%%s\n",
+						  stats->name,
+						  string_format_human_readable_bytes(temp, stats->used),
+						  string_format_human_readable_bytes(temp, stats->used_high_water),
+						  string_format_human_readable_bytes(temp, stats->committed),
+						  string_format_human_readable_bytes(temp, stats->committed_high_water),
+						  string_format_human_readable_bytes(temp, stats->reserved),
+						  stats->commit_count,
+						  stats->decommit_count,
+						  stats->reset_count,
+						  100.0*m_stats_fraction_used(stats),
+						  stats->released ? " (released)" : "");
+		}
+	}
+
+	return slist_flatten(&list, arena);
+}
@@ -6,6 +6,13 @@
 
 // initializes arena with pre-allocated memory. this is optional, if you default-initialize an arena it will be backed by 16 GiB of virtual memory
 fn void m_init_with_memory(arena_t *arena, void *memory, size_t size);
+
+// reserves capacity bytes right away instead of on first use. ArenaFlag_large_pages asks for large pages where the OS
+// allows it, which saves a lot of TLB misses for big arenas that get read all over the place (map geometry, BVHs).
+// if large pages aren't available it quietly falls back to regular pages and clears the flag, so check arena->flags
+// to see what you got. on Windows large pages can only be committed all at once, so the whole capacity gets committed
+// up front: keep it close to what the arena actually needs. after m_release the arena is back to a default arena
+fn void m_init_with_flags(arena_t *arena, size_t capacity, arena_flags_t flags);
 fn arena_t *m_child_arena(arena_t *arena, size_t size);
 fn int64_t m_get_alloc_offset(arena_t *arena, void *allocation);
 
@@ -54,10 +61,62 @@ fn void m_scope_end(arena_t *arena);
 fn arena_t *m_get_temp(arena_t **conflicts, size_t conflict_count);
 fn arena_t *m_get_temp_scope_begin(arena_t **conflicts, size_t conflict_count);
 
+// resets the temp arenas m_get_temp currently hands out on this thread
 fn void m_reset_temp_arenas(void);
 
 #define m_scoped(arena) DEFER_LOOP(m_scope_begin(arena), m_scope_end(arena))
 #define m_scoped_temp for (arena_t *temp = m_get_temp_scope_begin(NULL, 0); temp; m_scope_end(temp), temp = NULL)
 
+// releases this thread's temp arenas, for threads that are about to exit
+fn void m_release_temp_arenas(void);
+
+// Makes m_get_temp hand out arenas from another set on this thread, and returns the previous one. Null is the
+// thread's own set. For fibers: a job suspended on one thread can resume on another, so it has to bring its own.
+fn temp_arenas_t *m_swap_temp_arenas(temp_arenas_t *arenas);
+
 fn void *m_bootstrap_(size_t size, size_t align, size_t arena_offset);
 #define m_bootstrap(type, arena) m_bootstrap_(sizeof(type), alignof(type), offsetof(type, arena))
+
+fn void *m_bootstrap_with_flags_(size_t size, size_t align, size_t arena_offset, size_t capacity, arena_flags_t flags);
+#define m_bootstrap_with_flags(type, arena, capacity, flags) m_bootstrap_with_flags_(sizeof(type), alignof(type), offsetof(type, arena), capacity, flags)
+
+//
+// Arena registry. Optional: registering an arena gives it a name and an arena_stats_t that it keeps up to date
+// as it commits, decommits and resets, so you can see which arenas commit how much and which ones are closest
+// to running out of their reservation. Arenas that aren't registered only pay a null check on those paths.
+//
+
+typedef struct arena_stats_t
+{
+	struct arena_stats_t *next;
+
+	char name[64];
+
+	bool released;
+
+	size_t reserved;
+	size_t used;            // as of the last commit, reset or scope end, allocations that fit in committed memory don't report in
+	size_t used_high_water;
+	size_t committed;
+	size_t committed_high_water;
+
+	uint64_t commit_count;
+	uint64_t decommit_count;
+	uint64_t reset_count;
+} arena_stats_t;
+
+// the stats live in the registry, not in the arena, so arenas can still be moved around (like m_bootstrap does)
+fn arena_stats_t *m_register_arena(arena_t *arena, string_t name);
+
+// registers this thread's temp arenas as "<thread_name> temp N"
+fn void m_register_temp_arenas(string_t thread_name);
+
+// brings used and the high water marks up to date, call from the thread that owns the arena
+fn void m_update_arena_stats(arena_t *arena);
+
+// the stats are written by whatever thread owns the arena without synchronization, so other threads
+// can see slightly stale numbers. good enough for a debug display
+fn arena_stats_t *m_get_first_arena_stats(void);
+
+// one line per registered arena, ordered by how much of its reservation it has ever used
+fn string_t m_format_arena_stats(arena_t *arena);
@@ -21,7 +21,7 @@
 #define ALWAYS(expr) ASSERT(expr) // assert behaves like ALWAYS already
 #define NEVER(expr) !ALWAYS(!(expr))
 
-#define FATAL_ERROR(msg, ...) ASSERT_MSG(false, msg, ##__VA_ARGS__)
+#define FATAL_ERROR(msg, ...) (void)ASSERT_MSG(false, msg, ##__VA_ARGS__)
 #define LOUD_ERROR(msg, ...) loud_error(__LINE__, S(__FILE__), msg, ##__VA_ARGS__)
 
 #define INVALID_DEFAULT_CASE default: { FATAL_ERROR("Reached invalid default case!"); } break;
@@ -35,7 +35,11 @@ void fatal_error_va(int line, string_t file, const char *fmt, va_list args);
 #define ARRAY_AT(array, index) (*(ASSERT((index) >= 0 && ((index) < ARRAY_COUNT(array))), &array[index]))
 #define ARRAY_AT_N(array, index, n) (*(ASSERT((index) >= 0 && ((index) < (n))), &array[index]))
 
+#if _MSC_VER
 #define DEBUG_BREAK() __debugbreak()
+#else
+#define DEBUG_BREAK() __builtin_trap()
+#endif
 
 typedef struct debug_break_state_t
 {
@@ -0,0 +1,427 @@
+// ============================================================
+// Copyright 2024 by Daniël Cornelisse, All Rights Reserved.
+// ============================================================
+
+// The sequence counters follow the usual seqlock recipe: writers make the sequence odd, fence, write, and
+// release it even again. Readers load it with acquire, read the entries with relaxed loads, fence, and
+// check the sequence didn't move. Entries are atomics so torn reads are merely retried, not undefined.
+//
+// A reader can see any storage pointer the shard ever had, so all its reads stay within that storage's
+// own mask, and old storage stays mapped until the table is released.
+
+typedef struct concurrent_table_entry_t
+{
+	atomic uint64_t key;
+	atomic uint64_t value;
+} concurrent_table_entry_t;
+
+struct concurrent_table_storage_t
+{
+	concurrent_table_storage_t *next_retired;
+	uint64_t                    mask;
+	concurrent_table_entry_t    entries[];
+};
+
+#define CONCURRENT_TABLE_INITIAL_CAPACITY 64
+
+fn_local concurrent_table_shard_t *concurrent_table_get_shard(concurrent_table_t *table, uint64_t hash)
+{
+	// the top bits pick the shard, the bottom bits the slot, so the two don't correlate
+	return &table->shards[hash >> (64 - CONCURRENT_TABLE_SHARD_COUNT_LOG2)];
+}
+
+fn_local concurrent_table_storage_t *concurrent_table_allocate_storage(uint64_t capacity)
+{
+	size_t size = sizeof(concurrent_table_storage_t) + capacity*sizeof(concurrent_table_entry_t);
+
+	concurrent_table_storage_t *storage = vm_reserve(NULL, size);
+	ASSERT_MSG(storage, "Failed to reserve %zu bytes for a concurrent table shard", size);
+
+	bool commit_result = vm_commit(storage, size);
+	ASSERT(commit_result);
+
+	// freshly committed memory is zeroed, which is exactly an empty table
+	storage->next_retired = NULL;
+	storage->mask         = capacity - 1;
+
+	return storage;
+}
+
+//
+// writing, with the shard locked
+//
+
+fn_local void concurrent_table_begin_write(concurrent_table_shard_t *shard)
+{
+	mutex_lock(&shard->lock);
+
+	uint32_t sequence = atomic_load_explicit(&shard->sequence, memory_order_relaxed);
+	atomic_store_explicit(&shard->sequence, sequence + 1, memory_order_relaxed);
+	atomic_thread_fence(memory_order_release);
+}
+
+fn_local void concurrent_table_end_write(concurrent_table_shard_t *shard)
+{
+	uint32_t sequence = atomic_load_explicit(&shard->sequence, memory_order_relaxed);
+	atomic_store_explicit(&shard->sequence, sequence + 1, memory_order_release);
+
+	mutex_unlock(&shard->lock);
+}
+
+// the storage is private to the writer until it's published, so plain relaxed stores are fine
+fn_local void concurrent_table_put(concurrent_table_storage_t *storage, uint64_t key, uint64_t value)
+{
+	for (uint64_t probe = hash_u64(key) & storage->mask;; probe = (probe + 1) & storage->mask)
+	{
+		concurrent_table_entry_t *entry = &storage->entries[probe];
+
+		if (atomic_load_explicit(&entry->key, memory_order_relaxed) == 0)
+		{
+			atomic_store_explicit(&entry->value, value, memory_order_relaxed);
+			atomic_store_explicit(&entry->key,   key,   memory_order_relaxed);
+			break;
+		}
+	}
+}
+
+fn_local void concurrent_table_grow(concurrent_table_shard_t *shard)
+{
+	concurrent_table_storage_t *old_storage = atomic_load_explicit(&shard->storage, memory_order_relaxed);
+
+	uint64_t new_capacity = old_storage ? 2*(old_storage->mask + 1) : CONCURRENT_TABLE_INITIAL_CAPACITY;
+
+	concurrent_table_storage_t *new_storage = concurrent_table_allocate_storage(new_capacity);
+
+	if (old_storage)
+	{
+		for (uint64_t i = 0; i <= old_storage->mask; i++)
+		{
+			concurrent_table_entry_t *entry = &old_storage->entries[i];
+
+			uint64_t key = atomic_load_explicit(&entry->key, memory_order_relaxed);
+
+			if (key)
+			{
+				concurrent_table_put(new_storage, key, atomic_load_explicit(&entry->value, memory_order_relaxed));
+			}
+		}
+
+		old_storage->next_retired = shard->retired;
+		shard->retired = old_storage;
+	}
+
+	atomic_store_explicit(&shard->storage, new_storage, memory_order_release);
+}
+
+//
+// reading, from anywhere
+//
+
+// returns the storage the shard had when the read started, and the sequence to validate the read with
+fn_local concurrent_table_storage_t *concurrent_table_begin_read(concurrent_table_shard_t *shard, uint32_t *sequence)
+{
+	for (;;)
+	{
+		*sequence = atomic_load_explicit(&shard->sequence, memory_order_acquire);
+
+		if (!(*sequence & 1))
+			break;
+
+		_mm_pause();
+	}
+
+	return atomic_load_explicit(&shard->storage, memory_order_acquire);
+}
+
+fn_local bool concurrent_table_end_read(concurrent_table_shard_t *shard, uint32_t sequence)
+{
+	atomic_thread_fence(memory_order_acquire);
+	return atomic_load_explicit(&shard->sequence, memory_order_relaxed) == sequence;
+}
+
+bool concurrent_table_find(concurrent_table_t *table, uint64_t key, uint64_t *value)
+{
+	// a null hash is a fine thing to look up, it's just never there
+	if (key == 0)
+		return false;
+
+	uint64_t hash = hash_u64(key);
+
+	concurrent_table_shard_t *shard = concurrent_table_get_shard(table, hash);
+
+	for (;;)
+	{
+		uint32_t sequence;
+		concurrent_table_storage_t *storage = concurrent_table_begin_read(shard, &sequence);
+
+		bool     found       = false;
+		uint64_t found_value = 0;
+
+		if (storage)
+		{
+			uint64_t mask  = storage->mask;
+			uint64_t probe = hash & mask;
+
+			// bounded, because mid-write the table might briefly look like it has no empty slots
+			for (uint64_t i = 0; i <= mask; i++)
+			{
+				concurrent_table_entry_t *entry = &storage->entries[probe];
+
+				uint64_t entry_key = atomic_load_explicit(&entry->key, memory_order_relaxed);
+
+				if (entry_key == 0)
+					break;
+
+				if (entry_key == key)
+				{
+					found_value = atomic_load_explicit(&entry->value, memory_order_relaxed);
+					found       = true;
+					break;
+				}
+
+				probe = (probe + 1) & mask;
+			}
+		}
+
+		if (concurrent_table_end_read(shard, sequence))
+		{
+			if (found && value)
+			{
+				*value = found_value;
+			}
+
+			return found;
+		}
+	}
+}
+
+void concurrent_table_insert(concurrent_table_t *table, uint64_t key, uint64_t value)
+{
+	ASSERT_MSG(key != 0, "Key 0 is reserved");
+
+	uint64_t hash = hash_u64(key);
+
+	concurrent_table_shard_t *shard = concurrent_table_get_shard(table, hash);
+
+	concurrent_table_begin_write(shard);
+
+	concurrent_table_storage_t *storage = atomic_load_explicit(&shard->storage, memory_order_relaxed);
+
+	uint64_t load = atomic_load_explicit(&shard->load, memory_order_relaxed);
+
+	// growing a bit early keeps the probe runs short, which matters more here since readers retry whole probes
+	if (!storage || 4*(load + 1) > 3*(storage->mask + 1))
+	{
+		concurrent_table_grow(shard);
+		storage = atomic_load_explicit(&shard->storage, memory_order_relaxed);
+	}
+
+	for (uint64_t probe = hash & storage->mask;; probe = (probe + 1) & storage->mask)
+	{
+		concurrent_table_entry_t *entry = &storage->entries[probe];
+
+		uint64_t entry_key = atomic_load_explicit(&entry->key, memory_order_relaxed);
+
+		if (entry_key == key)
+		{
+			atomic_store_explicit(&entry->value, value, memory_order_relaxed);
+			break;
+		}
+
+		if (entry_key == 0)
+		{
+			atomic_store_explicit(&entry->value, value, memory_order_relaxed);
+			atomic_store_explicit(&entry->key,   key,   memory_order_relaxed);
+			atomic_store_explicit(&shard->load,  load + 1, memory_order_relaxed);
+			break;
+		}
+	}
+
+	concurrent_table_end_write(shard);
+}
+
+bool concurrent_table_remove(concurrent_table_t *table, uint64_t key)
+{
+	ASSERT_MSG(key != 0, "Key 0 is reserved");
+
+	uint64_t hash = hash_u64(key);
+
+	concurrent_table_shard_t *shard = concurrent_table_get_shard(table, hash);
+
+	bool result = false;
+
+	concurrent_table_begin_write(shard);
+
+	concurrent_table_storage_t *storage = atomic_load_explicit(&shard->storage, memory_order_relaxed);
+
+	if (storage)
+	{
+		uint64_t mask = storage->mask;
+		uint64_t i    = hash & mask;
+
+		for (;; i = (i + 1) & mask)
+		{
+			uint64_t entry_key = atomic_load_explicit(&storage->entries[i].key, memory_order_relaxed);
+
+			if (entry_key == 0)
+				break;
+
+			if (entry_key == key)
+			{
+				result = true;
+				break;
+			}
+		}
+
+		if (result)
+		{
+			atomic_store_explicit(&storage->entries[i].key, 0, memory_order_relaxed);
+			atomic_fetch_sub_explicit(&shard->load, 1, memory_order_relaxed);
+
+			// same backward shift as table_remove, so there are no tombstones
+			uint64_t j = i;
+			for (;;)
+			{
+				j = (j + 1) & mask;
+
+				uint64_t j_key = atomic_load_explicit(&storage->entries[j].key, memory_order_relaxed);
+
+				if (j_key == 0)
+					break;
+
+				uint64_t k = hash_u64(j_key) & mask;
+
+				if (i <= j)
+				{
+					if (i < k && k <= j)
+						continue;
+				}
+				else
+				{
+					if (i < k || k <= j)
+						continue;
+				}
+
+				atomic_store_explicit(&storage->entries[i].value, atomic_load_explicit(&storage->entries[j].value, memory_order_relaxed), memory_order_relaxed);
+				atomic_store_explicit(&storage->entries[i].key,   j_key, memory_order_relaxed);
+				atomic_store_explicit(&storage->entries[j].key,   0,     memory_order_relaxed);
+				i = j;
+			}
+		}
+	}
+
+	concurrent_table_end_write(shard);
+
+	return result;
+}
+
+void *concurrent_table_find_object(concurrent_table_t *table, uint64_t key)
+{
+	uint64_t result = 0;
+	concurrent_table_find(table, key, &result);
+	return (void *)result;
+}
+
+void concurrent_table_insert_object(concurrent_table_t *table, uint64_t key, void *value)
+{
+	concurrent_table_insert(table, key, (uint64_t)value);
+}
+
+size_t concurrent_table_count(concurrent_table_t *table)
+{
+	size_t result = 0;
+
+	for (size_t i = 0; i < CONCURRENT_TABLE_SHARD_COUNT; i++)
+	{
+		result += atomic_load_explicit(&table->shards[i].load, memory_order_relaxed);
+	}
+
+	return result;
+}
+
+void concurrent_table_release(concurrent_table_t *table)
+{
+	for (size_t i = 0; i < CONCURRENT_TABLE_SHARD_COUNT; i++)
+	{
+		concurrent_table_shard_t *shard = &table->shards[i];
+
+		concurrent_table_storage_t *storage = atomic_load_explicit(&shard->storage, memory_order_relaxed);
+
+		if (storage)
+		{
+			vm_release(storage);
+		}
+
+		for (concurrent_table_storage_t *retired = shard->retired; retired;)
+		{
+			concurrent_table_storage_t *next = retired->next_retired;
+			vm_release(retired);
+			retired = next;
+		}
+	}
+
+	zero_struct(table);
+}
+
+concurrent_table_iter_t concurrent_table_iter(concurrent_table_t *table)
+{
+	concurrent_table_iter_t it = {
+		.table = table,
+		.i     = (uint64_t)-1,
+	};
+
+	return it;
+}
+
+bool concurrent_table_iter_next(concurrent_table_iter_t *it)
+{
+	bool result = false;
+
+	while (it->shard_index < CONCURRENT_TABLE_SHARD_COUNT)
+	{
+		concurrent_table_shard_t *shard = &it->table->shards[it->shard_index];
+
+		bool     past_end = false;
+		uint64_t key      = 0;
+		uint64_t value    = 0;
+
+		for (;;)
+		{
+			uint32_t sequence;
+			concurrent_table_storage_t *storage = concurrent_table_begin_read(shard, &sequence);
+
+			past_end = !storage || it->slot_index > storage->mask;
+
+			if (!past_end)
+			{
+				key   = atomic_load_explicit(&storage->entries[it->slot_index].key,   memory_order_relaxed);
+				value = atomic_load_explicit(&storage->entries[it->slot_index].value, memory_order_relaxed);
+			}
+
+			if (concurrent_table_end_read(shard, sequence))
+				break;
+		}
+
+		if (past_end)
+		{
+			it->shard_index += 1;
+			it->slot_index   = 0;
+			continue;
+		}
+
+		it->slot_index += 1;
+
+		if (key)
+		{
+			it->key   = key;
+			it->value = value;
+
+			result = true;
+			break;
+		}
+	}
+
+	it->i += 1;
+
+	return result;
+}
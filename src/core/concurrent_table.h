@@ -0,0 +1,67 @@
+// ============================================================
+// Copyright 2024 by Daniël Cornelisse, All Rights Reserved.
+// ============================================================
+
+#pragma once
+
+// Hash table that can be read from any number of threads while others write to it. Keys are spread over
+// CONCURRENT_TABLE_SHARD_COUNT shards, each a linear probing table of its own with a mutex for writers and
+// a sequence counter that's odd while a write is in progress. Readers never lock or write anything shared:
+// they remember the sequence, probe, and retry if it changed under them.
+//
+// Growing a shard doesn't free the old entry arrays, since a reader might still be probing them. They're
+// kept until concurrent_table_release, which at most doubles the memory used by the entries.
+//
+// Key 0 is reserved, it can't be inserted and is never found. A zero-initialized concurrent_table_t is ready to use.
+
+#define CONCURRENT_TABLE_SHARD_COUNT_LOG2 6
+#define CONCURRENT_TABLE_SHARD_COUNT      (1 << CONCURRENT_TABLE_SHARD_COUNT_LOG2)
+
+typedef struct concurrent_table_storage_t concurrent_table_storage_t;
+
+typedef struct concurrent_table_shard_t
+{
+	alignas(CACHE_LINE_SIZE) atomic uint32_t sequence;
+
+	mutex_t         lock;
+	atomic uint64_t load;
+
+	_Atomic(concurrent_table_storage_t *) storage;
+	concurrent_table_storage_t           *retired; // storage that got replaced by a bigger one
+} concurrent_table_shard_t;
+
+typedef struct concurrent_table_t
+{
+	concurrent_table_shard_t shards[CONCURRENT_TABLE_SHARD_COUNT];
+} concurrent_table_t;
+
+fn bool   concurrent_table_find         (concurrent_table_t *table, uint64_t key, uint64_t *value);
+fn void   concurrent_table_insert       (concurrent_table_t *table, uint64_t key, uint64_t  value);
+fn bool   concurrent_table_remove       (concurrent_table_t *table, uint64_t key);
+fn void  *concurrent_table_find_object  (concurrent_table_t *table, uint64_t key);
+fn void   concurrent_table_insert_object(concurrent_table_t *table, uint64_t key, void *value);
+fn size_t concurrent_table_count        (concurrent_table_t *table); // only exact while nobody's writing
+fn void   concurrent_table_release      (concurrent_table_t *table); // no other thread can be using the table
+
+// Iteration reads one entry at a time, so entries inserted or removed while iterating may or may not show up,
+// and one moved by a concurrent removal could be seen twice or not at all.
+typedef struct concurrent_table_iter_t
+{
+	// internal state
+	concurrent_table_t *table;
+	uint32_t            shard_index;
+	uint64_t            slot_index;
+
+	uint64_t i;
+	uint64_t key;
+
+	// iterator result
+	union
+	{
+		uint64_t value;
+		void    *ptr;
+	};
+} concurrent_table_iter_t;
+
+fn concurrent_table_iter_t concurrent_table_iter     (concurrent_table_t *table);
+fn bool                    concurrent_table_iter_next(concurrent_table_iter_t *it);
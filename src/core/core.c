@@ -4,18 +4,29 @@
 
 #include "core.h"
 
+#if PLATFORM_LINUX
+// the portable files call into libc (memcpy, strcmp, fprintf, ...) so the system headers need to come first
+#include "core_linux.h"
+#endif
+
 #include "arena.c"
 #include "args_parser.c"
+#include "concurrent_table.c"
+#include "cpu_features.c"
 #include "simple_heap.c"
+#include "heap.c"
 
+#include "fs.c"
 #include "hashtable.c"
 #include "math.c"
 #include "pool.c"
+#include "simd_kernels.c"
 #include "sort.c"
 #include "stretchy_buffer.c"
 #include "string.c"
 #include "string_list.c"
 #include "thread.c"
+#include "thread_stress_test.c"
 #include "tls.c"
 #include "utility.c"
 
@@ -26,4 +37,9 @@
 #include "fs_win32.c"
 #include "os_win32.c"
 #include "thread_win32.c"
+#elif PLATFORM_LINUX
+#include "file_watcher_linux.c"
+#include "fs_linux.c"
+#include "os_linux.c"
+#include "thread_linux.c"
 #endif
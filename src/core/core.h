@@ -13,9 +13,11 @@
 #include "arena.h"
 #include "args_parser.h"
 #include "array.h"
-// #include "atomics.h"
+#include "atomics.h"
 #include "common.h"
+#include "concurrent_table.h"
 #include "core.h"
+#include "cpu_features.h"
 #include "dynamic_string.h"
 #include "file_watcher.h"
 #include "fs.h"
@@ -29,6 +31,7 @@
 #include "polymorphic_pool.h"
 #include "pool.h"
 #include "random.h"
+#include "simd_kernels.h"
 #include "simple_heap.h"
 #include "sort.h"
 #include "stretchy_buffer.h"
@@ -0,0 +1,198 @@
+// ============================================================
+// Copyright 2024 by Daniël Cornelisse, All Rights Reserved.
+// ============================================================
+
+global cpu_features_t  g_cpu_features;
+global atomic uint32_t g_cpu_features_state; // 0 = not detected, 1 = detecting, 2 = done
+
+fn_local void cpuid(uint32_t leaf, uint32_t subleaf, uint32_t regs[4])
+{
+#if _MSC_VER
+	int info[4];
+	__cpuidex(info, (int)leaf, (int)subleaf);
+
+	regs[0] = (uint32_t)info[0];
+	regs[1] = (uint32_t)info[1];
+	regs[2] = (uint32_t)info[2];
+	regs[3] = (uint32_t)info[3];
+#else
+	__cpuid_count(leaf, subleaf, regs[0], regs[1], regs[2], regs[3]);
+#endif
+}
+
+fn_local uint64_t read_xcr0(void)
+{
+#if _MSC_VER
+	return _xgetbv(0);
+#else
+	// _xgetbv wants the whole file compiled with -mxsave
+	uint32_t lo, hi;
+	__asm__ volatile ("xgetbv" : "=a"(lo), "=d"(hi) : "c"(0));
+	return ((uint64_t)hi << 32)|lo;
+#endif
+}
+
+fn_local void detect_cpu_features(cpu_features_t *features)
+{
+	uint32_t regs[4];
+
+	cpuid(0, 0, regs);
+
+	uint32_t max_leaf = regs[0];
+
+	copy_memory(features->vendor + 0, &regs[1], 4); // ebx
+	copy_memory(features->vendor + 4, &regs[3], 4); // edx
+	copy_memory(features->vendor + 8, &regs[2], 4); // ecx
+
+	cpuid(0x80000000, 0, regs);
+
+	if (regs[0] >= 0x80000004)
+	{
+		for (uint32_t i = 0; i < 3; i++)
+		{
+			cpuid(0x80000002 + i, 0, regs);
+			copy_memory(features->brand + 16*i, regs, 16);
+		}
+	}
+
+	cpu_feature_flags_t flags = 0;
+
+	if (max_leaf >= 1)
+	{
+		cpuid(1, 0, regs);
+
+		uint32_t ecx = regs[2];
+		uint32_t edx = regs[3];
+
+		if (edx & (1u << 26)) flags |= CpuFeature_sse2;
+		if (ecx & (1u << 0))  flags |= CpuFeature_sse3;
+		if (ecx & (1u << 9))  flags |= CpuFeature_ssse3;
+		if (ecx & (1u << 19)) flags |= CpuFeature_sse41;
+		if (ecx & (1u << 20)) flags |= CpuFeature_sse42;
+		if (ecx & (1u << 23)) flags |= CpuFeature_popcnt;
+
+		// the OS has to have turned on xsave and be saving the ymm (and for AVX-512 the opmask and zmm) state
+		bool os_saves_ymm = false;
+		bool os_saves_zmm = false;
+
+		if (ecx & (1u << 27))
+		{
+			uint64_t xcr0 = read_xcr0();
+			os_saves_ymm = (xcr0 & 0x6)  == 0x6;
+			os_saves_zmm = (xcr0 & 0xE6) == 0xE6;
+		}
+
+		if (os_saves_ymm)
+		{
+			if (ecx & (1u << 28)) flags |= CpuFeature_avx;
+			if (ecx & (1u << 12)) flags |= CpuFeature_fma;
+		}
+
+		if (max_leaf >= 7)
+		{
+			cpuid(7, 0, regs);
+
+			uint32_t ebx = regs[1];
+
+			if (ebx & (1u << 3)) flags |= CpuFeature_bmi1;
+			if (ebx & (1u << 8)) flags |= CpuFeature_bmi2;
+
+			if (os_saves_ymm)
+			{
+				if (ebx & (1u << 5)) flags |= CpuFeature_avx2;
+			}
+
+			if (os_saves_zmm)
+			{
+				if (ebx & (1u << 16)) flags |= CpuFeature_avx512f;
+				if (ebx & (1u << 17)) flags |= CpuFeature_avx512dq;
+				if (ebx & (1u << 30)) flags |= CpuFeature_avx512bw;
+				if (ebx & (1u << 31)) flags |= CpuFeature_avx512vl;
+			}
+		}
+	}
+
+	// we can't be running if there's no SSE2
+	flags |= CpuFeature_sse2;
+
+	features->flags = flags;
+
+	features->best_simd_tier = SimdTier_sse2;
+
+	if (flags & CpuFeature_avx2)
+	{
+		features->best_simd_tier = SimdTier_avx2;
+	}
+
+	if ((flags & CpuFeature_avx2) && (flags & CpuFeature_avx512f))
+	{
+		features->best_simd_tier = SimdTier_avx512;
+	}
+}
+
+const cpu_features_t *query_cpu_features(void)
+{
+	uint32_t state = atomic_load(&g_cpu_features_state);
+
+	if (state != 2)
+	{
+		uint32_t expected = 0;
+
+		if (atomic_compare_exchange_strong(&g_cpu_features_state, &expected, 1))
+		{
+			detect_cpu_features(&g_cpu_features);
+			atomic_store(&g_cpu_features_state, 2);
+		}
+		else
+		{
+			while (atomic_load(&g_cpu_features_state) != 2)
+			{
+				_mm_pause();
+			}
+		}
+	}
+
+	return &g_cpu_features;
+}
+
+bool cpu_has_features(cpu_feature_flags_t flags)
+{
+	return (query_cpu_features()->flags & flags) == flags;
+}
+
+bool cpu_supports_simd_tier(simd_tier_t tier)
+{
+	return tier >= 0 && tier <= query_cpu_features()->best_simd_tier;
+}
+
+global string_t g_simd_tier_names[SimdTier_COUNT] = {
+	[SimdTier_sse2]   = Sc("sse2"),
+	[SimdTier_avx2]   = Sc("avx2"),
+	[SimdTier_avx512] = Sc("avx512"),
+};
+
+string_t simd_tier_name(simd_tier_t tier)
+{
+	string_t result = S("unknown");
+
+	if (tier >= 0 && tier < SimdTier_COUNT)
+	{
+		result = g_simd_tier_names[tier];
+	}
+
+	return result;
+}
+
+bool simd_tier_from_name(string_t name, simd_tier_t *tier)
+{
+	for (size_t i = 0; i < SimdTier_COUNT; i++)
+	{
+		if (string_match_nocase(name, g_simd_tier_names[i]))
+		{
+			*tier = (simd_tier_t)i;
+			return true;
+		}
+	}
+
+	return false;
+}
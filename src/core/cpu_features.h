@@ -0,0 +1,58 @@
+// ============================================================
+// Copyright 2024 by Daniël Cornelisse, All Rights Reserved.
+// ============================================================
+
+#pragma once
+
+//
+// features
+//
+
+// Detected once with cpuid. Extensions that add register state (AVX and up) are only reported if the OS
+// also saves that state on a context switch, so a set flag means the instructions are actually usable.
+
+typedef uint32_t cpu_feature_flags_t;
+typedef enum cpu_feature_flags_enum_t
+{
+	CpuFeature_sse2     = 1 << 0,
+	CpuFeature_sse3     = 1 << 1,
+	CpuFeature_ssse3    = 1 << 2,
+	CpuFeature_sse41    = 1 << 3,
+	CpuFeature_sse42    = 1 << 4,
+	CpuFeature_popcnt   = 1 << 5,
+	CpuFeature_avx      = 1 << 6,
+	CpuFeature_fma      = 1 << 7,
+	CpuFeature_avx2     = 1 << 8,
+	CpuFeature_bmi1     = 1 << 9,
+	CpuFeature_bmi2     = 1 << 10,
+	CpuFeature_avx512f  = 1 << 11,
+	CpuFeature_avx512dq = 1 << 12,
+	CpuFeature_avx512bw = 1 << 13,
+	CpuFeature_avx512vl = 1 << 14,
+} cpu_feature_flags_enum_t;
+
+// The instruction sets hot kernels get compiled for, see simd_kernels.h
+typedef enum simd_tier_t
+{
+	SimdTier_sse2,   // the x64 baseline, always there
+	SimdTier_avx2,   // needs avx2
+	SimdTier_avx512, // needs avx512f and avx2, it shares some kernels with the avx2 tier
+
+	SimdTier_COUNT,
+} simd_tier_t;
+
+typedef struct cpu_features_t
+{
+	cpu_feature_flags_t flags;
+	simd_tier_t         best_simd_tier;
+
+	char vendor[16]; // e.g. GenuineIntel, null terminated
+	char brand [64]; // e.g. AMD Ryzen 9 7950X 16-Core Processor, null terminated
+} cpu_features_t;
+
+fn const cpu_features_t *query_cpu_features(void);
+fn bool                  cpu_has_features(cpu_feature_flags_t flags); // true if all of the flags are supported
+fn bool                  cpu_supports_simd_tier(simd_tier_t tier);
+
+fn string_t              simd_tier_name(simd_tier_t tier);
+fn bool                  simd_tier_from_name(string_t name, simd_tier_t *tier); // case insensitive
@@ -0,0 +1,349 @@
+// ============================================================
+// Copyright 2024 by Daniël Cornelisse, All Rights Reserved.
+// ============================================================
+
+// inotify implementation of file_watcher.h. inotify doesn't watch recursively, so every directory under
+// a watched root gets its own watch descriptor, including directories that get created later on.
+
+typedef struct linux_watch_t
+{
+	struct linux_watch_t *next;
+
+	int                       wd;
+	file_watcher_directory_t *root;
+	string_t                  subpath; // relative to root, empty for the root itself
+	bool                      moved_away; // saw IN_MOVED_FROM, waiting to see if it lands back in the tree
+} linux_watch_t;
+
+typedef struct file_watcher_os_t
+{
+	int inotify_fd;
+	int init_errno;
+
+	linux_watch_t *first_watch;
+	linux_watch_t *first_free_watch;
+
+	size_t buffer_size;
+	char  *buffer;
+} file_watcher_os_t;
+
+typedef struct file_watcher_directory_os_t
+{
+	int unused;
+} file_watcher_directory_os_t;
+
+#define LINUX_WATCH_MASK (IN_CREATE|IN_DELETE|IN_CLOSE_WRITE|IN_MOVED_FROM|IN_MOVED_TO|IN_MOVE_SELF|IN_ONLYDIR)
+
+void file_watcher_init(file_watcher_t *watcher)
+{
+	watcher->os = m_alloc_struct(&watcher->arena, file_watcher_os_t);
+	watcher->os->inotify_fd  = inotify_init1(IN_NONBLOCK|IN_CLOEXEC);
+	watcher->os->buffer_size = KB(256);
+	watcher->os->buffer      = m_alloc_nozero(&watcher->arena, watcher->os->buffer_size, 16);
+
+	if (watcher->os->inotify_fd == -1)
+	{
+		watcher->os->init_errno = errno;
+		debug_print("inotify_init1 failed: %s\n", strerror(errno));
+	}
+}
+
+void file_watcher_release(file_watcher_t *watcher)
+{
+	if (watcher->os && watcher->os->inotify_fd != -1)
+	{
+		// closing the inotify instance drops all of its watches
+		close(watcher->os->inotify_fd);
+	}
+
+	m_release(&watcher->arena);
+}
+
+fn_local bool file_watcher__is_descendant(linux_watch_t *watch, file_watcher_directory_t *root, string_t subpath)
+{
+	if (watch->root != root || watch->subpath.count <= subpath.count)
+		return false;
+
+	if (subpath.count == 0)
+		return true;
+
+	return (string_match_prefix(watch->subpath, subpath) &&
+			watch->subpath.data[subpath.count] == '/');
+}
+
+fn_local linux_watch_t *file_watcher__find_watch_by_subpath(file_watcher_t *watcher, file_watcher_directory_t *root, string_t subpath)
+{
+	for (linux_watch_t *watch = watcher->os->first_watch; watch; watch = watch->next)
+	{
+		if (watch->root == root && string_match(watch->subpath, subpath))
+			return watch;
+	}
+
+	return NULL;
+}
+
+// a directory moved within the tree keeps its watch descriptor (and so do all the directories under it),
+// but every one of their subpaths is now stale
+fn_local void file_watcher__rename_watch(file_watcher_t *watcher, linux_watch_t *renamed, string_t subpath)
+{
+	file_watcher_os_t *os = watcher->os;
+
+	string_t old_subpath = renamed->subpath;
+
+	for (linux_watch_t *watch = os->first_watch; watch; watch = watch->next)
+	{
+		if (watch != renamed && file_watcher__is_descendant(watch, renamed->root, old_subpath))
+		{
+			string_t rest = substring(watch->subpath, old_subpath.count, watch->subpath.count - old_subpath.count);
+			watch->subpath    = string_format(&watcher->arena, "%cs%cs", subpath, rest);
+			watch->moved_away = false;
+		}
+	}
+
+	renamed->subpath    = m_copy_string(&watcher->arena, subpath);
+	renamed->moved_away = false;
+}
+
+fn_local void file_watcher__add_watch(file_watcher_t *watcher, file_watcher_directory_t *root, string_t subpath)
+{
+	file_watcher_os_t *os = watcher->os;
+
+	int wd = -1;
+
+	m_scoped_temp
+	{
+		string_t path = subpath.count ? string_format(temp, "%cs/%cs", root->path, subpath) : root->path;
+		wd = inotify_add_watch(os->inotify_fd, string_null_terminate(temp, path).data, LINUX_WATCH_MASK);
+
+		if (wd == -1)
+		{
+			debug_print("inotify_add_watch failed for %.*s: %s\n", (int)path.count, path.data, strerror(errno));
+		}
+	}
+
+	if (wd == -1)
+		return;
+
+	// inotify hands out the same descriptor when a directory is watched twice, which is also what
+	// happens when a watched directory gets moved somewhere else inside the tree
+	linux_watch_t *existing = NULL;
+
+	for (linux_watch_t *watch = os->first_watch; watch; watch = watch->next)
+	{
+		if (watch->wd == wd)
+		{
+			existing = watch;
+			break;
+		}
+	}
+
+	if (existing)
+	{
+		if (existing->root == root && string_match(existing->subpath, subpath))
+			return;
+
+		// moved: fix up the subpaths and fall through to rescan, in case it picked up children on the way
+		file_watcher__rename_watch(watcher, existing, subpath);
+	}
+	else
+	{
+		linux_watch_t *watch = NULL;
+
+		if (os->first_free_watch)
+		{
+			watch = sll_pop(os->first_free_watch);
+			zero_struct(watch);
+		}
+		else
+		{
+			watch = m_alloc_struct(&watcher->arena, linux_watch_t);
+		}
+
+		watch->wd      = wd;
+		watch->root    = root;
+		watch->subpath = subpath.count ? m_copy_string(&watcher->arena, subpath) : subpath;
+
+		sll_push(os->first_watch, watch);
+	}
+
+	// the directory may already have children, which need their own watches
+	m_scoped_temp
+	{
+		string_t path = subpath.count ? string_format(temp, "%cs/%cs", root->path, subpath) : root->path;
+
+		for (fs_entry_t *entry = fs_scan_directory(temp, path, FsScanDirectory_dont_skip_dotfiles);
+			 entry;
+			 entry = entry->next)
+		{
+			if (entry->kind == FsEntryKind_directory)
+			{
+				string_t child = subpath.count ? string_format(temp, "%cs/%cs", subpath, entry->name) : entry->name;
+				file_watcher__add_watch(watcher, root, child);
+			}
+		}
+	}
+}
+
+fn_local linux_watch_t *file_watcher__find_watch(file_watcher_t *watcher, int wd)
+{
+	for (linux_watch_t *watch = watcher->os->first_watch; watch; watch = watch->next)
+	{
+		if (watch->wd == wd)
+			return watch;
+	}
+
+	return NULL;
+}
+
+fn_local void file_watcher__remove_watch(file_watcher_t *watcher, int wd)
+{
+	file_watcher_os_t *os = watcher->os;
+
+	for (linux_watch_t **at = &os->first_watch; *at; at = &(*at)->next)
+	{
+		linux_watch_t *watch = *at;
+
+		if (watch->wd == wd)
+		{
+			*at = watch->next;
+			sll_push(os->first_free_watch, watch);
+			break;
+		}
+	}
+}
+
+void file_watcher_add_directory(file_watcher_t *watcher, string_t directory)
+{
+	if (watcher->os->inotify_fd == -1)
+	{
+		debug_print("Failed to watch directory %.*s: inotify instance is not available (%s)\n",
+					(int)directory.count, directory.data, strerror(watcher->os->init_errno));
+		return;
+	}
+
+	file_watcher_directory_t *dir = m_alloc_struct(&watcher->arena, file_watcher_directory_t);
+	dir->os                       = m_alloc_struct(&watcher->arena, file_watcher_directory_os_t);
+
+	dir->path = m_copy_string(&watcher->arena, directory);
+
+	dir->next = watcher->first_directory;
+	watcher->first_directory = dir;
+
+	file_watcher__add_watch(watcher, dir, S(""));
+}
+
+file_event_t *file_watcher_get_events(file_watcher_t *watcher, arena_t *arena)
+{
+	file_event_t *head_event = NULL;
+	file_event_t *tail_event = NULL;
+
+	file_watcher_os_t *os = watcher->os;
+
+	if (os->inotify_fd == -1)
+	{
+		return NULL;
+	}
+
+	for (;;)
+	{
+		ssize_t bytes_read = read(os->inotify_fd, os->buffer, os->buffer_size);
+
+		if (bytes_read < 0 && errno == EINTR)
+			continue;
+
+		if (bytes_read <= 0)
+			break;
+
+		for (char *at = os->buffer; at < os->buffer + bytes_read;)
+		{
+			struct inotify_event *notif = (struct inotify_event *)at;
+			at += sizeof(struct inotify_event) + notif->len;
+
+			if (notif->mask & IN_Q_OVERFLOW)
+			{
+				debug_print("File watcher overflow!");
+				continue;
+			}
+
+			if (notif->mask & IN_IGNORED)
+			{
+				// the directory went away (or got unwatched), its descriptor is dead now
+				file_watcher__remove_watch(watcher, notif->wd);
+				continue;
+			}
+
+			linux_watch_t *watch = file_watcher__find_watch(watcher, notif->wd);
+
+			if (!watch)
+				continue;
+
+			if (notif->mask & IN_MOVE_SELF)
+			{
+				// a directory that was moved within the tree got its IN_MOVED_TO before this and is no longer
+				// moved_away. if it still is, it left the tree, so stop watching it and everything under it
+				if (watch->moved_away)
+				{
+					for (linux_watch_t *child = os->first_watch; child; child = child->next)
+					{
+						if (file_watcher__is_descendant(child, watch->root, watch->subpath))
+						{
+							inotify_rm_watch(os->inotify_fd, child->wd);
+						}
+					}
+
+					inotify_rm_watch(os->inotify_fd, watch->wd);
+				}
+				continue;
+			}
+
+			if (notif->len == 0)
+				continue;
+
+			string_t name = string_from_cstr(notif->name);
+
+			if (watch->subpath.count)
+			{
+				name = string_format(arena, "%cs/%cs", watch->subpath, name);
+			}
+			else
+			{
+				name = m_copy_string(arena, name);
+			}
+
+			uint32_t flags = 0;
+
+			if (notif->mask & IN_CREATE)      flags |= FileEvent_Added;
+			if (notif->mask & IN_DELETE)      flags |= FileEvent_Removed;
+			if (notif->mask & IN_CLOSE_WRITE) flags |= FileEvent_Modified;
+			if (notif->mask & IN_MOVED_FROM)  flags |= FileEvent_Renamed|FileEvent_Renamed_OldName;
+			if (notif->mask & IN_MOVED_TO)    flags |= FileEvent_Renamed|FileEvent_Renamed_NewName;
+
+			if ((notif->mask & IN_ISDIR) && (notif->mask & IN_MOVED_FROM))
+			{
+				linux_watch_t *moved = file_watcher__find_watch_by_subpath(watcher, watch->root, name);
+
+				if (moved)
+				{
+					moved->moved_away = true;
+				}
+			}
+
+			// new directories (created or moved in) need watches of their own to keep things recursive.
+			// directories moved within the tree come back with their old descriptor and get their subpaths updated
+			if ((notif->mask & IN_ISDIR) && (notif->mask & (IN_CREATE|IN_MOVED_TO)))
+			{
+				file_watcher__add_watch(watcher, watch->root, name);
+			}
+
+			file_event_t *event = m_alloc_struct(arena, file_event_t);
+
+			event->name  = name;
+			event->path  = string_format(arena, "%cs/%cs", watch->root->path, event->name);
+			event->flags = flags;
+
+			sll_push_back(head_event, tail_event, event);
+		}
+	}
+
+	return head_event;
+}
@@ -0,0 +1,87 @@
+// ============================================================
+// Copyright 2024 by Daniël Cornelisse, All Rights Reserved.
+// ============================================================
+
+// platform independent parts of fs.h, the rest lives in fs_win32.c / fs_linux.c
+
+fs_entry_t *fs_entry_next(fs_entry_t *entry)
+{
+    fs_entry_t *next = NULL;
+
+    if (entry->first_child)
+    {
+        next = entry->first_child;
+    }
+    else
+    {
+        if (entry->next)
+        {
+            next = entry->next;
+        }
+        else
+        {
+            fs_entry_t *p = entry;
+            while (p)
+            {
+                if (p->next)
+                {
+                    next = p->next;
+                    break;
+                }
+
+                p = p->parent;
+            }
+        }
+    }
+
+    return next;
+}
+
+fs_create_directory_result_t fs_create_directory_recursive(string_t directory)
+{
+    fs_create_directory_result_t result = FsCreateDirectory_success;
+
+    size_t at = 0;
+
+    while (at < directory.count)
+    {
+        string_t sub_directory = {0};
+
+        while (at < directory.count)
+        {
+            if (directory.data[at] == '/' ||
+                directory.data[at] == '\\')
+            {
+                sub_directory = substring(directory, 0, at);
+
+                at += 1;
+                break;
+            }
+            else
+            {
+                at += 1;
+            }
+        }
+
+        if (at >= directory.count && sub_directory.count == 0)
+        {
+            sub_directory = directory;
+        }
+
+        if (sub_directory.count == 0)
+        {
+            // leading separator of an absolute path, there's no directory to create for it
+            continue;
+        }
+
+        result = fs_create_directory(sub_directory);
+
+        if (result != FsCreateDirectory_success &&
+            result != FsCreateDirectory_already_exists)
+        {
+            break;
+        }
+    }
+
+    return result;
+}
@@ -7,6 +7,12 @@
 fn string_t fs_read_entire_file (arena_t *arena, string_t path);
 fn bool     fs_write_entire_file(string_t path, string_t file);
 
+// Maps a whole file into memory read-only, instead of copying it into an arena. The cheaper way to read big files
+// that are only looked at once. The result is not null terminated, and data is null if the file couldn't be mapped.
+// Don't write to the file while it's mapped.
+fn string_t fs_map_file  (string_t path);
+fn void     fs_unmap_file(string_t mapped_file);
+
 fn bool fs_copy(string_t source, string_t destination);
 fn bool fs_move(string_t source, string_t destination);
 
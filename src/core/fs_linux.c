@@ -0,0 +1,380 @@
+// ============================================================
+// Copyright 2024 by Daniël Cornelisse, All Rights Reserved.
+// ============================================================
+
+// Linux implementation of fs.h. Whole-file reads are plain read() loops, fs_map_file hands out
+// a read-only mmap of the file so the big inputs of the headless tools never get copied.
+
+// Last write times are reported in FILETIME units (100ns ticks since 1601), same as on Win32,
+// so timestamps stored by one platform still compare sensibly on the other.
+fn_local uint64_t linux_filetime_from_timespec(struct timespec time)
+{
+	uint64_t seconds_from_1601_to_1970 = 11644473600ull;
+	return ((uint64_t)time.tv_sec + seconds_from_1601_to_1970)*10000000ull + (uint64_t)time.tv_nsec / 100;
+}
+
+fn_local bool linux_read_all(int fd, char *buffer, size_t size, size_t *bytes_read)
+{
+	size_t at = 0;
+
+	while (at < size)
+	{
+		ssize_t result = read(fd, buffer + at, size - at);
+
+		if (result < 0)
+		{
+			if (errno == EINTR)
+				continue;
+
+			break;
+		}
+
+		if (result == 0)
+			break;
+
+		at += (size_t)result;
+	}
+
+	*bytes_read = at;
+	return at == size;
+}
+
+fn_local bool linux_write_all(int fd, const char *buffer, size_t size)
+{
+	size_t at = 0;
+
+	while (at < size)
+	{
+		ssize_t result = write(fd, buffer + at, size - at);
+
+		if (result < 0)
+		{
+			if (errno == EINTR)
+				continue;
+
+			return false;
+		}
+
+		at += (size_t)result;
+	}
+
+	return true;
+}
+
+string_t fs_read_entire_file(arena_t *arena, string_t path)
+{
+	string_t result = {0};
+
+	arena_t *temp = m_get_temp(&arena, 1);
+
+	m_scoped(temp)
+	{
+		int fd = open(string_null_terminate(temp, path).data, O_RDONLY|O_CLOEXEC);
+		if (fd != -1)
+		{
+			struct stat st;
+			if (fstat(fd, &st) == 0 && st.st_size > 0)
+			{
+				size_t file_size = (size_t)st.st_size;
+
+				char *buffer = m_alloc_nozero(arena, file_size + 1, 16);
+
+				size_t bytes_read;
+				linux_read_all(fd, buffer, file_size, &bytes_read);
+
+				// the file can shrink under us, in which case we return what was there
+				if (bytes_read > 0)
+				{
+					buffer[bytes_read] = 0;
+					result.count = bytes_read;
+					result.data  = buffer;
+				}
+			}
+
+			close(fd);
+		}
+	}
+
+	return result;
+}
+
+bool fs_write_entire_file(string_t path, string_t file)
+{
+	bool result = false;
+
+	m_scoped_temp
+	{
+		int fd = open(string_null_terminate(temp, path).data, O_WRONLY|O_CREAT|O_TRUNC|O_CLOEXEC, 0644);
+		if (fd != -1)
+		{
+			result = linux_write_all(fd, file.data, file.count);
+			close(fd);
+		}
+	}
+
+	return result;
+}
+
+string_t fs_map_file(string_t path)
+{
+	string_t result = {0};
+
+	m_scoped_temp
+	{
+		int fd = open(string_null_terminate(temp, path).data, O_RDONLY|O_CLOEXEC);
+		if (fd != -1)
+		{
+			struct stat st;
+			if (fstat(fd, &st) == 0)
+			{
+				if (st.st_size == 0)
+				{
+					// can't map an empty file, but it's not a failure either
+					result.data = "";
+				}
+				else
+				{
+					// the mapping holds its own reference to the file, so the descriptor can be closed right away
+					void *view = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+					if (view != MAP_FAILED)
+					{
+						// advice values aren't flags, each one needs a call of its own
+						madvise(view, (size_t)st.st_size, MADV_SEQUENTIAL);
+						madvise(view, (size_t)st.st_size, MADV_WILLNEED);
+
+						result.data  = view;
+						result.count = (size_t)st.st_size;
+					}
+					else
+					{
+						debug_print("fs_map_file failed: %s\n", strerror(errno));
+					}
+				}
+			}
+
+			close(fd);
+		}
+	}
+
+	return result;
+}
+
+void fs_unmap_file(string_t mapped_file)
+{
+	if (mapped_file.count > 0)
+	{
+		munmap(mapped_file.data, mapped_file.count);
+	}
+}
+
+bool fs_copy(string_t source, string_t destination)
+{
+	bool result = false;
+
+	m_scoped_temp
+	{
+		int src = open(string_null_terminate(temp, source).data, O_RDONLY|O_CLOEXEC);
+		if (src != -1)
+		{
+			struct stat st;
+			if (fstat(src, &st) == 0)
+			{
+				int dst = open(string_null_terminate(temp, destination).data, O_WRONLY|O_CREAT|O_TRUNC|O_CLOEXEC, st.st_mode & 0777);
+				if (dst != -1)
+				{
+					result = true;
+
+					off_t remaining = st.st_size;
+					while (remaining > 0)
+					{
+						ssize_t copied = sendfile(dst, src, NULL, (size_t)remaining);
+
+						if (copied < 0 && errno == EINTR)
+							continue;
+
+						if (copied <= 0)
+						{
+							result = false;
+							break;
+						}
+
+						remaining -= copied;
+					}
+
+					close(dst);
+				}
+			}
+
+			close(src);
+		}
+
+		if (!result) debug_print("fs_copy failed: %s\n", strerror(errno));
+	}
+
+	return result;
+}
+
+bool fs_move(string_t source, string_t destination)
+{
+	bool result = false;
+
+	m_scoped_temp
+	{
+		result = (rename(string_null_terminate(temp, source).data, string_null_terminate(temp, destination).data) == 0);
+		if (!result) debug_print("fs_move failed: %s\n", strerror(errno));
+	}
+
+	return result;
+}
+
+bool fs_copy_directory(string_t source, string_t destination)
+{
+	bool result = true;
+
+	m_scoped_temp
+	{
+		fs_create_directory_result_t create_result = fs_create_directory_recursive(destination);
+		result = (create_result != FsCreateDirectory_path_not_found);
+
+		fs_entry_t *first = fs_scan_directory(temp, source, FsScanDirectory_recursive|FsScanDirectory_dont_skip_dotfiles);
+
+		// entries come out parents first, so directories exist by the time their files get copied
+		for (fs_entry_t *entry = first; result && entry; entry = fs_entry_next(entry))
+		{
+			string_t relative = substring(entry->path, source.count + 1, entry->path.count - source.count - 1);
+			string_t target   = string_format(temp, "%cs/%cs", destination, relative);
+
+			if (entry->kind == FsEntryKind_directory)
+			{
+				result = (fs_create_directory(target) != FsCreateDirectory_path_not_found);
+			}
+			else
+			{
+				result = fs_copy(entry->path, target);
+			}
+		}
+	}
+
+	return result;
+}
+
+fn_local fs_entry_t *fs_scan_directory_(arena_t *arena, string_t path, int flags, fs_entry_t *parent_dir)
+{
+	arena_t *temp = m_get_temp(&arena, 1);
+	m_scope_begin(temp);
+
+	fs_entry_t *first = NULL;
+	fs_entry_t *last  = NULL;
+
+	DIR *dir = opendir(string_null_terminate(temp, path).data);
+	if (dir)
+	{
+		struct dirent *dirent;
+		while ((dirent = readdir(dir)))
+		{
+			bool skip = strcmp(dirent->d_name, ".")  == 0 ||
+						strcmp(dirent->d_name, "..") == 0;
+
+			if (!(flags & FsScanDirectory_dont_skip_dotfiles))
+			{
+				skip |= dirent->d_name[0] == '.';
+			}
+
+			if (skip)
+				continue;
+
+			string_t name       = string_from_cstr(dirent->d_name);
+			string_t entry_path = string_format(arena, "%cs/%cs", parent_dir ? parent_dir->path : path, name);
+
+			// stat follows symlinks, which matches FindFirstFile looking through junctions well enough
+			struct stat st;
+			if (stat(entry_path.data, &st) != 0)
+				continue;
+
+			fs_entry_t *entry = m_alloc_struct(arena, fs_entry_t);
+
+			dll_push_back(first, last, entry);
+
+			entry->parent          = parent_dir;
+			entry->kind            = S_ISDIR(st.st_mode) ? FsEntryKind_directory : FsEntryKind_file;
+			entry->name            = m_copy_string(arena, name);
+			entry->path            = entry_path;
+			entry->last_write_time = linux_filetime_from_timespec(st.st_mtim);
+			entry->file_size       = entry->kind == FsEntryKind_file ? (size_t)st.st_size : 0;
+
+			if ((flags & FsScanDirectory_recursive) && entry->kind == FsEntryKind_directory)
+			{
+				entry->first_child = fs_scan_directory_(arena, entry->path, flags, entry);
+			}
+		}
+
+		closedir(dir);
+	}
+
+	m_scope_end(temp);
+
+	return first;
+}
+
+fs_entry_t *fs_scan_directory(arena_t *arena, string_t path, int flags)
+{
+	return fs_scan_directory_(arena, path, flags, NULL);
+}
+
+fs_create_directory_result_t fs_create_directory(string_t directory)
+{
+	fs_create_directory_result_t result = FsCreateDirectory_success;
+
+	m_scoped_temp
+	if (mkdir(string_null_terminate(temp, directory).data, 0755) != 0)
+	{
+		switch (errno)
+		{
+			case EEXIST: result = FsCreateDirectory_already_exists; break;
+			default:     result = FsCreateDirectory_path_not_found; break;
+		}
+	}
+
+	return result;
+}
+
+string_t fs_full_path(arena_t *arena, string_t relative_path)
+{
+	string_t result = {0};
+
+	m_scoped_temp
+	{
+		char buffer[PATH_MAX];
+		if (realpath(string_null_terminate(temp, relative_path).data, buffer))
+		{
+			result = string_copy_cstr(arena, buffer);
+		}
+		else if (relative_path.count > 0 && relative_path.data[0] == '/')
+		{
+			result = m_copy_string(arena, relative_path);
+		}
+		else if (getcwd(buffer, sizeof(buffer)))
+		{
+			// realpath wants the file to exist, GetFullPathName doesn't, so fall back to gluing on the working directory
+			result = string_format(arena, "%s/%cs", buffer, relative_path);
+		}
+	}
+
+	return result;
+}
+
+uint64_t fs_get_last_write_time(string_t path)
+{
+	uint64_t result = 0;
+
+	m_scoped_temp
+	{
+		struct stat st;
+		if (stat(string_null_terminate(temp, path).data, &st) == 0)
+		{
+			result = linux_filetime_from_timespec(st.st_mtim);
+		}
+	}
+
+	return result;
+}
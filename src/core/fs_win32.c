@@ -608,6 +608,62 @@ bool fs_write_entire_file(string_t path, string_t file)
     return result;
 }
 
+string_t fs_map_file(string_t path)
+{
+	string_t result = {0};
+
+	m_scoped_temp
+	{
+		string16_t path16 = utf16_from_utf8(temp, path);
+
+		HANDLE handle = CreateFileW(path16.data, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+		if (handle != INVALID_HANDLE_VALUE)
+		{
+			LARGE_INTEGER file_size;
+			if (GetFileSizeEx(handle, &file_size))
+			{
+				if (file_size.QuadPart == 0)
+				{
+					// can't map an empty file, but it's not a failure either
+					result.data = "";
+				}
+				else
+				{
+					// the view keeps the mapping alive, so both handles can be closed right away
+					HANDLE mapping = CreateFileMappingW(handle, NULL, PAGE_READONLY, 0, 0, NULL);
+					if (mapping)
+					{
+						void *view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+						if (view)
+						{
+							result.data  = view;
+							result.count = (size_t)file_size.QuadPart;
+						}
+						else
+						{
+							win32_output_last_error(strlit16("fs_map_file failed"));
+						}
+
+						CloseHandle(mapping);
+					}
+				}
+			}
+
+			CloseHandle(handle);
+		}
+	}
+
+	return result;
+}
+
+void fs_unmap_file(string_t mapped_file)
+{
+	if (mapped_file.count > 0)
+	{
+		UnmapViewOfFile(mapped_file.data);
+	}
+}
+
 bool fs_copy(string_t source, string_t destination)
 {
 	bool result = false;
@@ -753,39 +809,6 @@ fs_entry_t *fs_scan_directory(arena_t *arena, string_t path, int flags)
     return fs_scan_directory_(arena, path, flags, NULL);
 }
 
-fs_entry_t *fs_entry_next(fs_entry_t *entry)
-{
-    fs_entry_t *next = NULL;
-
-    if (entry->first_child)
-    {
-        next = entry->first_child;
-    }
-    else
-    {
-        if (entry->next)
-        {
-            next = entry->next;
-        }
-        else
-        {
-            fs_entry_t *p = entry;
-            while (p)
-            {
-                if (p->next)
-                {
-                    next = p->next;
-                    break;
-                }
-
-                p = p->parent;
-            }
-        }
-    }
-
-    return next;
-}
-
 fs_create_directory_result_t fs_create_directory(string_t directory)
 {
     fs_create_directory_result_t result = FsCreateDirectory_success;
@@ -804,49 +827,6 @@ fs_create_directory_result_t fs_create_directory(string_t directory)
     return result;
 }
 
-fs_create_directory_result_t fs_create_directory_recursive(string_t directory)
-{
-    fs_create_directory_result_t result = FsCreateDirectory_success;
-
-    size_t at = 0;
-
-    while (at < directory.count)
-    {
-        string_t sub_directory = {0};
-
-        while (at < directory.count)
-        {
-            if (directory.data[at] == '/' ||
-                directory.data[at] == '\\')
-            {
-                sub_directory = substring(directory, 0, at);
-
-                at += 1;
-                break;
-            }
-            else
-            {
-                at += 1;
-            }
-        }
-
-        if (sub_directory.count == 0)
-        {
-            sub_directory = directory;
-        }
-
-        result = fs_create_directory(sub_directory);
-
-        if (result != FsCreateDirectory_success &&
-            result != FsCreateDirectory_already_exists)
-        {
-            break;
-        }
-    }
-
-    return result;
-}
-
 string_t fs_full_path(arena_t *arena, string_t relative_path)
 {
     string_t result = {0};
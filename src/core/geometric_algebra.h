@@ -62,9 +62,9 @@ static inline biv3_t wedge3(v3_t a, v3_t b)
     return result;
 }
 
-static biv3_t PLANE_XY = { 1.0f, 0.0f, 0.0f };
-static biv3_t PLANE_ZX = { 0.0f, 1.0f, 0.0f };
-static biv3_t PLANE_YZ = { 0.0f, 0.0f, 1.0f };
+static const biv3_t PLANE_XY = { 1.0f, 0.0f, 0.0f };
+static const biv3_t PLANE_ZX = { 0.0f, 1.0f, 0.0f };
+static const biv3_t PLANE_YZ = { 0.0f, 0.0f, 1.0f };
 
 static inline float rotor3_lengthsq(rotor3_t r)
 {
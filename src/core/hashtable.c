@@ -2,85 +2,140 @@
 // Copyright 2024 by Daniël Cornelisse, All Rights Reserved.
 // ============================================================
 
-fn_local void table_init(table_t *table)
+// The low 7 bits of the hash go in the control byte, the rest picks the home slot. A key always sits in
+// the run of full slots that starts at its home slot, so a probe can stop at the first empty one.
+
+fn_local uint64_t table_home_slot(const table_t *table, uint64_t hash)
+{
+	return (hash >> 7) & table->mask;
+}
+
+fn_local uint8_t table_tag(uint64_t hash)
 {
-    ASSERT(!table->entries);
+	return (uint8_t)(hash & 0x7F);
+}
 
-    table->entries = vm_reserve(NULL, sizeof(table_entry_t)*TABLE_RESERVE_CAPACITY);
-    vm_commit(table->entries, sizeof(table_entry_t)*256); // one page worth of entries
+fn_local void table_set_ctrl(table_t *table, uint64_t slot, uint8_t ctrl)
+{
+	table->ctrl[slot] = ctrl;
 
-    table->mask = 255;
-    table->load = 0;
+	if (slot < TABLE_GROUP_SIZE)
+	{
+		table->ctrl[table->mask + 1 + slot] = ctrl;
+	}
 }
 
-fn_local void table_grow(table_t *table)
+fn_local uint32_t table_lowest_set_bit(uint32_t mask)
 {
-    table_entry_t *new_entries, *old_entries;
+	unsigned long index;
+	bit_scan_forward64(&index, mask);
+	return (uint32_t)index;
+}
 
-    if (TABLE_POINTER_HAS_TAGS(table->entries, TABLE_SECONDARY_BUFFER))
-        new_entries = (table_entry_t *)TABLE_UNTAG_POINTER(table->entries) - TABLE_HALF_CAPACITY;
-    else
-        new_entries = (table_entry_t *)TABLE_UNTAG_POINTER(table->entries) + TABLE_HALF_CAPACITY;
+// Control bytes and entries share one allocation straight from the OS, the control bytes come first.
+fn_local void table_allocate(table_t *table, uint64_t capacity)
+{
+	ASSERT(IS_POW2(capacity) && capacity >= TABLE_GROUP_SIZE);
 
-    old_entries = TABLE_UNTAG_POINTER(table->entries);
+	size_t ctrl_size  = align_forward(capacity + TABLE_GROUP_SIZE, alignof(table_entry_t));
+	size_t total_size = ctrl_size + capacity*sizeof(table_entry_t);
 
-    uint32_t old_capacity = table->mask + 1;
-    uint32_t new_capacity = old_capacity*2;
+	char *memory = vm_reserve(NULL, total_size);
+	ASSERT_MSG(memory, "Failed to reserve %zu bytes for a table of %llu entries", total_size, capacity);
 
-    vm_commit(new_entries, sizeof(table_entry_t)*new_capacity);
-    zero_array(new_entries, old_capacity);
+	bool commit_result = vm_commit(memory, total_size);
+	ASSERT(commit_result);
 
-    if (new_entries > old_entries)
-        new_entries = TABLE_TAG_POINTER(new_entries, TABLE_SECONDARY_BUFFER);
+	set_memory(memory, capacity + TABLE_GROUP_SIZE, TABLE_CTRL_EMPTY);
 
-    table_t new_table = {
-        .mask    = new_capacity - 1,
-        .entries = new_entries,
-    };
+	table->mask    = capacity - 1;
+	table->load    = 0;
+	table->ctrl    = (uint8_t *)memory;
+	table->entries = (table_entry_t *)(memory + ctrl_size);
+}
 
-    for (size_t i = 0; i < old_capacity; i++)
-    {
-        table_entry_t *old_entry = &old_entries[i];
+// Finds the slot holding the key if it's in the table, otherwise the empty slot it would be inserted in.
+fn_local bool table_find_slot(const table_t *table, uint64_t key, uint64_t *slot)
+{
+	uint64_t hash  = hash_u64(key);
+	uint64_t probe = table_home_slot(table, hash);
 
-        if (old_entry->key != TABLE_UNUSED_KEY_VALUE)
-            table_insert(&new_table, old_entry->key, old_entry->value);
-    }
+	__m128i tag = _mm_set1_epi8((char)table_tag(hash));
 
-    copy_struct(table, &new_table);
+	for (;;)
+	{
+		__m128i group = _mm_loadu_si128((const __m128i *)(table->ctrl + probe));
+
+		uint32_t matches = (uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(group, tag));
+		uint32_t empties = (uint32_t)_mm_movemask_epi8(group); // empty is the only control byte with the top bit set
+
+		// matches past the first empty slot belong to some other run
+		if (empties)
+		{
+			matches &= (empties & (0 - empties)) - 1;
+		}
+
+		while (matches)
+		{
+			uint64_t candidate = (probe + table_lowest_set_bit(matches)) & table->mask;
+
+			if (table->entries[candidate].key == key)
+			{
+				*slot = candidate;
+				return true;
+			}
+
+			matches &= matches - 1;
+		}
+
+		if (empties)
+		{
+			*slot = (probe + table_lowest_set_bit(empties)) & table->mask;
+			return false;
+		}
+
+		probe = (probe + TABLE_GROUP_SIZE) & table->mask;
+	}
 }
 
-fn_local bool table_find_slot(const table_t *table, uint64_t key, uint64_t *slot)
+fn_local void table_grow(table_t *table, uint64_t new_capacity)
 {
-    if (!table->entries)
-        return false;
+	table_t old_table = *table;
 
-    bool result = false;
+	table_allocate(table, new_capacity);
 
-    uint64_t       mask    = table->mask;
-    table_entry_t *entries = TABLE_UNTAG_POINTER(table->entries);
+	if (old_table.ctrl)
+	{
+		for (uint64_t i = 0; i <= old_table.mask; i++)
+		{
+			if (old_table.ctrl[i] != TABLE_CTRL_EMPTY)
+			{
+				table_entry_t *entry = &old_table.entries[i];
 
-    if (key == TABLE_UNUSED_KEY_VALUE)
-        key = 1;
+				uint64_t slot;
+				table_find_slot(table, entry->key, &slot);
 
-    uint64_t probe = key & mask;
-    for (;;)
-    {
-        table_entry_t *entry = &entries[probe];
+				table_set_ctrl(table, slot, old_table.ctrl[i]);
+				table->entries[slot] = *entry;
+			}
+		}
 
-        if (entry->key == TABLE_UNUSED_KEY_VALUE)
-            break;
+		table->load = old_table.load;
 
-        if (entry->key == key)
-        {
-			*slot = probe;
-            result = true;
-            break;
-        }
+		vm_release(old_table.ctrl);
+	}
+}
 
-        probe = (probe + 1) & mask;
-    }
+fn_local uint64_t table_capacity_for_count(uint64_t count)
+{
+	uint64_t capacity = TABLE_INITIAL_CAPACITY;
 
-    return result;
+	while (count*TABLE_MAX_LOAD_FACTOR_DENOMINATOR > capacity*TABLE_MAX_LOAD_FACTOR_NUMERATOR)
+	{
+		capacity *= 2;
+	}
+
+	return capacity;
 }
 
 bool table_find_entry(const table_t *table, uint64_t key, uint64_t **entry)
@@ -88,11 +143,9 @@ bool table_find_entry(const table_t *table, uint64_t key, uint64_t **entry)
 	bool result = false;
 
 	uint64_t slot;
-	if (table_find_slot(table, key, &slot))
+	if (table->ctrl && table_find_slot(table, key, &slot))
 	{
-		table_entry_t *entries = TABLE_UNTAG_POINTER(table->entries);
-
-		*entry = &entries[slot].value;
+		*entry = &table->entries[slot].value;
 		result = true;
 	}
 
@@ -118,65 +171,58 @@ bool table_find(const table_t *table, uint64_t key, uint64_t *value)
 
 void table_insert(table_t *table, uint64_t key, uint64_t value)
 {
-    if (!table->entries)
-        table_init(table);
-
-    if (table->load*4 >= (table->mask + 1)*3)
-        table_grow(table);
-
-    uint64_t       mask    = table->mask;
-    table_entry_t *entries = TABLE_UNTAG_POINTER(table->entries);
-
-    if (key == TABLE_UNUSED_KEY_VALUE)
-        key = 1;
-
-    uint64_t probe = key & mask;
-    for (;;)
-    {
-        table_entry_t *entry = &entries[probe];
+	if (!table->ctrl)
+		table_allocate(table, TABLE_INITIAL_CAPACITY);
 
-        if (entry->key == TABLE_UNUSED_KEY_VALUE ||
-            entry->key == key)
-        {
-            table->load += (entry->key == TABLE_UNUSED_KEY_VALUE);
+	uint64_t slot;
+	if (!table_find_slot(table, key, &slot))
+	{
+		if ((table->load + 1)*TABLE_MAX_LOAD_FACTOR_DENOMINATOR > (table->mask + 1)*TABLE_MAX_LOAD_FACTOR_NUMERATOR)
+		{
+			table_grow(table, 2*(table->mask + 1));
+			table_find_slot(table, key, &slot);
+		}
 
-            entry->key   = key;
-            entry->value = value;
+		table_set_ctrl(table, slot, table_tag(hash_u64(key)));
+		table->entries[slot].key = key;
+		table->load += 1;
+	}
 
-            break;
-        }
+	table->entries[slot].value = value;
+}
 
-        probe = (probe + 1) & mask;
+void table_reserve(table_t *table, uint64_t count)
+{
+	uint64_t capacity = table_capacity_for_count(count);
 
-        if (NEVER(probe == key))
-            break; // table is full! that shouldn't happen!
-    }
+	if (capacity > table_capacity(table))
+	{
+		table_grow(table, capacity);
+	}
 }
 
 bool table_remove(table_t *table, uint64_t key)
 {
 	uint64_t i;
 
-	if (!table_find_slot(table, key, &i))
+	if (!table->ctrl || !table_find_slot(table, key, &i))
 		return false;
 
-    uint64_t       mask    = table->mask;
-    table_entry_t *entries = TABLE_UNTAG_POINTER(table->entries);
-
-	if (entries[i].key == TABLE_UNUSED_KEY_VALUE)
-		return false;
+	uint64_t mask = table->mask;
 
-	entries[i].key = TABLE_UNUSED_KEY_VALUE;
+	table_set_ctrl(table, i, TABLE_CTRL_EMPTY);
+	table->load -= 1;
 
+	// shift back every entry after the hole that would no longer be reachable from its home slot
 	uint64_t j = i;
 	for (;;)
 	{
 		j = (j + 1) & mask;
 
-		if (entries[j].key == TABLE_UNUSED_KEY_VALUE)
+		if (table->ctrl[j] == TABLE_CTRL_EMPTY)
 			break;
 
-		uint64_t k = entries[j].key & mask;
+		uint64_t k = table_home_slot(table, hash_u64(table->entries[j].key));
 
 		if (i <= j)
 		{
@@ -189,8 +235,9 @@ bool table_remove(table_t *table, uint64_t key)
 				continue;
 		}
 
-		entries[i] = entries[j];
-		entries[j].key = TABLE_UNUSED_KEY_VALUE;
+		table->entries[i] = table->entries[j];
+		table_set_ctrl(table, i, table->ctrl[j]);
+		table_set_ctrl(table, j, TABLE_CTRL_EMPTY);
 		i = j;
 	}
 
@@ -199,10 +246,12 @@ bool table_remove(table_t *table, uint64_t key)
 
 void table_release(table_t *table)
 {
-    table->mask = 0;
-    table->load = 0;
-    vm_release(table->entries);
-    table->entries = NULL;
+	if (table->ctrl)
+	{
+		vm_release(table->ctrl);
+	}
+
+	zero_struct(table);
 }
 
 void *table_find_object(const table_t *table, uint64_t key)
@@ -4,14 +4,20 @@
 
 #pragma once
 
-enum { TABLE_UNUSED_KEY_VALUE = 0 };
+// Open addressing hash table with linear probing, in the style of a Swiss table: next to the entries there's
+// one control byte per slot, holding either TABLE_CTRL_EMPTY or 7 bits of the key's hash. Probing compares
+// a whole group of TABLE_GROUP_SIZE control bytes at once with SSE2, and only looks at the entries whose
+// control byte matched. Removal shifts the rest of the probe run back instead of leaving tombstones, so
+// lookups never get slower from churn.
+//
+// Any uint64_t is a valid key, including 0. A zero-initialized table_t is ready to use.
 
-enum { TABLE_RESERVE_CAPACITY = 1 << 20, TABLE_HALF_CAPACITY = 1 << 19 }; // up to ~500k entries
-enum { TABLE_SECONDARY_BUFFER = 1 << 0, TABLE_EXTERNAL_MEMORY = 1 << 1 };
+enum { TABLE_GROUP_SIZE = 16, TABLE_CTRL_EMPTY = 0x80 };
+enum { TABLE_INITIAL_CAPACITY = 64 };
 
-#define TABLE_TAG_POINTER(pointer, tags)      (void *)((uintptr_t)(pointer)|(tags))
-#define TABLE_UNTAG_POINTER(pointer)          (void *)((uintptr_t)(pointer) & ~(alignof(table_entry_t) - 1))
-#define TABLE_POINTER_HAS_TAGS(pointer, tags) !!((uintptr_t)(pointer) & tags)
+// the table grows when it'd get fuller than this
+#define TABLE_MAX_LOAD_FACTOR_NUMERATOR   7
+#define TABLE_MAX_LOAD_FACTOR_DENOMINATOR 8
 
 typedef struct table_entry_t
 {
@@ -21,8 +27,9 @@ typedef struct table_entry_t
 
 typedef struct table_t
 {
-    uint32_t mask;
-    uint32_t load;
+    uint64_t mask;
+    uint64_t load;
+	uint8_t       *ctrl;    // mask + 1 + TABLE_GROUP_SIZE bytes, the first group is mirrored past the end so groups can be loaded at any slot
     table_entry_t *entries;
 } table_t;
 
@@ -46,6 +53,7 @@ fn bool table_find_entry    (const table_t *table, uint64_t key, uint64_t **valu
 fn bool table_find          (const table_t *table, uint64_t key, uint64_t  *value);
 fn void table_insert        (      table_t *table, uint64_t key, uint64_t   value);
 fn bool table_remove        (      table_t *table, uint64_t key);
+fn void table_reserve       (      table_t *table, uint64_t count); // makes room for count entries without further growth
 
 fn void *table_find_object  (const table_t *table, uint64_t key);
 fn void  table_insert_object(      table_t *table, uint64_t key, void *value);
@@ -54,7 +62,12 @@ fn void table_release(table_t *table);
 
 fn_local table_entry_t *table_get_entries(const table_t *table)
 {
-	return TABLE_UNTAG_POINTER(table->entries);
+	return table->entries;
+}
+
+fn_local uint64_t table_capacity(const table_t *table)
+{
+	return table->ctrl ? table->mask + 1 : 0;
 }
 
 typedef struct table_iter_t
@@ -90,19 +103,17 @@ fn_local bool table_iter_next(table_iter_t *it)
 
     const table_t *table = it->table;
 
-    if (!table->entries)
+    if (!table->ctrl)
         return false;
 
-	table_entry_t *entries = table_get_entries(table);
-
     while (it->internal_index <= table->mask)
     {
-        if (entries[it->internal_index].key != TABLE_UNUSED_KEY_VALUE)
+        if (table->ctrl[it->internal_index] != TABLE_CTRL_EMPTY)
         {
             result = true;
 
-			it->key   = entries[it->internal_index].key;
-            it->value = entries[it->internal_index].value;
+			it->key   = table->entries[it->internal_index].key;
+            it->value = table->entries[it->internal_index].value;
             it->internal_index += 1;
 
             break;
@@ -0,0 +1,540 @@
+// ============================================================
+// Copyright 2024 by Daniël Cornelisse, All Rights Reserved.
+// ============================================================
+
+//
+// Every block starts with a 16 byte header, followed by its payload. Blocks tile the committed range
+// back to back, and the last 16 bytes of it are a zero-sized sentinel block that's never free, so walking
+// to the next block never needs a bounds check. Free blocks keep their free list links in the payload.
+//
+// Invariant: no two free blocks are ever next to each other, they get merged when the second one is freed.
+//
+
+struct heap_block_t
+{
+	size_t        size_and_flags; // payload size, always a multiple of HEAP_ALIGN, which leaves the low bits for flags
+	heap_block_t *prev_physical;  // the block right before this one in memory, NULL for the first block
+
+	// only valid while the block is free
+	heap_block_t *next_free;
+	heap_block_t *prev_free;
+};
+
+#define HEAP_BLOCK_FREE         0x1
+#define HEAP_HEADER_SIZE        offsetof(heap_block_t, next_free)
+#define HEAP_MIN_PAYLOAD_SIZE   (sizeof(heap_block_t) - HEAP_HEADER_SIZE)
+#define HEAP_MIN_BLOCK_SIZE     sizeof(heap_block_t)
+#define HEAP_FL_SHIFT           (HEAP_SL_COUNT_LOG2 + 4) // 4 = log2(HEAP_ALIGN)
+#define HEAP_SMALL_BLOCK_SIZE   ((size_t)1 << HEAP_FL_SHIFT)
+
+STATIC_ASSERT(HEAP_HEADER_SIZE % HEAP_ALIGN == 0, "Block headers have to preserve payload alignment");
+
+fn_local size_t heap_block_size(heap_block_t *block)
+{
+	return block->size_and_flags & ~(size_t)(HEAP_ALIGN - 1);
+}
+
+fn_local void heap_block_set_size(heap_block_t *block, size_t size)
+{
+	block->size_and_flags = size | (block->size_and_flags & (HEAP_ALIGN - 1));
+}
+
+fn_local bool heap_block_is_free(heap_block_t *block)
+{
+	return block->size_and_flags & HEAP_BLOCK_FREE;
+}
+
+fn_local void *heap_pointer_from_block(heap_block_t *block)
+{
+	return (char *)block + HEAP_HEADER_SIZE;
+}
+
+fn_local heap_block_t *heap_block_from_pointer(void *pointer)
+{
+	return (heap_block_t *)((char *)pointer - HEAP_HEADER_SIZE);
+}
+
+fn_local heap_block_t *heap_block_next(heap_block_t *block)
+{
+	return (heap_block_t *)((char *)block + HEAP_HEADER_SIZE + heap_block_size(block));
+}
+
+fn_local heap_block_t *heap_sentinel(heap_t *heap)
+{
+	return (heap_block_t *)(heap->committed - HEAP_HEADER_SIZE);
+}
+
+fn_local uint32_t heap_lowest_set_bit(uint32_t mask)
+{
+	unsigned long index;
+	bit_scan_forward64(&index, mask);
+	return (uint32_t)index;
+}
+
+//
+// size classes
+//
+
+// Small blocks get a first level bin of their own, split linearly in HEAP_ALIGN steps. Past that, the
+// first level is the index of the highest set bit and the second level the next HEAP_SL_COUNT_LOG2 bits.
+fn_local void heap_mapping(size_t size, uint32_t *fl, uint32_t *sl)
+{
+	if (size < HEAP_SMALL_BLOCK_SIZE)
+	{
+		*fl = 0;
+		*sl = (uint32_t)(size / (HEAP_SMALL_BLOCK_SIZE / HEAP_SL_COUNT));
+	}
+	else
+	{
+		uint32_t high_bit = (uint32_t)bit_scan_reverse_u64(size);
+
+		*fl = high_bit - (HEAP_FL_SHIFT - 1);
+		*sl = (uint32_t)(size >> (high_bit - HEAP_SL_COUNT_LOG2)) ^ HEAP_SL_COUNT;
+	}
+}
+
+// Any block in a bin can be anywhere within the bin's range, so to get a block that's big enough without
+// searching the bin, allocations round their size up to the start of the next bin.
+fn_local size_t heap_round_up_to_bin(size_t size)
+{
+	if (size >= HEAP_SMALL_BLOCK_SIZE)
+	{
+		size_t bin_size = (size_t)1 << (bit_scan_reverse_u64(size) - HEAP_SL_COUNT_LOG2);
+		size = align_forward(size, bin_size);
+	}
+
+	return size;
+}
+
+//
+// free lists
+//
+
+fn_local void heap_insert_free_block(heap_t *heap, heap_block_t *block)
+{
+	uint32_t fl, sl;
+	heap_mapping(heap_block_size(block), &fl, &sl);
+
+	heap_block_t *head = heap->free_lists[fl][sl];
+
+	block->next_free = head;
+	block->prev_free = NULL;
+
+	if (head) head->prev_free = block;
+
+	heap->free_lists[fl][sl] = block;
+
+	heap->fl_bitmap     |= 1u << fl;
+	heap->sl_bitmap[fl] |= 1u << sl;
+}
+
+fn_local void heap_remove_free_block(heap_t *heap, heap_block_t *block)
+{
+	uint32_t fl, sl;
+	heap_mapping(heap_block_size(block), &fl, &sl);
+
+	if (block->prev_free) block->prev_free->next_free = block->next_free;
+	if (block->next_free) block->next_free->prev_free = block->prev_free;
+
+	if (heap->free_lists[fl][sl] == block)
+	{
+		heap->free_lists[fl][sl] = block->next_free;
+
+		if (!block->next_free)
+		{
+			heap->sl_bitmap[fl] &= ~(1u << sl);
+
+			if (!heap->sl_bitmap[fl])
+			{
+				heap->fl_bitmap &= ~(1u << fl);
+			}
+		}
+	}
+}
+
+// takes a free block of at least size bytes off the free lists, or returns NULL
+fn_local heap_block_t *heap_take_free_block(heap_t *heap, size_t size)
+{
+	uint32_t fl, sl;
+	heap_mapping(heap_round_up_to_bin(size), &fl, &sl);
+
+	if (fl >= HEAP_FL_COUNT)
+		return NULL;
+
+	uint32_t sl_map = heap->sl_bitmap[fl] & (~0u << sl);
+
+	if (!sl_map)
+	{
+		uint32_t fl_map = heap->fl_bitmap & (uint32_t)(~0ull << (fl + 1));
+
+		if (!fl_map)
+			return NULL;
+
+		fl     = heap_lowest_set_bit(fl_map);
+		sl_map = heap->sl_bitmap[fl];
+	}
+
+	sl = heap_lowest_set_bit(sl_map);
+
+	heap_block_t *block = heap->free_lists[fl][sl];
+	ASSERT(block && heap_block_size(block) >= size);
+
+	heap_remove_free_block(heap, block);
+
+	return block;
+}
+
+//
+// splitting and merging
+//
+
+// cuts the tail off a block to leave it with size bytes, the tail goes back on the free lists
+fn_local void heap_trim_block(heap_t *heap, heap_block_t *block, size_t size)
+{
+	size_t block_size = heap_block_size(block);
+
+	if (block_size >= size + HEAP_MIN_BLOCK_SIZE)
+	{
+		heap_block_t *remainder = (heap_block_t *)((char *)block + HEAP_HEADER_SIZE + size);
+		remainder->size_and_flags = (block_size - size - HEAP_HEADER_SIZE) | HEAP_BLOCK_FREE;
+		remainder->prev_physical  = block;
+
+		heap_block_next(remainder)->prev_physical = remainder;
+
+		heap_block_set_size(block, size);
+
+		// the block was either free or came off the free lists, so the block after it can't be free
+		heap_insert_free_block(heap, remainder);
+	}
+}
+
+// merges a free block (not on the free lists) with its free neighbours, returns the merged block
+fn_local heap_block_t *heap_merge_block(heap_t *heap, heap_block_t *block)
+{
+	heap_block_t *prev = block->prev_physical;
+
+	if (prev && heap_block_is_free(prev))
+	{
+		heap_remove_free_block(heap, prev);
+		heap_block_set_size(prev, heap_block_size(prev) + HEAP_HEADER_SIZE + heap_block_size(block));
+		block = prev;
+	}
+
+	heap_block_t *next = heap_block_next(block);
+
+	if (heap_block_is_free(next))
+	{
+		heap_remove_free_block(heap, next);
+		heap_block_set_size(block, heap_block_size(block) + HEAP_HEADER_SIZE + heap_block_size(next));
+	}
+
+	heap_block_next(block)->prev_physical = block;
+
+	return block;
+}
+
+//
+// committing and decommitting
+//
+
+fn_local void heap_place_sentinel(heap_t *heap, heap_block_t *last_block)
+{
+	heap_block_t *sentinel = heap_sentinel(heap);
+	sentinel->size_and_flags = 0;
+	sentinel->prev_physical  = last_block;
+}
+
+// commits enough to fit a free block of at least size bytes, which ends up on the free lists
+fn_local bool heap_grow(heap_t *heap, size_t size)
+{
+	size_t to_commit = align_forward(heap_round_up_to_bin(size) + HEAP_HEADER_SIZE, HEAP_COMMIT_CHUNK_SIZE);
+
+	if (to_commit > (size_t)(heap->end - heap->committed))
+		return false;
+
+	if (!vm_commit(heap->committed, to_commit))
+		return false;
+
+	heap->commit_count += 1;
+
+	// the old sentinel becomes the header of the new block
+	heap_block_t *block = heap_sentinel(heap);
+
+	heap->committed += to_commit;
+
+	block->size_and_flags = (to_commit - HEAP_HEADER_SIZE) | HEAP_BLOCK_FREE;
+	heap_place_sentinel(heap, block);
+
+	block = heap_merge_block(heap, block);
+	heap_insert_free_block(heap, block);
+
+	return true;
+}
+
+// gives back the committed memory past the last block, if it's free and there's enough of it
+fn_local void heap_shrink(heap_t *heap, heap_block_t *last_block)
+{
+	ASSERT(heap_block_next(last_block) == heap_sentinel(heap));
+
+	char *payload = heap_pointer_from_block(last_block);
+	char *keep    = heap->base + align_forward(payload + HEAP_MIN_PAYLOAD_SIZE + HEAP_HEADER_SIZE - heap->base, HEAP_COMMIT_CHUNK_SIZE);
+
+	size_t to_decommit = (size_t)(heap->committed - keep);
+
+	if (to_decommit >= HEAP_DECOMMIT_THRESHOLD)
+	{
+		vm_decommit(keep, to_decommit);
+
+		heap->committed       = keep;
+		heap->decommit_count += 1;
+
+		heap_block_set_size(last_block, (size_t)((char *)heap_sentinel(heap) - payload));
+		heap_place_sentinel(heap, last_block);
+	}
+}
+
+//
+// heap
+//
+
+void heap_init(heap_t *heap, size_t reserve_size)
+{
+	ASSERT_MSG(!heap->base, "Heap is already initialized");
+
+	reserve_size = align_forward(MAX(reserve_size, HEAP_COMMIT_CHUNK_SIZE), HEAP_COMMIT_CHUNK_SIZE);
+
+	heap->base      = vm_reserve(NULL, reserve_size);
+	heap->committed = heap->base;
+	heap->end       = heap->base + reserve_size;
+
+	ASSERT_MSG(heap->base, "Failed to reserve %zu bytes for heap", reserve_size);
+
+	bool commit_result = vm_commit(heap->base, HEAP_COMMIT_CHUNK_SIZE);
+	ASSERT(commit_result);
+
+	heap->committed    = heap->base + HEAP_COMMIT_CHUNK_SIZE;
+	heap->commit_count = 1;
+
+	heap_block_t *first = (heap_block_t *)heap->base;
+	first->size_and_flags = (HEAP_COMMIT_CHUNK_SIZE - 2*HEAP_HEADER_SIZE) | HEAP_BLOCK_FREE;
+	first->prev_physical  = NULL;
+
+	heap_place_sentinel(heap, first);
+	heap_insert_free_block(heap, first);
+}
+
+void heap_release(heap_t *heap)
+{
+	if (heap->base)
+	{
+		vm_release(heap->base);
+	}
+
+	zero_struct(heap);
+}
+
+void *heap_alloc_nozero(heap_t *heap, size_t size, size_t align)
+{
+	ASSERT_MSG(align > 0 && (align & (align - 1)) == 0, "Alignment has to be a power of two");
+
+	if (!heap->base)
+	{
+		heap_init(heap, HEAP_DEFAULT_RESERVE_SIZE);
+	}
+
+	align = MAX(align, HEAP_ALIGN);
+	size  = align_forward(MAX(size, HEAP_MIN_PAYLOAD_SIZE), HEAP_ALIGN);
+
+	// for bigger alignments, ask for enough extra to be able to split a free block off the front
+	size_t search_size = size;
+
+	if (align > HEAP_ALIGN)
+	{
+		search_size += align + HEAP_MIN_BLOCK_SIZE;
+	}
+
+	heap_block_t *block = heap_take_free_block(heap, search_size);
+
+	if (!block)
+	{
+		if (!heap_grow(heap, search_size))
+		{
+			FATAL_ERROR("Heap is out of memory: wanted to allocate %zu bytes with align %zu, %zu of %zu bytes are committed",
+						size, align, (size_t)(heap->committed - heap->base), (size_t)(heap->end - heap->base));
+			return NULL;
+		}
+
+		block = heap_take_free_block(heap, search_size);
+		ASSERT(block);
+	}
+
+	if (align > HEAP_ALIGN)
+	{
+		char *pointer = heap_pointer_from_block(block);
+		char *aligned = align_address(pointer, align);
+
+		// the gap in front has to be big enough to be a block of its own
+		if (aligned != pointer && (size_t)(aligned - pointer) < HEAP_MIN_BLOCK_SIZE)
+		{
+			aligned = align_address(pointer + HEAP_MIN_BLOCK_SIZE, align);
+		}
+
+		size_t gap = (size_t)(aligned - pointer);
+
+		if (gap > 0)
+		{
+			heap_block_t *aligned_block = heap_block_from_pointer(aligned);
+			aligned_block->size_and_flags = heap_block_size(block) - gap;
+			aligned_block->prev_physical  = block;
+
+			heap_block_next(aligned_block)->prev_physical = aligned_block;
+
+			// the block in front was used or didn't exist, otherwise this block would have been merged with it
+			heap_block_set_size(block, gap - HEAP_HEADER_SIZE);
+			heap_insert_free_block(heap, block);
+
+			block = aligned_block;
+		}
+	}
+
+	heap_trim_block(heap, block, size);
+
+	block->size_and_flags &= ~(size_t)HEAP_BLOCK_FREE;
+
+	heap->allocation_count += 1;
+	heap->allocated_bytes  += heap_block_size(block) + HEAP_HEADER_SIZE;
+
+	return heap_pointer_from_block(block);
+}
+
+void *heap_alloc(heap_t *heap, size_t size, size_t align)
+{
+	void *result = heap_alloc_nozero(heap, size, align);
+	zero_memory(result, size);
+	return result;
+}
+
+void heap_free(heap_t *heap, void *pointer)
+{
+	if (!pointer)
+		return;
+
+	heap_block_t *block = heap_block_from_pointer(pointer);
+
+	ASSERT_MSG((char *)block >= heap->base && (char *)block < heap->committed, "Pointer was not allocated from this heap");
+	ASSERT_MSG(!heap_block_is_free(block), "Double free");
+
+	heap->allocation_count -= 1;
+	heap->allocated_bytes  -= heap_block_size(block) + HEAP_HEADER_SIZE;
+
+	block->size_and_flags |= HEAP_BLOCK_FREE;
+
+	block = heap_merge_block(heap, block);
+
+	if (heap_block_next(block) == heap_sentinel(heap))
+	{
+		heap_shrink(heap, block);
+	}
+
+	heap_insert_free_block(heap, block);
+}
+
+size_t heap_usable_size(void *pointer)
+{
+	return pointer ? heap_block_size(heap_block_from_pointer(pointer)) : 0;
+}
+
+void heap_get_stats(heap_t *heap, heap_stats_t *stats)
+{
+	zero_struct(stats);
+
+	stats->allocation_count = heap->allocation_count;
+	stats->allocated_bytes  = heap->allocated_bytes;
+	stats->committed_bytes  = (size_t)(heap->committed - heap->base);
+	stats->reserved_bytes   = (size_t)(heap->end       - heap->base);
+	stats->commit_count     = heap->commit_count;
+	stats->decommit_count   = heap->decommit_count;
+
+	for (uint32_t fl = 0; fl < HEAP_FL_COUNT; fl++)
+	for (uint32_t sl = 0; sl < HEAP_SL_COUNT; sl++)
+	{
+		for (heap_block_t *block = heap->free_lists[fl][sl]; block; block = block->next_free)
+		{
+			size_t size = heap_block_size(block);
+
+			stats->free_bytes         += size;
+			stats->free_block_count   += 1;
+			stats->largest_free_block  = MAX(stats->largest_free_block, size);
+		}
+	}
+}
+
+bool heap_check(heap_t *heap)
+{
+	if (!heap->base)
+		return true;
+
+	size_t free_count      = 0;
+	size_t used_count      = 0;
+	size_t allocated_bytes = 0;
+
+	heap_block_t *prev  = NULL;
+	heap_block_t *block = (heap_block_t *)heap->base;
+
+	while (block != heap_sentinel(heap))
+	{
+		if ((char *)block > (char *)heap_sentinel(heap)) return false;
+		if (block->prev_physical != prev)                return false;
+		if (heap_block_size(block) < HEAP_MIN_PAYLOAD_SIZE) return false;
+
+		if (heap_block_is_free(block))
+		{
+			if (prev && heap_block_is_free(prev)) return false; // should have been merged
+
+			free_count += 1;
+		}
+		else
+		{
+			used_count      += 1;
+			allocated_bytes += heap_block_size(block) + HEAP_HEADER_SIZE;
+		}
+
+		prev  = block;
+		block = heap_block_next(block);
+	}
+
+	if (block->prev_physical != prev || block->size_and_flags != 0) return false;
+
+	if (used_count      != heap->allocation_count) return false;
+	if (allocated_bytes != heap->allocated_bytes)  return false;
+
+	size_t listed_count = 0;
+
+	for (uint32_t fl = 0; fl < HEAP_FL_COUNT; fl++)
+	{
+		if (!!(heap->fl_bitmap & (1u << fl)) != !!heap->sl_bitmap[fl]) return false;
+
+		for (uint32_t sl = 0; sl < HEAP_SL_COUNT; sl++)
+		{
+			heap_block_t *head = heap->free_lists[fl][sl];
+
+			if (!!(heap->sl_bitmap[fl] & (1u << sl)) != !!head) return false;
+			if (head && head->prev_free)                        return false;
+
+			for (heap_block_t *free_block = head; free_block; free_block = free_block->next_free)
+			{
+				if (!heap_block_is_free(free_block)) return false;
+
+				uint32_t block_fl, block_sl;
+				heap_mapping(heap_block_size(free_block), &block_fl, &block_sl);
+
+				if (block_fl != fl || block_sl != sl) return false;
+				if (free_block->next_free && free_block->next_free->prev_free != free_block) return false;
+
+				listed_count += 1;
+			}
+		}
+	}
+
+	return listed_count == free_count;
+}
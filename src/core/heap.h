@@ -4,10 +4,67 @@
 
 #pragma once
 
+// Two-Level Segregated Fit heap. Free blocks are binned by size: the first level splits sizes into
+// power of two ranges, the second level splits each of those linearly into HEAP_SL_COUNT bins. Both levels
+// have a bitmap of non-empty bins, so finding a free block that fits is a couple of bit scans, and
+// allocating and freeing are O(1). Freed blocks are merged with free neighbours right away.
+//
+// The heap lives in one vm_reserve'd range. It commits more of it as it grows, and decommits the top
+// again when enough of it is free, so unlike simple_heap_t it gives memory back.
+//
+// A zero-initialized heap_t is ready to use and reserves HEAP_DEFAULT_RESERVE_SIZE on first allocation.
+// Not thread safe.
+
+#define HEAP_ALIGN                16
+#define HEAP_SL_COUNT_LOG2        5
+#define HEAP_SL_COUNT             (1 << HEAP_SL_COUNT_LOG2)
+#define HEAP_FL_COUNT             32 // enough for blocks up to 1TB
+#define HEAP_DEFAULT_RESERVE_SIZE GB(16)
+#define HEAP_COMMIT_CHUNK_SIZE    KB(64)
+#define HEAP_DECOMMIT_THRESHOLD   MB(1) // free bytes at the top of the heap before any get decommitted
+
+typedef struct heap_block_t heap_block_t;
+
 typedef struct heap_t
 {
-    int dummy;
+	char *base;
+	char *committed;
+	char *end;
+
+	size_t allocation_count;
+	size_t allocated_bytes; // including block headers
+	size_t commit_count;
+	size_t decommit_count;
+
+	uint32_t      fl_bitmap;
+	uint32_t      sl_bitmap [HEAP_FL_COUNT];
+	heap_block_t *free_lists[HEAP_FL_COUNT][HEAP_SL_COUNT];
 } heap_t;
 
-void *heap_alloc(heap_t *heap, size_t size, size_t align);
-void *heap_free (heap_t *heap, size_t size, void *ptr);
+typedef struct heap_stats_t
+{
+	size_t allocation_count;
+	size_t allocated_bytes;
+	size_t free_bytes;
+	size_t free_block_count;
+	size_t largest_free_block;
+	size_t committed_bytes;
+	size_t reserved_bytes;
+	size_t commit_count;
+	size_t decommit_count;
+} heap_stats_t;
+
+fn void   heap_init        (heap_t *heap, size_t reserve_size); // only needed for a reserve size other than the default
+fn void   heap_release     (heap_t *heap);                      // frees all memory, the heap can be used again afterwards
+fn void  *heap_alloc_nozero(heap_t *heap, size_t size, size_t align);
+fn void  *heap_alloc       (heap_t *heap, size_t size, size_t align);
+fn void   heap_free        (heap_t *heap, void *pointer);
+fn size_t heap_usable_size (void *pointer); // at least the size the pointer was allocated with
+fn void   heap_get_stats   (heap_t *heap, heap_stats_t *stats);
+fn bool   heap_check       (heap_t *heap); // walks every block and free list, returns false if anything is inconsistent
+
+#define heap_alloc_struct(heap, type) \
+	(type *)heap_alloc(heap, sizeof(type), alignof(type))
+
+#define heap_alloc_array(heap, type, count) \
+	(type *)heap_alloc(heap, sizeof(type)*(count), alignof(type))
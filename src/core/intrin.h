@@ -5,14 +5,19 @@
 #ifndef INTRIN_H
 #define INTRIN_H
 
+#if _MSC_VER
 #include <intrin.h>
+#else
+#include <x86intrin.h>
+#include <cpuid.h>
+#endif
 
 static inline uint64_t count_set_bits64(uint64_t x)
 {
 #if _MSC_VER
     return __popcnt64(x);
 #else
-#error TODO: Implement
+    return (uint64_t)__builtin_popcountll(x);
 #endif
 }
 
@@ -21,7 +26,7 @@ static inline void bit_scan_forward64(unsigned long *index, uint64_t mask)
 #if _MSC_VER
     _BitScanForward64(index, mask);
 #else
-#error TODO: Implement
+    *index = (unsigned long)__builtin_ctzll(mask);
 #endif
 }
 
@@ -31,7 +36,7 @@ fn_local unsigned long bit_scan_reverse_u64(uint64_t x)
 	unsigned long index;
     _BitScanReverse64(&index, x);
 #else
-#error TODO: Implement
+	unsigned long index = 63 - (unsigned long)__builtin_clzll(x);
 #endif
 	return index;
 }
@@ -41,7 +46,7 @@ fn_local uint64_t count_leading_zeros_u64(uint64_t x)
 #if _MSC_VER
 	return __lzcnt64(x);
 #else
-#error TODO: Implement
+	return x ? (uint64_t)__builtin_clzll(x) : 64;
 #endif
 }
 
@@ -5,10 +5,20 @@
 #pragma once
 
 #include <xmmintrin.h>
+#include <immintrin.h>
 #include <float.h>
 #include <math.h>
 
 typedef __m128 v4sf;  // vector of 4 float (sse1)
+typedef __m256 v8sf;  // vector of 8 float (avx)
+
+// MSVC lets any function use any intrinsic. GCC and clang only allow AVX2 in functions marked with this, and
+// only inline those into other marked functions. Anything marked can only run after checking the CPU has AVX2.
+#if _MSC_VER
+#define TARGET_AVX2
+#else
+#define TARGET_AVX2 __attribute__((target("avx2")))
+#endif
 
 // allows for row-major creation of matrices
 #define make_m4x4(e00, e01, e02, e03, \
@@ -70,6 +80,13 @@ fn_local v4sf sin_ps(v4sf x);
 fn_local v4sf cos_ps(v4sf x);
 fn_local void sincos_ps(v4sf x, v4sf *s, v4sf *c);
 
+// and their AVX2 versions further down
+TARGET_AVX2 fn_local v8sf log256_ps(v8sf x);
+TARGET_AVX2 fn_local v8sf exp256_ps(v8sf x);
+TARGET_AVX2 fn_local v8sf sin256_ps(v8sf x);
+TARGET_AVX2 fn_local v8sf cos256_ps(v8sf x);
+TARGET_AVX2 fn_local void sincos256_ps(v8sf x, v8sf *s, v8sf *c);
+
 // #pragma optimize("t", on)
 
 fn_local float log_ss(float x)
@@ -347,7 +364,7 @@ fn_local hsv_conv_t hsv_from_rgb(v3_t rgb)
 
 	hsv_conv_t result = {
 		.hsv                 = { h, s, v },
-		.hue_is_well_defined = true,
+		.hue_is_well_defined = hue_is_well_defined,
 	};
 
 	return result;
@@ -1931,6 +1948,17 @@ fn_local v3_t rect3_dim(rect3_t rect)
     return sub(rect.max, rect.min);
 }
 
+// 0 for inverted rects, like rect3_inverted_infinity()
+fn_local float rect3_surface_area(rect3_t rect)
+{
+    v3_t dim = sub(rect.max, rect.min);
+
+    if (dim.x < 0.0f || dim.y < 0.0f || dim.z < 0.0f)
+        return 0.0f;
+
+    return 2.0f*(dim.x*dim.y + dim.y*dim.z + dim.z*dim.x);
+}
+
 fn_local rect3_t rect3_center_radius(v3_t center, v3_t radius)
 {
     rect3_t result = {
@@ -2142,6 +2170,323 @@ fn_local v3_t forward_vector_from_pitch_yaw(float pitch, float yaw)
     return forward;
 }
 
+//
+// wide
+//
+
+// Structure of arrays math, 4 lanes with SSE2 and 8 with AVX2. Where there's a scalar version the wide one does
+// the same float operations in the same order, so each lane matches it bit for bit: min and max pick the same
+// operand on ties and NaNs as flt_min and flt_max, dot and cross multiply and add like v3_dot and cross. That
+// holds as long as the compiler doesn't fuse the scalar code's multiplies and adds into FMAs. The exceptions are
+// rsqrt, which is the hardware approximation with a relative error below 1.5*2^-12 (same as rsqrt_ss), and the
+// transcendentals, which are sse_mathfun and only good to an ulp or two.
+//
+// Comparisons return masks with all bits of a lane set where it holds, for select, the bitwise ops and mask_bits.
+// Everything x8 is TARGET_AVX2.
+
+typedef __m128 f32x4_t;
+typedef __m256 f32x8_t;
+
+typedef struct v3x4_t
+{
+    f32x4_t x, y, z;
+} v3x4_t;
+
+typedef struct v3x8_t
+{
+    f32x8_t x, y, z;
+} v3x8_t;
+
+// f32x4_t
+
+fn_local f32x4_t f32x4_set1 (float x)                  { return _mm_set1_ps(x); }
+fn_local f32x4_t f32x4_zero (void)                     { return _mm_setzero_ps(); }
+fn_local f32x4_t f32x4_load (const float *src)         { return _mm_loadu_ps(src); }
+fn_local void    f32x4_store(float *dst, f32x4_t x)    { _mm_storeu_ps(dst, x); }
+fn_local float   f32x4_get  (f32x4_t x, uint32_t lane) { float lanes[4]; _mm_storeu_ps(lanes, x); return lanes[lane]; }
+
+fn_local f32x4_t f32x4_add(f32x4_t l, f32x4_t r) { return _mm_add_ps(l, r); }
+fn_local f32x4_t f32x4_sub(f32x4_t l, f32x4_t r) { return _mm_sub_ps(l, r); }
+fn_local f32x4_t f32x4_mul(f32x4_t l, f32x4_t r) { return _mm_mul_ps(l, r); }
+fn_local f32x4_t f32x4_div(f32x4_t l, f32x4_t r) { return _mm_div_ps(l, r); }
+fn_local f32x4_t f32x4_min(f32x4_t l, f32x4_t r) { return _mm_min_ps(l, r); }
+fn_local f32x4_t f32x4_max(f32x4_t l, f32x4_t r) { return _mm_max_ps(l, r); }
+
+fn_local f32x4_t f32x4_sqrt  (f32x4_t x) { return _mm_sqrt_ps(x); }
+fn_local f32x4_t f32x4_rsqrt (f32x4_t x) { return _mm_rsqrt_ps(x); }
+fn_local f32x4_t f32x4_abs   (f32x4_t x) { return _mm_andnot_ps(_mm_set1_ps(-0.0f), x); }
+fn_local f32x4_t f32x4_negate(f32x4_t x) { return _mm_xor_ps(_mm_set1_ps(-0.0f), x); }
+
+fn_local f32x4_t f32x4_lerp(f32x4_t l, f32x4_t r, f32x4_t t)
+{
+    return _mm_add_ps(_mm_mul_ps(l, _mm_sub_ps(_mm_set1_ps(1.0f), t)), _mm_mul_ps(r, t));
+}
+
+fn_local f32x4_t f32x4_cmplt (f32x4_t l, f32x4_t r) { return _mm_cmplt_ps (l, r); }
+fn_local f32x4_t f32x4_cmple (f32x4_t l, f32x4_t r) { return _mm_cmple_ps (l, r); }
+fn_local f32x4_t f32x4_cmpgt (f32x4_t l, f32x4_t r) { return _mm_cmpgt_ps (l, r); }
+fn_local f32x4_t f32x4_cmpge (f32x4_t l, f32x4_t r) { return _mm_cmpge_ps (l, r); }
+fn_local f32x4_t f32x4_cmpeq (f32x4_t l, f32x4_t r) { return _mm_cmpeq_ps (l, r); }
+fn_local f32x4_t f32x4_cmpneq(f32x4_t l, f32x4_t r) { return _mm_cmpneq_ps(l, r); }
+
+fn_local f32x4_t  f32x4_and      (f32x4_t l, f32x4_t r) { return _mm_and_ps(l, r); }
+fn_local f32x4_t  f32x4_or       (f32x4_t l, f32x4_t r) { return _mm_or_ps(l, r); }
+fn_local f32x4_t  f32x4_xor      (f32x4_t l, f32x4_t r) { return _mm_xor_ps(l, r); }
+fn_local f32x4_t  f32x4_andnot   (f32x4_t l, f32x4_t r) { return _mm_andnot_ps(l, r); } // ~l & r
+fn_local uint32_t f32x4_mask_bits(f32x4_t mask)         { return (uint32_t)_mm_movemask_ps(mask); } // bit i = lane i
+
+// mask ? a : b, per lane
+fn_local f32x4_t f32x4_select(f32x4_t mask, f32x4_t a, f32x4_t b)
+{
+    return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b));
+}
+
+fn_local f32x4_t f32x4_log(f32x4_t x) { return log_ps(x); }
+fn_local f32x4_t f32x4_exp(f32x4_t x) { return exp_ps(x); }
+fn_local f32x4_t f32x4_sin(f32x4_t x) { return sin_ps(x); }
+fn_local f32x4_t f32x4_cos(f32x4_t x) { return cos_ps(x); }
+fn_local void    f32x4_sincos(f32x4_t x, f32x4_t *s, f32x4_t *c) { sincos_ps(x, s, c); }
+
+// f32x8_t
+
+TARGET_AVX2 fn_local f32x8_t f32x8_set1 (float x)                  { return _mm256_set1_ps(x); }
+TARGET_AVX2 fn_local f32x8_t f32x8_zero (void)                     { return _mm256_setzero_ps(); }
+TARGET_AVX2 fn_local f32x8_t f32x8_load (const float *src)         { return _mm256_loadu_ps(src); }
+TARGET_AVX2 fn_local void    f32x8_store(float *dst, f32x8_t x)    { _mm256_storeu_ps(dst, x); }
+TARGET_AVX2 fn_local float   f32x8_get  (f32x8_t x, uint32_t lane) { float lanes[8]; _mm256_storeu_ps(lanes, x); return lanes[lane]; }
+
+TARGET_AVX2 fn_local f32x8_t f32x8_add(f32x8_t l, f32x8_t r) { return _mm256_add_ps(l, r); }
+TARGET_AVX2 fn_local f32x8_t f32x8_sub(f32x8_t l, f32x8_t r) { return _mm256_sub_ps(l, r); }
+TARGET_AVX2 fn_local f32x8_t f32x8_mul(f32x8_t l, f32x8_t r) { return _mm256_mul_ps(l, r); }
+TARGET_AVX2 fn_local f32x8_t f32x8_div(f32x8_t l, f32x8_t r) { return _mm256_div_ps(l, r); }
+TARGET_AVX2 fn_local f32x8_t f32x8_min(f32x8_t l, f32x8_t r) { return _mm256_min_ps(l, r); }
+TARGET_AVX2 fn_local f32x8_t f32x8_max(f32x8_t l, f32x8_t r) { return _mm256_max_ps(l, r); }
+
+TARGET_AVX2 fn_local f32x8_t f32x8_sqrt  (f32x8_t x) { return _mm256_sqrt_ps(x); }
+TARGET_AVX2 fn_local f32x8_t f32x8_rsqrt (f32x8_t x) { return _mm256_rsqrt_ps(x); }
+TARGET_AVX2 fn_local f32x8_t f32x8_abs   (f32x8_t x) { return _mm256_andnot_ps(_mm256_set1_ps(-0.0f), x); }
+TARGET_AVX2 fn_local f32x8_t f32x8_negate(f32x8_t x) { return _mm256_xor_ps(_mm256_set1_ps(-0.0f), x); }
+
+TARGET_AVX2 fn_local f32x8_t f32x8_lerp(f32x8_t l, f32x8_t r, f32x8_t t)
+{
+    return _mm256_add_ps(_mm256_mul_ps(l, _mm256_sub_ps(_mm256_set1_ps(1.0f), t)), _mm256_mul_ps(r, t));
+}
+
+TARGET_AVX2 fn_local f32x8_t f32x8_cmplt (f32x8_t l, f32x8_t r) { return _mm256_cmp_ps(l, r, _CMP_LT_OS);  }
+TARGET_AVX2 fn_local f32x8_t f32x8_cmple (f32x8_t l, f32x8_t r) { return _mm256_cmp_ps(l, r, _CMP_LE_OS);  }
+TARGET_AVX2 fn_local f32x8_t f32x8_cmpgt (f32x8_t l, f32x8_t r) { return _mm256_cmp_ps(l, r, _CMP_GT_OS);  }
+TARGET_AVX2 fn_local f32x8_t f32x8_cmpge (f32x8_t l, f32x8_t r) { return _mm256_cmp_ps(l, r, _CMP_GE_OS);  }
+TARGET_AVX2 fn_local f32x8_t f32x8_cmpeq (f32x8_t l, f32x8_t r) { return _mm256_cmp_ps(l, r, _CMP_EQ_OQ);  }
+TARGET_AVX2 fn_local f32x8_t f32x8_cmpneq(f32x8_t l, f32x8_t r) { return _mm256_cmp_ps(l, r, _CMP_NEQ_UQ); }
+
+TARGET_AVX2 fn_local f32x8_t  f32x8_and      (f32x8_t l, f32x8_t r) { return _mm256_and_ps(l, r); }
+TARGET_AVX2 fn_local f32x8_t  f32x8_or       (f32x8_t l, f32x8_t r) { return _mm256_or_ps(l, r); }
+TARGET_AVX2 fn_local f32x8_t  f32x8_xor      (f32x8_t l, f32x8_t r) { return _mm256_xor_ps(l, r); }
+TARGET_AVX2 fn_local f32x8_t  f32x8_andnot   (f32x8_t l, f32x8_t r) { return _mm256_andnot_ps(l, r); } // ~l & r
+TARGET_AVX2 fn_local uint32_t f32x8_mask_bits(f32x8_t mask)         { return (uint32_t)_mm256_movemask_ps(mask); } // bit i = lane i
+
+// mask ? a : b, per lane. blendv only looks at the top bit of each lane, which is set in every mask from a comparison
+TARGET_AVX2 fn_local f32x8_t f32x8_select(f32x8_t mask, f32x8_t a, f32x8_t b)
+{
+    return _mm256_blendv_ps(b, a, mask);
+}
+
+TARGET_AVX2 fn_local f32x8_t f32x8_log(f32x8_t x) { return log256_ps(x); }
+TARGET_AVX2 fn_local f32x8_t f32x8_exp(f32x8_t x) { return exp256_ps(x); }
+TARGET_AVX2 fn_local f32x8_t f32x8_sin(f32x8_t x) { return sin256_ps(x); }
+TARGET_AVX2 fn_local f32x8_t f32x8_cos(f32x8_t x) { return cos256_ps(x); }
+TARGET_AVX2 fn_local void    f32x8_sincos(f32x8_t x, f32x8_t *s, f32x8_t *c) { sincos256_ps(x, s, c); }
+
+// v3x4_t
+
+fn_local v3x4_t make_v3x4(f32x4_t x, f32x4_t y, f32x4_t z)
+{
+    return (v3x4_t){ x, y, z };
+}
+
+fn_local v3x4_t v3x4_set1(v3_t v)
+{
+    return (v3x4_t){ _mm_set1_ps(v.x), _mm_set1_ps(v.y), _mm_set1_ps(v.z) };
+}
+
+// from separate arrays of x, y and z
+fn_local v3x4_t v3x4_load(const float *x, const float *y, const float *z)
+{
+    return (v3x4_t){ _mm_loadu_ps(x), _mm_loadu_ps(y), _mm_loadu_ps(z) };
+}
+
+fn_local void v3x4_store(float *x, float *y, float *z, v3x4_t v)
+{
+    _mm_storeu_ps(x, v.x);
+    _mm_storeu_ps(y, v.y);
+    _mm_storeu_ps(z, v.z);
+}
+
+// from 4 v3_t in a row
+fn_local v3x4_t v3x4_from_v3s(const v3_t *v)
+{
+    return (v3x4_t){
+        _mm_setr_ps(v[0].x, v[1].x, v[2].x, v[3].x),
+        _mm_setr_ps(v[0].y, v[1].y, v[2].y, v[3].y),
+        _mm_setr_ps(v[0].z, v[1].z, v[2].z, v[3].z),
+    };
+}
+
+fn_local v3_t v3x4_get(v3x4_t v, uint32_t lane)
+{
+    return (v3_t){ f32x4_get(v.x, lane), f32x4_get(v.y, lane), f32x4_get(v.z, lane) };
+}
+
+fn_local v3x4_t v3x4_add(v3x4_t l, v3x4_t r) { return (v3x4_t){ _mm_add_ps(l.x, r.x), _mm_add_ps(l.y, r.y), _mm_add_ps(l.z, r.z) }; }
+fn_local v3x4_t v3x4_sub(v3x4_t l, v3x4_t r) { return (v3x4_t){ _mm_sub_ps(l.x, r.x), _mm_sub_ps(l.y, r.y), _mm_sub_ps(l.z, r.z) }; }
+fn_local v3x4_t v3x4_mul(v3x4_t l, v3x4_t r) { return (v3x4_t){ _mm_mul_ps(l.x, r.x), _mm_mul_ps(l.y, r.y), _mm_mul_ps(l.z, r.z) }; }
+fn_local v3x4_t v3x4_div(v3x4_t l, v3x4_t r) { return (v3x4_t){ _mm_div_ps(l.x, r.x), _mm_div_ps(l.y, r.y), _mm_div_ps(l.z, r.z) }; }
+fn_local v3x4_t v3x4_min(v3x4_t l, v3x4_t r) { return (v3x4_t){ _mm_min_ps(l.x, r.x), _mm_min_ps(l.y, r.y), _mm_min_ps(l.z, r.z) }; }
+fn_local v3x4_t v3x4_max(v3x4_t l, v3x4_t r) { return (v3x4_t){ _mm_max_ps(l.x, r.x), _mm_max_ps(l.y, r.y), _mm_max_ps(l.z, r.z) }; }
+
+fn_local v3x4_t v3x4_muls(v3x4_t l, f32x4_t r) { return (v3x4_t){ _mm_mul_ps(l.x, r), _mm_mul_ps(l.y, r), _mm_mul_ps(l.z, r) }; }
+fn_local v3x4_t v3x4_divs(v3x4_t l, f32x4_t r) { return (v3x4_t){ _mm_div_ps(l.x, r), _mm_div_ps(l.y, r), _mm_div_ps(l.z, r) }; }
+
+fn_local v3x4_t v3x4_negate(v3x4_t v)
+{
+    return (v3x4_t){ f32x4_negate(v.x), f32x4_negate(v.y), f32x4_negate(v.z) };
+}
+
+fn_local f32x4_t v3x4_dot(v3x4_t l, v3x4_t r)
+{
+    return _mm_add_ps(_mm_add_ps(_mm_mul_ps(l.x, r.x), _mm_mul_ps(l.y, r.y)), _mm_mul_ps(l.z, r.z));
+}
+
+fn_local v3x4_t v3x4_cross(v3x4_t a, v3x4_t b)
+{
+    return (v3x4_t){
+        _mm_sub_ps(_mm_mul_ps(a.y, b.z), _mm_mul_ps(a.z, b.y)),
+        _mm_sub_ps(_mm_mul_ps(a.z, b.x), _mm_mul_ps(a.x, b.z)),
+        _mm_sub_ps(_mm_mul_ps(a.x, b.y), _mm_mul_ps(a.y, b.x)),
+    };
+}
+
+fn_local f32x4_t v3x4_lensq(v3x4_t v)
+{
+    return v3x4_dot(v, v);
+}
+
+fn_local f32x4_t v3x4_len(v3x4_t v)
+{
+    return _mm_sqrt_ps(v3x4_dot(v, v));
+}
+
+fn_local v3x4_t v3x4_normalize(v3x4_t v)
+{
+    f32x4_t rcp_len = _mm_div_ps(_mm_set1_ps(1.0f), _mm_sqrt_ps(v3x4_dot(v, v)));
+    return v3x4_muls(v, rcp_len);
+}
+
+fn_local v3x4_t v3x4_lerp(v3x4_t l, v3x4_t r, f32x4_t t)
+{
+    return (v3x4_t){ f32x4_lerp(l.x, r.x, t), f32x4_lerp(l.y, r.y, t), f32x4_lerp(l.z, r.z, t) };
+}
+
+fn_local v3x4_t v3x4_select(f32x4_t mask, v3x4_t a, v3x4_t b)
+{
+    return (v3x4_t){ f32x4_select(mask, a.x, b.x), f32x4_select(mask, a.y, b.y), f32x4_select(mask, a.z, b.z) };
+}
+
+// v3x8_t
+
+TARGET_AVX2 fn_local v3x8_t make_v3x8(f32x8_t x, f32x8_t y, f32x8_t z)
+{
+    return (v3x8_t){ x, y, z };
+}
+
+TARGET_AVX2 fn_local v3x8_t v3x8_set1(v3_t v)
+{
+    return (v3x8_t){ _mm256_set1_ps(v.x), _mm256_set1_ps(v.y), _mm256_set1_ps(v.z) };
+}
+
+// from separate arrays of x, y and z
+TARGET_AVX2 fn_local v3x8_t v3x8_load(const float *x, const float *y, const float *z)
+{
+    return (v3x8_t){ _mm256_loadu_ps(x), _mm256_loadu_ps(y), _mm256_loadu_ps(z) };
+}
+
+TARGET_AVX2 fn_local void v3x8_store(float *x, float *y, float *z, v3x8_t v)
+{
+    _mm256_storeu_ps(x, v.x);
+    _mm256_storeu_ps(y, v.y);
+    _mm256_storeu_ps(z, v.z);
+}
+
+// from 8 v3_t in a row
+TARGET_AVX2 fn_local v3x8_t v3x8_from_v3s(const v3_t *v)
+{
+    return (v3x8_t){
+        _mm256_setr_ps(v[0].x, v[1].x, v[2].x, v[3].x, v[4].x, v[5].x, v[6].x, v[7].x),
+        _mm256_setr_ps(v[0].y, v[1].y, v[2].y, v[3].y, v[4].y, v[5].y, v[6].y, v[7].y),
+        _mm256_setr_ps(v[0].z, v[1].z, v[2].z, v[3].z, v[4].z, v[5].z, v[6].z, v[7].z),
+    };
+}
+
+TARGET_AVX2 fn_local v3_t v3x8_get(v3x8_t v, uint32_t lane)
+{
+    return (v3_t){ f32x8_get(v.x, lane), f32x8_get(v.y, lane), f32x8_get(v.z, lane) };
+}
+
+TARGET_AVX2 fn_local v3x8_t v3x8_add(v3x8_t l, v3x8_t r) { return (v3x8_t){ _mm256_add_ps(l.x, r.x), _mm256_add_ps(l.y, r.y), _mm256_add_ps(l.z, r.z) }; }
+TARGET_AVX2 fn_local v3x8_t v3x8_sub(v3x8_t l, v3x8_t r) { return (v3x8_t){ _mm256_sub_ps(l.x, r.x), _mm256_sub_ps(l.y, r.y), _mm256_sub_ps(l.z, r.z) }; }
+TARGET_AVX2 fn_local v3x8_t v3x8_mul(v3x8_t l, v3x8_t r) { return (v3x8_t){ _mm256_mul_ps(l.x, r.x), _mm256_mul_ps(l.y, r.y), _mm256_mul_ps(l.z, r.z) }; }
+TARGET_AVX2 fn_local v3x8_t v3x8_div(v3x8_t l, v3x8_t r) { return (v3x8_t){ _mm256_div_ps(l.x, r.x), _mm256_div_ps(l.y, r.y), _mm256_div_ps(l.z, r.z) }; }
+TARGET_AVX2 fn_local v3x8_t v3x8_min(v3x8_t l, v3x8_t r) { return (v3x8_t){ _mm256_min_ps(l.x, r.x), _mm256_min_ps(l.y, r.y), _mm256_min_ps(l.z, r.z) }; }
+TARGET_AVX2 fn_local v3x8_t v3x8_max(v3x8_t l, v3x8_t r) { return (v3x8_t){ _mm256_max_ps(l.x, r.x), _mm256_max_ps(l.y, r.y), _mm256_max_ps(l.z, r.z) }; }
+
+TARGET_AVX2 fn_local v3x8_t v3x8_muls(v3x8_t l, f32x8_t r) { return (v3x8_t){ _mm256_mul_ps(l.x, r), _mm256_mul_ps(l.y, r), _mm256_mul_ps(l.z, r) }; }
+TARGET_AVX2 fn_local v3x8_t v3x8_divs(v3x8_t l, f32x8_t r) { return (v3x8_t){ _mm256_div_ps(l.x, r), _mm256_div_ps(l.y, r), _mm256_div_ps(l.z, r) }; }
+
+TARGET_AVX2 fn_local v3x8_t v3x8_negate(v3x8_t v)
+{
+    return (v3x8_t){ f32x8_negate(v.x), f32x8_negate(v.y), f32x8_negate(v.z) };
+}
+
+TARGET_AVX2 fn_local f32x8_t v3x8_dot(v3x8_t l, v3x8_t r)
+{
+    return _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(l.x, r.x), _mm256_mul_ps(l.y, r.y)), _mm256_mul_ps(l.z, r.z));
+}
+
+TARGET_AVX2 fn_local v3x8_t v3x8_cross(v3x8_t a, v3x8_t b)
+{
+    return (v3x8_t){
+        _mm256_sub_ps(_mm256_mul_ps(a.y, b.z), _mm256_mul_ps(a.z, b.y)),
+        _mm256_sub_ps(_mm256_mul_ps(a.z, b.x), _mm256_mul_ps(a.x, b.z)),
+        _mm256_sub_ps(_mm256_mul_ps(a.x, b.y), _mm256_mul_ps(a.y, b.x)),
+    };
+}
+
+TARGET_AVX2 fn_local f32x8_t v3x8_lensq(v3x8_t v)
+{
+    return v3x8_dot(v, v);
+}
+
+TARGET_AVX2 fn_local f32x8_t v3x8_len(v3x8_t v)
+{
+    return _mm256_sqrt_ps(v3x8_dot(v, v));
+}
+
+TARGET_AVX2 fn_local v3x8_t v3x8_normalize(v3x8_t v)
+{
+    f32x8_t rcp_len = _mm256_div_ps(_mm256_set1_ps(1.0f), _mm256_sqrt_ps(v3x8_dot(v, v)));
+    return v3x8_muls(v, rcp_len);
+}
+
+TARGET_AVX2 fn_local v3x8_t v3x8_lerp(v3x8_t l, v3x8_t r, f32x8_t t)
+{
+    return (v3x8_t){ f32x8_lerp(l.x, r.x, t), f32x8_lerp(l.y, r.y, t), f32x8_lerp(l.z, r.z, t) };
+}
+
+TARGET_AVX2 fn_local v3x8_t v3x8_select(f32x8_t mask, v3x8_t a, v3x8_t b)
+{
+    return (v3x8_t){ f32x8_select(mask, a.x, b.x), f32x8_select(mask, a.y, b.y), f32x8_select(mask, a.z, b.z) };
+}
+
 // Steam hardware survey says SSE2 availability is 100%
 // That seems good enough to me.
 #define USE_SSE2
@@ -2855,4 +3200,454 @@ void sincos_ps(v4sf x, v4sf *s, v4sf *c) {
   *c = _mm_xor_ps(xmm2, sign_bit_cos);
 }
 
+/* AVX2 versions of the above for 8 floats at a time, same algorithms, constants and order of operations, so
+   each lane gives exactly what the SSE2 version does. Only the SSE2 paths were carried over. */
+
+#ifdef _MSC_VER /* visual c++ */
+# define ALIGN32_BEG __declspec(align(32))
+# define ALIGN32_END 
+#else /* gcc or icc */
+# define ALIGN32_BEG
+# define ALIGN32_END __attribute__((aligned(32)))
+#endif
+
+typedef __m256i v8si; // vector of 8 int (avx2)
+
+#define _PS256_CONST(Name, Val)                                            \
+  static const ALIGN32_BEG float _ps256_##Name[8] ALIGN32_END = { (float)Val, (float)Val, (float)Val, (float)Val, (float)Val, (float)Val, (float)Val, (float)Val }
+#define _PI32_CONST256(Name, Val)                                            \
+  static const ALIGN32_BEG int _pi32_256_##Name[8] ALIGN32_END = { Val, Val, Val, Val, Val, Val, Val, Val }
+#define _PS256_CONST_TYPE(Name, Type, Val)                                 \
+  static const ALIGN32_BEG Type _ps256_##Name[8] ALIGN32_END = { Val, Val, Val, Val, Val, Val, Val, Val }
+
+_PS256_CONST(1  , 1.0f);
+_PS256_CONST(0p5, 0.5f);
+/* the smallest non denormalized float number */
+_PS256_CONST_TYPE(min_norm_pos, int, 0x00800000);
+_PS256_CONST_TYPE(inv_mant_mask, int, ~0x7f800000);
+
+_PS256_CONST_TYPE(sign_mask, int, (int)0x80000000);
+_PS256_CONST_TYPE(inv_sign_mask, int, ~0x80000000);
+
+_PI32_CONST256(1, 1);
+_PI32_CONST256(inv1, ~1);
+_PI32_CONST256(2, 2);
+_PI32_CONST256(4, 4);
+_PI32_CONST256(0x7f, 0x7f);
+
+_PS256_CONST(cephes_SQRTHF, 0.707106781186547524);
+_PS256_CONST(cephes_log_p0, 7.0376836292E-2);
+_PS256_CONST(cephes_log_p1, - 1.1514610310E-1);
+_PS256_CONST(cephes_log_p2, 1.1676998740E-1);
+_PS256_CONST(cephes_log_p3, - 1.2420140846E-1);
+_PS256_CONST(cephes_log_p4, + 1.4249322787E-1);
+_PS256_CONST(cephes_log_p5, - 1.6668057665E-1);
+_PS256_CONST(cephes_log_p6, + 2.0000714765E-1);
+_PS256_CONST(cephes_log_p7, - 2.4999993993E-1);
+_PS256_CONST(cephes_log_p8, + 3.3333331174E-1);
+_PS256_CONST(cephes_log_q1, -2.12194440e-4);
+_PS256_CONST(cephes_log_q2, 0.693359375);
+
+/* natural logarithm computed for 8 simultaneous float 
+   return NaN for x <= 0
+*/
+TARGET_AVX2 v8sf log256_ps(v8sf x) {
+  v8si imm0;
+  v8sf one = *(v8sf*)_ps256_1;
+
+  v8sf invalid_mask = _mm256_cmp_ps(x, _mm256_setzero_ps(), _CMP_LE_OS);
+
+  x = _mm256_max_ps(x, *(v8sf*)_ps256_min_norm_pos);  /* cut off denormalized stuff */
+
+  /* part 1: x = frexpf(x, &e); */
+  imm0 = _mm256_srli_epi32(_mm256_castps_si256(x), 23);
+
+  /* keep only the fractional part */
+  x = _mm256_and_ps(x, *(v8sf*)_ps256_inv_mant_mask);
+  x = _mm256_or_ps(x, *(v8sf*)_ps256_0p5);
+
+  imm0 = _mm256_sub_epi32(imm0, *(v8si*)_pi32_256_0x7f);
+  v8sf e = _mm256_cvtepi32_ps(imm0);
+
+  e = _mm256_add_ps(e, one);
+
+  /* part2: 
+     if( x < SQRTHF ) {
+       e -= 1;
+       x = x + x - 1.0;
+     } else { x = x - 1.0; }
+  */
+  v8sf mask = _mm256_cmp_ps(x, *(v8sf*)_ps256_cephes_SQRTHF, _CMP_LT_OS);
+  v8sf tmp = _mm256_and_ps(x, mask);
+  x = _mm256_sub_ps(x, one);
+  e = _mm256_sub_ps(e, _mm256_and_ps(one, mask));
+  x = _mm256_add_ps(x, tmp);
+
+  v8sf z = _mm256_mul_ps(x,x);
+
+  v8sf y = *(v8sf*)_ps256_cephes_log_p0;
+  y = _mm256_mul_ps(y, x);
+  y = _mm256_add_ps(y, *(v8sf*)_ps256_cephes_log_p1);
+  y = _mm256_mul_ps(y, x);
+  y = _mm256_add_ps(y, *(v8sf*)_ps256_cephes_log_p2);
+  y = _mm256_mul_ps(y, x);
+  y = _mm256_add_ps(y, *(v8sf*)_ps256_cephes_log_p3);
+  y = _mm256_mul_ps(y, x);
+  y = _mm256_add_ps(y, *(v8sf*)_ps256_cephes_log_p4);
+  y = _mm256_mul_ps(y, x);
+  y = _mm256_add_ps(y, *(v8sf*)_ps256_cephes_log_p5);
+  y = _mm256_mul_ps(y, x);
+  y = _mm256_add_ps(y, *(v8sf*)_ps256_cephes_log_p6);
+  y = _mm256_mul_ps(y, x);
+  y = _mm256_add_ps(y, *(v8sf*)_ps256_cephes_log_p7);
+  y = _mm256_mul_ps(y, x);
+  y = _mm256_add_ps(y, *(v8sf*)_ps256_cephes_log_p8);
+  y = _mm256_mul_ps(y, x);
+
+  y = _mm256_mul_ps(y, z);
+
+  tmp = _mm256_mul_ps(e, *(v8sf*)_ps256_cephes_log_q1);
+  y = _mm256_add_ps(y, tmp);
+
+  tmp = _mm256_mul_ps(z, *(v8sf*)_ps256_0p5);
+  y = _mm256_sub_ps(y, tmp);
+
+  tmp = _mm256_mul_ps(e, *(v8sf*)_ps256_cephes_log_q2);
+  x = _mm256_add_ps(x, y);
+  x = _mm256_add_ps(x, tmp);
+  x = _mm256_or_ps(x, invalid_mask); // negative arg will be NAN
+  return x;
+}
+
+_PS256_CONST(exp_hi,	88.3762626647949f);
+_PS256_CONST(exp_lo,	-88.3762626647949f);
+
+_PS256_CONST(cephes_LOG2EF, 1.44269504088896341);
+_PS256_CONST(cephes_exp_C1, 0.693359375);
+_PS256_CONST(cephes_exp_C2, -2.12194440e-4);
+
+_PS256_CONST(cephes_exp_p0, 1.9875691500E-4);
+_PS256_CONST(cephes_exp_p1, 1.3981999507E-3);
+_PS256_CONST(cephes_exp_p2, 8.3334519073E-3);
+_PS256_CONST(cephes_exp_p3, 4.1665795894E-2);
+_PS256_CONST(cephes_exp_p4, 1.6666665459E-1);
+_PS256_CONST(cephes_exp_p5, 5.0000001201E-1);
+
+TARGET_AVX2 v8sf exp256_ps(v8sf x) {
+  v8sf tmp = _mm256_setzero_ps(), fx;
+  v8si imm0;
+  v8sf one = *(v8sf*)_ps256_1;
+
+  x = _mm256_min_ps(x, *(v8sf*)_ps256_exp_hi);
+  x = _mm256_max_ps(x, *(v8sf*)_ps256_exp_lo);
+
+  /* express exp(x) as exp(g + n*log(2)) */
+  fx = _mm256_mul_ps(x, *(v8sf*)_ps256_cephes_LOG2EF);
+  fx = _mm256_add_ps(fx, *(v8sf*)_ps256_0p5);
+
+  /* the same truncate and fix up floor as the SSE2 version, rather than _mm256_floor_ps, to match it exactly */
+  imm0 = _mm256_cvttps_epi32(fx);
+  tmp  = _mm256_cvtepi32_ps(imm0);
+  /* if greater, substract 1 */
+  v8sf mask = _mm256_cmp_ps(tmp, fx, _CMP_GT_OS);
+  mask = _mm256_and_ps(mask, one);
+  fx = _mm256_sub_ps(tmp, mask);
+
+  tmp = _mm256_mul_ps(fx, *(v8sf*)_ps256_cephes_exp_C1);
+  v8sf z = _mm256_mul_ps(fx, *(v8sf*)_ps256_cephes_exp_C2);
+  x = _mm256_sub_ps(x, tmp);
+  x = _mm256_sub_ps(x, z);
+
+  z = _mm256_mul_ps(x,x);
+  
+  v8sf y = *(v8sf*)_ps256_cephes_exp_p0;
+  y = _mm256_mul_ps(y, x);
+  y = _mm256_add_ps(y, *(v8sf*)_ps256_cephes_exp_p1);
+  y = _mm256_mul_ps(y, x);
+  y = _mm256_add_ps(y, *(v8sf*)_ps256_cephes_exp_p2);
+  y = _mm256_mul_ps(y, x);
+  y = _mm256_add_ps(y, *(v8sf*)_ps256_cephes_exp_p3);
+  y = _mm256_mul_ps(y, x);
+  y = _mm256_add_ps(y, *(v8sf*)_ps256_cephes_exp_p4);
+  y = _mm256_mul_ps(y, x);
+  y = _mm256_add_ps(y, *(v8sf*)_ps256_cephes_exp_p5);
+  y = _mm256_mul_ps(y, z);
+  y = _mm256_add_ps(y, x);
+  y = _mm256_add_ps(y, one);
+
+  /* build 2^n */
+  imm0 = _mm256_cvttps_epi32(fx);
+  imm0 = _mm256_add_epi32(imm0, *(v8si*)_pi32_256_0x7f);
+  imm0 = _mm256_slli_epi32(imm0, 23);
+  v8sf pow2n = _mm256_castsi256_ps(imm0);
+  y = _mm256_mul_ps(y, pow2n);
+  return y;
+}
+
+_PS256_CONST(minus_cephes_DP1, -0.78515625);
+_PS256_CONST(minus_cephes_DP2, -2.4187564849853515625e-4);
+_PS256_CONST(minus_cephes_DP3, -3.77489497744594108e-8);
+_PS256_CONST(sincof_p0, -1.9515295891E-4);
+_PS256_CONST(sincof_p1,  8.3321608736E-3);
+_PS256_CONST(sincof_p2, -1.6666654611E-1);
+_PS256_CONST(coscof_p0,  2.443315711809948E-005);
+_PS256_CONST(coscof_p1, -1.388731625493765E-003);
+_PS256_CONST(coscof_p2,  4.166664568298827E-002);
+_PS256_CONST(cephes_FOPI, 1.27323954473516); // 4 / M_PI
+
+TARGET_AVX2 v8sf sin256_ps(v8sf x) { // any x
+  v8sf xmm1, xmm2, xmm3, sign_bit, y;
+  v8si imm0, imm2;
+
+  sign_bit = x;
+  /* take the absolute value */
+  x = _mm256_and_ps(x, *(v8sf*)_ps256_inv_sign_mask);
+  /* extract the sign bit (upper one) */
+  sign_bit = _mm256_and_ps(sign_bit, *(v8sf*)_ps256_sign_mask);
+  
+  /* scale by 4/Pi */
+  y = _mm256_mul_ps(x, *(v8sf*)_ps256_cephes_FOPI);
+
+  /* store the integer part of y in imm2 */
+  imm2 = _mm256_cvttps_epi32(y);
+  /* j=(j+1) & (~1) (see the cephes sources) */
+  imm2 = _mm256_add_epi32(imm2, *(v8si*)_pi32_256_1);
+  imm2 = _mm256_and_si256(imm2, *(v8si*)_pi32_256_inv1);
+  y = _mm256_cvtepi32_ps(imm2);
+
+  /* get the swap sign flag */
+  imm0 = _mm256_and_si256(imm2, *(v8si*)_pi32_256_4);
+  imm0 = _mm256_slli_epi32(imm0, 29);
+  /* get the polynom selection mask 
+     there is one polynom for 0 <= x <= Pi/4
+     and another one for Pi/4<x<=Pi/2
+
+     Both branches will be computed.
+  */
+  imm2 = _mm256_and_si256(imm2, *(v8si*)_pi32_256_2);
+  imm2 = _mm256_cmpeq_epi32(imm2, _mm256_setzero_si256());
+  
+  v8sf swap_sign_bit = _mm256_castsi256_ps(imm0);
+  v8sf poly_mask = _mm256_castsi256_ps(imm2);
+  sign_bit = _mm256_xor_ps(sign_bit, swap_sign_bit);
+
+  /* The magic pass: "Extended precision modular arithmetic" 
+     x = ((x - y * DP1) - y * DP2) - y * DP3; */
+  xmm1 = *(v8sf*)_ps256_minus_cephes_DP1;
+  xmm2 = *(v8sf*)_ps256_minus_cephes_DP2;
+  xmm3 = *(v8sf*)_ps256_minus_cephes_DP3;
+  xmm1 = _mm256_mul_ps(y, xmm1);
+  xmm2 = _mm256_mul_ps(y, xmm2);
+  xmm3 = _mm256_mul_ps(y, xmm3);
+  x = _mm256_add_ps(x, xmm1);
+  x = _mm256_add_ps(x, xmm2);
+  x = _mm256_add_ps(x, xmm3);
+
+  /* Evaluate the first polynom  (0 <= x <= Pi/4) */
+  y = *(v8sf*)_ps256_coscof_p0;
+  v8sf z = _mm256_mul_ps(x,x);
+
+  y = _mm256_mul_ps(y, z);
+  y = _mm256_add_ps(y, *(v8sf*)_ps256_coscof_p1);
+  y = _mm256_mul_ps(y, z);
+  y = _mm256_add_ps(y, *(v8sf*)_ps256_coscof_p2);
+  y = _mm256_mul_ps(y, z);
+  y = _mm256_mul_ps(y, z);
+  v8sf tmp = _mm256_mul_ps(z, *(v8sf*)_ps256_0p5);
+  y = _mm256_sub_ps(y, tmp);
+  y = _mm256_add_ps(y, *(v8sf*)_ps256_1);
+  
+  /* Evaluate the second polynom  (Pi/4 <= x <= 0) */
+
+  v8sf y2 = *(v8sf*)_ps256_sincof_p0;
+  y2 = _mm256_mul_ps(y2, z);
+  y2 = _mm256_add_ps(y2, *(v8sf*)_ps256_sincof_p1);
+  y2 = _mm256_mul_ps(y2, z);
+  y2 = _mm256_add_ps(y2, *(v8sf*)_ps256_sincof_p2);
+  y2 = _mm256_mul_ps(y2, z);
+  y2 = _mm256_mul_ps(y2, x);
+  y2 = _mm256_add_ps(y2, x);
+
+  /* select the correct result from the two polynoms */  
+  xmm3 = poly_mask;
+  y2 = _mm256_and_ps(xmm3, y2);
+  y = _mm256_andnot_ps(xmm3, y);
+  y = _mm256_add_ps(y,y2);
+  /* update the sign */
+  y = _mm256_xor_ps(y, sign_bit);
+  return y;
+}
+
+/* almost the same as sin256_ps */
+TARGET_AVX2 v8sf cos256_ps(v8sf x) { // any x
+  v8sf xmm1, xmm2, xmm3, y;
+  v8si imm0, imm2;
+
+  /* take the absolute value */
+  x = _mm256_and_ps(x, *(v8sf*)_ps256_inv_sign_mask);
+  
+  /* scale by 4/Pi */
+  y = _mm256_mul_ps(x, *(v8sf*)_ps256_cephes_FOPI);
+  
+  /* store the integer part of y in imm2 */
+  imm2 = _mm256_cvttps_epi32(y);
+  /* j=(j+1) & (~1) (see the cephes sources) */
+  imm2 = _mm256_add_epi32(imm2, *(v8si*)_pi32_256_1);
+  imm2 = _mm256_and_si256(imm2, *(v8si*)_pi32_256_inv1);
+  y = _mm256_cvtepi32_ps(imm2);
+
+  imm2 = _mm256_sub_epi32(imm2, *(v8si*)_pi32_256_2);
+  
+  /* get the swap sign flag */
+  imm0 = _mm256_andnot_si256(imm2, *(v8si*)_pi32_256_4);
+  imm0 = _mm256_slli_epi32(imm0, 29);
+  /* get the polynom selection mask */
+  imm2 = _mm256_and_si256(imm2, *(v8si*)_pi32_256_2);
+  imm2 = _mm256_cmpeq_epi32(imm2, _mm256_setzero_si256());
+  
+  v8sf sign_bit = _mm256_castsi256_ps(imm0);
+  v8sf poly_mask = _mm256_castsi256_ps(imm2);
+
+  /* The magic pass: "Extended precision modular arithmetic" 
+     x = ((x - y * DP1) - y * DP2) - y * DP3; */
+  xmm1 = *(v8sf*)_ps256_minus_cephes_DP1;
+  xmm2 = *(v8sf*)_ps256_minus_cephes_DP2;
+  xmm3 = *(v8sf*)_ps256_minus_cephes_DP3;
+  xmm1 = _mm256_mul_ps(y, xmm1);
+  xmm2 = _mm256_mul_ps(y, xmm2);
+  xmm3 = _mm256_mul_ps(y, xmm3);
+  x = _mm256_add_ps(x, xmm1);
+  x = _mm256_add_ps(x, xmm2);
+  x = _mm256_add_ps(x, xmm3);
+  
+  /* Evaluate the first polynom  (0 <= x <= Pi/4) */
+  y = *(v8sf*)_ps256_coscof_p0;
+  v8sf z = _mm256_mul_ps(x,x);
+
+  y = _mm256_mul_ps(y, z);
+  y = _mm256_add_ps(y, *(v8sf*)_ps256_coscof_p1);
+  y = _mm256_mul_ps(y, z);
+  y = _mm256_add_ps(y, *(v8sf*)_ps256_coscof_p2);
+  y = _mm256_mul_ps(y, z);
+  y = _mm256_mul_ps(y, z);
+  v8sf tmp = _mm256_mul_ps(z, *(v8sf*)_ps256_0p5);
+  y = _mm256_sub_ps(y, tmp);
+  y = _mm256_add_ps(y, *(v8sf*)_ps256_1);
+  
+  /* Evaluate the second polynom  (Pi/4 <= x <= 0) */
+
+  v8sf y2 = *(v8sf*)_ps256_sincof_p0;
+  y2 = _mm256_mul_ps(y2, z);
+  y2 = _mm256_add_ps(y2, *(v8sf*)_ps256_sincof_p1);
+  y2 = _mm256_mul_ps(y2, z);
+  y2 = _mm256_add_ps(y2, *(v8sf*)_ps256_sincof_p2);
+  y2 = _mm256_mul_ps(y2, z);
+  y2 = _mm256_mul_ps(y2, x);
+  y2 = _mm256_add_ps(y2, x);
+
+  /* select the correct result from the two polynoms */  
+  xmm3 = poly_mask;
+  y2 = _mm256_and_ps(xmm3, y2);
+  y = _mm256_andnot_ps(xmm3, y);
+  y = _mm256_add_ps(y,y2);
+  /* update the sign */
+  y = _mm256_xor_ps(y, sign_bit);
+
+  return y;
+}
+
+/* since sin256_ps and cos256_ps are almost identical, sincos256_ps could replace both of them..
+   it is almost as fast, and gives you a free cosine with your sine */
+TARGET_AVX2 void sincos256_ps(v8sf x, v8sf *s, v8sf *c) {
+  v8sf xmm1, xmm2, xmm3, sign_bit_sin, y;
+  v8si imm0, imm2, imm4;
+
+  sign_bit_sin = x;
+  /* take the absolute value */
+  x = _mm256_and_ps(x, *(v8sf*)_ps256_inv_sign_mask);
+  /* extract the sign bit (upper one) */
+  sign_bit_sin = _mm256_and_ps(sign_bit_sin, *(v8sf*)_ps256_sign_mask);
+  
+  /* scale by 4/Pi */
+  y = _mm256_mul_ps(x, *(v8sf*)_ps256_cephes_FOPI);
+
+  /* store the integer part of y in imm2 */
+  imm2 = _mm256_cvttps_epi32(y);
+
+  /* j=(j+1) & (~1) (see the cephes sources) */
+  imm2 = _mm256_add_epi32(imm2, *(v8si*)_pi32_256_1);
+  imm2 = _mm256_and_si256(imm2, *(v8si*)_pi32_256_inv1);
+  y = _mm256_cvtepi32_ps(imm2);
+
+  imm4 = imm2;
+
+  /* get the swap sign flag for the sine */
+  imm0 = _mm256_and_si256(imm2, *(v8si*)_pi32_256_4);
+  imm0 = _mm256_slli_epi32(imm0, 29);
+  v8sf swap_sign_bit_sin = _mm256_castsi256_ps(imm0);
+
+  /* get the polynom selection mask for the sine*/
+  imm2 = _mm256_and_si256(imm2, *(v8si*)_pi32_256_2);
+  imm2 = _mm256_cmpeq_epi32(imm2, _mm256_setzero_si256());
+  v8sf poly_mask = _mm256_castsi256_ps(imm2);
+
+  /* The magic pass: "Extended precision modular arithmetic" 
+     x = ((x - y * DP1) - y * DP2) - y * DP3; */
+  xmm1 = *(v8sf*)_ps256_minus_cephes_DP1;
+  xmm2 = *(v8sf*)_ps256_minus_cephes_DP2;
+  xmm3 = *(v8sf*)_ps256_minus_cephes_DP3;
+  xmm1 = _mm256_mul_ps(y, xmm1);
+  xmm2 = _mm256_mul_ps(y, xmm2);
+  xmm3 = _mm256_mul_ps(y, xmm3);
+  x = _mm256_add_ps(x, xmm1);
+  x = _mm256_add_ps(x, xmm2);
+  x = _mm256_add_ps(x, xmm3);
+
+  imm4 = _mm256_sub_epi32(imm4, *(v8si*)_pi32_256_2);
+  imm4 = _mm256_andnot_si256(imm4, *(v8si*)_pi32_256_4);
+  imm4 = _mm256_slli_epi32(imm4, 29);
+  v8sf sign_bit_cos = _mm256_castsi256_ps(imm4);
+
+  sign_bit_sin = _mm256_xor_ps(sign_bit_sin, swap_sign_bit_sin);
+  
+  /* Evaluate the first polynom  (0 <= x <= Pi/4) */
+  v8sf z = _mm256_mul_ps(x,x);
+  y = *(v8sf*)_ps256_coscof_p0;
+
+  y = _mm256_mul_ps(y, z);
+  y = _mm256_add_ps(y, *(v8sf*)_ps256_coscof_p1);
+  y = _mm256_mul_ps(y, z);
+  y = _mm256_add_ps(y, *(v8sf*)_ps256_coscof_p2);
+  y = _mm256_mul_ps(y, z);
+  y = _mm256_mul_ps(y, z);
+  v8sf tmp = _mm256_mul_ps(z, *(v8sf*)_ps256_0p5);
+  y = _mm256_sub_ps(y, tmp);
+  y = _mm256_add_ps(y, *(v8sf*)_ps256_1);
+  
+  /* Evaluate the second polynom  (Pi/4 <= x <= 0) */
+
+  v8sf y2 = *(v8sf*)_ps256_sincof_p0;
+  y2 = _mm256_mul_ps(y2, z);
+  y2 = _mm256_add_ps(y2, *(v8sf*)_ps256_sincof_p1);
+  y2 = _mm256_mul_ps(y2, z);
+  y2 = _mm256_add_ps(y2, *(v8sf*)_ps256_sincof_p2);
+  y2 = _mm256_mul_ps(y2, z);
+  y2 = _mm256_mul_ps(y2, x);
+  y2 = _mm256_add_ps(y2, x);
+
+  /* select the correct result from the two polynoms */  
+  xmm3 = poly_mask;
+  v8sf ysin2 = _mm256_and_ps(xmm3, y2);
+  v8sf ysin1 = _mm256_andnot_ps(xmm3, y);
+  y2 = _mm256_sub_ps(y2,ysin2);
+  y = _mm256_sub_ps(y, ysin1);
+
+  xmm1 = _mm256_add_ps(ysin1,ysin2);
+  xmm2 = _mm256_add_ps(y,y2);
+ 
+  /* update the sign */
+  *s = _mm256_xor_ps(xmm1, sign_bit_sin);
+  *c = _mm256_xor_ps(xmm2, sign_bit_cos);
+}
+
 // #pragma optimize("", on)
@@ -23,6 +23,14 @@ fn bool  vm_commit  (void *address, size_t size);
 fn void  vm_decommit(void *address, size_t size);
 fn void  vm_release (void *address);
 
+// Large pages (2MiB on x64). vm_reserve_large reserves memory aligned to vm_large_page_size that the OS backs with
+// large pages where it can, and returns NULL if large pages aren't available at all. On Linux they're transparent
+// huge pages, and the memory gets committed with vm_commit like any other reservation, in large page sized pieces
+// to actually get them. Windows can't commit large pages piecemeal, so there the whole range comes back committed
+// and *committed is set. Either way it's released with vm_release.
+fn size_t vm_large_page_size(void); // 0 if large pages aren't available
+fn void  *vm_reserve_large  (size_t size, bool *committed);
+
 fn void os_show_loud_error   (const char *fmt, ...);
 fn void os_show_loud_error_va(const char *fmt, va_list args);
 
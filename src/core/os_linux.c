@@ -0,0 +1,416 @@
+// ============================================================
+// Copyright 2024 by Daniël Cornelisse, All Rights Reserved.
+// ============================================================
+
+// Linux implementation of os.h and the error reporting functions. There's no windowing on Linux,
+// so everything that pops up a message box on Win32 goes to stderr instead.
+
+void loud_error(int line, string_t file, const char *fmt, ...)
+{
+    va_list args;
+    va_start(args, fmt);
+    loud_error_va(line, file, fmt, args);
+    va_end(args);
+}
+
+void loud_error_va(int line, string_t file, const char *fmt, va_list args)
+{
+    char buffer[4096];
+
+    string_t message = string_format_into_buffer_va(buffer, sizeof(buffer), fmt, args);
+    fprintf(stderr, "Error: %.*s\nLine: %d\nFile: %.*s\n", (int)message.count, message.data, line, (int)file.count, file.data);
+
+	DEBUG_BREAK();
+}
+
+void fatal_error(int line, string_t file, const char *fmt, ...)
+{
+    va_list args;
+    va_start(args, fmt);
+    fatal_error_va(line, file, fmt, args);
+    va_end(args);
+}
+
+void fatal_error_va(int line, string_t file, const char *fmt, va_list args)
+{
+    char buffer[4096];
+
+    string_t message = string_format_into_buffer_va(buffer, sizeof(buffer), fmt, args);
+    fprintf(stderr, "Fatal error: %.*s\nLine: %d\nFile: %.*s\n", (int)message.count, message.data, line, (int)file.count, file.data);
+	fflush(stderr);
+
+#if DREAM_DEVELOPER
+	DEBUG_BREAK();
+#endif
+	abort();
+}
+
+// munmap wants the base and size of the mapping, but vm_release only gets the address it handed out.
+// So every reservation gets an extra page in front of it that remembers both.
+#define LINUX_VM_HEADER_SIZE 4096
+
+typedef struct linux_vm_header_t
+{
+	char  *base;
+	size_t size;
+} linux_vm_header_t;
+
+fn_local void linux_vm_write_header(char *address, char *base, size_t size)
+{
+	char *header_page = address - LINUX_VM_HEADER_SIZE;
+	mprotect(header_page, LINUX_VM_HEADER_SIZE, PROT_READ|PROT_WRITE);
+
+	linux_vm_header_t *header = (linux_vm_header_t *)header_page;
+	header->base = base;
+	header->size = size;
+}
+
+void *vm_reserve(void *address, size_t size)
+{
+	if (address) address = (char *)address - LINUX_VM_HEADER_SIZE;
+
+	size_t total_size = size + LINUX_VM_HEADER_SIZE;
+
+    char *base = mmap(address, total_size, PROT_NONE, MAP_PRIVATE|MAP_ANONYMOUS|MAP_NORESERVE, -1, 0);
+
+	if (base == MAP_FAILED)
+		return NULL;
+
+	linux_vm_write_header(base + LINUX_VM_HEADER_SIZE, base, total_size);
+
+    return base + LINUX_VM_HEADER_SIZE;
+}
+
+global atomic size_t g_linux_large_page_size = SIZE_MAX; // SIZE_MAX means it hasn't been looked up yet
+
+size_t vm_large_page_size(void)
+{
+	size_t result = atomic_load_explicit(&g_linux_large_page_size, memory_order_relaxed);
+
+	if (result == SIZE_MAX)
+	{
+		result = 0;
+
+		char buffer[128] = {0};
+
+		// it reads something like "always [madvise] never", MADV_HUGEPAGE only does nothing if it's set to never
+		FILE *enabled = fopen("/sys/kernel/mm/transparent_hugepage/enabled", "r");
+
+		if (enabled)
+		{
+			if (fgets(buffer, sizeof(buffer), enabled) && !strstr(buffer, "[never]"))
+			{
+				result = MB(2);
+
+				FILE *pmd_size = fopen("/sys/kernel/mm/transparent_hugepage/hpage_pmd_size", "r");
+
+				if (pmd_size)
+				{
+					unsigned long long size;
+					if (fscanf(pmd_size, "%llu", &size) == 1 && size && IS_POW2(size))
+					{
+						result = (size_t)size;
+					}
+
+					fclose(pmd_size);
+				}
+			}
+
+			fclose(enabled);
+		}
+
+		atomic_store_explicit(&g_linux_large_page_size, result, memory_order_relaxed);
+	}
+
+	return result;
+}
+
+// Transparent huge pages are only a hint: the range is aligned to the huge page size and marked with
+// MADV_HUGEPAGE, and the kernel backs each huge page sized piece with a huge page once it's all committed,
+// if it has one to spare at that point.
+void *vm_reserve_large(size_t size, bool *committed)
+{
+	*committed = false;
+
+	size_t page_size = vm_large_page_size();
+
+	if (!page_size)
+		return NULL;
+
+	size = align_forward(size, page_size);
+
+	size_t total_size = size + page_size + LINUX_VM_HEADER_SIZE;
+
+    char *base = mmap(NULL, total_size, PROT_NONE, MAP_PRIVATE|MAP_ANONYMOUS|MAP_NORESERVE, -1, 0);
+
+	if (base == MAP_FAILED)
+		return NULL;
+
+	char *result = align_address(base + LINUX_VM_HEADER_SIZE, page_size);
+
+	if (madvise(result, size, MADV_HUGEPAGE) != 0)
+	{
+		munmap(base, total_size);
+		return NULL;
+	}
+
+	linux_vm_write_header(result, base, total_size);
+
+	return result;
+}
+
+bool vm_commit(void *address, size_t size)
+{
+    bool result = (mprotect(address, size, PROT_READ|PROT_WRITE) == 0);
+
+    if (!result)
+        debug_print("vm_commit failed: %s\n", strerror(errno));
+
+    return result;
+}
+
+void vm_decommit(void *address, size_t size)
+{
+	// give the pages back, but keep the address range reserved
+    madvise(address, size, MADV_DONTNEED);
+    mprotect(address, size, PROT_NONE);
+}
+
+void vm_release(void *address)
+{
+	linux_vm_header_t *header = (linux_vm_header_t *)((char *)address - LINUX_VM_HEADER_SIZE);
+	munmap(header->base, header->size);
+}
+
+void debug_print_va(const char *fmt, va_list args)
+{
+	char buffer[4096];
+
+	string_t string = string_format_into_buffer_va(buffer, sizeof(buffer), fmt, args);
+	fwrite(string.data, 1, string.count, stderr);
+}
+
+void debug_print(const char *fmt, ...)
+{
+    va_list args;
+    va_start(args, fmt);
+
+    debug_print_va(fmt, args);
+
+    va_end(args);
+}
+
+string_t os_get_working_directory(arena_t *arena)
+{
+    string_t result = {0};
+
+	char buffer[4096];
+
+	if (ALWAYS(getcwd(buffer, sizeof(buffer))))
+	{
+		result = string_copy_cstr(arena, buffer);
+	}
+
+    return result;
+}
+
+bool os_set_working_directory(string_t directory)
+{
+	bool result = false;
+
+	m_scoped_temp
+	{
+		result = (chdir(string_null_terminate(temp, directory).data) == 0);
+		if (!result) debug_print("os_set_working_directory failed: %s\n", strerror(errno));
+	}
+
+    return result;
+}
+
+// runs the command through the shell, with stdout and stderr either passed through or captured
+fn_local bool linux_execute(string_t command, int *exit_code, arena_t *arena, string_t *out, string_t *err)
+{
+	bool capture = !!arena;
+
+	arena_t *temp = m_get_temp(&arena, 1);
+	m_scope_begin(temp);
+
+	int stdout_pipe[2] = { -1, -1 };
+	int stderr_pipe[2] = { -1, -1 };
+
+	posix_spawn_file_actions_t actions;
+	posix_spawn_file_actions_init(&actions);
+
+	bool result = true;
+
+	if (capture)
+	{
+		result = (pipe(stdout_pipe) == 0 && pipe(stderr_pipe) == 0);
+
+		if (result)
+		{
+			posix_spawn_file_actions_adddup2 (&actions, stdout_pipe[1], STDOUT_FILENO);
+			posix_spawn_file_actions_adddup2 (&actions, stderr_pipe[1], STDERR_FILENO);
+			posix_spawn_file_actions_addclose(&actions, stdout_pipe[0]);
+			posix_spawn_file_actions_addclose(&actions, stderr_pipe[0]);
+		}
+	}
+
+	pid_t pid = 0;
+
+	if (result)
+	{
+		char *argv[] = { "/bin/sh", "-c", string_null_terminate(temp, command).data, NULL };
+		result = (posix_spawn(&pid, "/bin/sh", &actions, NULL, argv, environ) == 0);
+
+		if (!result)
+		{
+			debug_print("os_execute failed: %s\n", strerror(errno));
+		}
+	}
+
+	posix_spawn_file_actions_destroy(&actions);
+
+	if (capture)
+	{
+		if (stdout_pipe[1] != -1) close(stdout_pipe[1]);
+		if (stderr_pipe[1] != -1) close(stderr_pipe[1]);
+
+		if (result)
+		{
+			string_list_t out_list = { 0 };
+			string_list_t err_list = { 0 };
+
+			enum { BUFFER_SIZE = 4096 };
+			char buffer[BUFFER_SIZE];
+
+			// read both pipes as data comes in, reading them one after the other deadlocks if the child fills up
+			// the pipe that isn't being read from. A pipe is done when it hits end of file (or fails).
+			struct pollfd fds[2] = {
+				{ .fd = stdout_pipe[0], .events = POLLIN },
+				{ .fd = stderr_pipe[0], .events = POLLIN },
+			};
+
+			string_list_t *lists[2] = { &out_list, &err_list };
+
+			while (fds[0].fd >= 0 || fds[1].fd >= 0)
+			{
+				if (poll(fds, 2, -1) < 0)
+				{
+					if (errno == EINTR) continue;
+
+					debug_print("os_execute_capture failed to poll: %s\n", strerror(errno));
+					break;
+				}
+
+				for (size_t i = 0; i < 2; i++)
+				{
+					if (fds[i].fd < 0 || !fds[i].revents)
+					{
+						continue;
+					}
+
+					ssize_t bytes_read = read(fds[i].fd, buffer, BUFFER_SIZE);
+
+					if (bytes_read > 0)
+					{
+						slist_appends(lists[i], temp, (string_t){buffer, (size_t)bytes_read});
+					}
+					else if (bytes_read == 0 || errno != EINTR)
+					{
+						// negative fds are skipped by poll, the pipe still gets closed below
+						fds[i].fd = -1;
+					}
+				}
+			}
+
+			*out = slist_flatten(&out_list, arena);
+			*err = slist_flatten(&err_list, arena);
+		}
+
+		if (stdout_pipe[0] != -1) close(stdout_pipe[0]);
+		if (stderr_pipe[0] != -1) close(stderr_pipe[0]);
+	}
+
+	if (result)
+	{
+		int status = 0;
+		waitpid(pid, &status, 0);
+
+		if (exit_code)
+		{
+			*exit_code = WIFEXITED(status) ? WEXITSTATUS(status) : -1;
+		}
+	}
+
+	m_scope_end(temp);
+
+	return result;
+}
+
+bool os_execute(string_t command, int *exit_code)
+{
+	return linux_execute(command, exit_code, NULL, NULL, NULL);
+}
+
+bool os_execute_capture(string_t command, int *exit_code, arena_t *arena, string_t *out, string_t *err)
+{
+	return linux_execute(command, exit_code, arena, out, err);
+}
+
+// hires_time_t is in nanoseconds on Linux
+hires_time_t os_hires_time(void)
+{
+	struct timespec time;
+	clock_gettime(CLOCK_MONOTONIC, &time);
+
+    return (hires_time_t) { (uint64_t)time.tv_sec*1000000000ull + (uint64_t)time.tv_nsec };
+}
+
+double os_seconds_elapsed(hires_time_t start, hires_time_t end)
+{
+    double result = (double)(end.value - start.value) / 1000000000.0;
+    return result;
+}
+
+uint64_t os_estimate_cpu_timer_frequency(uint64_t wait_ms)
+{
+	uint64_t os_freq      = 1000000000ull;
+	uint64_t os_wait_time = (os_freq * wait_ms) / 1000;
+	uint64_t cpu_start    = read_cpu_timer();
+	uint64_t os_start     = os_hires_time().value;
+	uint64_t os_end       = 0;
+	uint64_t os_elapsed   = 0;
+	while (os_elapsed < os_wait_time)
+	{
+		os_end     = os_hires_time().value;
+		os_elapsed = os_end - os_start;
+	}
+	uint64_t cpu_end     = read_cpu_timer();
+	uint64_t cpu_elapsed = cpu_end - cpu_start;
+	uint64_t cpu_freq    = 0;
+	if (os_elapsed)
+	{
+		cpu_freq = (os_freq * cpu_elapsed) / os_elapsed;
+	}
+	return cpu_freq;
+}
+
+void os_sleep(float milliseconds)
+{
+	if (milliseconds < 0.0f) return;
+
+	if (milliseconds == 0.0f)
+	{
+		// matches Sleep(0), which gives up the rest of the time slice
+		sched_yield();
+		return;
+	}
+
+	struct timespec time = {
+		.tv_sec  = (time_t)(milliseconds / 1000.0f),
+		.tv_nsec = (long)(fmodf(milliseconds, 1000.0f)*1000000.0f),
+	};
+
+	while (nanosleep(&time, &time) == -1 && errno == EINTR);
+}
@@ -207,6 +207,65 @@ void vm_release(void *address)
     VirtualFree(address, 0, MEM_RELEASE);
 }
 
+// Large pages need the "Lock pages in memory" privilege, which the user has to be granted by policy and which
+// then has to be enabled on the process token. If either isn't the case, there are no large pages for us.
+global atomic int g_win32_large_pages; // 0 = not checked yet, 1 = available, 2 = unavailable
+
+fn_local bool win32_enable_lock_memory_privilege(void)
+{
+	bool result = false;
+
+	HANDLE token;
+	if (OpenProcessToken(GetCurrentProcess(), TOKEN_ADJUST_PRIVILEGES|TOKEN_QUERY, &token))
+	{
+		TOKEN_PRIVILEGES privileges = {
+			.PrivilegeCount = 1,
+			.Privileges[0].Attributes = SE_PRIVILEGE_ENABLED,
+		};
+
+		if (LookupPrivilegeValueW(NULL, SE_LOCK_MEMORY_NAME, &privileges.Privileges[0].Luid))
+		{
+			// succeeds without enabling anything if we don't hold the privilege, so GetLastError has the real answer
+			AdjustTokenPrivileges(token, FALSE, &privileges, 0, NULL, NULL);
+			result = (GetLastError() == ERROR_SUCCESS);
+		}
+
+		CloseHandle(token);
+	}
+
+	return result;
+}
+
+size_t vm_large_page_size(void)
+{
+	int state = atomic_load_explicit(&g_win32_large_pages, memory_order_relaxed);
+
+	if (state == 0)
+	{
+		state = (GetLargePageMinimum() > 0 && win32_enable_lock_memory_privilege()) ? 1 : 2;
+		atomic_store_explicit(&g_win32_large_pages, state, memory_order_relaxed);
+	}
+
+	return state == 1 ? GetLargePageMinimum() : 0;
+}
+
+void *vm_reserve_large(size_t size, bool *committed)
+{
+	void *result = NULL;
+
+	size_t page_size = vm_large_page_size();
+
+	if (page_size)
+	{
+		size   = align_forward(size, page_size);
+		result = VirtualAlloc(NULL, size, MEM_RESERVE|MEM_COMMIT|MEM_LARGE_PAGES, PAGE_READWRITE);
+	}
+
+	*committed = !!result;
+
+	return result;
+}
+
 void debug_print_va(const char *fmt, va_list args)
 {
 	m_scoped_temp
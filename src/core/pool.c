@@ -31,13 +31,438 @@ fn_local void *pool_item_at_index(pool_t *pool, size_t index)
     return (void *)(pool->buffer + index*pool_stride(pool));
 }
 
+//
+// lock-free pools
+//
+
+// The shared free list is a Treiber stack of item indices, threaded through free_item_t.next. The head
+// carries a tag that's bumped on every change, so a pop that raced with a pop+push of the same item
+// (ABA) fails its CAS instead of corrupting the list.
+#define POOL_TAGGED_INDEX(tagged) ((uint32_t)(tagged))
+#define POOL_TAGGED_TAG(tagged)   ((uint32_t)((tagged) >> 32))
+#define POOL_TAGGED(tag, index)   (((uint64_t)(tag) << 32) | (uint64_t)(index))
+
+typedef struct pool_magazine_t
+{
+	alignas(CACHE_LINE_SIZE) uint32_t count;
+	uint32_t indices[POOL_MAGAZINE_CAPACITY];
+} pool_magazine_t;
+
+struct pool_lock_free_t
+{
+	alignas(CACHE_LINE_SIZE) atomic uint64_t free_head;
+	alignas(CACHE_LINE_SIZE) atomic size_t   claimed;   // end of the items pool_bump_lock_free has handed out, never runs ahead of committed
+	                         atomic size_t   watermark; // end of the items pool_get and pool_iter look at, trails claimed until claimed items are set up
+	                         atomic size_t   committed;
+
+	pool_t           *pool;
+	pool_lock_free_t *next; // in g_pool_threads.first_lock_free
+
+	pool_magazine_t magazines[POOL_MAX_MAGAZINES];
+};
+
+// Magazine slots are handed out to threads as they first touch a lock-free pool, and given back by
+// pool_release_thread, which also empties the thread's magazines so their items don't go missing.
+global struct
+{
+	mutex_t           mutex;
+	uint32_t          next_thread_index;
+	uint32_t          free_thread_index_count;
+	uint32_t          free_thread_indices[POOL_MAX_MAGAZINES];
+	pool_lock_free_t *first_lock_free; // every initialized lock-free pool
+} g_pool_threads;
+
+global thread_local uint32_t tls_pool_thread_index; // index + 1, 0 means not assigned yet
+
+fn_local uint32_t pool_thread_index(void)
+{
+	if (!tls_pool_thread_index)
+	{
+		uint32_t index = POOL_MAX_MAGAZINES;
+
+		mutex_scoped_lock(&g_pool_threads.mutex)
+		{
+			if (g_pool_threads.free_thread_index_count > 0)
+			{
+				index = g_pool_threads.free_thread_indices[--g_pool_threads.free_thread_index_count];
+			}
+			else if (g_pool_threads.next_thread_index < POOL_MAX_MAGAZINES)
+			{
+				index = g_pool_threads.next_thread_index++;
+			}
+		}
+
+		tls_pool_thread_index = index + 1;
+	}
+
+	return tls_pool_thread_index - 1;
+}
+
+fn_local pool_magazine_t *pool_get_magazine(pool_t *pool)
+{
+	uint32_t index = pool_thread_index();
+	return index < POOL_MAX_MAGAZINES ? &pool->lock_free->magazines[index] : NULL;
+}
+
+// The generation and next fields are plain integers so the mutex path doesn't pay for atomics, the lock-free
+// path accesses them through these.
+fn_local atomic uint32_t *pool_atomic_generation(void *pool_item)
+{
+	return (atomic uint32_t *)&((pool_item_t *)pool_item)->generation;
+}
+
+fn_local atomic uint32_t *pool_atomic_next(void *free_item)
+{
+	return (atomic uint32_t *)&((free_item_t *)free_item)->next;
+}
+
+fn_local void pool_init_lock_free(pool_t *pool)
+{
+	uint32_t state = atomic_load(&pool->init_state);
+
+	if (state != 2)
+	{
+		uint32_t expected = 0;
+		if (atomic_compare_exchange_strong(&pool->init_state, &expected, 1))
+		{
+			ASSERT_MSG(pool->item_size, "POOL INITIALIZATION FAILURE: ITEM SIZE IS ZERO"); // this needs to be initialized by the user
+
+			pool_lock_free_t *lock_free = vm_reserve(NULL, sizeof(pool_lock_free_t));
+			vm_commit(lock_free, sizeof(pool_lock_free_t));
+
+			pool->buffer = vm_reserve(NULL, POOL_RESERVE_SIZE);
+			vm_commit(pool->buffer, POOL_COMMIT_SIZE);
+
+			// index 0 is the null index, so the first entry is skipped like the sentinel of the mutex path
+			atomic_store(&lock_free->claimed,   pool_stride(pool));
+			atomic_store(&lock_free->watermark, pool_stride(pool));
+			atomic_store(&lock_free->committed, POOL_COMMIT_SIZE);
+
+			pool->lock_free = lock_free;
+			pool->watermark = pool_stride(pool);
+
+			lock_free->pool = pool;
+
+			mutex_scoped_lock(&g_pool_threads.mutex)
+			{
+				sll_push(g_pool_threads.first_lock_free, lock_free);
+			}
+
+			atomic_store(&pool->init_state, 2);
+		}
+		else
+		{
+			while (atomic_load(&pool->init_state) != 2)
+			{
+				_mm_pause();
+			}
+		}
+	}
+}
+
+fn_local size_t pool_get_watermark(pool_t *pool)
+{
+	if (pool->flags & POOL_FLAGS_LOCK_FREE)
+	{
+		if (atomic_load_explicit(&pool->init_state, memory_order_acquire) != 2)
+			return 0;
+
+		return atomic_load_explicit(&pool->lock_free->watermark, memory_order_acquire);
+	}
+
+	return pool->watermark;
+}
+
+// claims count fresh items from the end of the pool and returns the index of the first one
+fn_local uint32_t pool_bump_lock_free(pool_t *pool, uint32_t count)
+{
+	pool_lock_free_t *lock_free = pool->lock_free;
+
+	size_t stride = pool_stride(pool);
+	size_t size   = count*stride;
+
+	size_t claimed = atomic_load_explicit(&lock_free->claimed, memory_order_relaxed);
+	size_t new_claimed;
+
+	for (;;)
+	{
+		new_claimed = claimed + size;
+
+		if (NEVER(new_claimed > POOL_RESERVE_SIZE))  FATAL_ERROR("Pool ran out of address space!");
+
+		// commit before claiming, so the items are there to be set up below.
+		// committing memory that's already committed is harmless, so racing threads don't need to coordinate
+		size_t committed = atomic_load_explicit(&lock_free->committed, memory_order_acquire);
+		if (new_claimed > committed)
+		{
+			size_t commit_end = align_forward(new_claimed, POOL_COMMIT_SIZE);
+
+			if (!vm_commit(pool->buffer + committed, commit_end - committed))
+			{
+				FATAL_ERROR("Pool failed to commit memory!");
+			}
+
+			while (committed < commit_end &&
+				   !atomic_compare_exchange_weak(&lock_free->committed, &committed, commit_end))
+			{
+			}
+		}
+
+		if (atomic_compare_exchange_weak_explicit(&lock_free->claimed, &claimed, new_claimed,
+												  memory_order_relaxed, memory_order_relaxed))
+		{
+			break;
+		}
+	}
+
+	uint32_t first = (uint32_t)(claimed / stride);
+
+	// fresh items sit in a magazine before they're handed out, so they must not look alive to pool_iter or
+	// pool_get: their generations are set before the watermark moves past them
+	for (uint32_t i = 0; i < count; i++)
+	{
+		atomic_store_explicit(pool_atomic_generation(pool_item_at_index(pool, first + i)), POOL_FREE_BIT, memory_order_relaxed);
+	}
+
+	// the watermark moves past claims in the order they were made, so wait for the claims before this one.
+	// that's only ever a few stores away, unless the thread ahead got preempted, so give up the time slice if
+	// spinning doesn't cut it
+	size_t   expected = claimed;
+	uint32_t spins    = 0;
+
+	while (!atomic_compare_exchange_weak_explicit(&lock_free->watermark, &expected, new_claimed,
+												  memory_order_release, memory_order_relaxed))
+	{
+		expected = claimed;
+
+		if (spins++ < 64)
+		{
+			_mm_pause();
+		}
+		else
+		{
+			os_sleep(0.0f);
+		}
+	}
+
+	return first;
+}
+
+// pushes the chain first..last, already linked through their next fields, onto the shared free list
+fn_local void pool_push_free_chain(pool_t *pool, uint32_t first, uint32_t last)
+{
+	pool_lock_free_t *lock_free = pool->lock_free;
+
+	free_item_t *last_item = pool_item_at_index(pool, last);
+
+	uint64_t head = atomic_load_explicit(&lock_free->free_head, memory_order_relaxed);
+
+	for (;;)
+	{
+		atomic_store_explicit(pool_atomic_next(last_item), POOL_TAGGED_INDEX(head), memory_order_relaxed);
+
+		uint64_t new_head = POOL_TAGGED(POOL_TAGGED_TAG(head) + 1, first);
+
+		if (atomic_compare_exchange_weak_explicit(&lock_free->free_head, &head, new_head,
+												  memory_order_release, memory_order_relaxed))
+		{
+			break;
+		}
+	}
+}
+
+fn_local uint32_t pool_pop_free(pool_t *pool)
+{
+	pool_lock_free_t *lock_free = pool->lock_free;
+
+	uint64_t head = atomic_load_explicit(&lock_free->free_head, memory_order_acquire);
+
+	for (;;)
+	{
+		uint32_t index = POOL_TAGGED_INDEX(head);
+
+		if (index == 0)
+		{
+			return 0;
+		}
+
+		// the item may get popped and reused by someone else before we read next, in which case the value is
+		// garbage, but the tag will have moved on and the CAS below fails. pool memory is never decommitted,
+		// so the read itself is always safe
+		uint32_t next = atomic_load_explicit(pool_atomic_next(pool_item_at_index(pool, index)), memory_order_relaxed);
+
+		uint64_t new_head = POOL_TAGGED(POOL_TAGGED_TAG(head) + 1, next);
+
+		if (atomic_compare_exchange_weak_explicit(&lock_free->free_head, &head, new_head,
+												  memory_order_acquire, memory_order_acquire))
+		{
+			return index;
+		}
+	}
+}
+
+// pops half a magazine's worth off the shared free list one item at a time, so other threads still see whatever
+// is left on it while this is going on. bumps fresh items if the list was empty
+fn_local void pool_refill_magazine(pool_t *pool, pool_magazine_t *magazine)
+{
+	uint32_t want = POOL_MAGAZINE_CAPACITY / 2;
+
+	while (magazine->count < want)
+	{
+		uint32_t index = pool_pop_free(pool);
+
+		if (index == 0)
+			break;
+
+		magazine->indices[magazine->count++] = index;
+	}
+
+	if (magazine->count == 0)
+	{
+		uint32_t count = want;
+		uint32_t first = pool_bump_lock_free(pool, count);
+
+		// hand them out lowest index first
+		for (uint32_t i = 0; i < count; i++)
+		{
+			magazine->indices[magazine->count++] = first + count - i - 1;
+		}
+	}
+}
+
+// moves the oldest flush_count items of a magazine to the shared free list as one chain
+fn_local void pool_flush_magazine_items(pool_t *pool, pool_magazine_t *magazine, uint32_t flush_count)
+{
+	if (flush_count == 0)
+		return;
+
+	for (uint32_t i = 0; i < flush_count - 1; i++)
+	{
+		atomic_store_explicit(pool_atomic_next(pool_item_at_index(pool, magazine->indices[i])), magazine->indices[i + 1], memory_order_relaxed);
+	}
+
+	pool_push_free_chain(pool, magazine->indices[0], magazine->indices[flush_count - 1]);
+
+	magazine->count -= flush_count;
+	copy_memory(&magazine->indices[0], &magazine->indices[flush_count], magazine->count*sizeof(uint32_t));
+}
+
+// moves the older half of a full magazine to the shared free list
+fn_local void pool_flush_magazine(pool_t *pool, pool_magazine_t *magazine)
+{
+	pool_flush_magazine_items(pool, magazine, POOL_MAGAZINE_CAPACITY / 2);
+}
+
+void pool_release_thread(void)
+{
+	if (!tls_pool_thread_index)
+		return;
+
+	uint32_t index = tls_pool_thread_index - 1;
+
+	if (index < POOL_MAX_MAGAZINES)
+	{
+		mutex_scoped_lock(&g_pool_threads.mutex)
+		{
+			for (pool_lock_free_t *lock_free = g_pool_threads.first_lock_free; lock_free; lock_free = lock_free->next)
+			{
+				pool_magazine_t *magazine = &lock_free->magazines[index];
+				pool_flush_magazine_items(lock_free->pool, magazine, magazine->count);
+			}
+
+			g_pool_threads.free_thread_indices[g_pool_threads.free_thread_index_count++] = index;
+		}
+	}
+
+	tls_pool_thread_index = 0;
+}
+
+fn_local void *pool_add_lock_free(pool_t *pool)
+{
+	pool_init_lock_free(pool);
+
+	uint32_t index = 0;
+
+	pool_magazine_t *magazine = pool_get_magazine(pool);
+
+	if (magazine)
+	{
+		if (magazine->count == 0)
+		{
+			pool_refill_magazine(pool, magazine);
+		}
+
+		index = magazine->indices[--magazine->count];
+	}
+	else
+	{
+		index = pool_pop_free(pool);
+
+		if (index == 0)
+		{
+			index = pool_bump_lock_free(pool, 1);
+		}
+	}
+
+	pool_item_t *pool_item = pool_item_at_index(pool, index);
+
+	void *result = item_from_pool_item(pool_item);
+	zero_memory(result, pool->item_size);
+
+	// clearing the free bit publishes the item, after it's been zeroed
+	uint32_t generation = atomic_load_explicit(pool_atomic_generation(pool_item), memory_order_relaxed);
+	atomic_store_explicit(pool_atomic_generation(pool_item), generation & ~POOL_FREE_BIT, memory_order_release);
+
+	return result;
+}
+
+fn_local bool pool_rem_lock_free(pool_t *pool, resource_handle_t handle)
+{
+	bool result = false;
+
+	size_t count = pool_get_watermark(pool) / pool_stride(pool);
+
+	if (handle.index > 0 && ALWAYS(handle.index < count) && !(handle.generation & POOL_FREE_BIT))
+	{
+		pool_item_t *pool_item = pool_item_at_index(pool, handle.index);
+
+		// only one of several threads removing the same handle gets to free it
+		uint32_t expected = handle.generation;
+		uint32_t freed    = (handle.generation + 1) | POOL_FREE_BIT;
+
+		if (atomic_compare_exchange_strong(pool_atomic_generation(pool_item), &expected, freed))
+		{
+			pool_magazine_t *magazine = pool_get_magazine(pool);
+
+			if (magazine)
+			{
+				if (magazine->count == POOL_MAGAZINE_CAPACITY)
+				{
+					pool_flush_magazine(pool, magazine);
+				}
+
+				magazine->indices[magazine->count++] = handle.index;
+			}
+			else
+			{
+				pool_push_free_chain(pool, handle.index, handle.index);
+			}
+
+			result = true;
+		}
+	}
+
+	return result;
+}
+
 fn_local void pool_init(pool_t *pool)
 {
     ASSERT_MSG(pool->item_size, "POOL INITIALIZATION FAILURE: ITEM SIZE IS ZERO"); // this needs to be initialized by the user
 
 	if (pool->flags & POOL_FLAGS_CONCURRENT) mutex_lock(&pool->lock);
 
-    if (ALWAYS(!pool->buffer))
+    // concurrent pools can get here from several threads at once, only the first one initializes
+    if (!pool->buffer)
     {
         pool->buffer = vm_reserve(NULL, POOL_RESERVE_SIZE);
         vm_commit(pool->buffer, POOL_COMMIT_SIZE);
@@ -50,6 +475,8 @@ fn_local void pool_init(pool_t *pool)
 
 void *pool_add(pool_t *pool)
 {
+	if (pool->flags & POOL_FLAGS_LOCK_FREE)  return pool_add_lock_free(pool);
+
     if (!pool->buffer)  pool_init(pool);
 
     void *result = NULL;
@@ -111,12 +538,16 @@ void *pool_get_impl(pool_t *pool, resource_handle_t handle)
     void *result = NULL;
 
     size_t stride = pool_stride(pool);
-    size_t count  = pool->watermark / stride;
+    size_t count  = pool_get_watermark(pool) / stride;
 
     if (handle.index > 0 && ALWAYS(handle.index < count))
     {
         pool_item_t *pool_item = pool_item_at_index(pool, handle.index);
-        if (pool_item->generation == handle.generation)
+
+        uint32_t generation = (pool->flags & POOL_FLAGS_LOCK_FREE) ?
+            atomic_load_explicit(pool_atomic_generation(pool_item), memory_order_acquire) : pool_item->generation;
+
+        if (generation == handle.generation)
         {
             result = item_from_pool_item(pool_item);
         }
@@ -129,6 +560,8 @@ bool pool_rem(pool_t *pool, resource_handle_t handle)
 {
     if (NEVER(!pool->buffer))  FATAL_ERROR("Pool not initialized!");
 
+	if (pool->flags & POOL_FLAGS_LOCK_FREE)  return pool_rem_lock_free(pool, handle);
+
     bool result = false;
 
 	if (pool->flags & POOL_FLAGS_CONCURRENT) mutex_lock(&pool->lock);
@@ -175,7 +608,7 @@ resource_handle_t pool_get_handle(pool_t *pool, void *item)
 
     uint32_t index = index_from_pool_item(pool, pool_item);
 
-    size_t count = pool->watermark / pool_stride(pool);
+    size_t count = pool_get_watermark(pool) / pool_stride(pool);
     if (NEVER(index <  0))      return NULL_RESOURCE_HANDLE;
     if (NEVER(index >= count))  return NULL_RESOURCE_HANDLE;
 
@@ -187,6 +620,34 @@ resource_handle_t pool_get_handle(pool_t *pool, void *item)
     return handle;
 }
 
+void pool_release(pool_t *pool)
+{
+	if (pool->lock_free)
+	{
+		mutex_scoped_lock(&g_pool_threads.mutex)
+		{
+			for (pool_lock_free_t **at = &g_pool_threads.first_lock_free; *at; at = &(*at)->next)
+			{
+				if (*at == pool->lock_free)
+				{
+					*at = pool->lock_free->next;
+					break;
+				}
+			}
+		}
+	}
+
+	if (pool->buffer)     vm_release(pool->buffer);
+	if (pool->lock_free)  vm_release(pool->lock_free);
+
+	pool->buffer    = NULL;
+	pool->lock_free = NULL;
+	pool->watermark = 0;
+	pool->count     = 0;
+
+	atomic_store(&pool->init_state, 0);
+}
+
 //
 // pool_iter_t
 //
@@ -217,13 +678,16 @@ void pool_iter_next(pool_iter_t *it)
 
         pool_item_t *pool_item = pool_item_from_item(it->data);
 
-        if ((char *)pool_item >= it->pool->buffer + it->pool->watermark)
+        if ((char *)pool_item >= it->pool->buffer + pool_get_watermark(it->pool))
         {
             it->data = NULL;
             break;
         }
 
-        if (!(pool_item->generation & POOL_FREE_BIT))
+        uint32_t generation = (it->pool->flags & POOL_FLAGS_LOCK_FREE) ?
+            atomic_load_explicit(pool_atomic_generation(pool_item), memory_order_acquire) : pool_item->generation;
+
+        if (!(generation & POOL_FREE_BIT))
             break;
     }
 }
@@ -23,18 +23,29 @@ typedef struct free_item_t
 
 typedef enum pool_flags_t
 {
-	POOL_FLAGS_CONCURRENT = 0x1,
+	POOL_FLAGS_CONCURRENT = 0x1, // pool_add / pool_rem serialize on the pool's mutex
+	POOL_FLAGS_LOCK_FREE  = 0x2, // pool_add / pool_rem go through per-thread magazines and a lock-free free list instead
 } pool_flags_t;
 
+// Lock-free pools hand out free slots from a small per-thread cache (a "magazine"), and only touch the
+// shared free list when it runs dry or overflows, a batch of slots at a time.
+#define POOL_MAGAZINE_CAPACITY 32
+#define POOL_MAX_MAGAZINES     64 // threads past this many alive at once go straight to the shared free list
+
+typedef struct pool_lock_free_t pool_lock_free_t;
+
 typedef struct pool_t
 {
     size_t   watermark;
-	size_t   count;
+	size_t   count; // not maintained for lock-free pools, it would put a shared counter back on every call
     uint32_t item_size;
     uint16_t align;
 	uint16_t flags;
     char    *buffer;
 	mutex_t  lock;
+
+	atomic uint32_t   init_state; // lock-free pools only: 0 = not initialized, 1 = initializing, 2 = done
+	pool_lock_free_t *lock_free;
 } pool_t;
 
 fn void             *pool_add       (pool_t *pool);
@@ -44,6 +55,11 @@ fn void             *pool_get_impl  (pool_t *pool, resource_handle_t handle);
 fn bool              pool_rem       (pool_t *pool, resource_handle_t handle);
 fn bool              pool_rem_item  (pool_t *pool, void *item);
 fn resource_handle_t pool_get_handle(pool_t *pool, void *item);
+fn void              pool_release   (pool_t *pool); // frees all memory, the pool can be used again afterwards
+
+// Hands the free slots cached by the calling thread back to every lock-free pool, and gives its magazine slot to
+// the next thread that comes along. Called by threads on their way out, after which they shouldn't touch pools.
+fn void              pool_release_thread(void);
 
 #define INIT_POOL(Type)           { .item_size = sizeof(Type), .align = alignof(Type) }
 #define INIT_POOL_EX(Type, Flags) { .item_size = sizeof(Type), .align = alignof(Type), .flags = Flags }
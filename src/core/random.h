@@ -20,8 +20,8 @@ fn_local float random_unilateral (random_series_t *r)
     // NOTE: Stolen from rnd.h, courtesy of Jonatan Hedborg
     uint32_t exponent = 127;
     uint32_t mantissa = random_uint32(r) >> 9;
-    uint32_t bits = (exponent << 23) | mantissa;
-    float result = *(float *)&bits - 1.0f;
+    union { uint32_t bits; float f; } pun = { .bits = (exponent << 23) | mantissa };
+    float result = pun.f - 1.0f;
     return result;
 }
 
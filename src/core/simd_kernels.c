@@ -0,0 +1,829 @@
+// ============================================================
+// Copyright 2024 by Daniël Cornelisse, All Rights Reserved.
+// ============================================================
+
+// MSVC lets any function use any intrinsic. GCC and clang only allow instructions the file wasn't compiled
+// for inside functions that ask for them with a target attribute. GCC also fuses multiplies and adds into FMAs
+// whenever the target has them unless told otherwise, which would make the tiers disagree in the last bit.
+
+#if _MSC_VER
+#define SIMD_KERNEL_SSE2
+#define SIMD_KERNEL_AVX2
+#define SIMD_KERNEL_AVX512
+#elif __clang__
+#define SIMD_KERNEL_SSE2
+#define SIMD_KERNEL_AVX2   __attribute__((target("avx2")))
+#define SIMD_KERNEL_AVX512 __attribute__((target("avx512f")))
+#else
+#define SIMD_KERNEL_SSE2   __attribute__((optimize("fp-contract=off")))
+#define SIMD_KERNEL_AVX2   __attribute__((target("avx2"),    optimize("fp-contract=off")))
+#define SIMD_KERNEL_AVX512 __attribute__((target("avx512f"), optimize("fp-contract=off")))
+#endif
+
+//
+// scalar tails
+//
+
+SIMD_KERNEL_SSE2
+fn_local void mix_s16_scalar(float *dst, const int16_t *src, const float *volumes, float gain, size_t count)
+{
+	for (size_t i = 0; i < count; i++)
+	{
+		float sample = (float)src[i] / (float)INT16_MAX;
+		sample *= volumes[i];
+		dst[i] += gain*sample;
+	}
+}
+
+SIMD_KERNEL_SSE2
+fn_local void clamp_interleave_stereo_scalar(float *dst, const float *l, const float *r, size_t count)
+{
+	for (size_t i = 0; i < count; i++)
+	{
+		dst[2*i + 0] = flt_max(-1.0f, flt_min(1.0f, l[i]));
+		dst[2*i + 1] = flt_max(-1.0f, flt_min(1.0f, r[i]));
+	}
+}
+
+//
+// sse2
+//
+
+SIMD_KERNEL_SSE2
+fn_local void mix_s16_sse2(float *dst, const int16_t *src, const float *volumes, float gain, size_t count)
+{
+	__m128 scale  = _mm_set1_ps((float)INT16_MAX);
+	__m128 gain_  = _mm_set1_ps(gain);
+
+	size_t i = 0;
+
+	for (; i + 8 <= count; i += 8)
+	{
+		__m128i s16 = _mm_loadu_si128((const __m128i *)(src + i));
+
+		// sign extend by putting the 16 bits in the top half and shifting them back down
+		__m128i s32_lo = _mm_srai_epi32(_mm_unpacklo_epi16(s16, s16), 16);
+		__m128i s32_hi = _mm_srai_epi32(_mm_unpackhi_epi16(s16, s16), 16);
+
+		__m128 sample_lo = _mm_div_ps(_mm_cvtepi32_ps(s32_lo), scale);
+		__m128 sample_hi = _mm_div_ps(_mm_cvtepi32_ps(s32_hi), scale);
+
+		sample_lo = _mm_mul_ps(sample_lo, _mm_loadu_ps(volumes + i + 0));
+		sample_hi = _mm_mul_ps(sample_hi, _mm_loadu_ps(volumes + i + 4));
+
+		_mm_storeu_ps(dst + i + 0, _mm_add_ps(_mm_loadu_ps(dst + i + 0), _mm_mul_ps(gain_, sample_lo)));
+		_mm_storeu_ps(dst + i + 4, _mm_add_ps(_mm_loadu_ps(dst + i + 4), _mm_mul_ps(gain_, sample_hi)));
+	}
+
+	mix_s16_scalar(dst + i, src + i, volumes + i, gain, count - i);
+}
+
+SIMD_KERNEL_SSE2
+fn_local void clamp_interleave_stereo_sse2(float *dst, const float *l, const float *r, size_t count)
+{
+	__m128 one     = _mm_set1_ps( 1.0f);
+	__m128 neg_one = _mm_set1_ps(-1.0f);
+
+	size_t i = 0;
+
+	for (; i + 4 <= count; i += 4)
+	{
+		// min and max return the second operand unless the comparison holds, same as flt_min and flt_max
+		__m128 l4 = _mm_max_ps(neg_one, _mm_min_ps(one, _mm_loadu_ps(l + i)));
+		__m128 r4 = _mm_max_ps(neg_one, _mm_min_ps(one, _mm_loadu_ps(r + i)));
+
+		_mm_storeu_ps(dst + 2*i + 0, _mm_unpacklo_ps(l4, r4));
+		_mm_storeu_ps(dst + 2*i + 4, _mm_unpackhi_ps(l4, r4));
+	}
+
+	clamp_interleave_stereo_scalar(dst + 2*i, l + i, r + i, count - i);
+}
+
+SIMD_KERNEL_SSE2
+fn_local __m128 dot3_sse2(__m128 ax, __m128 ay, __m128 az, __m128 bx, __m128 by, __m128 bz)
+{
+	return _mm_add_ps(_mm_add_ps(_mm_mul_ps(ax, bx), _mm_mul_ps(ay, by)), _mm_mul_ps(az, bz));
+}
+
+SIMD_KERNEL_SSE2
+fn_local uint32_t ray_intersect_triangles_sse2(const triangle_soa_t *triangles, uint32_t first, uint32_t count,
+											   v3_t o, v3_t d, float min_t, float *inout_t, v3_t *uvw)
+{
+	const __m128  epsilon     = _mm_set1_ps( 0.000000001f);
+	const __m128  neg_epsilon = _mm_set1_ps(-0.000000001f);
+	const __m128  zero        = _mm_setzero_ps();
+	const __m128  one         = _mm_set1_ps(1.0f);
+	const __m128  min_t4      = _mm_set1_ps(min_t);
+	const __m128i lane_index  = _mm_setr_epi32(0, 1, 2, 3);
+
+	const __m128 ox = _mm_set1_ps(o.x), oy = _mm_set1_ps(o.y), oz = _mm_set1_ps(o.z);
+	const __m128 dx = _mm_set1_ps(d.x), dy = _mm_set1_ps(d.y), dz = _mm_set1_ps(d.z);
+
+	float    best_t = *inout_t;
+	float    best_v = 0.0f;
+	float    best_w = 0.0f;
+	uint32_t best   = UINT32_MAX;
+
+	for (uint32_t i = 0; i < count; i += 4)
+	{
+		uint32_t at = first + i;
+
+		__m128 ax  = _mm_loadu_ps(triangles->ax  + at), ay  = _mm_loadu_ps(triangles->ay  + at), az  = _mm_loadu_ps(triangles->az  + at);
+		__m128 e1x = _mm_loadu_ps(triangles->e1x + at), e1y = _mm_loadu_ps(triangles->e1y + at), e1z = _mm_loadu_ps(triangles->e1z + at);
+		__m128 e2x = _mm_loadu_ps(triangles->e2x + at), e2y = _mm_loadu_ps(triangles->e2y + at), e2z = _mm_loadu_ps(triangles->e2z + at);
+
+		__m128 px = _mm_sub_ps(_mm_mul_ps(dy, e2z), _mm_mul_ps(dz, e2y));
+		__m128 py = _mm_sub_ps(_mm_mul_ps(dz, e2x), _mm_mul_ps(dx, e2z));
+		__m128 pz = _mm_sub_ps(_mm_mul_ps(dx, e2y), _mm_mul_ps(dy, e2x));
+
+		__m128 det     = dot3_sse2(e1x, e1y, e1z, px, py, pz);
+		__m128 rcp_det = _mm_div_ps(one, det);
+
+		__m128 tx = _mm_sub_ps(ox, ax);
+		__m128 ty = _mm_sub_ps(oy, ay);
+		__m128 tz = _mm_sub_ps(oz, az);
+
+		__m128 v = _mm_mul_ps(rcp_det, dot3_sse2(tx, ty, tz, px, py, pz));
+
+		__m128 qx = _mm_sub_ps(_mm_mul_ps(ty, e1z), _mm_mul_ps(tz, e1y));
+		__m128 qy = _mm_sub_ps(_mm_mul_ps(tz, e1x), _mm_mul_ps(tx, e1z));
+		__m128 qz = _mm_sub_ps(_mm_mul_ps(tx, e1y), _mm_mul_ps(ty, e1x));
+
+		__m128 w = _mm_mul_ps(rcp_det, dot3_sse2(dx, dy, dz, qx, qy, qz));
+		__m128 t = _mm_mul_ps(rcp_det, dot3_sse2(qx, qy, qz, e2x, e2y, e2z));
+
+		__m128 reject = _mm_and_ps(_mm_cmpgt_ps(det, neg_epsilon), _mm_cmplt_ps(det, epsilon));
+		reject = _mm_or_ps(reject, _mm_cmplt_ps(v, zero));
+		reject = _mm_or_ps(reject, _mm_cmpgt_ps(v, one));
+		reject = _mm_or_ps(reject, _mm_cmplt_ps(w, zero));
+		reject = _mm_or_ps(reject, _mm_cmpgt_ps(_mm_add_ps(v, w), one));
+		reject = _mm_or_ps(reject, _mm_cmplt_ps(t, epsilon));
+
+		__m128 accept = _mm_castsi128_ps(_mm_cmplt_epi32(lane_index, _mm_set1_epi32((int)(count - i))));
+		accept = _mm_and_ps(accept, _mm_cmpge_ps(t, min_t4));
+		accept = _mm_and_ps(accept, _mm_cmplt_ps(t, _mm_set1_ps(best_t)));
+		accept = _mm_andnot_ps(reject, accept);
+
+		uint32_t hits = (uint32_t)_mm_movemask_ps(accept);
+
+		if (hits)
+		{
+			alignas(16) float hit_t[4], hit_v[4], hit_w[4];
+			_mm_store_ps(hit_t, t);
+			_mm_store_ps(hit_v, v);
+			_mm_store_ps(hit_w, w);
+
+			while (hits)
+			{
+				unsigned long lane;
+				bit_scan_forward64(&lane, hits);
+
+				if (hit_t[lane] < best_t)
+				{
+					best_t = hit_t[lane];
+					best_v = hit_v[lane];
+					best_w = hit_w[lane];
+					best   = at + (uint32_t)lane;
+				}
+
+				hits &= hits - 1;
+			}
+		}
+	}
+
+	if (best != UINT32_MAX)
+	{
+		*inout_t = best_t;
+
+		if (uvw)
+		{
+			uvw->x = 1.0f - best_v - best_w;
+			uvw->y = best_v;
+			uvw->z = best_w;
+		}
+	}
+
+	return best;
+}
+
+SIMD_KERNEL_SSE2
+fn_local uint32_t ray_packet_intersect_box_sse2(const ray_packet_t *packet, uint32_t active, rect3_t box)
+{
+	__m128 ox = _mm_load_ps(packet->ox), oy = _mm_load_ps(packet->oy), oz = _mm_load_ps(packet->oz);
+
+	__m128 tx1 = _mm_mul_ps(_mm_load_ps(packet->rcp_dx), _mm_sub_ps(_mm_set1_ps(box.min.x), ox));
+	__m128 tx2 = _mm_mul_ps(_mm_load_ps(packet->rcp_dx), _mm_sub_ps(_mm_set1_ps(box.max.x), ox));
+
+	__m128 t_min = _mm_min_ps(tx1, tx2);
+	__m128 t_max = _mm_max_ps(tx1, tx2);
+
+	__m128 ty1 = _mm_mul_ps(_mm_load_ps(packet->rcp_dy), _mm_sub_ps(_mm_set1_ps(box.min.y), oy));
+	__m128 ty2 = _mm_mul_ps(_mm_load_ps(packet->rcp_dy), _mm_sub_ps(_mm_set1_ps(box.max.y), oy));
+
+	t_min = _mm_max_ps(t_min, _mm_min_ps(ty1, ty2));
+	t_max = _mm_min_ps(t_max, _mm_max_ps(ty1, ty2));
+
+	__m128 tz1 = _mm_mul_ps(_mm_load_ps(packet->rcp_dz), _mm_sub_ps(_mm_set1_ps(box.min.z), oz));
+	__m128 tz2 = _mm_mul_ps(_mm_load_ps(packet->rcp_dz), _mm_sub_ps(_mm_set1_ps(box.max.z), oz));
+
+	t_min = _mm_max_ps(t_min, _mm_min_ps(tz1, tz2));
+	t_max = _mm_min_ps(t_max, _mm_max_ps(tz1, tz2));
+
+	__m128 hit = _mm_and_ps(_mm_cmpge_ps(t_max, t_min), _mm_cmple_ps(t_min, _mm_load_ps(packet->t)));
+
+	return active & (uint32_t)_mm_movemask_ps(hit);
+}
+
+SIMD_KERNEL_SSE2
+fn_local uint32_t ray_packet_intersect_triangles_sse2(const triangle_soa_t *triangles, uint32_t first, uint32_t count,
+													  ray_packet_t *packet, uint32_t active)
+{
+	const __m128 epsilon     = _mm_set1_ps( 0.000000001f);
+	const __m128 neg_epsilon = _mm_set1_ps(-0.000000001f);
+	const __m128 zero        = _mm_setzero_ps();
+	const __m128 one         = _mm_set1_ps(1.0f);
+
+	const __m128 lane_bits   = _mm_castsi128_ps(_mm_setr_epi32(1, 2, 4, 8));
+	const __m128 active_mask = _mm_castsi128_ps(_mm_cmpeq_epi32(_mm_and_si128(_mm_castps_si128(lane_bits), _mm_set1_epi32((int)active)),
+																_mm_castps_si128(lane_bits)));
+
+	const __m128 ox = _mm_load_ps(packet->ox), oy = _mm_load_ps(packet->oy), oz = _mm_load_ps(packet->oz);
+	const __m128 dx = _mm_load_ps(packet->dx), dy = _mm_load_ps(packet->dy), dz = _mm_load_ps(packet->dz);
+	const __m128 min_t = _mm_load_ps(packet->min_t);
+
+	__m128  best_t = _mm_load_ps(packet->t);
+	__m128  best_v = _mm_load_ps(packet->v);
+	__m128  best_w = _mm_load_ps(packet->w);
+	__m128i best   = _mm_load_si128((const __m128i *)packet->triangle);
+
+	uint32_t hits = 0;
+
+	for (uint32_t i = 0; i < count; i++)
+	{
+		uint32_t at = first + i;
+
+		__m128 ax  = _mm_set1_ps(triangles->ax [at]), ay  = _mm_set1_ps(triangles->ay [at]), az  = _mm_set1_ps(triangles->az [at]);
+		__m128 e1x = _mm_set1_ps(triangles->e1x[at]), e1y = _mm_set1_ps(triangles->e1y[at]), e1z = _mm_set1_ps(triangles->e1z[at]);
+		__m128 e2x = _mm_set1_ps(triangles->e2x[at]), e2y = _mm_set1_ps(triangles->e2y[at]), e2z = _mm_set1_ps(triangles->e2z[at]);
+
+		__m128 px = _mm_sub_ps(_mm_mul_ps(dy, e2z), _mm_mul_ps(dz, e2y));
+		__m128 py = _mm_sub_ps(_mm_mul_ps(dz, e2x), _mm_mul_ps(dx, e2z));
+		__m128 pz = _mm_sub_ps(_mm_mul_ps(dx, e2y), _mm_mul_ps(dy, e2x));
+
+		__m128 det     = dot3_sse2(e1x, e1y, e1z, px, py, pz);
+		__m128 rcp_det = _mm_div_ps(one, det);
+
+		__m128 tx = _mm_sub_ps(ox, ax);
+		__m128 ty = _mm_sub_ps(oy, ay);
+		__m128 tz = _mm_sub_ps(oz, az);
+
+		__m128 v = _mm_mul_ps(rcp_det, dot3_sse2(tx, ty, tz, px, py, pz));
+
+		__m128 qx = _mm_sub_ps(_mm_mul_ps(ty, e1z), _mm_mul_ps(tz, e1y));
+		__m128 qy = _mm_sub_ps(_mm_mul_ps(tz, e1x), _mm_mul_ps(tx, e1z));
+		__m128 qz = _mm_sub_ps(_mm_mul_ps(tx, e1y), _mm_mul_ps(ty, e1x));
+
+		__m128 w = _mm_mul_ps(rcp_det, dot3_sse2(dx, dy, dz, qx, qy, qz));
+		__m128 t = _mm_mul_ps(rcp_det, dot3_sse2(qx, qy, qz, e2x, e2y, e2z));
+
+		__m128 reject = _mm_and_ps(_mm_cmpgt_ps(det, neg_epsilon), _mm_cmplt_ps(det, epsilon));
+		reject = _mm_or_ps(reject, _mm_cmplt_ps(v, zero));
+		reject = _mm_or_ps(reject, _mm_cmpgt_ps(v, one));
+		reject = _mm_or_ps(reject, _mm_cmplt_ps(w, zero));
+		reject = _mm_or_ps(reject, _mm_cmpgt_ps(_mm_add_ps(v, w), one));
+		reject = _mm_or_ps(reject, _mm_cmplt_ps(t, epsilon));
+
+		__m128 accept = _mm_and_ps(active_mask, _mm_cmpge_ps(t, min_t));
+		accept = _mm_and_ps(accept, _mm_cmplt_ps(t, best_t));
+		accept = _mm_andnot_ps(reject, accept);
+
+		uint32_t accepted = (uint32_t)_mm_movemask_ps(accept);
+
+		if (accepted)
+		{
+			best_t = _mm_or_ps(_mm_and_ps(accept, t), _mm_andnot_ps(accept, best_t));
+			best_v = _mm_or_ps(_mm_and_ps(accept, v), _mm_andnot_ps(accept, best_v));
+			best_w = _mm_or_ps(_mm_and_ps(accept, w), _mm_andnot_ps(accept, best_w));
+
+			__m128i accept_i = _mm_castps_si128(accept);
+			best = _mm_or_si128(_mm_and_si128(accept_i, _mm_set1_epi32((int)at)), _mm_andnot_si128(accept_i, best));
+
+			hits |= accepted;
+		}
+	}
+
+	_mm_store_ps(packet->t, best_t);
+	_mm_store_ps(packet->v, best_v);
+	_mm_store_ps(packet->w, best_w);
+	_mm_store_si128((__m128i *)packet->triangle, best);
+
+	return hits;
+}
+
+//
+// avx2
+//
+
+SIMD_KERNEL_AVX2
+fn_local void mix_s16_avx2(float *dst, const int16_t *src, const float *volumes, float gain, size_t count)
+{
+	__m256 scale = _mm256_set1_ps((float)INT16_MAX);
+	__m256 gain_ = _mm256_set1_ps(gain);
+
+	size_t i = 0;
+
+	for (; i + 8 <= count; i += 8)
+	{
+		__m256i s32 = _mm256_cvtepi16_epi32(_mm_loadu_si128((const __m128i *)(src + i)));
+
+		__m256 sample = _mm256_div_ps(_mm256_cvtepi32_ps(s32), scale);
+		sample = _mm256_mul_ps(sample, _mm256_loadu_ps(volumes + i));
+
+		_mm256_storeu_ps(dst + i, _mm256_add_ps(_mm256_loadu_ps(dst + i), _mm256_mul_ps(gain_, sample)));
+	}
+
+	mix_s16_scalar(dst + i, src + i, volumes + i, gain, count - i);
+}
+
+SIMD_KERNEL_AVX2
+fn_local void clamp_interleave_stereo_avx2(float *dst, const float *l, const float *r, size_t count)
+{
+	__m256 one     = _mm256_set1_ps( 1.0f);
+	__m256 neg_one = _mm256_set1_ps(-1.0f);
+
+	size_t i = 0;
+
+	for (; i + 8 <= count; i += 8)
+	{
+		__m256 l8 = _mm256_max_ps(neg_one, _mm256_min_ps(one, _mm256_loadu_ps(l + i)));
+		__m256 r8 = _mm256_max_ps(neg_one, _mm256_min_ps(one, _mm256_loadu_ps(r + i)));
+
+		// unpack works within 128 bit halves: lo = l0 r0 l1 r1 | l4 r4 l5 r5, hi = l2 r2 l3 r3 | l6 r6 l7 r7
+		__m256 lo = _mm256_unpacklo_ps(l8, r8);
+		__m256 hi = _mm256_unpackhi_ps(l8, r8);
+
+		_mm256_storeu_ps(dst + 2*i + 0, _mm256_permute2f128_ps(lo, hi, 0x20));
+		_mm256_storeu_ps(dst + 2*i + 8, _mm256_permute2f128_ps(lo, hi, 0x31));
+	}
+
+	clamp_interleave_stereo_scalar(dst + 2*i, l + i, r + i, count - i);
+}
+
+SIMD_KERNEL_AVX2
+fn_local __m256 dot3_avx2(__m256 ax, __m256 ay, __m256 az, __m256 bx, __m256 by, __m256 bz)
+{
+	return _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(ax, bx), _mm256_mul_ps(ay, by)), _mm256_mul_ps(az, bz));
+}
+
+SIMD_KERNEL_AVX2
+fn_local uint32_t ray_intersect_triangles_avx2(const triangle_soa_t *triangles, uint32_t first, uint32_t count,
+											   v3_t o, v3_t d, float min_t, float *inout_t, v3_t *uvw)
+{
+	const __m256  epsilon     = _mm256_set1_ps( 0.000000001f);
+	const __m256  neg_epsilon = _mm256_set1_ps(-0.000000001f);
+	const __m256  zero        = _mm256_setzero_ps();
+	const __m256  one         = _mm256_set1_ps(1.0f);
+	const __m256  min_t8      = _mm256_set1_ps(min_t);
+	const __m256i lane_index  = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+
+	const __m256 ox = _mm256_set1_ps(o.x), oy = _mm256_set1_ps(o.y), oz = _mm256_set1_ps(o.z);
+	const __m256 dx = _mm256_set1_ps(d.x), dy = _mm256_set1_ps(d.y), dz = _mm256_set1_ps(d.z);
+
+	float    best_t = *inout_t;
+	float    best_v = 0.0f;
+	float    best_w = 0.0f;
+	uint32_t best   = UINT32_MAX;
+
+	for (uint32_t i = 0; i < count; i += 8)
+	{
+		uint32_t at = first + i;
+
+		__m256 ax  = _mm256_loadu_ps(triangles->ax  + at), ay  = _mm256_loadu_ps(triangles->ay  + at), az  = _mm256_loadu_ps(triangles->az  + at);
+		__m256 e1x = _mm256_loadu_ps(triangles->e1x + at), e1y = _mm256_loadu_ps(triangles->e1y + at), e1z = _mm256_loadu_ps(triangles->e1z + at);
+		__m256 e2x = _mm256_loadu_ps(triangles->e2x + at), e2y = _mm256_loadu_ps(triangles->e2y + at), e2z = _mm256_loadu_ps(triangles->e2z + at);
+
+		__m256 px = _mm256_sub_ps(_mm256_mul_ps(dy, e2z), _mm256_mul_ps(dz, e2y));
+		__m256 py = _mm256_sub_ps(_mm256_mul_ps(dz, e2x), _mm256_mul_ps(dx, e2z));
+		__m256 pz = _mm256_sub_ps(_mm256_mul_ps(dx, e2y), _mm256_mul_ps(dy, e2x));
+
+		__m256 det     = dot3_avx2(e1x, e1y, e1z, px, py, pz);
+		__m256 rcp_det = _mm256_div_ps(one, det);
+
+		__m256 tx = _mm256_sub_ps(ox, ax);
+		__m256 ty = _mm256_sub_ps(oy, ay);
+		__m256 tz = _mm256_sub_ps(oz, az);
+
+		__m256 v = _mm256_mul_ps(rcp_det, dot3_avx2(tx, ty, tz, px, py, pz));
+
+		__m256 qx = _mm256_sub_ps(_mm256_mul_ps(ty, e1z), _mm256_mul_ps(tz, e1y));
+		__m256 qy = _mm256_sub_ps(_mm256_mul_ps(tz, e1x), _mm256_mul_ps(tx, e1z));
+		__m256 qz = _mm256_sub_ps(_mm256_mul_ps(tx, e1y), _mm256_mul_ps(ty, e1x));
+
+		__m256 w = _mm256_mul_ps(rcp_det, dot3_avx2(dx, dy, dz, qx, qy, qz));
+		__m256 t = _mm256_mul_ps(rcp_det, dot3_avx2(qx, qy, qz, e2x, e2y, e2z));
+
+		__m256 reject = _mm256_and_ps(_mm256_cmp_ps(det, neg_epsilon, _CMP_GT_OQ), _mm256_cmp_ps(det, epsilon, _CMP_LT_OQ));
+		reject = _mm256_or_ps(reject, _mm256_cmp_ps(v, zero, _CMP_LT_OQ));
+		reject = _mm256_or_ps(reject, _mm256_cmp_ps(v, one, _CMP_GT_OQ));
+		reject = _mm256_or_ps(reject, _mm256_cmp_ps(w, zero, _CMP_LT_OQ));
+		reject = _mm256_or_ps(reject, _mm256_cmp_ps(_mm256_add_ps(v, w), one, _CMP_GT_OQ));
+		reject = _mm256_or_ps(reject, _mm256_cmp_ps(t, epsilon, _CMP_LT_OQ));
+
+		__m256 accept = _mm256_castsi256_ps(_mm256_cmpgt_epi32(_mm256_set1_epi32((int)(count - i)), lane_index));
+		accept = _mm256_and_ps(accept, _mm256_cmp_ps(t, min_t8, _CMP_GE_OQ));
+		accept = _mm256_and_ps(accept, _mm256_cmp_ps(t, _mm256_set1_ps(best_t), _CMP_LT_OQ));
+		accept = _mm256_andnot_ps(reject, accept);
+
+		uint32_t hits = (uint32_t)_mm256_movemask_ps(accept);
+
+		if (hits)
+		{
+			alignas(32) float hit_t[8], hit_v[8], hit_w[8];
+			_mm256_store_ps(hit_t, t);
+			_mm256_store_ps(hit_v, v);
+			_mm256_store_ps(hit_w, w);
+
+			while (hits)
+			{
+				unsigned long lane;
+				bit_scan_forward64(&lane, hits);
+
+				if (hit_t[lane] < best_t)
+				{
+					best_t = hit_t[lane];
+					best_v = hit_v[lane];
+					best_w = hit_w[lane];
+					best   = at + (uint32_t)lane;
+				}
+
+				hits &= hits - 1;
+			}
+		}
+	}
+
+	if (best != UINT32_MAX)
+	{
+		*inout_t = best_t;
+
+		if (uvw)
+		{
+			uvw->x = 1.0f - best_v - best_w;
+			uvw->y = best_v;
+			uvw->z = best_w;
+		}
+	}
+
+	return best;
+}
+
+SIMD_KERNEL_AVX2
+fn_local uint32_t ray_packet_intersect_box_avx2(const ray_packet_t *packet, uint32_t active, rect3_t box)
+{
+	__m256 ox = _mm256_load_ps(packet->ox), oy = _mm256_load_ps(packet->oy), oz = _mm256_load_ps(packet->oz);
+
+	__m256 tx1 = _mm256_mul_ps(_mm256_load_ps(packet->rcp_dx), _mm256_sub_ps(_mm256_set1_ps(box.min.x), ox));
+	__m256 tx2 = _mm256_mul_ps(_mm256_load_ps(packet->rcp_dx), _mm256_sub_ps(_mm256_set1_ps(box.max.x), ox));
+
+	__m256 t_min = _mm256_min_ps(tx1, tx2);
+	__m256 t_max = _mm256_max_ps(tx1, tx2);
+
+	__m256 ty1 = _mm256_mul_ps(_mm256_load_ps(packet->rcp_dy), _mm256_sub_ps(_mm256_set1_ps(box.min.y), oy));
+	__m256 ty2 = _mm256_mul_ps(_mm256_load_ps(packet->rcp_dy), _mm256_sub_ps(_mm256_set1_ps(box.max.y), oy));
+
+	t_min = _mm256_max_ps(t_min, _mm256_min_ps(ty1, ty2));
+	t_max = _mm256_min_ps(t_max, _mm256_max_ps(ty1, ty2));
+
+	__m256 tz1 = _mm256_mul_ps(_mm256_load_ps(packet->rcp_dz), _mm256_sub_ps(_mm256_set1_ps(box.min.z), oz));
+	__m256 tz2 = _mm256_mul_ps(_mm256_load_ps(packet->rcp_dz), _mm256_sub_ps(_mm256_set1_ps(box.max.z), oz));
+
+	t_min = _mm256_max_ps(t_min, _mm256_min_ps(tz1, tz2));
+	t_max = _mm256_min_ps(t_max, _mm256_max_ps(tz1, tz2));
+
+	__m256 hit = _mm256_and_ps(_mm256_cmp_ps(t_max, t_min, _CMP_GE_OQ), _mm256_cmp_ps(t_min, _mm256_load_ps(packet->t), _CMP_LE_OQ));
+
+	return active & (uint32_t)_mm256_movemask_ps(hit);
+}
+
+SIMD_KERNEL_AVX2
+fn_local uint32_t ray_packet_intersect_triangles_avx2(const triangle_soa_t *triangles, uint32_t first, uint32_t count,
+													  ray_packet_t *packet, uint32_t active)
+{
+	const __m256 epsilon     = _mm256_set1_ps( 0.000000001f);
+	const __m256 neg_epsilon = _mm256_set1_ps(-0.000000001f);
+	const __m256 zero        = _mm256_setzero_ps();
+	const __m256 one         = _mm256_set1_ps(1.0f);
+
+	const __m256i lane_bits   = _mm256_setr_epi32(1, 2, 4, 8, 16, 32, 64, 128);
+	const __m256  active_mask = _mm256_castsi256_ps(_mm256_cmpeq_epi32(_mm256_and_si256(lane_bits, _mm256_set1_epi32((int)active)), lane_bits));
+
+	const __m256 ox = _mm256_load_ps(packet->ox), oy = _mm256_load_ps(packet->oy), oz = _mm256_load_ps(packet->oz);
+	const __m256 dx = _mm256_load_ps(packet->dx), dy = _mm256_load_ps(packet->dy), dz = _mm256_load_ps(packet->dz);
+	const __m256 min_t = _mm256_load_ps(packet->min_t);
+
+	__m256 best_t = _mm256_load_ps(packet->t);
+	__m256 best_v = _mm256_load_ps(packet->v);
+	__m256 best_w = _mm256_load_ps(packet->w);
+	__m256 best   = _mm256_load_ps((const float *)packet->triangle);
+
+	uint32_t hits = 0;
+
+	for (uint32_t i = 0; i < count; i++)
+	{
+		uint32_t at = first + i;
+
+		__m256 ax  = _mm256_set1_ps(triangles->ax [at]), ay  = _mm256_set1_ps(triangles->ay [at]), az  = _mm256_set1_ps(triangles->az [at]);
+		__m256 e1x = _mm256_set1_ps(triangles->e1x[at]), e1y = _mm256_set1_ps(triangles->e1y[at]), e1z = _mm256_set1_ps(triangles->e1z[at]);
+		__m256 e2x = _mm256_set1_ps(triangles->e2x[at]), e2y = _mm256_set1_ps(triangles->e2y[at]), e2z = _mm256_set1_ps(triangles->e2z[at]);
+
+		__m256 px = _mm256_sub_ps(_mm256_mul_ps(dy, e2z), _mm256_mul_ps(dz, e2y));
+		__m256 py = _mm256_sub_ps(_mm256_mul_ps(dz, e2x), _mm256_mul_ps(dx, e2z));
+		__m256 pz = _mm256_sub_ps(_mm256_mul_ps(dx, e2y), _mm256_mul_ps(dy, e2x));
+
+		__m256 det     = dot3_avx2(e1x, e1y, e1z, px, py, pz);
+		__m256 rcp_det = _mm256_div_ps(one, det);
+
+		__m256 tx = _mm256_sub_ps(ox, ax);
+		__m256 ty = _mm256_sub_ps(oy, ay);
+		__m256 tz = _mm256_sub_ps(oz, az);
+
+		__m256 v = _mm256_mul_ps(rcp_det, dot3_avx2(tx, ty, tz, px, py, pz));
+
+		__m256 qx = _mm256_sub_ps(_mm256_mul_ps(ty, e1z), _mm256_mul_ps(tz, e1y));
+		__m256 qy = _mm256_sub_ps(_mm256_mul_ps(tz, e1x), _mm256_mul_ps(tx, e1z));
+		__m256 qz = _mm256_sub_ps(_mm256_mul_ps(tx, e1y), _mm256_mul_ps(ty, e1x));
+
+		__m256 w = _mm256_mul_ps(rcp_det, dot3_avx2(dx, dy, dz, qx, qy, qz));
+		__m256 t = _mm256_mul_ps(rcp_det, dot3_avx2(qx, qy, qz, e2x, e2y, e2z));
+
+		__m256 reject = _mm256_and_ps(_mm256_cmp_ps(det, neg_epsilon, _CMP_GT_OQ), _mm256_cmp_ps(det, epsilon, _CMP_LT_OQ));
+		reject = _mm256_or_ps(reject, _mm256_cmp_ps(v, zero, _CMP_LT_OQ));
+		reject = _mm256_or_ps(reject, _mm256_cmp_ps(v, one, _CMP_GT_OQ));
+		reject = _mm256_or_ps(reject, _mm256_cmp_ps(w, zero, _CMP_LT_OQ));
+		reject = _mm256_or_ps(reject, _mm256_cmp_ps(_mm256_add_ps(v, w), one, _CMP_GT_OQ));
+		reject = _mm256_or_ps(reject, _mm256_cmp_ps(t, epsilon, _CMP_LT_OQ));
+
+		__m256 accept = _mm256_and_ps(active_mask, _mm256_cmp_ps(t, min_t, _CMP_GE_OQ));
+		accept = _mm256_and_ps(accept, _mm256_cmp_ps(t, best_t, _CMP_LT_OQ));
+		accept = _mm256_andnot_ps(reject, accept);
+
+		uint32_t accepted = (uint32_t)_mm256_movemask_ps(accept);
+
+		if (accepted)
+		{
+			best_t = _mm256_blendv_ps(best_t, t, accept);
+			best_v = _mm256_blendv_ps(best_v, v, accept);
+			best_w = _mm256_blendv_ps(best_w, w, accept);
+			best   = _mm256_blendv_ps(best, _mm256_castsi256_ps(_mm256_set1_epi32((int)at)), accept);
+
+			hits |= accepted;
+		}
+	}
+
+	_mm256_store_ps(packet->t, best_t);
+	_mm256_store_ps(packet->v, best_v);
+	_mm256_store_ps(packet->w, best_w);
+	_mm256_store_ps((float *)packet->triangle, best);
+
+	return hits;
+}
+
+//
+// avx512
+//
+
+SIMD_KERNEL_AVX512
+fn_local void mix_s16_avx512(float *dst, const int16_t *src, const float *volumes, float gain, size_t count)
+{
+	__m512 scale = _mm512_set1_ps((float)INT16_MAX);
+	__m512 gain_ = _mm512_set1_ps(gain);
+
+	size_t i = 0;
+
+	for (; i + 16 <= count; i += 16)
+	{
+		__m512i s32 = _mm512_cvtepi16_epi32(_mm256_loadu_si256((const __m256i *)(src + i)));
+
+		__m512 sample = _mm512_div_ps(_mm512_cvtepi32_ps(s32), scale);
+		sample = _mm512_mul_ps(sample, _mm512_loadu_ps(volumes + i));
+
+		_mm512_storeu_ps(dst + i, _mm512_add_ps(_mm512_loadu_ps(dst + i), _mm512_mul_ps(gain_, sample)));
+	}
+
+	mix_s16_scalar(dst + i, src + i, volumes + i, gain, count - i);
+}
+
+SIMD_KERNEL_AVX512
+fn_local void clamp_interleave_stereo_avx512(float *dst, const float *l, const float *r, size_t count)
+{
+	__m512 one     = _mm512_set1_ps( 1.0f);
+	__m512 neg_one = _mm512_set1_ps(-1.0f);
+
+	// indices 16 and up pick from the second operand
+	__m512i interleave_lo = _mm512_setr_epi32(0, 16, 1, 17, 2, 18, 3, 19, 4, 20, 5, 21, 6, 22, 7, 23);
+	__m512i interleave_hi = _mm512_setr_epi32(8, 24, 9, 25, 10, 26, 11, 27, 12, 28, 13, 29, 14, 30, 15, 31);
+
+	size_t i = 0;
+
+	for (; i + 16 <= count; i += 16)
+	{
+		__m512 l16 = _mm512_max_ps(neg_one, _mm512_min_ps(one, _mm512_loadu_ps(l + i)));
+		__m512 r16 = _mm512_max_ps(neg_one, _mm512_min_ps(one, _mm512_loadu_ps(r + i)));
+
+		_mm512_storeu_ps(dst + 2*i +  0, _mm512_permutex2var_ps(l16, interleave_lo, r16));
+		_mm512_storeu_ps(dst + 2*i + 16, _mm512_permutex2var_ps(l16, interleave_hi, r16));
+	}
+
+	clamp_interleave_stereo_scalar(dst + 2*i, l + i, r + i, count - i);
+}
+
+SIMD_KERNEL_AVX512
+fn_local __m512 dot3_avx512(__m512 ax, __m512 ay, __m512 az, __m512 bx, __m512 by, __m512 bz)
+{
+	return _mm512_add_ps(_mm512_add_ps(_mm512_mul_ps(ax, bx), _mm512_mul_ps(ay, by)), _mm512_mul_ps(az, bz));
+}
+
+SIMD_KERNEL_AVX512
+fn_local uint32_t ray_intersect_triangles_avx512(const triangle_soa_t *triangles, uint32_t first, uint32_t count,
+												 v3_t o, v3_t d, float min_t, float *inout_t, v3_t *uvw)
+{
+	const __m512 epsilon     = _mm512_set1_ps( 0.000000001f);
+	const __m512 neg_epsilon = _mm512_set1_ps(-0.000000001f);
+	const __m512 zero        = _mm512_setzero_ps();
+	const __m512 one         = _mm512_set1_ps(1.0f);
+	const __m512 min_t16     = _mm512_set1_ps(min_t);
+
+	const __m512 ox = _mm512_set1_ps(o.x), oy = _mm512_set1_ps(o.y), oz = _mm512_set1_ps(o.z);
+	const __m512 dx = _mm512_set1_ps(d.x), dy = _mm512_set1_ps(d.y), dz = _mm512_set1_ps(d.z);
+
+	float    best_t = *inout_t;
+	float    best_v = 0.0f;
+	float    best_w = 0.0f;
+	uint32_t best   = UINT32_MAX;
+
+	for (uint32_t i = 0; i < count; i += 16)
+	{
+		uint32_t at = first + i;
+
+		__m512 ax  = _mm512_loadu_ps(triangles->ax  + at), ay  = _mm512_loadu_ps(triangles->ay  + at), az  = _mm512_loadu_ps(triangles->az  + at);
+		__m512 e1x = _mm512_loadu_ps(triangles->e1x + at), e1y = _mm512_loadu_ps(triangles->e1y + at), e1z = _mm512_loadu_ps(triangles->e1z + at);
+		__m512 e2x = _mm512_loadu_ps(triangles->e2x + at), e2y = _mm512_loadu_ps(triangles->e2y + at), e2z = _mm512_loadu_ps(triangles->e2z + at);
+
+		__m512 px = _mm512_sub_ps(_mm512_mul_ps(dy, e2z), _mm512_mul_ps(dz, e2y));
+		__m512 py = _mm512_sub_ps(_mm512_mul_ps(dz, e2x), _mm512_mul_ps(dx, e2z));
+		__m512 pz = _mm512_sub_ps(_mm512_mul_ps(dx, e2y), _mm512_mul_ps(dy, e2x));
+
+		__m512 det     = dot3_avx512(e1x, e1y, e1z, px, py, pz);
+		__m512 rcp_det = _mm512_div_ps(one, det);
+
+		__m512 tx = _mm512_sub_ps(ox, ax);
+		__m512 ty = _mm512_sub_ps(oy, ay);
+		__m512 tz = _mm512_sub_ps(oz, az);
+
+		__m512 v = _mm512_mul_ps(rcp_det, dot3_avx512(tx, ty, tz, px, py, pz));
+
+		__m512 qx = _mm512_sub_ps(_mm512_mul_ps(ty, e1z), _mm512_mul_ps(tz, e1y));
+		__m512 qy = _mm512_sub_ps(_mm512_mul_ps(tz, e1x), _mm512_mul_ps(tx, e1z));
+		__m512 qz = _mm512_sub_ps(_mm512_mul_ps(tx, e1y), _mm512_mul_ps(ty, e1x));
+
+		__m512 w = _mm512_mul_ps(rcp_det, dot3_avx512(dx, dy, dz, qx, qy, qz));
+		__m512 t = _mm512_mul_ps(rcp_det, dot3_avx512(qx, qy, qz, e2x, e2y, e2z));
+
+		__mmask16 reject = _mm512_cmp_ps_mask(det, neg_epsilon, _CMP_GT_OQ) & _mm512_cmp_ps_mask(det, epsilon, _CMP_LT_OQ);
+		reject |= _mm512_cmp_ps_mask(v, zero, _CMP_LT_OQ);
+		reject |= _mm512_cmp_ps_mask(v, one, _CMP_GT_OQ);
+		reject |= _mm512_cmp_ps_mask(w, zero, _CMP_LT_OQ);
+		reject |= _mm512_cmp_ps_mask(_mm512_add_ps(v, w), one, _CMP_GT_OQ);
+		reject |= _mm512_cmp_ps_mask(t, epsilon, _CMP_LT_OQ);
+
+		uint32_t remaining = count - i;
+
+		__mmask16 accept = remaining >= 16 ? 0xFFFF : (__mmask16)((1u << remaining) - 1);
+		accept &= _mm512_cmp_ps_mask(t, min_t16, _CMP_GE_OQ);
+		accept &= _mm512_cmp_ps_mask(t, _mm512_set1_ps(best_t), _CMP_LT_OQ);
+		accept &= ~reject;
+
+		uint32_t hits = (uint32_t)accept;
+
+		if (hits)
+		{
+			alignas(64) float hit_t[16], hit_v[16], hit_w[16];
+			_mm512_store_ps(hit_t, t);
+			_mm512_store_ps(hit_v, v);
+			_mm512_store_ps(hit_w, w);
+
+			while (hits)
+			{
+				unsigned long lane;
+				bit_scan_forward64(&lane, hits);
+
+				if (hit_t[lane] < best_t)
+				{
+					best_t = hit_t[lane];
+					best_v = hit_v[lane];
+					best_w = hit_w[lane];
+					best   = at + (uint32_t)lane;
+				}
+
+				hits &= hits - 1;
+			}
+		}
+	}
+
+	if (best != UINT32_MAX)
+	{
+		*inout_t = best_t;
+
+		if (uvw)
+		{
+			uvw->x = 1.0f - best_v - best_w;
+			uvw->y = best_v;
+			uvw->z = best_w;
+		}
+	}
+
+	return best;
+}
+
+//
+// dispatch
+//
+
+global const simd_kernels_t g_simd_kernel_tables[SimdTier_COUNT] = {
+	[SimdTier_sse2] = {
+		.tier                    = SimdTier_sse2,
+		.mix_s16                 = mix_s16_sse2,
+		.clamp_interleave_stereo = clamp_interleave_stereo_sse2,
+		.ray_intersect_triangles = ray_intersect_triangles_sse2,
+
+		.ray_packet_width               = 4,
+		.ray_packet_intersect_box       = ray_packet_intersect_box_sse2,
+		.ray_packet_intersect_triangles = ray_packet_intersect_triangles_sse2,
+	},
+	[SimdTier_avx2] = {
+		.tier                    = SimdTier_avx2,
+		.mix_s16                 = mix_s16_avx2,
+		.clamp_interleave_stereo = clamp_interleave_stereo_avx2,
+		.ray_intersect_triangles = ray_intersect_triangles_avx2,
+
+		.ray_packet_width               = 8,
+		.ray_packet_intersect_box       = ray_packet_intersect_box_avx2,
+		.ray_packet_intersect_triangles = ray_packet_intersect_triangles_avx2,
+	},
+	[SimdTier_avx512] = {
+		.tier                    = SimdTier_avx512,
+		.mix_s16                 = mix_s16_avx512,
+		.clamp_interleave_stereo = clamp_interleave_stereo_avx512,
+		.ray_intersect_triangles = ray_intersect_triangles_avx512,
+
+		// packets wider than 8 rays are rarely coherent enough to pay off, so AVX-512 sticks with the AVX2 ones
+		.ray_packet_width               = 8,
+		.ray_packet_intersect_box       = ray_packet_intersect_box_avx2,
+		.ray_packet_intersect_triangles = ray_packet_intersect_triangles_avx2,
+	},
+};
+
+global _Atomic(const simd_kernels_t *) g_simd_kernels;
+
+const simd_kernels_t *simd_kernels(void)
+{
+	const simd_kernels_t *result = atomic_load(&g_simd_kernels);
+
+	if (!result)
+	{
+		simd_tier_t tier = query_cpu_features()->best_simd_tier;
+		result = &g_simd_kernel_tables[tier];
+
+		// if someone selected a tier in the meantime, theirs wins
+		const simd_kernels_t *expected = NULL;
+		if (!atomic_compare_exchange_strong(&g_simd_kernels, &expected, result))
+		{
+			result = expected;
+		}
+	}
+
+	return result;
+}
+
+const simd_kernels_t *simd_kernels_for_tier(simd_tier_t tier)
+{
+	const simd_kernels_t *result = NULL;
+
+	if (cpu_supports_simd_tier(tier))
+	{
+		result = &g_simd_kernel_tables[tier];
+	}
+
+	return result;
+}
+
+simd_tier_t simd_select_tier(simd_tier_t tier)
+{
+	simd_tier_t best = query_cpu_features()->best_simd_tier;
+
+	if (tier < 0)    tier = SimdTier_sse2;
+	if (tier > best) tier = best;
+
+	atomic_store(&g_simd_kernels, &g_simd_kernel_tables[tier]);
+
+	return tier;
+}
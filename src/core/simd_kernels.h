@@ -0,0 +1,81 @@
+// ============================================================
+// Copyright 2024 by Daniël Cornelisse, All Rights Reserved.
+// ============================================================
+
+#pragma once
+
+// Hot loops that get compiled once per simd_tier_t and picked at runtime, so a binary built for the SSE2
+// baseline still uses the full vector width of whatever it runs on. simd_kernels() hands out the table of
+// the selected tier, which is the best one the CPU supports unless something called simd_select_tier.
+//
+// Every tier produces bit-identical results: they do the same float operations in the same order, just more
+// lanes at a time, and floating point contraction is off so the compiler can't fuse a multiply and add on the
+// tiers that have FMA. Grab the table once outside of a loop, not per iteration.
+
+// Triangles as separate arrays of floats, for ray_intersect_triangles. Every array must stay readable for
+// TRIANGLE_SOA_PADDING floats past the last triangle, since the kernels load whole vectors and mask off lanes.
+#define TRIANGLE_SOA_PADDING 16
+
+typedef struct triangle_soa_t
+{
+	uint32_t count;
+
+	float *ax,  *ay,  *az;
+	float *e1x, *e1y, *e1z; // b - a
+	float *e2x, *e2y, *e2z; // c - a
+} triangle_soa_t;
+
+// Rays traced together by the ray_packet_* kernels, one per lane, as separate arrays of floats. Packets only
+// pay off for coherent rays, ones that start close together and head roughly the same way, since a node gets
+// visited as soon as any ray in the packet wants it.
+#define RAY_PACKET_MAX_WIDTH 8
+
+typedef struct ray_packet_t
+{
+	alignas(32) float ox[RAY_PACKET_MAX_WIDTH];
+	float oy    [RAY_PACKET_MAX_WIDTH], oz    [RAY_PACKET_MAX_WIDTH];
+	float dx    [RAY_PACKET_MAX_WIDTH], dy    [RAY_PACKET_MAX_WIDTH], dz    [RAY_PACKET_MAX_WIDTH];
+	float rcp_dx[RAY_PACKET_MAX_WIDTH], rcp_dy[RAY_PACKET_MAX_WIDTH], rcp_dz[RAY_PACKET_MAX_WIDTH]; // 1 / d
+
+	float min_t[RAY_PACKET_MAX_WIDTH];
+	float t    [RAY_PACKET_MAX_WIDTH]; // max t going in, t of the nearest hit so far after
+
+	// the nearest hit so far
+	float    v       [RAY_PACKET_MAX_WIDTH];
+	float    w       [RAY_PACKET_MAX_WIDTH];
+	uint32_t triangle[RAY_PACKET_MAX_WIDTH]; // UINT32_MAX if there is none
+} ray_packet_t;
+
+typedef struct simd_kernels_t
+{
+	simd_tier_t tier;
+
+	// dst[i] += gain*(snorm_from_s16(src[i])*volumes[i])
+	void (*mix_s16)(float *dst, const int16_t *src, const float *volumes, float gain, size_t count);
+
+	// dst[2*i + 0] = clamp(l[i], -1, 1), dst[2*i + 1] = clamp(r[i], -1, 1)
+	void (*clamp_interleave_stereo)(float *dst, const float *l, const float *r, size_t count);
+
+	// Tests the ray against triangles [first, first + count) the same way ray_intersect_triangle does, and
+	// returns the index of the nearest one hit with min_t <= hit t < *t, or UINT32_MAX if there was none.
+	// On a hit *t and *uvw are updated. Ties go to the lowest index.
+	uint32_t (*ray_intersect_triangles)(const triangle_soa_t *triangles, uint32_t first, uint32_t count,
+										v3_t o, v3_t d, float min_t, float *t, v3_t *uvw);
+
+	// How many lanes of a ray_packet_t the ray_packet_* kernels use, 4 for SSE2 and 8 from AVX2 up. The active
+	// masks they take and return have a bit per lane.
+	uint32_t ray_packet_width;
+
+	// The slab test of ray_intersect_rect3_bvh for each active ray, with the ray's t as max_t. Returns the active
+	// rays that hit the box.
+	uint32_t (*ray_packet_intersect_box)(const ray_packet_t *packet, uint32_t active, rect3_t box);
+
+	// Tests each active ray against triangles [first, first + count) the same way ray_intersect_triangles does,
+	// and updates the hits of the rays that found a nearer one. Returns those rays.
+	uint32_t (*ray_packet_intersect_triangles)(const triangle_soa_t *triangles, uint32_t first, uint32_t count,
+											   ray_packet_t *packet, uint32_t active);
+} simd_kernels_t;
+
+fn const simd_kernels_t *simd_kernels         (void);
+fn const simd_kernels_t *simd_kernels_for_tier(simd_tier_t tier); // NULL if the CPU doesn't support the tier
+fn simd_tier_t           simd_select_tier     (simd_tier_t tier); // clamped to what the CPU supports, returns the tier that got selected
@@ -2,76 +2,442 @@
 // Copyright 2024 by Daniël Cornelisse, All Rights Reserved.
 // ============================================================
 
-void radix_sort_u32(uint32_t *array, size_t count)
+//
+// radix sort
+//
+
+// Least significant digit first, one byte per pass. Before the first pass one read over the keys counts
+// the digits of every pass at once. A pass where all keys have the same digit wouldn't move anything, so
+// it's skipped: keys that only use their low bytes, or that share their high bytes, cost a pass per byte
+// that actually differs.
+
+typedef struct radix_digit_counts_t
+{
+	size_t counts[256];
+} radix_digit_counts_t;
+
+fn_local uint8_t radix_digit(const void *keys, size_t key_size, size_t index, size_t digit)
+{
+	uint64_t key = key_size == sizeof(uint32_t) ? ((const uint32_t *)keys)[index] : ((const uint64_t *)keys)[index];
+	return (uint8_t)(key >> 8*digit);
+}
+
+// counts every digit of keys [first, one_past_last) into digits[0 .. key_size)
+fn_local void radix_count_digits(const void *keys, size_t key_size, size_t first, size_t one_past_last, radix_digit_counts_t *digits)
+{
+	if (key_size == sizeof(uint32_t))
+	{
+		const uint32_t *src = keys;
+
+		for (size_t i = first; i < one_past_last; i++)
+		{
+			uint32_t key = src[i];
+
+			for (size_t digit = 0; digit < sizeof(uint32_t); digit++)
+			{
+				digits[digit].counts[(uint8_t)(key >> 8*digit)]++;
+			}
+		}
+	}
+	else
+	{
+		const uint64_t *src = keys;
+
+		for (size_t i = first; i < one_past_last; i++)
+		{
+			uint64_t key = src[i];
+
+			for (size_t digit = 0; digit < sizeof(uint64_t); digit++)
+			{
+				digits[digit].counts[(uint8_t)(key >> 8*digit)]++;
+			}
+		}
+	}
+}
+
+fn_local void radix_count_digit(const void *keys, size_t key_size, size_t first, size_t one_past_last, size_t digit, radix_digit_counts_t *counts)
+{
+	zero_struct(counts);
+
+	if (key_size == sizeof(uint32_t))
+	{
+		const uint32_t *src = keys;
+
+		for (size_t i = first; i < one_past_last; i++)
+		{
+			counts->counts[(uint8_t)(src[i] >> 8*digit)]++;
+		}
+	}
+	else
+	{
+		const uint64_t *src = keys;
+
+		for (size_t i = first; i < one_past_last; i++)
+		{
+			counts->counts[(uint8_t)(src[i] >> 8*digit)]++;
+		}
+	}
+}
+
+// offsets holds where the first key of each digit value goes, and gets advanced past the keys written
+fn_local void radix_scatter(const void *keys, void *dst, size_t key_size, size_t first, size_t one_past_last, size_t digit, radix_digit_counts_t *offsets)
+{
+	if (key_size == sizeof(uint32_t))
+	{
+		const uint32_t *src = keys;
+		uint32_t       *out = dst;
+
+		for (size_t i = first; i < one_past_last; i++)
+		{
+			uint32_t key = src[i];
+			out[offsets->counts[(uint8_t)(key >> 8*digit)]++] = key;
+		}
+	}
+	else
+	{
+		const uint64_t *src = keys;
+		uint64_t       *out = dst;
+
+		for (size_t i = first; i < one_past_last; i++)
+		{
+			uint64_t key = src[i];
+			out[offsets->counts[(uint8_t)(key >> 8*digit)]++] = key;
+		}
+	}
+}
+
+fn_local void radix_offsets_from_counts(radix_digit_counts_t *digit)
 {
-    m_scoped_temp
-    {
-        uint32_t *src = array;
-        uint32_t *dst = m_alloc_array_nozero(temp, count, uint32_t);
+	size_t total = 0;
+	for (size_t i = 0; i < 256; i++)
+	{
+		size_t piece_count = digit->counts[i];
+		digit->counts[i] = total;
+		total += piece_count;
+	}
+}
 
-        for (int byte_index = 0; byte_index < 4; byte_index++)
-        {
-            uint32_t offsets[256] = { 0 };
+fn_local void radix_sort_internal(void *array, size_t count, size_t key_size)
+{
+	if (count <= 1)
+	{
+		return;
+	}
+
+	m_scoped_temp
+	{
+		radix_digit_counts_t *digits = m_alloc_array(temp, key_size, radix_digit_counts_t);
+		radix_count_digits(array, key_size, 0, count, digits);
 
-            for (size_t i = 0; i < count; i++)
-            {
-                unsigned char radix_piece = (unsigned char)(src[i] >> 8*byte_index);
-                offsets[radix_piece]++;
-            }
+		char *src = array;
+		char *dst = NULL;
 
-            uint32_t total = 0;
-            for (size_t i = 0; i < ARRAY_COUNT(offsets); i++)
-            {
-                uint32_t piece_count = offsets[i];
-                offsets[i] = total;
-                total += piece_count;
-            }
+		for (size_t digit = 0; digit < key_size; digit++)
+		{
+			radix_digit_counts_t *offsets = &digits[digit];
 
-            for (size_t i = 0; i < count; i++)
-            {
-                unsigned char radix_piece = (unsigned char)(src[i] >> 8*byte_index);
-                dst[offsets[radix_piece]++] = src[i];
-            }
+			if (offsets->counts[radix_digit(src, key_size, 0, digit)] == count)
+			{
+				continue;
+			}
 
-            SWAP(uint32_t *, dst, src);
-        }
-    }
+			if (!dst)
+			{
+				dst = m_alloc_nozero(temp, count*key_size, 64);
+			}
+
+			radix_offsets_from_counts(offsets);
+
+			radix_scatter(src, dst, key_size, 0, count, digit, offsets);
+
+			SWAP(char *, dst, src);
+		}
+
+		if (src != array)
+		{
+			copy_memory(array, src, count*key_size);
+		}
+	}
+}
+
+void radix_sort_u32(uint32_t *array, size_t count)
+{
+	radix_sort_internal(array, count, sizeof(uint32_t));
 }
 
 void radix_sort_u64(uint64_t *array, size_t count)
 {
-    m_scoped_temp
-    {
-        uint64_t *src = array;
-        uint64_t *dst = m_alloc_array_nozero(temp, count, uint64_t);
-
-        for (int byte_index = 0; byte_index < sizeof(*array); byte_index++)
-        {
-            size_t offsets[256] = { 0 };
-
-            for (size_t i = 0; i < count; i++)
-            {
-                unsigned char radix_piece = (unsigned char)(src[i] >> 8*byte_index);
-                offsets[radix_piece]++;
-            }
-
-            uint64_t total = 0;
-            for (size_t i = 0; i < ARRAY_COUNT(offsets); i++)
-            {
-                uint64_t piece_count = offsets[i];
-                offsets[i] = total;
-                total += piece_count;
-            }
-
-            for (size_t i = 0; i < count; i++)
-            {
-                unsigned char radix_piece = (unsigned char)(src[i] >> 8*byte_index);
-                dst[offsets[radix_piece]++] = src[i];
-            }
-
-            SWAP(uint64_t *, dst, src);
-        }
-    }
+	radix_sort_internal(array, count, sizeof(uint64_t));
+}
+
+//
+// radix sort with payloads
+//
+
+fn_local void radix_scatter_with_payload(const uint64_t *keys, const uint32_t *payloads, uint64_t *dst_keys, uint32_t *dst_payloads,
+										 size_t count, size_t digit, radix_digit_counts_t *offsets)
+{
+	for (size_t i = 0; i < count; i++)
+	{
+		uint64_t key    = keys[i];
+		size_t   offset = offsets->counts[(uint8_t)(key >> 8*digit)]++;
+
+		dst_keys    [offset] = key;
+		dst_payloads[offset] = payloads[i];
+	}
+}
+
+void radix_sort_u64_with_payload(uint64_t *keys, uint32_t *payloads, size_t count)
+{
+	if (count <= 1)
+	{
+		return;
+	}
+
+	m_scoped_temp
+	{
+		radix_digit_counts_t *digits = m_alloc_array(temp, sizeof(uint64_t), radix_digit_counts_t);
+		radix_count_digits(keys, sizeof(uint64_t), 0, count, digits);
+
+		uint64_t *src_keys     = keys;
+		uint32_t *src_payloads = payloads;
+		uint64_t *dst_keys     = NULL;
+		uint32_t *dst_payloads = NULL;
+
+		for (size_t digit = 0; digit < sizeof(uint64_t); digit++)
+		{
+			radix_digit_counts_t *offsets = &digits[digit];
+
+			if (offsets->counts[(uint8_t)(src_keys[0] >> 8*digit)] == count)
+			{
+				continue;
+			}
+
+			if (!dst_keys)
+			{
+				dst_keys     = m_alloc_nozero(temp, count*sizeof(uint64_t), 64);
+				dst_payloads = m_alloc_nozero(temp, count*sizeof(uint32_t), 64);
+			}
+
+			radix_offsets_from_counts(offsets);
+
+			radix_scatter_with_payload(src_keys, src_payloads, dst_keys, dst_payloads, count, digit, offsets);
+
+			SWAP(uint64_t *, dst_keys,     src_keys);
+			SWAP(uint32_t *, dst_payloads, src_payloads);
+		}
+
+		if (src_keys != keys)
+		{
+			copy_array(keys,     src_keys,     count);
+			copy_array(payloads, src_payloads, count);
+		}
+	}
+}
+
+void radix_sort_u64_permutation(const uint64_t *keys, uint32_t *permutation, size_t count)
+{
+	ASSERT(count <= UINT32_MAX);
+
+	for (size_t i = 0; i < count; i++)
+	{
+		permutation[i] = (uint32_t)i;
+	}
+
+	m_scoped_temp
+	{
+		uint64_t *sorted_keys = m_copy_array(temp, keys, count);
+		radix_sort_u64_with_payload(sorted_keys, permutation, count);
+	}
+}
+
+//
+// parallel radix sort
+//
+
+// The keys are cut into one block per thread. Every pass, each block counts its own digits, then one thread
+// turns the counts into offsets - digit value major, block minor - and each block scatters its keys to its own
+// offsets. Blocks write to disjoint ranges and keep their keys in order, so the sort stays stable and the result
+// is the same as the serial sort's no matter how many threads took part.
+
+typedef struct radix_sort_parallel_t
+{
+	size_t key_size;
+	size_t count;
+	size_t block_count;
+	size_t block_size;
+
+	size_t digit;
+	char  *src;
+	char  *dst;
+
+	radix_digit_counts_t *block_digits; // block_count*key_size, block major
+} radix_sort_parallel_t;
+
+fn_local void radix_block_range(radix_sort_parallel_t *sort, size_t block, size_t *first, size_t *one_past_last)
+{
+	*first         = block*sort->block_size;
+	*one_past_last = MIN(*first + sort->block_size, sort->count);
+}
+
+fn_local void radix_count_digits_proc(job_context_t *context, void *userdata, size_t first_block, size_t one_past_last_block)
+{
+	(void)context;
+
+	radix_sort_parallel_t *sort = userdata;
+
+	for (size_t block = first_block; block < one_past_last_block; block++)
+	{
+		size_t first, one_past_last;
+		radix_block_range(sort, block, &first, &one_past_last);
+
+		radix_count_digits(sort->src, sort->key_size, first, one_past_last, &sort->block_digits[block*sort->key_size]);
+	}
+}
+
+fn_local void radix_count_digit_proc(job_context_t *context, void *userdata, size_t first_block, size_t one_past_last_block)
+{
+	(void)context;
+
+	radix_sort_parallel_t *sort = userdata;
+
+	for (size_t block = first_block; block < one_past_last_block; block++)
+	{
+		size_t first, one_past_last;
+		radix_block_range(sort, block, &first, &one_past_last);
+
+		radix_count_digit(sort->src, sort->key_size, first, one_past_last, sort->digit, &sort->block_digits[block*sort->key_size + sort->digit]);
+	}
+}
+
+fn_local void radix_scatter_proc(job_context_t *context, void *userdata, size_t first_block, size_t one_past_last_block)
+{
+	(void)context;
+
+	radix_sort_parallel_t *sort = userdata;
+
+	for (size_t block = first_block; block < one_past_last_block; block++)
+	{
+		size_t first, one_past_last;
+		radix_block_range(sort, block, &first, &one_past_last);
+
+		radix_scatter(sort->src, sort->dst, sort->key_size, first, one_past_last, sort->digit, &sort->block_digits[block*sort->key_size + sort->digit]);
+	}
+}
+
+fn_local void radix_copy_proc(job_context_t *context, void *userdata, size_t first_block, size_t one_past_last_block)
+{
+	(void)context;
+
+	radix_sort_parallel_t *sort = userdata;
+
+	for (size_t block = first_block; block < one_past_last_block; block++)
+	{
+		size_t first, one_past_last;
+		radix_block_range(sort, block, &first, &one_past_last);
+
+		copy_memory(sort->dst + first*sort->key_size, sort->src + first*sort->key_size, (one_past_last - first)*sort->key_size);
+	}
+}
+
+fn_local void radix_sort_parallel_internal(job_queue_t queue, void *array, size_t count, size_t key_size)
+{
+	// the calling thread helps out while it waits, so it gets a block too
+	size_t thread_count = get_job_queue_thread_count(queue) + 1;
+	size_t block_count  = MIN(thread_count, count / RADIX_SORT_PARALLEL_MIN_BLOCK_SIZE);
+
+	block_count = MIN(block_count, RADIX_SORT_PARALLEL_MAX_BLOCKS);
+
+	if (block_count <= 1)
+	{
+		radix_sort_internal(array, count, key_size);
+		return;
+	}
+
+	m_scoped_temp
+	{
+		radix_sort_parallel_t sort = {
+			.key_size     = key_size,
+			.count        = count,
+			.block_count  = block_count,
+			.block_size   = (count + block_count - 1) / block_count,
+			.src          = array,
+			.block_digits = m_alloc_array(temp, block_count*key_size, radix_digit_counts_t),
+		};
+
+		parallel_for(queue, block_count, 1, radix_count_digits_proc, &sort);
+
+		// the counts of the whole array decide which passes get skipped, they don't change between passes
+		radix_digit_counts_t *digits = m_alloc_array(temp, key_size, radix_digit_counts_t);
+
+		for (size_t block = 0; block < block_count; block++)
+		{
+			for (size_t digit = 0; digit < key_size; digit++)
+			{
+				for (size_t i = 0; i < 256; i++)
+				{
+					digits[digit].counts[i] += sort.block_digits[block*key_size + digit].counts[i];
+				}
+			}
+		}
+
+		bool counts_are_current = true; // the first pass can use the counts made above, later passes recount
+
+		for (size_t digit = 0; digit < key_size; digit++)
+		{
+			if (digits[digit].counts[radix_digit(sort.src, key_size, 0, digit)] == count)
+			{
+				continue;
+			}
+
+			if (!sort.dst)
+			{
+				sort.dst = m_alloc_nozero(temp, count*key_size, 64);
+			}
+
+			sort.digit = digit;
+
+			if (!counts_are_current)
+			{
+				parallel_for(queue, block_count, 1, radix_count_digit_proc, &sort);
+			}
+
+			counts_are_current = false;
+
+			size_t total = 0;
+			for (size_t i = 0; i < 256; i++)
+			{
+				for (size_t block = 0; block < block_count; block++)
+				{
+					radix_digit_counts_t *offsets = &sort.block_digits[block*key_size + digit];
+
+					size_t piece_count = offsets->counts[i];
+					offsets->counts[i] = total;
+					total += piece_count;
+				}
+			}
+
+			parallel_for(queue, block_count, 1, radix_scatter_proc, &sort);
+
+			SWAP(char *, sort.dst, sort.src);
+		}
+
+		if (sort.src != array)
+		{
+			sort.dst = array;
+			parallel_for(queue, block_count, 1, radix_copy_proc, &sort);
+		}
+	}
+}
+
+void radix_sort_u32_parallel(job_queue_t queue, uint32_t *array, size_t count)
+{
+	radix_sort_parallel_internal(queue, array, count, sizeof(uint32_t));
+}
+
+void radix_sort_u64_parallel(job_queue_t queue, uint64_t *array, size_t count)
+{
+	radix_sort_parallel_internal(queue, array, count, sizeof(uint64_t));
 }
 
 void radix_sort_keys(sort_key_t *array, size_t count)
@@ -4,16 +4,34 @@
 
 #pragma once
 
+typedef struct job_queue_t job_queue_t;
+
 typedef struct sort_key_t
 {
 	uint32_t index;
 	uint32_t key;
 } sort_key_t;
 
+// Stable. Bytes that are the same in every key are skipped, so a sort costs one pass per byte that differs.
 fn void radix_sort_u32 (uint32_t   *array, size_t size);
 fn void radix_sort_u64 (uint64_t   *array, size_t size);
 fn void radix_sort_keys(sort_key_t *array, size_t size);
 
+// Sorts keys and moves payloads[i] along with keys[i], so there's no need to squeeze an index into the low bits
+// of the key. Stable: payloads of equal keys stay in the order they came in.
+fn void radix_sort_u64_with_payload(uint64_t *keys, uint32_t *payloads, size_t size);
+// Leaves keys alone and writes the order that sorts them instead: keys[permutation[0]] <= keys[permutation[1]] <= ...
+// Stable, so equal keys come out in index order.
+fn void radix_sort_u64_permutation(const uint64_t *keys, uint32_t *permutation, size_t size);
+
+// Same result as radix_sort_u32 and radix_sort_u64, with counting and scattering split over the queue's threads. Blocks until done,
+// helping out with jobs from the queue in the meantime. Arrays too small to be worth it get sorted serially.
+#define RADIX_SORT_PARALLEL_MIN_BLOCK_SIZE (1 << 15)
+#define RADIX_SORT_PARALLEL_MAX_BLOCKS     64
+
+fn void radix_sort_u32_parallel(job_queue_t queue, uint32_t *array, size_t size);
+fn void radix_sort_u64_parallel(job_queue_t queue, uint64_t *array, size_t size);
+
 typedef int (*comparison_function_t)(const void *l, const void *r, void *user_data);
 
 fn void merge_sort(void *array, size_t count, size_t element_size, comparison_function_t func, void *user_data);
@@ -431,15 +431,18 @@ string_t string_split_word(string_t *string)
 {
     string_t result = *string;
 
-    for (size_t i = 0; i < string->count; i++)
+    // if there's no whitespace, the whole string is the last word
+    string_skip(string, string->count);
+
+    for (size_t i = 0; i < result.count; i++)
     {
-        if (string->data[i] == ' '  ||
-            string->data[i] == '\n' ||
-            string->data[i] == '\r' ||
-            string->data[i] == '\t')
+        if (result.data[i] == ' '  ||
+            result.data[i] == '\n' ||
+            result.data[i] == '\r' ||
+            result.data[i] == '\t')
         {
-            result = substring(*string, 0, i);
-            string_skip(string, i + 1);
+            *string = substring(result, i + 1, result.count);
+            result  = substring(result, 0, i);
 
             break;
         }
@@ -603,7 +606,7 @@ parse_float_result_t string_parse_float(string_t string)
 	{
 		char *null_terminated = string_null_terminate(temp, string).data;
 
-		const char *strtod_end = NULL;
+		char *strtod_end = NULL;
 		result.value = (float)strtod(null_terminated, &strtod_end);
 
 		result.is_valid = strtod_end != null_terminated;
@@ -793,4 +796,190 @@ string_t string_format_human_readable_bytes(arena_t *arena, uint64_t bytes)
     }
 
     return string;
-}
\ No newline at end of file
+}
+
+//
+// atoms
+//
+
+typedef struct atom_entry_t
+{
+	char    *data;
+	uint32_t count;
+	atom_t   next; // next atom with the same string hash, these are rare enough to not be worth a better answer
+	uint64_t hash;
+} atom_entry_t;
+
+global struct
+{
+	mutex_t            mutex;  // held while interning new strings
+	concurrent_table_t table;  // string hash -> first atom with that hash
+	arena_t            arena;  // string data and entry chunks
+
+	atomic uint32_t count;     // including the null atom
+	size_t          string_bytes;
+
+	_Atomic(atom_entry_t *) chunks[ATOM_MAX_CHUNKS];
+} g_atoms;
+
+fn_local atom_entry_t *atom_get_entry(atom_t atom)
+{
+	atom_entry_t *chunk = atomic_load_explicit(&g_atoms.chunks[atom.value >> ATOM_CHUNK_SIZE_LOG2], memory_order_acquire);
+	return &chunk[atom.value & (ATOM_CHUNK_SIZE - 1)];
+}
+
+// key 0 is reserved by the concurrent table
+fn_local uint64_t atom_table_key(uint64_t hash)
+{
+	return hash ? hash : 1;
+}
+
+fn_local atom_t atom_find_with_hash(string_t string, uint64_t hash)
+{
+	atom_t result = {0};
+
+	uint64_t first;
+	if (concurrent_table_find(&g_atoms.table, atom_table_key(hash), &first))
+	{
+		for (atom_t atom = { (uint32_t)first }; atom.value; )
+		{
+			atom_entry_t *entry = atom_get_entry(atom);
+
+			if (entry->hash == hash && string_match(string, (string_t){ .data = entry->data, .count = entry->count }))
+			{
+				result = atom;
+				break;
+			}
+
+			atom = entry->next;
+		}
+	}
+
+	return result;
+}
+
+atom_t atom_find(string_t string)
+{
+	atom_t result = {0};
+
+	if (string.count > 0)
+	{
+		result = atom_find_with_hash(string, string_hash(string));
+	}
+
+	return result;
+}
+
+atom_t atom_from_string(string_t string)
+{
+	if (string.count == 0)
+		return (atom_t){0};
+
+	uint64_t hash = string_hash(string);
+
+	atom_t result = atom_find_with_hash(string, hash);
+
+	if (!result.value)
+	{
+		mutex_scoped_lock(&g_atoms.mutex)
+		{
+			// someone else might have interned it between the lookup and taking the lock
+			result = atom_find_with_hash(string, hash);
+
+			if (!result.value)
+			{
+				uint32_t index = atomic_load_explicit(&g_atoms.count, memory_order_relaxed);
+
+				if (index == 0)
+				{
+					m_register_arena(&g_atoms.arena, S("atoms"));
+					index = 1;
+				}
+
+				uint32_t chunk_index = index >> ATOM_CHUNK_SIZE_LOG2;
+				ASSERT_MSG(chunk_index < ATOM_MAX_CHUNKS, "Ran out of atoms");
+
+				if (!g_atoms.chunks[chunk_index])
+				{
+					atom_entry_t *chunk = m_alloc_array_nozero(&g_atoms.arena, ATOM_CHUNK_SIZE, atom_entry_t);
+					atomic_store_explicit(&g_atoms.chunks[chunk_index], chunk, memory_order_release);
+				}
+
+				result.value = index;
+
+				uint64_t first = 0;
+				concurrent_table_find(&g_atoms.table, atom_table_key(hash), &first);
+
+				atom_entry_t *entry = atom_get_entry(result);
+				entry->data  = string_null_terminate(&g_atoms.arena, string).data;
+				entry->count = (uint32_t)string.count;
+				entry->next  = (atom_t){ (uint32_t)first };
+				entry->hash  = hash;
+
+				// the concurrent table publishes the entry, a reader that finds the atom there also sees the entry
+				concurrent_table_insert(&g_atoms.table, atom_table_key(hash), result.value);
+
+				g_atoms.string_bytes += string.count;
+				atomic_store_explicit(&g_atoms.count, index + 1, memory_order_release);
+			}
+		}
+	}
+
+	return result;
+}
+
+string_t string_from_atom(atom_t atom)
+{
+	string_t result = S("");
+
+	if (atom.value)
+	{
+		DEBUG_ASSERT(atom.value < atomic_load_explicit(&g_atoms.count, memory_order_relaxed));
+
+		atom_entry_t *entry = atom_get_entry(atom);
+		result = (string_t){ .data = entry->data, .count = entry->count };
+	}
+
+	return result;
+}
+
+uint64_t atom_hash(atom_t atom)
+{
+	uint64_t result = string_hash(S(""));
+
+	if (atom.value)
+	{
+		result = atom_get_entry(atom)->hash;
+	}
+
+	return result;
+}
+
+atom_t atom_cached(atom_cache_t *cache, string_t string)
+{
+	atom_t result = { atomic_load_explicit(&cache->value, memory_order_acquire) };
+
+	if (!result.value)
+	{
+		result = atom_from_string(string);
+		atomic_store_explicit(&cache->value, result.value, memory_order_release);
+	}
+
+	return result;
+}
+
+atom_stats_t atom_get_stats(void)
+{
+	atom_stats_t result = {0};
+
+	mutex_scoped_lock(&g_atoms.mutex)
+	{
+		uint32_t count = atomic_load_explicit(&g_atoms.count, memory_order_relaxed);
+
+		result.count         = count ? count - 1 : 0;
+		result.string_bytes  = g_atoms.string_bytes;
+		result.storage_bytes = m_size_used(&g_atoms.arena);
+	}
+
+	return result;
+}
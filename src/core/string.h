@@ -146,4 +146,54 @@ typedef struct string_storage_overlay_t
 fn void string_storage_append_impl(string_storage_overlay_t *storage, size_t capacity, string_t string);
 #define string_storage_append(storage, string) (string_storage_append_impl((string_storage_overlay_t *)(storage), ARRAY_COUNT((storage)->data), string))
 
-fn string_t string_format_human_readable_bytes(arena_t *arena, uint64_t bytes);
\ No newline at end of file
+fn string_t string_format_human_readable_bytes(arena_t *arena, uint64_t bytes);
+
+//
+// Interned strings. Every unique string gets a 32-bit atom that stays the same for the lifetime of the
+// program, so strings that get looked up by name over and over can be stored and compared as integers.
+// Interning takes a lock when the string is new, finding an existing atom or the string behind an atom
+// never does. Interned strings are never freed.
+//
+// The null atom is the empty string.
+//
+
+typedef struct atom_t
+{
+	uint32_t value;
+} atom_t;
+
+#define ATOM_CHUNK_SIZE_LOG2 12
+#define ATOM_CHUNK_SIZE      (1u << ATOM_CHUNK_SIZE_LOG2)
+#define ATOM_MAX_CHUNKS      4096
+
+fn_local bool atom_match(atom_t a, atom_t b)
+{
+	return a.value == b.value;
+}
+
+fn atom_t   atom_from_string(string_t string);
+fn atom_t   atom_find       (string_t string); // returns the null atom if the string was never interned, without interning it
+fn string_t string_from_atom(atom_t atom);     // the string is null terminated
+fn uint64_t atom_hash       (atom_t atom);     // same as string_hash(string_from_atom(atom)), without the hashing
+
+// For string constants on hot paths, so they get interned once instead of hashed on every lookup:
+//
+//     local_persist atom_cache_t classname;
+//     atom_t key = atom_cached(&classname, S("classname"));
+//
+// A zero-initialized cache is empty. Threads racing to fill it intern the same string, so they all get the same atom.
+typedef struct atom_cache_t
+{
+	atomic uint32_t value;
+} atom_cache_t;
+
+fn atom_t atom_cached(atom_cache_t *cache, string_t string);
+
+typedef struct atom_stats_t
+{
+	uint32_t count;
+	size_t   string_bytes;  // characters of all interned strings, excluding null terminators
+	size_t   storage_bytes; // everything the interned strings and their entries take up, not counting the lookup table
+} atom_stats_t;
+
+fn atom_stats_t atom_get_stats(void);
@@ -2,7 +2,83 @@
 // Copyright 2024 by Daniël Cornelisse, All Rights Reserved.
 // ============================================================
 
-// Wait group implementation referenced (more accurately: copied) from Odin's standard library
+//
+// topology
+//
+
+// implemented per platform, fills in logical processors, their cores and whatever cache info the OS has
+fn void detect_cpu_topology(cpu_topology_t *topology);
+
+global cpu_topology_t  g_cpu_topology;
+global atomic uint32_t g_cpu_topology_state; // 0 = not detected, 1 = detecting, 2 = done
+
+const cpu_topology_t *query_cpu_topology(void)
+{
+	uint32_t state = atomic_load(&g_cpu_topology_state);
+
+	if (state != 2)
+	{
+		uint32_t expected = 0;
+
+		if (atomic_compare_exchange_strong(&g_cpu_topology_state, &expected, 1))
+		{
+			cpu_topology_t *topology = &g_cpu_topology;
+			detect_cpu_topology(topology);
+
+			if (topology->logical_processor_count == 0)
+			{
+				// we know nothing, so let's pretend to be a single core
+				topology->logical_processor_count = 1;
+				topology->core_count              = 1;
+			}
+
+			if (topology->l2_group_count == 0)
+			{
+				for (size_t i = 0; i < topology->logical_processor_count; i++)
+				{
+					topology->logical_processors[i].l2_group = topology->logical_processors[i].core;
+				}
+
+				topology->l2_group_count = topology->core_count;
+			}
+
+			if (topology->l3_group_count == 0)
+			{
+				for (size_t i = 0; i < topology->logical_processor_count; i++)
+				{
+					topology->logical_processors[i].l3_group = 0;
+				}
+
+				topology->l3_group_count = 1;
+			}
+
+			atomic_store(&g_cpu_topology_state, 2);
+		}
+		else
+		{
+			while (atomic_load(&g_cpu_topology_state) != 2)
+			{
+				_mm_pause();
+			}
+		}
+	}
+
+	return &g_cpu_topology;
+}
+
+size_t query_processor_count(void)
+{
+	return query_cpu_topology()->core_count;
+}
+
+//
+// wait group
+//
+
+// Wait group implementation originally referenced (more accurately: copied) from Odin's standard library,
+// since extended with continuations for the job queue.
+
+fn_local void job_submit_continuations(job_continuation_t *first);
 
 void wait_group_add(wait_group_t *group, int64_t delta)
 {
@@ -11,26 +87,41 @@ void wait_group_add(wait_group_t *group, int64_t delta)
 		return;
 	}
 
+	// fast path: as long as the counter doesn't hit zero nobody needs to be woken up
+	int64_t counter = atomic_load_explicit(&group->counter, memory_order_relaxed);
+
+	while (counter + delta > 0)
+	{
+		if (atomic_compare_exchange_weak(&group->counter, &counter, counter + delta))
+		{
+			return;
+		}
+	}
+
+	// the counter only ever reaches zero with the mutex held, so waiters that see it under the mutex
+	// know we're done touching the wait group once they get the mutex back
+	job_continuation_t *continuations = NULL;
+
 	mutex_lock(&group->mutex);
 
-	atomic_add_i64(&group->counter, delta);
+	counter = atomic_fetch_add(&group->counter, delta) + delta;
 
-	if (group->counter < 0)
+	if (counter < 0)
 	{
 		FATAL_ERROR("Wait group counter went negative!");
 	}
 
-	if (group->counter == 0)
+	if (counter == 0)
 	{
-		cond_wake_all(&group->cond);
+		continuations = group->first_continuation;
+		group->first_continuation = NULL;
 
-		if (group->counter != 0)
-		{
-			FATAL_ERROR("Wait group misuse: wait_group_add called concurrently with wait_group_wait");
-		}
+		cond_wake_all(&group->cond);
 	}
 
 	mutex_unlock(&group->mutex);
+
+	job_submit_continuations(continuations);
 }
 
 void wait_group_done(wait_group_t *group)
@@ -42,13 +133,1921 @@ void wait_group_wait(wait_group_t *group)
 {
 	mutex_lock(&group->mutex);
 
-	if (group->counter != 0)
+	while (atomic_load(&group->counter) != 0)
 	{
 		cond_sleep(&group->cond, &group->mutex);
+	}
+
+	mutex_unlock(&group->mutex);
+}
+
+bool wait_group_is_done(wait_group_t *group)
+{
+	bool result = (atomic_load(&group->counter) == 0);
+
+	if (result)
+	{
+		// whoever brought the counter to zero may still be holding the mutex
+		mutex_lock(&group->mutex);
+		mutex_unlock(&group->mutex);
+	}
+
+	return result;
+}
+
+//
+// job queue
+//
+
+typedef struct job_queue_entry_t
+{
+    job_proc_t proc;
+
+	wait_group_t   *signal;
+	cancel_token_t *cancel_token;
+
+	job_priority_t priority; // never JobPriority_inherit, that's resolved when the job is added
+	bool           userdata_is_ptr;
+
+	union
+	{
+		char  userdata_u8[64];
+		void *userdata_ptr;
+	};
+} job_queue_entry_t;
+
+// A slot in the submission ring. The sequence number says whose turn it is: a slot at ring position pos
+// is free for the producer that claimed pos when sequence == pos, holds a published entry when
+// sequence == pos + 1, and is handed to the producer of the next lap (pos + queue_size) once the consumer
+// is done copying the entry out.
+typedef struct job_submit_slot_t
+{
+	atomic uint32_t   sequence;
+	job_queue_entry_t entry;
+} job_submit_slot_t;
+
+// Chase-Lev work-stealing deque. Only the owning worker pushes and pops at the bottom, any thread
+// may steal from the top. See "Correct and Efficient Work-Stealing for Weak Memory Models" (Lê et al.)
+typedef struct job_deque_t
+{
+	alignas(CACHE_LINE_SIZE) atomic int64_t top;
+	alignas(CACHE_LINE_SIZE) atomic int64_t bottom;
+	alignas(CACHE_LINE_SIZE)
+
+	int64_t            mask;
+	job_queue_entry_t *entries;
+} job_deque_t;
+
+typedef enum job_fiber_switch_t
+{
+	JobFiberSwitch_done,  // the job finished, the fiber can go back in the pool
+	JobFiberSwitch_yield, // the job wants to be resumed as soon as possible
+	JobFiberSwitch_wait,  // the job wants to be resumed once wait_group is done
+} job_fiber_switch_t;
+
+// a fiber from the queue's pool, running a job on behalf of whichever worker switched to it last
+typedef struct job_fiber_t
+{
+	struct job_fiber_t *next; // free list or ready list
+
+	fiber_t fiber;
+
+	struct job_queue_internal_t *queue;
+	struct job_worker_t         *worker;
+
+	job_queue_entry_t  entry;
+	job_context_t      job_context;
+	job_context_t     *context; // points at job_context while a job is running (or suspended) on the fiber
+
+	job_fiber_switch_t switch_reason;
+	wait_group_t      *wait_group;
+
+	temp_arenas_t temp_arenas; // swapped in while the fiber runs, so temp memory survives resuming on another thread
+} job_fiber_t;
+
+// a job or suspended fiber held back until a wait group is done
+struct job_continuation_t
+{
+	job_continuation_t *next;
+
+	struct job_queue_internal_t *queue;
+	job_fiber_t                 *fiber; // if set, this fiber gets resumed instead of adding the entry
+	job_queue_entry_t            entry;
+};
+
+enum { JOB_PRIORITY_LEVEL_COUNT = JobPriority_COUNT - JobPriority_high };
+
+fn_local uint32_t job_priority_level(job_priority_t priority)
+{
+	ASSERT(priority >= JobPriority_high && priority < JobPriority_COUNT);
+	return (uint32_t)(priority - JobPriority_high);
+}
+
+typedef struct job_worker_t
+{
+	job_deque_t deques[JOB_PRIORITY_LEVEL_COUNT]; // one per priority, highest first
+
+	struct job_queue_internal_t *queue;
+
+	thread_t        thread;
+	fiber_t         thread_fiber; // the fiber the worker thread was converted to, for queues with fibers
+	random_series_t entropy;
+	int             thread_index;
+	int32_t         affinity;     // logical processor to pin to, or -1
+} job_worker_t;
+
+// the submission ring and pending count for one priority
+typedef struct job_priority_queue_t
+{
+	// submission ring for jobs added by threads that aren't workers of this queue.
+	// any number of producers claim ranges of slots, workers consume from it in batches.
+	alignas(CACHE_LINE_SIZE) atomic uint32_t submit_read;
+	alignas(CACHE_LINE_SIZE) atomic uint32_t submit_write;
+
+	alignas(CACHE_LINE_SIZE) atomic int64_t  jobs_pending; // added, but not yet picked up to run
+	alignas(CACHE_LINE_SIZE)
+
+    job_submit_slot_t *submit_slots;
+} job_priority_queue_t;
+
+typedef struct job_queue_internal_t
+{
+	job_priority_queue_t priorities[JOB_PRIORITY_LEVEL_COUNT]; // highest first
+
+	alignas(CACHE_LINE_SIZE) atomic uint32_t jobs_in_flight; // added, but not yet finished running
+
+	alignas(CACHE_LINE_SIZE) atomic uint32_t wake_counter;
+	alignas(CACHE_LINE_SIZE) atomic uint32_t sleeper_count;
+	alignas(CACHE_LINE_SIZE) atomic bool     stop;
+	alignas(CACHE_LINE_SIZE) atomic bool     external_helper; // a non-worker thread is running jobs as thread_count
+	                         atomic uint32_t external_help_waiters; // threads in wait_on_queue sleeping until external_helper is released
+	alignas(CACHE_LINE_SIZE)
+
+    arena_t arena;
+
+    size_t        thread_count;
+	job_worker_t *workers;
+
+	char name[32]; // for naming threads in traces
+	bool named;    // given a name at creation, as opposed to a numbered throwaway queue
+
+    uint32_t queue_size;
+
+	mutex_t             continuation_mutex;
+	job_continuation_t *first_free_continuation;
+
+	size_t       fiber_count;
+	job_fiber_t *fibers;
+
+	mutex_t      fiber_mutex;
+	job_fiber_t *first_free_fiber;
+	job_fiber_t *first_ready_fiber;
+	job_fiber_t *last_ready_fiber;
+} job_queue_internal_t;
+
+enum { JOB_SUBMIT_BATCH_SIZE = 32, JOB_SPIN_COUNT = 64 };
+
+global thread_local job_worker_t *tls_job_worker;
+global thread_local job_fiber_t  *tls_job_fiber; // the fiber the current job is running on, if any
+global thread_local int           tls_job_submit_help_depth; // see job_queue_submit_entries
+global thread_local job_context_t *tls_job_context;           // the job running on this thread, for inheriting its priority and cancel token
+global thread_local job_queue_internal_t *tls_job_external_help_queue; // the queue this thread holds the external_helper slot of
+
+//
+// tracing
+//
+
+typedef enum job_trace_event_kind_t
+{
+	JobTraceEvent_job_begin,
+	JobTraceEvent_job_end,
+	JobTraceEvent_job_cancelled,
+	JobTraceEvent_steal,
+	JobTraceEvent_sleep_begin,
+	JobTraceEvent_sleep_end,
+	JobTraceEvent_wake,
+} job_trace_event_kind_t;
+
+typedef struct job_trace_event_t
+{
+	uint64_t   timestamp; // read_cpu_timer
+	job_proc_t proc;      // for job begin/end/cancelled
+	uint32_t   kind;
+	uint32_t   arg;       // steal: victim thread index, job begin/end: whether the job was resumed/suspended on a fiber
+} job_trace_event_t;
+
+enum { JOB_TRACE_EVENT_CAPACITY = 1 << 16 };
+
+// Every thread that records events gets its own ring buffer, so recording doesn't need any synchronization.
+// Buffers are never freed: when a worker thread exits its buffer is up for grabs for the next thread that
+// starts recording, which throws away the old events.
+typedef struct job_trace_buffer_t
+{
+	struct job_trace_buffer_t *next;
+
+	bool     in_use;
+	uint32_t thread_id;
+	char     thread_name[64];
+
+	atomic uint64_t   write;
+	job_trace_event_t events[JOB_TRACE_EVENT_CAPACITY];
+} job_trace_buffer_t;
+
+global atomic bool     g_job_tracing;
+global atomic uint32_t g_job_trace_recorders_in_flight;
+
+global struct
+{
+	mutex_t             mutex;
+	arena_t             arena;
+	job_trace_buffer_t *first_buffer;
+	uint32_t            next_thread_id;
+	uint64_t            cpu_timer_frequency;
+} g_job_trace;
+
+global thread_local job_trace_buffer_t *tls_job_trace_buffer;
+global thread_local char                tls_job_trace_thread_name[64];
+
+fn_local job_trace_buffer_t *job_trace_claim_buffer(void)
+{
+	job_trace_buffer_t *result = NULL;
+
+	mutex_scoped_lock(&g_job_trace.mutex)
+	{
+		for (job_trace_buffer_t *buffer = g_job_trace.first_buffer; buffer; buffer = buffer->next)
+		{
+			if (!buffer->in_use)
+			{
+				result = buffer;
+				break;
+			}
+		}
+
+		if (!result)
+		{
+			result = m_alloc_struct_nozero(&g_job_trace.arena, job_trace_buffer_t);
+			sll_push(g_job_trace.first_buffer, result);
+		}
+
+		result->in_use    = true;
+		result->thread_id = ++g_job_trace.next_thread_id;
+		atomic_store(&result->write, 0);
+
+		if (tls_job_trace_thread_name[0])
+		{
+			copy_memory(result->thread_name, tls_job_trace_thread_name, sizeof(result->thread_name));
+		}
+		else
+		{
+			string_format_into_buffer(result->thread_name, sizeof(result->thread_name), "thread %u", result->thread_id);
+		}
+	}
+
+	return result;
+}
+
+fn_local void job_trace_release_buffer(void)
+{
+	if (tls_job_trace_buffer)
+	{
+		mutex_scoped_lock(&g_job_trace.mutex)
+		{
+			tls_job_trace_buffer->in_use = false;
+		}
+
+		tls_job_trace_buffer = NULL;
+	}
+}
+
+fn_local void job_trace_record(job_trace_event_kind_t kind, job_proc_t proc, uint32_t arg)
+{
+	job_trace_buffer_t *buffer = tls_job_trace_buffer;
+
+	if (!buffer)
+	{
+		buffer = tls_job_trace_buffer = job_trace_claim_buffer();
+	}
+
+	uint64_t write = atomic_load_explicit(&buffer->write, memory_order_relaxed);
+
+	job_trace_event_t *event = &buffer->events[write % JOB_TRACE_EVENT_CAPACITY];
+	event->timestamp = read_cpu_timer();
+	event->proc      = proc;
+	event->kind      = kind;
+	event->arg       = arg;
+
+	atomic_store_explicit(&buffer->write, write + 1, memory_order_release);
+}
+
+// the only cost of tracing while it's off
+fn_local void job_trace(job_trace_event_kind_t kind, job_proc_t proc, uint32_t arg)
+{
+	if (atomic_load_explicit(&g_job_tracing, memory_order_relaxed))
+	{
+		// announce ourselves before looking at the flag again, so that once job_trace_wait_for_recorders
+		// sees no recorders in flight, nobody can still be writing into a buffer
+		atomic_fetch_add(&g_job_trace_recorders_in_flight, 1);
+
+		if (atomic_load(&g_job_tracing))
+		{
+			job_trace_record(kind, proc, arg);
+		}
+
+		atomic_fetch_sub(&g_job_trace_recorders_in_flight, 1);
+	}
+}
+
+// call after clearing g_job_tracing
+fn_local void job_trace_wait_for_recorders(void)
+{
+	while (atomic_load(&g_job_trace_recorders_in_flight) > 0)
+	{
+		_mm_pause();
+	}
+}
+
+void job_tracing_start(void)
+{
+	atomic_store(&g_job_tracing, false);
+	job_trace_wait_for_recorders();
+
+	mutex_scoped_lock(&g_job_trace.mutex)
+	{
+		for (job_trace_buffer_t *buffer = g_job_trace.first_buffer; buffer; buffer = buffer->next)
+		{
+			atomic_store(&buffer->write, 0);
+		}
+	}
+
+	atomic_store(&g_job_tracing, true);
+}
+
+bool job_tracing_stop(string_t path)
+{
+	atomic_store(&g_job_tracing, false);
+	job_trace_wait_for_recorders();
+
+	if (!g_job_trace.cpu_timer_frequency)
+	{
+		g_job_trace.cpu_timer_frequency = os_estimate_cpu_timer_frequency(100);
+	}
+
+	double us_per_tick = 1000000.0 / (double)g_job_trace.cpu_timer_frequency;
+
+	bool result = false;
+
+	mutex_scoped_lock(&g_job_trace.mutex)
+	m_scoped_temp
+	{
+		// timestamps are written relative to the first event, so they stay small enough to read
+		uint64_t first_timestamp = UINT64_MAX;
+
+		for (job_trace_buffer_t *buffer = g_job_trace.first_buffer; buffer; buffer = buffer->next)
+		{
+			uint64_t write = atomic_load(&buffer->write);
+			uint64_t count = MIN(write, JOB_TRACE_EVENT_CAPACITY);
+
+			if (count > 0)
+			{
+				first_timestamp = MIN(first_timestamp, buffer->events[(write - count) % JOB_TRACE_EVENT_CAPACITY].timestamp);
+			}
+		}
+
+		string_list_t list = {0};
+
+		slist_appends(&list, temp, S("{\"traceEvents\":[\n"));
+
+		bool first_event = true;
+
+		for (job_trace_buffer_t *buffer = g_job_trace.first_buffer; buffer; buffer = buffer->next)
+		{
+			uint64_t write = atomic_load(&buffer->write);
+			uint64_t count = MIN(write, JOB_TRACE_EVENT_CAPACITY);
+
+			if (count == 0)
+			{
+				continue;
+			}
+
+			slist_appendf(&list, temp, "%s{\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"name\":\"thread_name\",\"args\":{\"name\":\"%s\"}}",
+						  first_event ? "" : ",\n", buffer->thread_id, buffer->thread_name);
+			first_event = false;
+
+			for (uint64_t i = write - count; i < write; i++)
+			{
+				job_trace_event_t *event = &buffer->events[i % JOB_TRACE_EVENT_CAPACITY];
+
+				double ts = (double)(event->timestamp - first_timestamp)*us_per_tick;
+
+				switch ((job_trace_event_kind_t)event->kind)
+				{
+					case JobTraceEvent_job_begin:
+					case JobTraceEvent_job_end:
+					{
+						// there are no symbols to go by, so jobs are named after the address of their proc
+						slist_appendf(&list, temp, ",\n{\"ph\":\"%s\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"name\":\"job %p\",\"args\":{\"%s\":%s}}",
+									  event->kind == JobTraceEvent_job_begin ? "B" : "E",
+									  buffer->thread_id, ts, (void *)event->proc,
+									  event->kind == JobTraceEvent_job_begin ? "resumed" : "suspended",
+									  event->arg ? "true" : "false");
+					} break;
+
+					case JobTraceEvent_job_cancelled:
+					{
+						slist_appendf(&list, temp, ",\n{\"ph\":\"i\",\"s\":\"t\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"name\":\"cancelled job %p\"}",
+									  buffer->thread_id, ts, (void *)event->proc);
+					} break;
+
+					case JobTraceEvent_sleep_begin:
+					case JobTraceEvent_sleep_end:
+					{
+						slist_appendf(&list, temp, ",\n{\"ph\":\"%s\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"name\":\"sleep\"}",
+									  event->kind == JobTraceEvent_sleep_begin ? "B" : "E", buffer->thread_id, ts);
+					} break;
+
+					case JobTraceEvent_steal:
+					{
+						slist_appendf(&list, temp, ",\n{\"ph\":\"i\",\"s\":\"t\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"name\":\"steal\",\"args\":{\"victim\":%u}}",
+									  buffer->thread_id, ts, event->arg);
+					} break;
+
+					case JobTraceEvent_wake:
+					{
+						slist_appendf(&list, temp, ",\n{\"ph\":\"i\",\"s\":\"t\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"name\":\"wake\"}",
+									  buffer->thread_id, ts);
+					} break;
+				}
+			}
+		}
+
+		slist_appends(&list, temp, S("\n]}\n"));
+
+		result = fs_write_entire_file(path, slist_flatten(&list, temp));
+	}
+
+	return result;
+}
+
+fn_local bool job_deque_push(job_deque_t *deque, const job_queue_entry_t *entry)
+{
+	int64_t b = atomic_load_explicit(&deque->bottom, memory_order_relaxed);
+	int64_t t = atomic_load_explicit(&deque->top,    memory_order_acquire);
+
+	if (b - t > deque->mask)
+	{
+		return false;
+	}
+
+	deque->entries[b & deque->mask] = *entry;
+
+	atomic_thread_fence(memory_order_release);
+	atomic_store_explicit(&deque->bottom, b + 1, memory_order_relaxed);
+
+	return true;
+}
+
+fn_local bool job_deque_pop(job_deque_t *deque, job_queue_entry_t *entry)
+{
+	int64_t b = atomic_load_explicit(&deque->bottom, memory_order_relaxed) - 1;
+	atomic_store_explicit(&deque->bottom, b, memory_order_relaxed);
+
+	atomic_thread_fence(memory_order_seq_cst);
+
+	int64_t t = atomic_load_explicit(&deque->top, memory_order_relaxed);
+
+	bool result = false;
+
+	if (t <= b)
+	{
+		*entry = deque->entries[b & deque->mask];
+		result = true;
+
+		if (t == b)
+		{
+			// last entry, race against thieves for it
+			if (!atomic_compare_exchange_strong_explicit(&deque->top, &t, t + 1, memory_order_seq_cst, memory_order_relaxed))
+			{
+				result = false;
+			}
+
+			atomic_store_explicit(&deque->bottom, b + 1, memory_order_relaxed);
+		}
+	}
+	else
+	{
+		atomic_store_explicit(&deque->bottom, b + 1, memory_order_relaxed);
+	}
+
+	return result;
+}
+
+fn_local bool job_deque_steal(job_deque_t *deque, job_queue_entry_t *entry)
+{
+	int64_t t = atomic_load_explicit(&deque->top, memory_order_acquire);
+
+	atomic_thread_fence(memory_order_seq_cst);
+
+	int64_t b = atomic_load_explicit(&deque->bottom, memory_order_acquire);
+
+	bool result = false;
+
+	if (t < b)
+	{
+		// the copy may race with the owner wrapping around, but then the CAS fails and it is discarded
+		job_queue_entry_t copy = deque->entries[t & deque->mask];
+
+		if (atomic_compare_exchange_strong_explicit(&deque->top, &t, t + 1, memory_order_seq_cst, memory_order_relaxed))
+		{
+			*entry = copy;
+			result = true;
+		}
+	}
+
+	return result;
+}
+
+fn_local bool job_deque_is_empty(job_deque_t *deque)
+{
+	int64_t t = atomic_load_explicit(&deque->top,    memory_order_acquire);
+	int64_t b = atomic_load_explicit(&deque->bottom, memory_order_acquire);
+	return b <= t;
+}
+
+// copies up to max_count entries out of the submission ring, returns how many were taken
+fn_local uint32_t job_queue_take_submitted(job_queue_internal_t *queue, job_priority_queue_t *ring, job_queue_entry_t *entries, uint32_t max_count)
+{
+	uint32_t mask = queue->queue_size - 1;
+
+	uint32_t read  = atomic_load_explicit(&ring->submit_read, memory_order_relaxed);
+	uint32_t count = 0;
+
+	for (;;)
+	{
+		uint32_t write = atomic_load_explicit(&ring->submit_write, memory_order_acquire);
+
+		// only take entries that have been published, producers may still be filling in slots they claimed
+		uint32_t available = MIN(write - read, max_count);
+
+		for (count = 0; count < available; count++)
+		{
+			uint32_t pos = read + count;
+
+			if (atomic_load_explicit(&ring->submit_slots[pos & mask].sequence, memory_order_acquire) != pos + 1)
+			{
+				break;
+			}
+		}
+
+		if (count == 0)
+		{
+			// either empty, or another consumer got here first and we're looking at a stale read index
+			uint32_t current = atomic_load_explicit(&ring->submit_read, memory_order_relaxed);
+
+			if (current == read)
+			{
+				return 0;
+			}
+
+			read = current;
+			continue;
+		}
+
+		if (atomic_compare_exchange_weak_explicit(&ring->submit_read, &read, read + count, memory_order_acq_rel, memory_order_relaxed))
+		{
+			break;
+		}
+	}
+
+	for (uint32_t i = 0; i < count; i++)
+	{
+		uint32_t pos = read + i;
+
+		job_submit_slot_t *slot = &ring->submit_slots[pos & mask];
+		entries[i] = slot->entry;
+
+		atomic_store_explicit(&slot->sequence, pos + queue->queue_size, memory_order_release);
+	}
+
+	return count;
+}
+
+// Claims up to count slots in the submission ring and publishes the entries into them. Returns how many
+// went in, which is less than count if the ring is (nearly) full.
+// Slots only get claimed once their consumer from the previous lap is done with them, so neither side
+// ever waits on the other: a thread that gets preempted in the middle of it at worst makes the ring look
+// full or empty for a bit.
+fn_local uint32_t job_queue_push_submitted(job_queue_internal_t *queue, job_priority_queue_t *ring, const job_queue_entry_t *entries, uint32_t count)
+{
+	uint32_t mask  = queue->queue_size - 1;
+	uint32_t write = atomic_load_explicit(&ring->submit_write, memory_order_relaxed);
+
+	uint32_t claimed = 0;
+
+	for (;;)
+	{
+		for (claimed = 0; claimed < count; claimed++)
+		{
+			uint32_t pos = write + claimed;
+
+			if (atomic_load_explicit(&ring->submit_slots[pos & mask].sequence, memory_order_acquire) != pos)
+			{
+				break;
+			}
+		}
+
+		if (claimed == 0)
+		{
+			// either full, or another producer got here first and we're looking at a stale write index
+			uint32_t current = atomic_load_explicit(&ring->submit_write, memory_order_relaxed);
+
+			if (current == write)
+			{
+				return 0;
+			}
+
+			write = current;
+			continue;
+		}
+
+		if (atomic_compare_exchange_weak_explicit(&ring->submit_write, &write, write + claimed, memory_order_acq_rel, memory_order_relaxed))
+		{
+			break;
+		}
+	}
+
+	for (uint32_t i = 0; i < claimed; i++)
+	{
+		uint32_t pos = write + i;
+
+		job_submit_slot_t *slot = &ring->submit_slots[pos & mask];
+		slot->entry = entries[i];
+
+		atomic_store_explicit(&slot->sequence, pos + 1, memory_order_release);
+	}
+
+	return claimed;
+}
+
+fn_local bool job_queue_steal(job_queue_internal_t *queue, uint32_t level, job_worker_t *thief, random_series_t *entropy, job_queue_entry_t *entry)
+{
+	size_t thread_count = queue->thread_count;
+	size_t start        = random_choice(entropy, (uint32_t)thread_count);
+
+	for (size_t i = 0; i < thread_count; i++)
+	{
+		job_worker_t *victim = &queue->workers[(start + i) % thread_count];
+
+		if (victim != thief && job_deque_steal(&victim->deques[level], entry))
+		{
+			job_trace(JobTraceEvent_steal, NULL, (uint32_t)victim->thread_index);
+			return true;
+		}
+	}
+
+	return false;
+}
+
+fn_local void job_queue_wake_one(job_queue_internal_t *queue)
+{
+	if (atomic_load(&queue->sleeper_count) > 0)
+	{
+		job_trace(JobTraceEvent_wake, NULL, 0);
+
+		atomic_fetch_add(&queue->wake_counter, 1);
+		wake_by_address((void *)&queue->wake_counter);
+	}
+}
+
+fn_local void job_queue_wake_all(job_queue_internal_t *queue)
+{
+	atomic_fetch_add(&queue->wake_counter, 1);
+	wake_all_by_address((void *)&queue->wake_counter);
+}
+
+// jobs pending over all priorities
+fn_local int64_t job_queue_pending_count(job_queue_internal_t *queue)
+{
+	int64_t result = 0;
+
+	for (uint32_t level = 0; level < JOB_PRIORITY_LEVEL_COUNT; level++)
+	{
+		result += atomic_load(&queue->priorities[level].jobs_pending);
+	}
+
+	return result;
+}
+
+fn_local void job_queue_add_pending(job_queue_internal_t *queue, uint32_t level, int64_t count)
+{
+	atomic_fetch_add(&queue->priorities[level].jobs_pending, count);
+	job_queue_wake_one(queue);
+}
+
+// marks a found job as picked up, and passes the wake-up on if there is more work than this thread
+fn_local void job_queue_took_job(job_queue_internal_t *queue, uint32_t level)
+{
+	atomic_fetch_sub(&queue->priorities[level].jobs_pending, 1);
+
+	if (job_queue_pending_count(queue) > 0)
+	{
+		job_queue_wake_one(queue);
+	}
+}
+
+// Looks for work one priority at a time, trying the worker's own deque, then the submission ring, then the other
+// workers' deques. Priorities without pending jobs are skipped, so looking for normal priority work doesn't pay for
+// trying to steal high priority jobs from everybody first. A job that's been pushed but not counted yet may get
+// missed that way, but then the wake-up that follows the count makes us look again.
+fn_local bool job_worker_find_work(job_worker_t *worker, job_queue_entry_t *entry)
+{
+	job_queue_internal_t *queue = worker->queue;
+
+	for (uint32_t level = 0; level < JOB_PRIORITY_LEVEL_COUNT; level++)
+	{
+		job_priority_queue_t *ring  = &queue->priorities[level];
+		job_deque_t          *deque = &worker->deques[level];
+
+		if (atomic_load_explicit(&ring->jobs_pending, memory_order_relaxed) <= 0)
+		{
+			continue;
+		}
+
+		bool found = job_deque_pop(deque, entry);
+
+		if (!found)
+		{
+			job_queue_entry_t batch[JOB_SUBMIT_BATCH_SIZE];
+
+			// don't take more than fits in our own deque, it should be empty at this point anyway
+			uint32_t batch_max = (uint32_t)MIN(JOB_SUBMIT_BATCH_SIZE, deque->mask + 1);
+			uint32_t count     = job_queue_take_submitted(queue, ring, batch, batch_max);
+
+			if (count > 0)
+			{
+				*entry = batch[0];
+				found  = true;
+
+				for (uint32_t i = 1; i < count; i++)
+				{
+					bool pushed = job_deque_push(deque, &batch[i]);
+					ASSERT(pushed);
+				}
+			}
+		}
+
+		if (!found)
+		{
+			found = job_queue_steal(queue, level, worker, &worker->entropy, entry);
+		}
+
+		if (found)
+		{
+			job_queue_took_job(queue, level);
+			return true;
+		}
+	}
+
+	return false;
+}
+
+// for threads that are not workers of this queue, helping out in wait_on_queue
+fn_local bool job_queue_find_work_external(job_queue_internal_t *queue, random_series_t *entropy, job_queue_entry_t *entry)
+{
+	for (uint32_t level = 0; level < JOB_PRIORITY_LEVEL_COUNT; level++)
+	{
+		job_priority_queue_t *ring = &queue->priorities[level];
+
+		if (atomic_load_explicit(&ring->jobs_pending, memory_order_relaxed) <= 0)
+		{
+			continue;
+		}
+
+		bool found = (job_queue_take_submitted(queue, ring, entry, 1) == 1);
+
+		if (!found)
+		{
+			found = job_queue_steal(queue, level, NULL, entropy, entry);
+		}
+
+		if (found)
+		{
+			job_queue_took_job(queue, level);
+			return true;
+		}
+	}
+
+	return false;
+}
+
+fn_local void job_queue_run_entry_with_context(job_queue_internal_t *queue, job_queue_entry_t *entry, job_context_t *context)
+{
+	void *userdata = entry->userdata_is_ptr ? entry->userdata_ptr : entry->userdata_u8;
+
+	context->priority     = entry->priority;
+	context->cancel_token = entry->cancel_token;
+
+	if (cancel_token_is_cancelled(entry->cancel_token))
+	{
+		job_trace(JobTraceEvent_job_cancelled, entry->proc, 0);
+	}
+	else
+	{
+		job_trace(JobTraceEvent_job_begin, entry->proc, 0);
+		entry->proc(context, userdata);
+		job_trace(JobTraceEvent_job_end, entry->proc, 0);
+	}
+
+	// signal before the job stops counting as in flight, so continuations on this queue
+	// are added before wait_on_queue can see it empty
+	if (entry->signal)
+	{
+		wait_group_done(entry->signal);
+	}
+
+	if (atomic_fetch_sub(&queue->jobs_in_flight, 1) == 1)
+	{
+		wake_all_by_address((void *)&queue->jobs_in_flight);
+	}
+}
+
+fn_local void job_queue_run_entry(job_queue_internal_t *queue, job_queue_entry_t *entry, int thread_index)
+{
+	job_context_t context = {
+		.thread_index = thread_index,
+	};
+
+	job_context_t *outer_context = tls_job_context;
+	tls_job_context = &context;
+
+	job_queue_run_entry_with_context(queue, entry, &context);
+
+	tls_job_context = outer_context;
+}
+
+//
+// fibers
+//
+
+fn_local job_continuation_t *job_queue_alloc_continuation(job_queue_internal_t *queue);
+fn_local void                job_queue_free_continuation (job_queue_internal_t *queue, job_continuation_t *continuation);
+
+fn_local job_fiber_t *job_queue_alloc_fiber(job_queue_internal_t *queue)
+{
+	job_fiber_t *result = NULL;
+
+	mutex_scoped_lock(&queue->fiber_mutex)
+	{
+		result = queue->first_free_fiber;
+
+		if (result)
+		{
+			queue->first_free_fiber = result->next;
+			result->next = NULL;
+		}
+	}
+
+	return result;
+}
+
+fn_local void job_queue_free_fiber(job_queue_internal_t *queue, job_fiber_t *fiber)
+{
+	mutex_scoped_lock(&queue->fiber_mutex)
+	{
+		sll_push(queue->first_free_fiber, fiber);
+	}
+}
+
+// ready fibers count as pending jobs, so workers don't go to sleep on them
+fn_local void job_queue_ready_fiber(job_queue_internal_t *queue, job_fiber_t *fiber)
+{
+	fiber->next = NULL;
+
+	mutex_scoped_lock(&queue->fiber_mutex)
+	{
+		sll_push_back(queue->first_ready_fiber, queue->last_ready_fiber, fiber);
+	}
+
+	job_queue_add_pending(queue, job_priority_level(fiber->entry.priority), 1);
+}
+
+fn_local job_fiber_t *job_queue_take_ready_fiber(job_queue_internal_t *queue)
+{
+	if (!queue->fibers)
+	{
+		return NULL;
+	}
+
+	job_fiber_t *result = NULL;
+
+	mutex_scoped_lock(&queue->fiber_mutex)
+	{
+		result = queue->first_ready_fiber;
+
+		if (result)
+		{
+			queue->first_ready_fiber = result->next;
+
+			if (!queue->first_ready_fiber)
+			{
+				queue->last_ready_fiber = NULL;
+			}
+
+			result->next = NULL;
+		}
+	}
+
+	if (result)
+	{
+		job_queue_took_job(queue, job_priority_level(result->entry.priority));
+	}
+
+	return result;
+}
+
+fn_local void job_fiber_proc(void *userdata)
+{
+	job_fiber_t *fiber = userdata;
+
+	for (;;)
+	{
+		// set up by job_worker_run_fiber, which also takes care of tls_job_context - the fiber
+		// itself can't touch thread locals, it may have been switched to from a different thread
+		job_queue_run_entry_with_context(fiber->queue, &fiber->entry, fiber->context);
+
+		fiber->context       = NULL;
+		fiber->switch_reason = JobFiberSwitch_done;
+
+		switch_to_fiber(fiber->worker->thread_fiber);
+	}
+}
+
+// switches to a fiber from a worker's own fiber, and deals with whatever the fiber wanted once it switches back
+fn_local void job_worker_run_fiber(job_worker_t *worker, job_fiber_t *fiber)
+{
+	job_queue_internal_t *queue = worker->queue;
+
+	fiber->worker = worker;
+
+	bool resuming = !!fiber->context;
+
+	if (resuming)
+	{
+		// resumed jobs can end up on a different thread than they started on
+		fiber->context->thread_index = worker->thread_index;
+
+		job_trace(JobTraceEvent_job_begin, fiber->entry.proc, 1);
+	}
+	else
+	{
+		fiber->job_context = (job_context_t){
+			.thread_index = worker->thread_index,
+		};
+
+		fiber->context = &fiber->job_context;
+	}
+
+	job_context_t *outer_context     = tls_job_context;
+	temp_arenas_t *outer_temp_arenas = m_swap_temp_arenas(&fiber->temp_arenas);
+
+	tls_job_fiber   = fiber;
+	tls_job_context = fiber->context;
+	switch_to_fiber(fiber->fiber);
+	tls_job_fiber   = NULL;
+	tls_job_context = outer_context;
+
+	if (fiber->switch_reason == JobFiberSwitch_done)
+	{
+		// the next job on this fiber starts out with empty temp arenas, same as jobs run on the thread
+		m_reset_temp_arenas();
+	}
+
+	m_swap_temp_arenas(outer_temp_arenas);
+
+	if (fiber->switch_reason != JobFiberSwitch_done)
+	{
+		job_trace(JobTraceEvent_job_end, fiber->entry.proc, 1);
+	}
+
+	switch (fiber->switch_reason)
+	{
+		case JobFiberSwitch_done:
+		{
+			job_queue_free_fiber(queue, fiber);
+		} break;
+
+		case JobFiberSwitch_yield:
+		{
+			job_queue_ready_fiber(queue, fiber);
+		} break;
+
+		case JobFiberSwitch_wait:
+		{
+			// the fiber is only registered as waiting now that it's been switched out of,
+			// so it can't get resumed on another worker while it's still running here
+			wait_group_t *group = fiber->wait_group;
+
+			job_continuation_t *continuation = job_queue_alloc_continuation(queue);
+			continuation->fiber = fiber;
+
+			bool waiting = false;
+
+			mutex_scoped_lock(&group->mutex)
+			{
+				if (atomic_load(&group->counter) != 0)
+				{
+					sll_push(group->first_continuation, continuation);
+					waiting = true;
+				}
+			}
+
+			if (!waiting)
+			{
+				job_queue_free_continuation(queue, continuation);
+				job_queue_ready_fiber(queue, fiber);
+			}
+		} break;
+	}
+}
+
+fn_local void job_worker_run_entry(job_worker_t *worker, job_queue_entry_t *entry)
+{
+	job_queue_internal_t *queue = worker->queue;
+
+	// cancelled jobs only get their signal marked done, no need to tie up a fiber for that
+	bool cancelled = cancel_token_is_cancelled(entry->cancel_token);
+
+	job_fiber_t *fiber = queue->fibers && !cancelled ? job_queue_alloc_fiber(queue) : NULL;
+
+	if (fiber)
+	{
+		fiber->entry = *entry;
+		job_worker_run_fiber(worker, fiber);
+	}
+	else
+	{
+		// no fibers (left), run the job on the thread. job_wait will block instead of yielding.
+		job_queue_run_entry(queue, entry, worker->thread_index);
+	}
+}
+
+fn_local void job_worker_thread_proc(void *userdata)
+{
+	job_worker_t         *worker = userdata;
+	job_queue_internal_t *queue  = worker->queue;
+
+	tls_job_worker = worker;
+
+	string_format_into_buffer(tls_job_trace_thread_name, sizeof(tls_job_trace_thread_name), "%s worker %d", queue->name, worker->thread_index);
+
+	// only named queues, numbered ones come and go (in tests, for example) and would flood the registry
+	if (queue->named)
+	{
+		m_register_temp_arenas(string_from_cstr(tls_job_trace_thread_name));
+	}
+
+	if (worker->affinity >= 0)
+	{
+		pin_current_thread((uint32_t)worker->affinity);
+	}
+
+	if (queue->fibers)
+	{
+		worker->thread_fiber = convert_thread_to_fiber();
+	}
+
+	int spin_count = 0;
+
+	while (!atomic_load_explicit(&queue->stop, memory_order_relaxed))
+	{
+		// finish what was already started before picking up new jobs
+		job_fiber_t *ready_fiber = job_queue_take_ready_fiber(queue);
+
+		if (ready_fiber)
+		{
+			job_worker_run_fiber(worker, ready_fiber);
+
+			spin_count = 0;
+			continue;
+		}
+
+		job_queue_entry_t entry;
+
+		if (job_worker_find_work(worker, &entry))
+		{
+			job_worker_run_entry(worker, &entry);
+
+			// jobs on fibers use the fiber's temp arenas, so suspended ones don't mind this
+			m_reset_temp_arenas();
+
+			spin_count = 0;
+			continue;
+		}
+
+		if (spin_count < JOB_SPIN_COUNT)
+		{
+			spin_count += 1;
+			_mm_pause();
+			continue;
+		}
+
+		// read the wake counter before announcing we're going to sleep, so that a wake-up between
+		// here and wait_on_address makes the wait return immediately instead of getting lost
+		uint32_t wake_counter = atomic_load(&queue->wake_counter);
+
+		atomic_fetch_add(&queue->sleeper_count, 1);
+
+		if (job_queue_pending_count(queue) == 0 && !atomic_load(&queue->stop))
+		{
+			job_trace(JobTraceEvent_sleep_begin, NULL, 0);
+			wait_on_address(&queue->wake_counter, &wake_counter, sizeof(wake_counter));
+			job_trace(JobTraceEvent_sleep_end, NULL, 0);
+		}
+
+		atomic_fetch_sub(&queue->sleeper_count, 1);
+
+		spin_count = 0;
+	}
+
+	if (queue->fibers)
+	{
+		convert_fiber_to_thread();
+	}
+
+	job_trace_release_buffer();
+	m_release_temp_arenas();
+	pool_release_thread();
+
+	tls_job_worker = NULL;
+}
+
+global atomic uint32_t g_job_queue_counter;
+
+job_queue_t create_job_queue(size_t thread_count, size_t queue_size)
+{
+	job_queue_params_t params = {
+		.thread_count = thread_count,
+		.queue_size   = queue_size,
+	};
+
+	return create_job_queue_ex(&params);
+}
+
+job_queue_t create_job_queue_with_fibers(size_t thread_count, size_t queue_size, size_t fiber_count, size_t fiber_stack_size)
+{
+	job_queue_params_t params = {
+		.thread_count     = thread_count,
+		.queue_size       = queue_size,
+		.fiber_count      = fiber_count,
+		.fiber_stack_size = fiber_stack_size,
+	};
+
+	return create_job_queue_ex(&params);
+}
+
+job_queue_t create_job_queue_ex(const job_queue_params_t *params)
+{
+	size_t thread_count     = params->thread_count;
+	size_t queue_size       = params->queue_size;
+	size_t fiber_count      = params->fiber_count;
+	size_t fiber_stack_size = params->fiber_stack_size;
+
+	ASSERT_MSG(thread_count > 0, "A job queue needs at least one thread");
+
+    job_queue_internal_t *queue = m_bootstrap(job_queue_internal_t, arena);
+
+	uint32_t queue_number = atomic_fetch_add(&g_job_queue_counter, 1);
+
+	if (params->name)
+	{
+		string_format_into_buffer(queue->name, sizeof(queue->name), "%s", params->name);
+		queue->named = true;
+	}
+	else
+	{
+		string_format_into_buffer(queue->name, sizeof(queue->name), "job queue %u", queue_number);
+	}
+
+	queue->queue_size = (uint32_t)next_pow2(MAX(queue_size, JOB_SUBMIT_BATCH_SIZE));
+
+	for (uint32_t level = 0; level < JOB_PRIORITY_LEVEL_COUNT; level++)
+	{
+		job_priority_queue_t *ring = &queue->priorities[level];
+		ring->submit_slots = m_alloc_array(&queue->arena, queue->queue_size, job_submit_slot_t);
+
+		for (uint32_t i = 0; i < queue->queue_size; i++)
+		{
+			atomic_store_explicit(&ring->submit_slots[i].sequence, i, memory_order_relaxed);
+		}
+	}
+
+    queue->thread_count = thread_count;
+    queue->workers      = m_alloc_array(&queue->arena, thread_count, job_worker_t);
+
+    for (size_t thread_index = 0; thread_index < thread_count; thread_index++)
+	{
+		job_worker_t *worker = &queue->workers[thread_index];
+		worker->queue         = queue;
+		worker->thread_index  = (int)thread_index;
+		worker->affinity      = params->thread_affinity ? (int32_t)params->thread_affinity[thread_index] : -1;
+		worker->entropy.state = (uint32_t)(thread_index + 1)*0x9E3779B9u;
+
+		for (uint32_t level = 0; level < JOB_PRIORITY_LEVEL_COUNT; level++)
+		{
+			job_deque_t *deque = &worker->deques[level];
+			deque->mask    = queue->queue_size - 1;
+			deque->entries = m_alloc_array(&queue->arena, queue->queue_size, job_queue_entry_t);
+		}
+	}
+
+	if (fiber_count > 0)
+	{
+		queue->fiber_count = fiber_count;
+		queue->fibers      = m_alloc_array(&queue->arena, fiber_count, job_fiber_t);
+
+		for (size_t fiber_index = 0; fiber_index < fiber_count; fiber_index++)
+		{
+			job_fiber_t *fiber = &queue->fibers[fiber_index];
+			fiber->queue = queue;
+			fiber->fiber = create_fiber(fiber_stack_size, job_fiber_proc, fiber);
+
+			sll_push(queue->first_free_fiber, fiber);
+		}
+	}
+
+    for (size_t thread_index = 0; thread_index < thread_count; thread_index++)
+    {
+		job_worker_t *worker = &queue->workers[thread_index];
+		worker->thread = create_thread(job_worker_thread_proc, worker);
+    }
+
+    job_queue_t result = { queue };
+    return result;
+}
+
+size_t get_job_queue_thread_count(job_queue_t handle)
+{
+    job_queue_internal_t *queue = handle.opaque;
+	return queue->thread_count;
+}
+
+void destroy_job_queue(job_queue_t handle)
+{
+    job_queue_internal_t *queue = handle.opaque;
+
+	atomic_store(&queue->stop, true);
+	job_queue_wake_all(queue);
+
+    for (size_t thread_index = 0; thread_index < queue->thread_count; thread_index++)
+    {
+		join_thread(queue->workers[thread_index].thread);
+    }
+
+	for (size_t fiber_index = 0; fiber_index < queue->fiber_count; fiber_index++)
+	{
+		job_fiber_t *fiber = &queue->fibers[fiber_index];
+
+		destroy_fiber(fiber->fiber);
+
+		temp_arenas_t *outer_temp_arenas = m_swap_temp_arenas(&fiber->temp_arenas);
+		m_release_temp_arenas();
+		m_swap_temp_arenas(outer_temp_arenas);
+	}
+
+    m_release(&queue->arena);
+}
+
+fn_local bool job_queue_help(job_queue_internal_t *queue, random_series_t *entropy);
+
+// submits a run of entries that all have the same priority, see job_queue_submit_entries
+fn_local void job_queue_submit_run(job_queue_internal_t *queue, const job_queue_entry_t *entries, size_t count)
+{
+	uint32_t level = job_priority_level(entries[0].priority);
+
+	job_priority_queue_t *ring = &queue->priorities[level];
+
+	job_worker_t *worker = tls_job_worker;
+
+	bool own_worker = (worker && worker->queue == queue);
+
+	size_t submitted = 0;
+
+	if (own_worker)
+	{
+		while (submitted < count && job_deque_push(&worker->deques[level], &entries[submitted]))
+		{
+			submitted += 1;
+		}
+
+		if (submitted > 0)
+		{
+			job_queue_add_pending(queue, level, (int64_t)submitted);
+		}
+	}
+
+	random_series_t entropy = { (uint32_t)(uintptr_t)&entropy | 1 };
+
+	while (submitted < count)
+	{
+		uint32_t chunk  = (uint32_t)MIN(count - submitted, queue->queue_size);
+		uint32_t pushed = job_queue_push_submitted(queue, ring, &entries[submitted], chunk);
+
+		if (pushed > 0)
+		{
+			submitted += pushed;
+			job_queue_add_pending(queue, level, (int64_t)pushed);
+		}
+		else if (own_worker)
+		{
+			job_queue_entry_t entry = entries[submitted++];
+			job_queue_run_entry(queue, &entry, worker->thread_index);
+		}
+		else
+		{
+			bool helped = false;
+
+			if (tls_job_submit_help_depth == 0)
+			{
+				tls_job_submit_help_depth += 1;
+				helped = job_queue_help(queue, &entropy);
+				tls_job_submit_help_depth -= 1;
+			}
+
+			if (!helped)
+			{
+				os_sleep(0.0f);
+			}
+		}
+	}
+}
+
+// Jobs added from one of the queue's own workers go on its deque for their priority, where they are run by this
+// worker first and by other workers through stealing. Everything else, and whatever doesn't fit on the deque,
+// goes through the submission ring for their priority. Sleeping workers get a single wake-up per chunk that makes
+// it in, and wake each other up from there for as long as there is work left.
+//
+// If the ring is full the submitter pays for it: a worker of this queue runs the job itself, any other
+// thread runs jobs from the queue until there is room again. Jobs run that way can run into a full ring
+// themselves, so only the outermost submission on a thread helps out (that's enough to make sure queues
+// that submit to each other can't all end up stuck waiting on one another) and nested ones just yield.
+fn_local void job_queue_submit_entries(job_queue_internal_t *queue, const job_queue_entry_t *entries, size_t count)
+{
+	if (count == 0)
+	{
+		return;
+	}
+
+	atomic_fetch_add(&queue->jobs_in_flight, (uint32_t)count);
+
+	for (size_t first = 0; first < count;)
+	{
+		size_t one_past_last = first + 1;
+
+		while (one_past_last < count && entries[one_past_last].priority == entries[first].priority)
+		{
+			one_past_last += 1;
+		}
+
+		job_queue_submit_run(queue, &entries[first], one_past_last - first);
+
+		first = one_past_last;
+	}
+}
+
+fn_local void job_queue_submit_entry(job_queue_internal_t *queue, job_queue_entry_t *entry)
+{
+	job_queue_submit_entries(queue, entry, 1);
+}
+
+fn_local job_continuation_t *job_queue_alloc_continuation(job_queue_internal_t *queue)
+{
+	job_continuation_t *result = NULL;
+
+	mutex_scoped_lock(&queue->continuation_mutex)
+	{
+		result = queue->first_free_continuation;
+
+		if (result)
+		{
+			queue->first_free_continuation = result->next;
+		}
+		else
+		{
+			result = m_alloc_struct_nozero(&queue->arena, job_continuation_t);
+		}
+	}
+
+	result->next  = NULL;
+	result->queue = queue;
+	result->fiber = NULL;
+
+	return result;
+}
+
+fn_local void job_queue_free_continuation(job_queue_internal_t *queue, job_continuation_t *continuation)
+{
+	mutex_scoped_lock(&queue->continuation_mutex)
+	{
+		sll_push(queue->first_free_continuation, continuation);
+	}
+}
+
+fn_local void job_submit_continuations(job_continuation_t *first)
+{
+	// continuations for the same queue go in as one batch, so a wait group that releases
+	// lots of jobs at once doesn't wake a thread for every single one of them
+	job_queue_internal_t *batch_queue = NULL;
+	job_queue_entry_t     batch[JOB_SUBMIT_BATCH_SIZE];
+	size_t                batch_count = 0;
+
+	for (job_continuation_t *continuation = first, *next = NULL;
+		 continuation;
+		 continuation = next)
+	{
+		next = continuation->next;
+
+		job_queue_internal_t *queue = continuation->queue;
+
+		job_fiber_t      *fiber = continuation->fiber;
+		job_queue_entry_t entry = continuation->entry;
+		job_queue_free_continuation(queue, continuation);
+
+		if (fiber)
+		{
+			job_queue_ready_fiber(queue, fiber);
+		}
+		else
+		{
+			if (batch_count == ARRAY_COUNT(batch) || (batch_count > 0 && batch_queue != queue))
+			{
+				job_queue_submit_entries(batch_queue, batch, batch_count);
+				batch_count = 0;
+			}
+
+			batch_queue = queue;
+			batch[batch_count++] = entry;
+		}
+	}
+
+	if (batch_count > 0)
+	{
+		job_queue_submit_entries(batch_queue, batch, batch_count);
+	}
+}
+
+// fills in the priority and cancel token of an entry, inheriting from the job running on this thread where options leave them out
+fn_local void job_entry_apply_options(job_queue_entry_t *entry, const job_options_t *options)
+{
+	job_context_t *current = tls_job_context;
+
+	job_priority_t  priority     = options->priority;
+	cancel_token_t *cancel_token = options->cancel_token;
+
+	if (priority == JobPriority_inherit)
+	{
+		priority = current ? current->priority : JobPriority_normal;
+	}
+
+	if (!cancel_token && current && !options->not_cancellable)
+	{
+		cancel_token = current->cancel_token;
+	}
+
+	ASSERT(priority > JobPriority_inherit && priority < JobPriority_COUNT);
+	ASSERT_MSG(!(cancel_token && options->not_cancellable), "A job can't have a cancel token and be not cancellable at the same time");
+
+	entry->priority     = priority;
+	entry->cancel_token = cancel_token;
+}
+
+fn_local void add_job_to_queue_internal(job_queue_t handle, const job_options_t *options,
+										job_proc_t proc, void *userdata, size_t userdata_size, bool userdata_is_ptr)
+{
+    job_queue_internal_t *queue = handle.opaque;
+
+	job_queue_entry_t entry;
+
+	if (userdata_size > sizeof(entry.userdata_u8))
+	{
+		FATAL_ERROR("Tried to add job with userdata that was larger than 64 bytes!");
+	}
+
+	wait_group_t *run_after = options->run_after;
+	wait_group_t *signal    = options->signal;
+
+    entry.proc   = proc;
+	entry.signal = signal;
+	copy_memory(entry.userdata_u8, userdata, userdata_size);
+	entry.userdata_is_ptr = userdata_is_ptr;
+
+	job_entry_apply_options(&entry, options);
+
+	if (signal)
+	{
+		wait_group_add(signal, 1);
+	}
+
+	if (run_after)
+	{
+		job_continuation_t *continuation = job_queue_alloc_continuation(queue);
+		continuation->entry = entry;
+
+		bool held_back = false;
+
+		mutex_scoped_lock(&run_after->mutex)
+		{
+			if (atomic_load(&run_after->counter) != 0)
+			{
+				sll_push(run_after->first_continuation, continuation);
+				held_back = true;
+			}
+		}
+
+		if (held_back)
+		{
+			return;
+		}
+
+		job_queue_free_continuation(queue, continuation);
+	}
+
+	job_queue_submit_entry(queue, &entry);
+}
+
+void add_job_to_queue(job_queue_t queue, job_proc_t proc, void *userdata)
+{
+	job_options_t options = {0};
+	add_job_to_queue_internal(queue, &options, proc, &userdata, sizeof(userdata), true);
+}
+
+void add_job_to_queue_with_data_(job_queue_t queue, job_proc_t proc, void *userdata, size_t userdata_size)
+{
+	job_options_t options = {0};
+	add_job_to_queue_internal(queue, &options, proc, userdata, userdata_size, false);
+}
+
+void add_job_to_queue_after(job_queue_t queue, wait_group_t *run_after, wait_group_t *signal, job_proc_t proc, void *userdata)
+{
+	job_options_t options = {
+		.run_after = run_after,
+		.signal    = signal,
+	};
+
+	add_job_to_queue_internal(queue, &options, proc, &userdata, sizeof(userdata), true);
+}
+
+void add_job_to_queue_after_with_data_(job_queue_t queue, wait_group_t *run_after, wait_group_t *signal, job_proc_t proc, void *userdata, size_t userdata_size)
+{
+	job_options_t options = {
+		.run_after = run_after,
+		.signal    = signal,
+	};
+
+	add_job_to_queue_internal(queue, &options, proc, userdata, userdata_size, false);
+}
+
+void add_job_to_queue_ex(job_queue_t queue, const job_options_t *options, job_proc_t proc, void *userdata)
+{
+	add_job_to_queue_internal(queue, options, proc, &userdata, sizeof(userdata), true);
+}
+
+void add_job_to_queue_ex_with_data_(job_queue_t queue, const job_options_t *options, job_proc_t proc, void *userdata, size_t userdata_size)
+{
+	add_job_to_queue_internal(queue, options, proc, userdata, userdata_size, false);
+}
+
+void add_jobs_to_queue(job_queue_t handle, wait_group_t *signal, size_t count, job_proc_t proc, void *userdata, size_t userdata_stride)
+{
+    job_queue_internal_t *queue = handle.opaque;
+
+	if (signal)
+	{
+		wait_group_add(signal, (int64_t)count);
+	}
+
+	job_options_t options = {0};
+
+	m_scoped_temp
+	{
+		job_queue_entry_t *entries = m_alloc_array_nozero(temp, count, job_queue_entry_t);
+
+		for (size_t i = 0; i < count; i++)
+		{
+			job_queue_entry_t *entry = &entries[i];
+			entry->proc            = proc;
+			entry->signal          = signal;
+			entry->userdata_is_ptr = true;
+			entry->userdata_ptr    = (char *)userdata + i*userdata_stride;
+
+			job_entry_apply_options(entry, &options);
+		}
+
+		job_queue_submit_entries(queue, entries, count);
+	}
+}
+
+// runs one job on the calling thread if there is any to be found, for threads that are waiting on work to finish
+fn_local bool job_queue_help(job_queue_internal_t *queue, random_series_t *entropy)
+{
+	job_worker_t *worker = tls_job_worker;
+
+	job_queue_entry_t entry;
+
+	if (worker && worker->queue == queue)
+	{
+		if (job_worker_find_work(worker, &entry))
+		{
+			job_queue_run_entry(queue, &entry, worker->thread_index);
+			return true;
+		}
+	}
+	else
+	{
+		// every non-worker thread runs jobs as thread_count, so only one of them gets to help at a time or they'd
+		// share whatever per-thread state is picked by thread_index. The one that has the slot can nest, though.
+		bool holds_slot = tls_job_external_help_queue == queue;
+
+		if (!holds_slot && atomic_exchange_explicit(&queue->external_helper, true, memory_order_acquire))
+		{
+			return false;
+		}
+
+		job_queue_internal_t *previous_help_queue = tls_job_external_help_queue;
+		tls_job_external_help_queue = queue;
+
+		bool found = job_queue_find_work_external(queue, entropy, &entry);
+
+		if (found)
+		{
+			job_queue_run_entry(queue, &entry, (int)queue->thread_count);
+		}
+
+		tls_job_external_help_queue = previous_help_queue;
+
+		if (!holds_slot)
+		{
+			// sequentially consistent, so either this sees the waiter count go up or wait_on_queue sees the slot free
+			atomic_store(&queue->external_helper, false);
+
+			if (atomic_load(&queue->external_help_waiters) > 0)
+			{
+				wake_all_by_address((void *)&queue->external_helper);
+			}
+		}
+
+		return found;
+	}
+
+	return false;
+}
+
+fn_local void job_queue_help_until_done(job_queue_internal_t *queue, wait_group_t *group)
+{
+	random_series_t entropy = { (uint32_t)(uintptr_t)&entropy | 1 };
+
+	while (!wait_group_is_done(group))
+	{
+		if (!job_queue_help(queue, &entropy))
+		{
+			// whatever is left is already running on other threads
+			wait_group_wait(group);
+		}
+	}
+}
+
+void job_wait(wait_group_t *group)
+{
+	job_fiber_t *fiber = tls_job_fiber;
+
+	if (fiber)
+	{
+		if (!wait_group_is_done(group))
+		{
+			fiber->switch_reason = JobFiberSwitch_wait;
+			fiber->wait_group    = group;
+
+			// after this returns we may be on a different thread, so don't touch anything thread local here
+			switch_to_fiber(fiber->worker->thread_fiber);
+		}
+	}
+	else if (tls_job_worker)
+	{
+		job_queue_help_until_done(tls_job_worker->queue, group);
+	}
+	else
+	{
+		wait_group_wait(group);
+	}
+}
+
+void job_yield(void)
+{
+	job_fiber_t *fiber = tls_job_fiber;
+
+	if (fiber)
+	{
+		fiber->switch_reason = JobFiberSwitch_yield;
+		switch_to_fiber(fiber->worker->thread_fiber);
+	}
+}
+
+void wait_on_queue(job_queue_t handle)
+{
+    job_queue_internal_t *queue = handle.opaque;
+
+	random_series_t entropy = { (uint32_t)(uintptr_t)&entropy | 1 };
+
+	for (;;)
+	{
+		uint32_t in_flight = atomic_load(&queue->jobs_in_flight);
+
+		if (in_flight == 0)
+		{
+			break;
+		}
+
+		if (job_queue_help(queue, &entropy))
+		{
+			continue;
+		}
+
+		bool external = !(tls_job_worker && tls_job_worker->queue == queue) && tls_job_external_help_queue != queue;
+
+		if (external && atomic_load(&queue->external_helper))
+		{
+			// another non-worker thread has the helper slot, which may just mean it got there first and there's
+			// still plenty to do, so sleep until the slot is released and try again. The slot is only held while
+			// running a job of this queue, so it's released after the last one finishes too.
+			atomic_fetch_add(&queue->external_help_waiters, 1);
+
+			bool taken = true;
+
+			job_trace(JobTraceEvent_sleep_begin, NULL, 0);
+			wait_on_address(&queue->external_helper, &taken, sizeof(taken));
+			job_trace(JobTraceEvent_sleep_end, NULL, 0);
+
+			atomic_fetch_sub(&queue->external_help_waiters, 1);
+
+			continue;
+		}
+
+		// nothing left to help with, sleep until the last job in flight finishes
+		job_trace(JobTraceEvent_sleep_begin, NULL, 0);
+		wait_on_address(&queue->jobs_in_flight, &in_flight, sizeof(in_flight));
+		job_trace(JobTraceEvent_sleep_end, NULL, 0);
+	}
+}
+
+//
+// parallel for
+//
+
+typedef struct parallel_for_range_t
+{
+	job_queue_t          queue;
+	parallel_for_proc_t  proc;
+	void                *userdata;
+	wait_group_t        *signal;
+	size_t               grain;
+	size_t               first;
+	size_t               one_past_last;
+} parallel_for_range_t;
+
+STATIC_ASSERT(sizeof(parallel_for_range_t) <= 64, "parallel_for_range_t has to fit in the job userdata");
+
+fn_local void parallel_for_range_job(job_context_t *context, void *userdata)
+{
+	parallel_for_range_t range = *(parallel_for_range_t *)userdata;
+
+	job_queue_internal_t *queue = range.queue.opaque;
+
+	// Lazy splitting: run the range grain by grain, and only split off the upper half for other
+	// threads when the queue looks starved. That way big loops get spread out as soon as threads
+	// run dry, without flooding the queue with tiny jobs when everybody is busy anyway.
+	// The upper halves inherit this job's priority and cancel token.
+	while (range.first < range.one_past_last && !job_is_cancelled(context))
+	{
+		size_t remaining = range.one_past_last - range.first;
+
+		if (remaining > 2*range.grain &&
+			job_queue_pending_count(queue) < (int64_t)queue->thread_count)
+		{
+			parallel_for_range_t upper = range;
+			upper.first = range.first + remaining / 2;
+
+			add_job_to_queue_after_with_data(range.queue, NULL, range.signal, parallel_for_range_job, upper);
+
+			range.one_past_last = upper.first;
+		}
+
+		size_t one_past_last = MIN(range.first + range.grain, range.one_past_last);
+
+		range.proc(context, range.userdata, range.first, one_past_last);
+
+		range.first = one_past_last;
+	}
+}
+
+void parallel_for_ex(job_queue_t handle, const job_options_t *options, size_t count, size_t grain, parallel_for_proc_t proc, void *userdata)
+{
+    job_queue_internal_t *queue = handle.opaque;
+
+	if (count == 0)
+	{
+		return;
+	}
+
+	if (grain == 0)
+	{
+		// aim for a handful of chunks per thread, so there's something left to steal near the end
+		grain = MAX(1, count / (8*(queue->thread_count + 1)));
+	}
+
+	parallel_for_range_t range = {
+		.queue         = handle,
+		.proc          = proc,
+		.userdata      = userdata,
+		.signal        = options->signal,
+		.grain         = grain,
+		.first         = 0,
+		.one_past_last = count,
+	};
+
+	add_job_to_queue_ex_with_data(handle, options, parallel_for_range_job, range);
+}
+
+void parallel_for_async(job_queue_t queue, size_t count, size_t grain, parallel_for_proc_t proc, void *userdata, wait_group_t *signal)
+{
+	job_options_t options = {
+		.signal = signal,
+	};
+
+	parallel_for_ex(queue, &options, count, grain, proc, userdata);
+}
+
+void parallel_for(job_queue_t handle, size_t count, size_t grain, parallel_for_proc_t proc, void *userdata)
+{
+    job_queue_internal_t *queue = handle.opaque;
+
+	wait_group_t done = {0};
+	parallel_for_async(handle, count, grain, proc, userdata, &done);
+
+	if (tls_job_fiber)
+	{
+		job_wait(&done);
+	}
+	else
+	{
+		job_queue_help_until_done(queue, &done);
+	}
+}
+
+typedef struct parallel_reduce_t
+{
+	parallel_reduce_proc_t proc;
+	void                  *userdata;
+	char                  *partials;
+	size_t                 partial_stride;
+} parallel_reduce_t;
+
+fn_local void parallel_reduce_range(job_context_t *context, void *userdata, size_t first, size_t one_past_last)
+{
+	parallel_reduce_t *reduce = userdata;
+
+	void *partial = reduce->partials + context->thread_index*reduce->partial_stride;
+	reduce->proc(context, reduce->userdata, first, one_past_last, partial);
+}
+
+void parallel_reduce(job_queue_t handle, size_t count, size_t grain, 
+					 parallel_reduce_proc_t proc, parallel_combine_proc_t combine, void *userdata, 
+					 void *result, size_t result_size)
+{
+    job_queue_internal_t *queue = handle.opaque;
+
+	size_t partial_count  = queue->thread_count + 1;
+	size_t partial_stride = align_forward(result_size, CACHE_LINE_SIZE);
+
+	m_scoped_temp
+	{
+		char *partials = m_alloc_nozero(temp, partial_count*partial_stride, CACHE_LINE_SIZE);
+
+		for (size_t i = 0; i < partial_count; i++)
+		{
+			copy_memory(partials + i*partial_stride, result, result_size);
+		}
+
+		parallel_reduce_t reduce = {
+			.proc           = proc,
+			.userdata       = userdata,
+			.partials       = partials,
+			.partial_stride = partial_stride,
+		};
+
+		parallel_for(handle, count, grain, parallel_reduce_range, &reduce);
 
-		if (group->counter != 0)
+		// combine in thread order, which is not necessarily the same order as the ranges were processed in
+		for (size_t i = 0; i < partial_count; i++)
 		{
-			FATAL_ERROR("Wait group misuse: wait_group_add called concurrently with wait_group_wait");
+			combine(userdata, result, partials + i*partial_stride);
 		}
 	}
 }
@@ -4,8 +4,64 @@
 
 #pragma once
 
+//
+// topology
+//
+
+#define CPU_MAX_LOGICAL_PROCESSORS 256
+
+typedef struct cpu_logical_processor_t
+{
+	uint32_t core;      // index of the physical core this logical processor belongs to
+	uint32_t smt_index; // 0 for the first logical processor on a core, 1 for its SMT sibling, and so on
+	uint32_t l2_group;  // logical processors with the same l2_group share an L2 cache
+	uint32_t l3_group;  // same for L3
+} cpu_logical_processor_t;
+
+typedef struct cpu_topology_t
+{
+	uint32_t logical_processor_count;
+	uint32_t core_count;
+	uint32_t l2_group_count;
+	uint32_t l3_group_count;
+
+	cpu_logical_processor_t logical_processors[CPU_MAX_LOGICAL_PROCESSORS];
+} cpu_topology_t;
+
+// Detected on the first call and cached after that. If the OS doesn't tell us about caches, every core
+// gets its own L2 and all cores share one L3.
+fn const cpu_topology_t *query_cpu_topology(void);
+
+// number of physical cores
 fn size_t query_processor_count(void);
 
+// Restricts the calling thread to a single logical processor (an index into cpu_topology_t.logical_processors).
+fn bool pin_current_thread(uint32_t logical_processor);
+
+typedef struct thread_t
+{
+	void *opaque;
+} thread_t;
+
+typedef void (*thread_proc_t)(void *userdata);
+
+fn thread_t create_thread(thread_proc_t proc, void *userdata);
+fn void     join_thread  (thread_t thread); // waits for the thread to exit and releases it
+
+typedef struct fiber_t
+{
+	void *opaque;
+} fiber_t;
+
+typedef void (*fiber_proc_t)(void *userdata);
+
+// a thread has to be converted to a fiber before it can switch to other fibers
+fn fiber_t convert_thread_to_fiber(void);
+fn void    convert_fiber_to_thread(void);
+fn fiber_t create_fiber           (size_t stack_size, fiber_proc_t proc, void *userdata); // proc must never return
+fn void    destroy_fiber          (fiber_t fiber);
+fn void    switch_to_fiber        (fiber_t fiber);
+
 fn bool wait_on_address(volatile void *address, void *compare_address, size_t address_size);
 fn void wake_by_address(void *address);
 fn void wake_all_by_address(void *address);
@@ -15,7 +71,7 @@ fn void mutex_unlock         (mutex_t *mutex);
 fn bool mutex_try_lock       (mutex_t *mutex);
 fn void mutex_shared_lock    (mutex_t *mutex);
 fn void mutex_shared_unlock  (mutex_t *mutex);
-fn bool mutex_shared_try_lock(mutex_t *mutex);
+fn bool mutex_try_shared_lock(mutex_t *mutex);
 
 #define mutex_scoped_lock(mutex) DEFER_LOOP(mutex_lock(mutex), mutex_unlock(mutex))
 
@@ -28,27 +84,208 @@ fn void cond_wake_all    (cond_t *cond);
 //
 //
 
+typedef struct job_continuation_t job_continuation_t;
+
+// A wait group counts outstanding work. It doubles as the handle for a batch of jobs: jobs can signal
+// a wait group when they finish, and jobs can be held back until a wait group is done (see add_job_to_queue_after).
+// Zero-initialized is a valid, done wait group.
+typedef struct wait_group_t
+{
+	atomic int64_t counter;
+	mutex_t        mutex;
+	cond_t         cond;
+
+	job_continuation_t *first_continuation; // jobs waiting for the counter to drop to zero
+} wait_group_t;
+
 fn void wait_group_add (wait_group_t *group, int64_t delta);
 fn void wait_group_done(wait_group_t *group); // TODO: I don't love this name
-fn void wait_group_wait(wait_group_t *group);
+fn void wait_group_wait(wait_group_t *group); // blocks, don't call this from inside a job - use add_job_to_queue_after instead
+fn bool wait_group_is_done(wait_group_t *group); // non-blocking, once this returns true it's safe to free the wait group
 
 typedef struct job_queue_t
 {
     void *opaque;
 } job_queue_t;
 
+// Each worker thread owns a deque of jobs per priority. Jobs added from a worker go on its own deque, jobs added
+// from any other thread go through a shared submission ring per priority that workers pull from in batches.
+// Idle workers steal from the deques of random other workers before going to sleep.
+// queue_size is the capacity of each submission ring and each worker deque (rounded up to a power of 2).
+// Any thread can add jobs to any queue. When the ring is full, adding a job doesn't return until there's
+// room: a worker of the queue runs the job itself, other threads run jobs from the queue in the meantime.
 fn job_queue_t create_job_queue(size_t thread_count, size_t queue_size);
+// Jobs on a queue with fibers run on a fixed pool of fiber stacks, and can give their worker back with
+// job_wait/job_yield instead of blocking it. If all fibers are in use, jobs run on the worker thread as usual.
+// Suspended jobs may be resumed on another thread: don't keep temp arena memory or thread locals across a wait.
+fn job_queue_t create_job_queue_with_fibers(size_t thread_count, size_t queue_size, size_t fiber_count, size_t fiber_stack_size);
+
+typedef struct job_queue_params_t
+{
+	size_t thread_count;
+	size_t queue_size;
+
+	size_t fiber_count;      // 0 for a queue without fibers
+	size_t fiber_stack_size;
+
+	// Optional, thread_count logical processors to pin the worker threads to, one per worker.
+	// Leave null to let the OS schedule them wherever it likes.
+	const uint32_t *thread_affinity;
+
+	// Optional, used to name the worker threads in traces.
+	const char *name;
+} job_queue_params_t;
+
+fn job_queue_t create_job_queue_ex(const job_queue_params_t *params);
 fn void destroy_job_queue(job_queue_t queue);
 fn size_t get_job_queue_thread_count(job_queue_t queue);
 
+// Shared by any number of jobs to cancel them as a group. Once cancelled, jobs carrying the token that haven't
+// started yet are dropped without ever running (their signal is still marked done, so anything waiting on them
+// carries on), and jobs that are already running can check job_is_cancelled to bail out early.
+// Zero-initialized is a valid token that isn't cancelled.
+typedef struct cancel_token_t
+{
+	atomic bool cancelled;
+} cancel_token_t;
+
+fn_local void cancel_token_cancel(cancel_token_t *token)
+{
+	atomic_store_explicit(&token->cancelled, true, memory_order_release);
+}
+
+// only reset a token once no jobs carrying it are left in a queue, or they might run after all
+fn_local void cancel_token_reset(cancel_token_t *token)
+{
+	atomic_store_explicit(&token->cancelled, false, memory_order_release);
+}
+
+// a null token is never cancelled
+fn_local bool cancel_token_is_cancelled(cancel_token_t *token)
+{
+	return token && atomic_load_explicit(&token->cancelled, memory_order_acquire);
+}
+
+// Workers pick up jobs in priority order: normal priority jobs only run when there are no high priority
+// jobs to be found, and so on. There's no aging, so keeping a queue busy with high priority jobs starves
+// the lower priorities.
+typedef enum job_priority_t
+{
+	JobPriority_inherit, // the priority of the job doing the adding, or normal from outside of a job
+
+	JobPriority_high,
+	JobPriority_normal,
+	JobPriority_low,
+
+	JobPriority_COUNT,
+} job_priority_t;
+
 typedef struct job_context_t
 {
+    // in [0, thread_count] - jobs run by a non-worker thread helping out (in wait_on_queue, job_wait, ...) get
+    // thread_count. Only one such thread helps out at a time, so no two jobs ever run with the same index at once.
     int thread_index;
+
+	job_priority_t  priority;
+	cancel_token_t *cancel_token; // null if the job can't be cancelled
 } job_context_t;
 
+fn_local bool job_is_cancelled(job_context_t *context)
+{
+	return cancel_token_is_cancelled(context->cancel_token);
+}
+
 typedef void (*job_proc_t)(job_context_t *context, void *userdata);
 fn void add_job_to_queue(job_queue_t queue, job_proc_t proc, void *userdata);
 // up to 64 bytes of per-job data (so you don't have to allocate it yourself)
 fn void add_job_to_queue_with_data_(job_queue_t queue, job_proc_t proc, void *userdata, size_t userdata_size);
 #define add_job_to_queue_with_data(queue, proc, data) add_job_to_queue_with_data_(queue, proc, &(data), sizeof(data))
+
+// Adds a job that won't start until run_after is done, or right away if it already is or run_after is null.
+// If signal is not null, the job is added to it immediately and marks it done once it has finished running,
+// so chains of jobs can be built by passing one job's signal as the next job's run_after.
+fn void add_job_to_queue_after(job_queue_t queue, wait_group_t *run_after, wait_group_t *signal, job_proc_t proc, void *userdata);
+fn void add_job_to_queue_after_with_data_(job_queue_t queue, wait_group_t *run_after, wait_group_t *signal, job_proc_t proc, void *userdata, size_t userdata_size);
+#define add_job_to_queue_after_with_data(queue, run_after, signal, proc, data) add_job_to_queue_after_with_data_(queue, run_after, signal, proc, &(data), sizeof(data))
+
+// Adds count jobs in one go, job i gets (char *)userdata + i*userdata_stride as its userdata (so pass
+// sizeof(*array) to hand out elements of an array, or 0 to give all of them the same pointer).
+// Cheaper than adding them one by one: sleeping workers get woken once for the whole batch.
+// signal is optional, like for add_job_to_queue_after.
+fn void add_jobs_to_queue(job_queue_t queue, wait_group_t *signal, size_t count, job_proc_t proc, void *userdata, size_t userdata_stride);
+
+// Everything left zeroed is inherited from the job doing the adding: jobs added by a job run at its priority
+// and get cancelled along with it, unless they're given a priority or token of their own. The functions above
+// always inherit.
+typedef struct job_options_t
+{
+	job_priority_t  priority;
+	cancel_token_t *cancel_token;
+	wait_group_t   *run_after;    // see add_job_to_queue_after
+	wait_group_t   *signal;
+
+	// Don't inherit a cancel token either, for jobs that have to run to clean up after cancelled ones.
+	bool not_cancellable;
+} job_options_t;
+
+fn void add_job_to_queue_ex(job_queue_t queue, const job_options_t *options, job_proc_t proc, void *userdata);
+fn void add_job_to_queue_ex_with_data_(job_queue_t queue, const job_options_t *options, job_proc_t proc, void *userdata, size_t userdata_size);
+#define add_job_to_queue_ex_with_data(queue, options, proc, data) add_job_to_queue_ex_with_data_(queue, options, proc, &(data), sizeof(data))
+
+//
+// parallel for
+//
+
+// Calls proc for [0, count) in chunks of at most grain items, spread over the queue's threads.
+// Ranges are split lazily: a job only splits off half its range when the queue is running low on work,
+// so grain is the minimum amount of work per call rather than a fixed job size. Pass 0 to pick one
+// based on count and the number of threads.
+typedef void (*parallel_for_proc_t)(job_context_t *context, void *userdata, size_t first, size_t one_past_last);
+
+// blocks until done, running jobs from the queue on the calling thread in the meantime
+fn void parallel_for      (job_queue_t queue, size_t count, size_t grain, parallel_for_proc_t proc, void *userdata);
+// returns right away, signal is done once all of the range has been processed
+fn void parallel_for_async(job_queue_t queue, size_t count, size_t grain, parallel_for_proc_t proc, void *userdata, wait_group_t *signal);
+// same, with the priority, cancel token and run_after taken from options and signal marked done at the end.
+// A cancelled loop drops whatever part of the range hasn't started yet.
+fn void parallel_for_ex   (job_queue_t queue, const job_options_t *options, size_t count, size_t grain, parallel_for_proc_t proc, void *userdata);
+
+// Each thread accumulates into its own partial result, which start out as a copy of what's in result
+// (so result should hold the identity for the reduction). After the loop the partials are combined into result.
+// Combining happens in thread order, so non-associative reductions (e.g. float sums) aren't deterministic.
+// Partials are picked by thread_index.
+typedef void (*parallel_reduce_proc_t) (job_context_t *context, void *userdata, size_t first, size_t one_past_last, void *partial);
+typedef void (*parallel_combine_proc_t)(void *userdata, void *result, const void *partial);
+
+fn void parallel_reduce(job_queue_t queue, size_t count, size_t grain, 
+						parallel_reduce_proc_t proc, parallel_combine_proc_t combine, void *userdata, 
+						void *result, size_t result_size);
+
+// runs pending jobs on the calling thread until the queue has no jobs in flight
 fn void wait_on_queue(job_queue_t queue);
+
+//
+// tracing
+//
+
+// Records job begin/end, cancelled jobs, steals, sleeps and wake-ups for every thread that runs or waits on jobs, into
+// a ring buffer per thread that keeps the last 64k events. While tracing is off recording costs a single branch.
+fn void job_tracing_start(void);
+// Stops recording and writes the events to path in the Chrome trace format (chrome://tracing or ui.perfetto.dev).
+// Jobs are named by the address of their proc, so look those up in the map file/debugger.
+fn bool job_tracing_stop(string_t path);
+
+// Waits for a wait group from inside a job. On a fiber the job is suspended and the worker picks up other work
+// until the wait group is done. Otherwise this runs jobs from the worker's queue while waiting, or blocks if
+// called from outside a job queue.
+fn void job_wait(wait_group_t *group);
+// lets other jobs run before continuing, only does anything for jobs running on a fiber
+fn void job_yield(void);
+
+//
+// testing
+//
+
+// Randomized stress test for the job queues, see thread_stress_test.c. Runs round_count rounds seeded by seed, prints
+// every check that fails and returns how many did. Runs in game as test.jobs, and standalone as thread_stress_test.
+fn uint64_t job_stress_test(int64_t round_count, uint32_t seed);
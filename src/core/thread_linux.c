@@ -0,0 +1,561 @@
+// ============================================================
+// Copyright 2024 by Daniël Cornelisse, All Rights Reserved.
+// ============================================================
+
+// Linux implementation of thread.h. Everything that blocks (wait_on_address, mutexes, condition variables)
+// is built directly on futexes, so mutex_t and cond_t stay zero-initializable like they are on Win32.
+
+//
+// topology
+//
+
+fn_local bool linux_read_sysfs_string(const char *path, char *buffer, size_t buffer_size)
+{
+	FILE *file = fopen(path, "r");
+
+	if (!file)
+	{
+		return false;
+	}
+
+	bool result = !!fgets(buffer, (int)buffer_size, file);
+	fclose(file);
+
+	return result;
+}
+
+// also works for cpu lists like "0-3,8-11", where it returns the first cpu in the list
+fn_local bool linux_read_sysfs_u32(const char *path, uint32_t *result)
+{
+	char buffer[64];
+	return linux_read_sysfs_string(path, buffer, sizeof(buffer)) && sscanf(buffer, "%u", result) == 1;
+}
+
+// maps ids as the kernel reports them to dense indices
+fn_local uint32_t linux_dense_index(uint32_t *ids, uint32_t *count, uint32_t id)
+{
+	for (uint32_t i = 0; i < *count; i++)
+	{
+		if (ids[i] == id)
+		{
+			return i;
+		}
+	}
+
+	ids[*count] = id;
+	return (*count)++;
+}
+
+// Logical processor i is cpu i as far as the kernel is concerned. Detection stops at the first cpu
+// without topology info, so if some cpus in the middle are offline we only see the ones before them.
+void detect_cpu_topology(cpu_topology_t *topology)
+{
+	uint32_t core_ids[CPU_MAX_LOGICAL_PROCESSORS];
+	uint32_t l2_ids  [CPU_MAX_LOGICAL_PROCESSORS];
+	uint32_t l3_ids  [CPU_MAX_LOGICAL_PROCESSORS];
+
+	uint32_t l2_count = 0;
+	uint32_t l3_count = 0;
+
+	uint32_t core_smt_count[CPU_MAX_LOGICAL_PROCESSORS] = {0};
+
+	// only trust the cache info if every cpu had it
+	uint32_t cpus_with_l2 = 0;
+	uint32_t cpus_with_l3 = 0;
+
+	char path[256];
+
+	for (uint32_t cpu = 0; cpu < CPU_MAX_LOGICAL_PROCESSORS; cpu++)
+	{
+		uint32_t package_id = 0;
+		uint32_t core_id    = 0;
+
+		snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%u/topology/core_id", cpu);
+		if (!linux_read_sysfs_u32(path, &core_id)) break;
+
+		snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%u/topology/physical_package_id", cpu);
+		linux_read_sysfs_u32(path, &package_id);
+
+		cpu_logical_processor_t *processor = &topology->logical_processors[cpu];
+
+		processor->core      = linux_dense_index(core_ids, &topology->core_count, (package_id << 16)|core_id);
+		processor->smt_index = core_smt_count[processor->core]++;
+
+		bool found_l2 = false;
+		bool found_l3 = false;
+
+		for (uint32_t cache_index = 0; cache_index < 8; cache_index++)
+		{
+			uint32_t level = 0;
+			uint32_t first_shared_cpu = 0;
+
+			char type[32];
+
+			snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%u/cache/index%u/level", cpu, cache_index);
+			if (!linux_read_sysfs_u32(path, &level)) break;
+
+			snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%u/cache/index%u/type", cpu, cache_index);
+			if (linux_read_sysfs_string(path, type, sizeof(type)) && strncmp(type, "Instruction", 11) == 0) continue;
+
+			// caches are identified by the first cpu sharing them
+			snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%u/cache/index%u/shared_cpu_list", cpu, cache_index);
+			if (!linux_read_sysfs_u32(path, &first_shared_cpu)) continue;
+
+			if (level == 2) { processor->l2_group = linux_dense_index(l2_ids, &l2_count, first_shared_cpu); found_l2 = true; }
+			if (level == 3) { processor->l3_group = linux_dense_index(l3_ids, &l3_count, first_shared_cpu); found_l3 = true; }
+		}
+
+		cpus_with_l2 += found_l2;
+		cpus_with_l3 += found_l3;
+
+		topology->logical_processor_count = cpu + 1;
+	}
+
+	bool have_l2 = (cpus_with_l2 == topology->logical_processor_count);
+	bool have_l3 = (cpus_with_l3 == topology->logical_processor_count);
+
+	if (topology->logical_processor_count == 0)
+	{
+		// no sysfs, so we can't tell SMT siblings apart
+		long count = sysconf(_SC_NPROCESSORS_ONLN);
+
+		topology->logical_processor_count = (uint32_t)CLAMP(count, 1, CPU_MAX_LOGICAL_PROCESSORS);
+		topology->core_count              = topology->logical_processor_count;
+
+		for (uint32_t i = 0; i < topology->logical_processor_count; i++)
+		{
+			topology->logical_processors[i].core = i;
+		}
+
+		have_l2 = have_l3 = false;
+	}
+
+	topology->l2_group_count = have_l2 ? l2_count : 0;
+	topology->l3_group_count = have_l3 ? l3_count : 0;
+}
+
+bool pin_current_thread(uint32_t logical_processor)
+{
+	cpu_set_t set;
+	CPU_ZERO(&set);
+	CPU_SET(logical_processor, &set);
+
+	return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+}
+
+fn_local long linux_futex_wait(volatile uint32_t *word, uint32_t expected)
+{
+	return syscall(SYS_futex, (uint32_t *)word, FUTEX_WAIT_PRIVATE, expected, NULL, NULL, 0);
+}
+
+fn_local void linux_futex_wake(volatile uint32_t *word, int count)
+{
+	syscall(SYS_futex, (uint32_t *)word, FUTEX_WAKE_PRIVATE, count, NULL, NULL, 0);
+}
+
+// futexes only operate on aligned 32 bit words, so smaller values wait on the word they're in and
+// 64 bit values wait on their low half. Either way, wakes have to go to the same word.
+// NOTE: For 64 bit values that means a change confined to the high half that races with the wait can be
+// missed. Everything in thread.c waits on 32 bit values, so this doesn't come up there.
+fn_local volatile uint32_t *linux_futex_word(volatile void *address)
+{
+	return (volatile uint32_t *)((uintptr_t)address & ~(uintptr_t)3);
+}
+
+fn_local bool linux_value_equals(volatile void *address, void *compare_address, size_t address_size)
+{
+	switch (address_size)
+	{
+		case 1: return __atomic_load_n((volatile uint8_t  *)address, __ATOMIC_RELAXED) == *(uint8_t  *)compare_address;
+		case 2: return __atomic_load_n((volatile uint16_t *)address, __ATOMIC_RELAXED) == *(uint16_t *)compare_address;
+		case 4: return __atomic_load_n((volatile uint32_t *)address, __ATOMIC_RELAXED) == *(uint32_t *)compare_address;
+		case 8: return __atomic_load_n((volatile uint64_t *)address, __ATOMIC_RELAXED) == *(uint64_t *)compare_address;
+		INVALID_DEFAULT_CASE;
+	}
+
+	return false;
+}
+
+bool wait_on_address(volatile void *address, void *compare_address, size_t address_size)
+{
+	ASSERT(address_size == 1 || address_size == 2 || address_size == 4 || address_size == 8);
+
+	volatile uint32_t *word = linux_futex_word(address);
+
+	uint32_t word_value = atomic_load((atomic uint32_t *)word);
+
+	// like WaitOnAddress, return right away if the value is already different
+	if (!linux_value_equals(address, compare_address, address_size))
+	{
+		return true;
+	}
+
+	long result = linux_futex_wait(word, word_value);
+	return result == 0 || errno == EAGAIN || errno == EINTR;
+}
+
+void wake_by_address(void *address)
+{
+	linux_futex_wake(linux_futex_word(address), 1);
+}
+
+void wake_all_by_address(void *address)
+{
+	linux_futex_wake(linux_futex_word(address), INT_MAX);
+}
+
+//
+// thread
+//
+
+typedef struct linux_thread_params_t
+{
+	thread_proc_t  proc;
+	void          *userdata;
+} linux_thread_params_t;
+
+fn_local void *linux_thread_proc(void *userdata)
+{
+	linux_thread_params_t params = *(linux_thread_params_t *)userdata;
+	free(userdata);
+
+	params.proc(params.userdata);
+
+	// for threads that aren't job workers, which give back their magazines themselves
+	pool_release_thread();
+
+	return NULL;
+}
+
+thread_t create_thread(thread_proc_t proc, void *userdata)
+{
+	linux_thread_params_t *params = malloc(sizeof(linux_thread_params_t));
+	params->proc     = proc;
+	params->userdata = userdata;
+
+	thread_t result = {0};
+
+	pthread_t thread;
+	int error = pthread_create(&thread, NULL, linux_thread_proc, params);
+
+	if (error == 0)
+	{
+		result.opaque = (void *)thread;
+	}
+	else
+	{
+		free(params);
+		debug_print("create_thread failed: %s\n", strerror(error));
+	}
+
+	return result;
+}
+
+void join_thread(thread_t thread)
+{
+	if (thread.opaque)
+	{
+		pthread_join((pthread_t)thread.opaque, NULL);
+	}
+}
+
+//
+// fiber
+//
+
+typedef struct linux_fiber_t
+{
+	ucontext_t   context;
+	fiber_proc_t proc;
+	void        *userdata;
+	char        *mapping;      // guard page followed by the stack
+	size_t       mapping_size;
+} linux_fiber_t;
+
+global thread_local linux_fiber_t *tls_current_fiber;
+
+// makecontext only passes ints, so the fiber pointer gets split in two
+fn_local void linux_fiber_entry(unsigned int lo, unsigned int hi)
+{
+	linux_fiber_t *fiber = (linux_fiber_t *)(((uintptr_t)hi << 32) | (uintptr_t)lo);
+	fiber->proc(fiber->userdata);
+
+	FATAL_ERROR("Fiber procs must never return");
+}
+
+fiber_t convert_thread_to_fiber(void)
+{
+	ASSERT(!tls_current_fiber);
+
+	linux_fiber_t *fiber = calloc(1, sizeof(linux_fiber_t));
+	tls_current_fiber = fiber;
+
+	fiber_t result = { fiber };
+	return result;
+}
+
+void convert_fiber_to_thread(void)
+{
+	free(tls_current_fiber);
+	tls_current_fiber = NULL;
+}
+
+fiber_t create_fiber(size_t stack_size, fiber_proc_t proc, void *userdata)
+{
+	if (stack_size == 0)
+	{
+		stack_size = MB(1); // same default as CreateFiber
+	}
+
+	size_t page_size = (size_t)sysconf(_SC_PAGESIZE);
+
+	stack_size = align_forward(stack_size, page_size);
+
+	linux_fiber_t *fiber = calloc(1, sizeof(linux_fiber_t));
+	fiber->proc         = proc;
+	fiber->userdata     = userdata;
+	fiber->mapping_size = page_size + stack_size;
+	fiber->mapping      = mmap(NULL, fiber->mapping_size, PROT_READ|PROT_WRITE, MAP_PRIVATE|MAP_ANONYMOUS|MAP_STACK, -1, 0);
+
+	if (fiber->mapping == MAP_FAILED)
+	{
+		FATAL_ERROR("Failed to allocate a fiber stack: %s", strerror(errno));
+	}
+
+	// stacks grow down, so overflowing one runs into the page below it. CreateFiber stacks come with a guard page,
+	// this gives ours one too, so an overflow faults right away instead of scribbling over whatever is mapped there
+	mprotect(fiber->mapping, page_size, PROT_NONE);
+
+	getcontext(&fiber->context);
+	fiber->context.uc_stack.ss_sp   = fiber->mapping + page_size;
+	fiber->context.uc_stack.ss_size = stack_size;
+	fiber->context.uc_link          = NULL;
+
+	uintptr_t pointer = (uintptr_t)fiber;
+	makecontext(&fiber->context, (void (*)(void))linux_fiber_entry, 2, (unsigned int)pointer, (unsigned int)(pointer >> 32));
+
+	fiber_t result = { fiber };
+	return result;
+}
+
+void destroy_fiber(fiber_t handle)
+{
+	linux_fiber_t *fiber = handle.opaque;
+
+	if (fiber)
+	{
+		munmap(fiber->mapping, fiber->mapping_size);
+		free(fiber);
+	}
+}
+
+void switch_to_fiber(fiber_t handle)
+{
+	linux_fiber_t *from = tls_current_fiber;
+	linux_fiber_t *to   = handle.opaque;
+
+	ASSERT_MSG(from, "switch_to_fiber called from a thread that wasn't converted to a fiber");
+
+	tls_current_fiber = to;
+	swapcontext(&from->context, &to->context);
+}
+
+//
+// mutex
+//
+
+// The mutex is a reader-writer lock in the first 32 bits of mutex_t:
+// the top bit is set while held exclusively, the bit below it is set while anyone sleeps on it,
+// and the rest counts shared owners. Unlocks wake all sleepers when the lock becomes free,
+// which is simple and fine for the lightly contended locks we have.
+
+enum
+{
+	LINUX_MUTEX_EXCLUSIVE = 1u << 31,
+	LINUX_MUTEX_SLEEPERS  = 1u << 30,
+	LINUX_MUTEX_SHARED    = LINUX_MUTEX_SLEEPERS - 1,
+
+	LINUX_MUTEX_SPIN_COUNT = 64,
+};
+
+STATIC_ASSERT(sizeof(mutex_t) >= sizeof(uint32_t), "mutex_t has to fit a futex word");
+STATIC_ASSERT(sizeof(cond_t)  >= sizeof(uint32_t), "cond_t has to fit a futex word");
+
+fn_local atomic uint32_t *linux_mutex_state(mutex_t *mutex)
+{
+	return (atomic uint32_t *)mutex;
+}
+
+// marks the mutex as having sleepers and sleeps, if it still looks the way the caller saw it
+fn_local void linux_mutex_sleep(atomic uint32_t *state, uint32_t seen)
+{
+	uint32_t sleeping = seen|LINUX_MUTEX_SLEEPERS;
+
+	if (seen == sleeping || atomic_compare_exchange_strong(state, &seen, sleeping))
+	{
+		linux_futex_wait((volatile uint32_t *)state, sleeping);
+	}
+}
+
+bool mutex_try_lock(mutex_t *mutex)
+{
+	atomic uint32_t *state = linux_mutex_state(mutex);
+
+	uint32_t seen = atomic_load_explicit(state, memory_order_relaxed);
+
+	while ((seen & ~LINUX_MUTEX_SLEEPERS) == 0)
+	{
+		if (atomic_compare_exchange_weak_explicit(state, &seen, seen|LINUX_MUTEX_EXCLUSIVE, memory_order_acquire, memory_order_relaxed))
+		{
+			return true;
+		}
+	}
+
+	return false;
+}
+
+void mutex_lock(mutex_t *mutex)
+{
+	atomic uint32_t *state = linux_mutex_state(mutex);
+
+	for (int spin = 0;; spin++)
+	{
+		if (mutex_try_lock(mutex))
+		{
+			return;
+		}
+
+		if (spin < LINUX_MUTEX_SPIN_COUNT)
+		{
+			_mm_pause();
+			continue;
+		}
+
+		uint32_t seen = atomic_load_explicit(state, memory_order_relaxed);
+
+		if ((seen & ~LINUX_MUTEX_SLEEPERS) != 0)
+		{
+			linux_mutex_sleep(state, seen);
+		}
+	}
+}
+
+// clears the sleepers bit and wakes everyone up if the mutex is free
+fn_local void linux_mutex_wake_if_free(atomic uint32_t *state, uint32_t seen)
+{
+	while (seen == LINUX_MUTEX_SLEEPERS)
+	{
+		if (atomic_compare_exchange_weak(state, &seen, 0))
+		{
+			linux_futex_wake((volatile uint32_t *)state, INT_MAX);
+			break;
+		}
+	}
+}
+
+void mutex_unlock(mutex_t *mutex)
+{
+	atomic uint32_t *state = linux_mutex_state(mutex);
+
+	uint32_t seen = atomic_fetch_and_explicit(state, ~LINUX_MUTEX_EXCLUSIVE, memory_order_release) & ~LINUX_MUTEX_EXCLUSIVE;
+	linux_mutex_wake_if_free(state, seen);
+}
+
+bool mutex_try_shared_lock(mutex_t *mutex)
+{
+	atomic uint32_t *state = linux_mutex_state(mutex);
+
+	uint32_t seen = atomic_load_explicit(state, memory_order_relaxed);
+
+	while (!(seen & LINUX_MUTEX_EXCLUSIVE))
+	{
+		ASSERT((seen & LINUX_MUTEX_SHARED) != LINUX_MUTEX_SHARED);
+
+		if (atomic_compare_exchange_weak_explicit(state, &seen, seen + 1, memory_order_acquire, memory_order_relaxed))
+		{
+			return true;
+		}
+	}
+
+	return false;
+}
+
+void mutex_shared_lock(mutex_t *mutex)
+{
+	atomic uint32_t *state = linux_mutex_state(mutex);
+
+	for (int spin = 0;; spin++)
+	{
+		if (mutex_try_shared_lock(mutex))
+		{
+			return;
+		}
+
+		if (spin < LINUX_MUTEX_SPIN_COUNT)
+		{
+			_mm_pause();
+			continue;
+		}
+
+		uint32_t seen = atomic_load_explicit(state, memory_order_relaxed);
+
+		if (seen & LINUX_MUTEX_EXCLUSIVE)
+		{
+			linux_mutex_sleep(state, seen);
+		}
+	}
+}
+
+void mutex_shared_unlock(mutex_t *mutex)
+{
+	atomic uint32_t *state = linux_mutex_state(mutex);
+
+	uint32_t seen = atomic_fetch_sub_explicit(state, 1, memory_order_release) - 1;
+	linux_mutex_wake_if_free(state, seen);
+}
+
+//
+// condition variable
+//
+
+// The condition variable is a sequence number that gets bumped on every wake. Sleepers wait for it
+// to change, so a wake between unlocking the mutex and going to sleep can't get lost.
+
+fn_local void linux_cond_sleep(cond_t *cond, mutex_t *mutex, bool shared)
+{
+	atomic uint32_t *sequence = (atomic uint32_t *)cond;
+
+	uint32_t seen = atomic_load(sequence);
+
+	if (shared) mutex_shared_unlock(mutex);
+	else        mutex_unlock       (mutex);
+
+	linux_futex_wait((volatile uint32_t *)sequence, seen);
+
+	if (shared) mutex_shared_lock(mutex);
+	else        mutex_lock       (mutex);
+}
+
+void cond_sleep(cond_t *cond, mutex_t *mutex)
+{
+	linux_cond_sleep(cond, mutex, false);
+}
+
+void cond_sleep_shared(cond_t *cond, mutex_t *mutex)
+{
+	linux_cond_sleep(cond, mutex, true);
+}
+
+void cond_wake(cond_t *cond)
+{
+	atomic uint32_t *sequence = (atomic uint32_t *)cond;
+	atomic_fetch_add(sequence, 1);
+	linux_futex_wake((volatile uint32_t *)sequence, 1);
+}
+
+void cond_wake_all(cond_t *cond)
+{
+	atomic uint32_t *sequence = (atomic uint32_t *)cond;
+	atomic_fetch_add(sequence, 1);
+	linux_futex_wake((volatile uint32_t *)sequence, INT_MAX);
+}
@@ -0,0 +1,538 @@
+// ============================================================
+// Copyright 2024 by Daniël Cornelisse, All Rights Reserved.
+// ============================================================
+
+// Randomized stress test for the job queues. Every round creates fresh queues with a random thread count
+// and runs a mix of flat, nested, chained, parallel_for, parallel_reduce, cancelled, prioritized and fiber workloads on them,
+// checking the results instead of timing them. Meant to be run for a long time to shake out races in
+// the scheduler and the platform backends.
+
+typedef struct stress_jobs_t
+{
+	job_queue_t queue;
+	uint32_t    spawn_count;
+
+	alignas(CACHE_LINE_SIZE) atomic uint64_t counter;
+} stress_jobs_t;
+
+fn_local void stress_tiny_job(job_context_t *context, void *userdata)
+{
+	(void)context;
+
+	stress_jobs_t *test = userdata;
+	atomic_fetch_add_explicit(&test->counter, 1, memory_order_relaxed);
+}
+
+fn_local void stress_spawner_job(job_context_t *context, void *userdata)
+{
+	(void)context;
+
+	stress_jobs_t *test = userdata;
+
+	for (size_t i = 0; i < test->spawn_count; i++)
+	{
+		add_job_to_queue(test->queue, stress_tiny_job, test);
+	}
+
+	atomic_fetch_add_explicit(&test->counter, 1, memory_order_relaxed);
+}
+
+typedef struct stress_producer_t
+{
+	stress_jobs_t *test;
+	int64_t        job_count;
+	bool           batched;
+} stress_producer_t;
+
+fn_local void stress_producer_thread(void *userdata)
+{
+	stress_producer_t *producer = userdata;
+	stress_jobs_t     *test     = producer->test;
+
+	if (producer->batched)
+	{
+		add_jobs_to_queue(test->queue, NULL, (size_t)producer->job_count, stress_tiny_job, test, 0);
+	}
+	else
+	{
+		for (int64_t i = 0; i < producer->job_count; i++)
+		{
+			add_job_to_queue(test->queue, stress_tiny_job, test);
+		}
+	}
+}
+
+// submits job_count jobs split over producer_count threads that aren't part of the queue
+fn_local void stress_producers(stress_jobs_t *test, size_t producer_count, int64_t job_count, bool batched)
+{
+	stress_producer_t producers[16];
+	thread_t          threads  [16];
+
+	producer_count = MIN(producer_count, ARRAY_COUNT(producers));
+
+	for (size_t i = 0; i < producer_count; i++)
+	{
+		producers[i] = (stress_producer_t){
+			.test      = test,
+			.job_count = job_count / (int64_t)producer_count + ((int64_t)i < job_count % (int64_t)producer_count),
+			.batched   = batched,
+		};
+
+		threads[i] = create_thread(stress_producer_thread, &producers[i]);
+	}
+
+	for (size_t i = 0; i < producer_count; i++)
+	{
+		join_thread(threads[i]);
+	}
+}
+
+typedef struct stress_chain_t
+{
+	job_queue_t      queue;
+	int64_t          depth;
+	atomic uint64_t *counter;
+} stress_chain_t;
+
+// every link in the chain waits on the next one, so all of them are alive at the same time
+fn_local void stress_chain_job(job_context_t *context, void *userdata)
+{
+	(void)context;
+
+	stress_chain_t chain = *(stress_chain_t *)userdata;
+
+	if (chain.depth > 1)
+	{
+		wait_group_t child_done = {0};
+
+		stress_chain_t child = chain;
+		child.depth -= 1;
+
+		add_job_to_queue_after_with_data(chain.queue, NULL, &child_done, stress_chain_job, child);
+		job_wait(&child_done);
+	}
+
+	atomic_fetch_add_explicit(chain.counter, 1, memory_order_relaxed);
+}
+
+typedef struct stress_chain_link_t
+{
+	atomic uint64_t *progress;
+	uint64_t         index;
+	atomic uint64_t *failures;
+} stress_chain_link_t;
+
+fn_local void stress_chain_link_job(job_context_t *context, void *userdata)
+{
+	(void)context;
+
+	stress_chain_link_t *link = userdata;
+
+	// links run strictly in order, so everything before this one has to be done already
+	if (atomic_load(link->progress) != link->index)
+	{
+		atomic_fetch_add(link->failures, 1);
+	}
+
+	atomic_store(link->progress, link->index + 1);
+}
+
+typedef struct stress_parallel_for_t
+{
+	atomic uint8_t *hits;
+} stress_parallel_for_t;
+
+fn_local void stress_parallel_for_proc(job_context_t *context, void *userdata, size_t first, size_t one_past_last)
+{
+	(void)context;
+
+	stress_parallel_for_t *test = userdata;
+
+	for (size_t i = first; i < one_past_last; i++)
+	{
+		atomic_fetch_add_explicit(&test->hits[i], 1, memory_order_relaxed);
+	}
+}
+
+fn_local void stress_reduce_proc(job_context_t *context, void *userdata, size_t first, size_t one_past_last, void *partial)
+{
+	(void)context;
+	(void)userdata;
+
+	uint64_t *sum = partial;
+
+	for (size_t i = first; i < one_past_last; i++)
+	{
+		*sum += i;
+	}
+}
+
+fn_local void stress_combine_proc(void *userdata, void *result, const void *partial)
+{
+	(void)userdata;
+
+	*(uint64_t *)result += *(const uint64_t *)partial;
+}
+
+// cancels its own token before adding children, which inherit it and so should never run
+fn_local void stress_cancel_spawner_job(job_context_t *context, void *userdata)
+{
+	stress_jobs_t *test = userdata;
+
+	cancel_token_cancel(context->cancel_token);
+
+	for (size_t i = 0; i < test->spawn_count; i++)
+	{
+		add_job_to_queue(test->queue, stress_tiny_job, test);
+	}
+}
+
+typedef struct stress_priority_t
+{
+	wait_group_t   *gate;
+	uint64_t        high_count;
+	atomic uint64_t high_started;
+	atomic uint64_t failures;
+} stress_priority_t;
+
+fn_local void stress_priority_blocker_job(job_context_t *context, void *userdata)
+{
+	(void)context;
+
+	stress_priority_t *test = userdata;
+	wait_group_wait(test->gate);
+}
+
+fn_local void stress_priority_high_job(job_context_t *context, void *userdata)
+{
+	stress_priority_t *test = userdata;
+
+	if (context->priority != JobPriority_high)
+	{
+		atomic_fetch_add(&test->failures, 1);
+	}
+
+	atomic_fetch_add(&test->high_started, 1);
+}
+
+fn_local void stress_priority_low_job(job_context_t *context, void *userdata)
+{
+	(void)context;
+
+	stress_priority_t *test = userdata;
+
+	if (atomic_load(&test->high_started) != test->high_count)
+	{
+		atomic_fetch_add(&test->failures, 1);
+	}
+}
+
+fn_local uint64_t stress_test_round(random_series_t *entropy, int64_t round)
+{
+	uint64_t failures = 0;
+
+	size_t thread_count = 1 + random_choice(entropy, (uint32_t)query_processor_count());
+	size_t queue_size   = (size_t)1 << (4 + random_choice(entropy, 8));
+
+	// small fiber pools on purpose, so waits regularly have to fall back to blocking the thread
+	size_t fiber_count = 1 + random_choice(entropy, 64);
+
+	job_queue_t thread_queue = create_job_queue(thread_count, queue_size);
+	job_queue_t fiber_queue  = create_job_queue_with_fibers(thread_count, queue_size, fiber_count, KB(64));
+
+	job_queue_t queues[] = { thread_queue, fiber_queue };
+
+	// priorities: with a single worker that's kept busy while the jobs go in, every high priority job
+	// has to have started before the first low priority one does
+	{
+		job_queue_t single_queue = create_job_queue(1, queue_size);
+
+		wait_group_t gate = {0};
+		wait_group_t done = {0};
+
+		stress_priority_t test = {
+			.gate       = &gate,
+			.high_count = 1 + random_choice(entropy, (uint32_t)queue_size),
+		};
+
+		uint64_t low_count = 1 + random_choice(entropy, (uint32_t)queue_size);
+
+		wait_group_add(&gate, 1);
+
+		add_job_to_queue(single_queue, stress_priority_blocker_job, &test);
+
+		for (uint64_t i = 0; i < low_count; i++)
+		{
+			add_job_to_queue_ex(single_queue, &(job_options_t){ .priority = JobPriority_low, .signal = &done }, stress_priority_low_job, &test);
+		}
+
+		for (uint64_t i = 0; i < test.high_count; i++)
+		{
+			add_job_to_queue_ex(single_queue, &(job_options_t){ .priority = JobPriority_high, .signal = &done }, stress_priority_high_job, &test);
+		}
+
+		wait_group_done(&gate);
+		wait_group_wait(&done);
+
+		destroy_job_queue(single_queue);
+
+		if (atomic_load(&test.failures) > 0)
+		{
+			debug_print("test.jobs: round %lld: %llu of %llu low priority jobs ran before all %llu high priority jobs had started\n", 
+				round, atomic_load(&test.failures), low_count, test.high_count);
+			failures += 1;
+		}
+	}
+
+	for (size_t queue_index = 0; queue_index < ARRAY_COUNT(queues); queue_index++)
+	{
+		job_queue_t queue = queues[queue_index];
+
+		// flat and nested
+		{
+			stress_jobs_t jobs = {
+				.queue       = queue,
+				.spawn_count = random_choice(entropy, 128),
+			};
+
+			int64_t flat_count    = random_choice(entropy, 1 << 14);
+			int64_t spawner_count = random_choice(entropy, 256);
+
+			for (int64_t i = 0; i < flat_count; i++)
+			{
+				add_job_to_queue(queue, stress_tiny_job, &jobs);
+			}
+
+			for (int64_t i = 0; i < spawner_count; i++)
+			{
+				add_job_to_queue(queue, stress_spawner_job, &jobs);
+			}
+
+			wait_on_queue(queue);
+
+			uint64_t expected = (uint64_t)(flat_count + spawner_count*(jobs.spawn_count + 1));
+			uint64_t counted  = atomic_load(&jobs.counter);
+
+			if (counted != expected)
+			{
+				debug_print("test.jobs: round %lld: flat/nested ran %llu jobs, expected %llu\n", round, counted, expected);
+				failures += 1;
+			}
+		}
+
+		// several producers at once, mixing single jobs and batches, which with the small rings
+		// picked above regularly run into a full ring
+		{
+			stress_jobs_t jobs = {
+				.queue = queue,
+			};
+
+			size_t  producer_count = 1 + random_choice(entropy, 8);
+			int64_t job_count      = random_choice(entropy, 1 << 15);
+
+			stress_producers(&jobs, producer_count, job_count, random_choice(entropy, 2));
+			wait_on_queue(queue);
+
+			if (atomic_load(&jobs.counter) != (uint64_t)job_count)
+			{
+				debug_print("test.jobs: round %lld: %zu producers ran %llu jobs, expected %lld\n", 
+					round, producer_count, atomic_load(&jobs.counter), job_count);
+				failures += 1;
+			}
+		}
+
+		// fan-out: lots of jobs held back by one wait group, released all at once
+		{
+			stress_jobs_t jobs = {
+				.queue = queue,
+			};
+
+			wait_group_t gate     = {0};
+			wait_group_t fan_done = {0};
+
+			int64_t fan_count = 1 + random_choice(entropy, 2048);
+
+			wait_group_add(&gate, 1);
+
+			for (int64_t i = 0; i < fan_count; i++)
+			{
+				add_job_to_queue_after(queue, &gate, &fan_done, stress_tiny_job, &jobs);
+			}
+
+			wait_group_done(&gate);
+			wait_group_wait(&fan_done);
+
+			if (atomic_load(&jobs.counter) != (uint64_t)fan_count)
+			{
+				debug_print("test.jobs: round %lld: fan-out ran %llu jobs, expected %lld\n", round, atomic_load(&jobs.counter), fan_count);
+				failures += 1;
+			}
+		}
+
+		// cancellation: held back jobs whose token gets cancelled before they're released never run,
+		// and neither do jobs added by a job whose token is cancelled
+		{
+			stress_jobs_t cancelled = {
+				.queue       = queue,
+				.spawn_count = random_choice(entropy, 128),
+			};
+
+			stress_jobs_t kept = {
+				.queue = queue,
+			};
+
+			cancel_token_t token        = {0};
+			cancel_token_t parent_token = {0};
+
+			wait_group_t gate = {0};
+			wait_group_add(&gate, 1);
+
+			int64_t job_count = random_choice(entropy, 512);
+
+			for (int64_t i = 0; i < job_count; i++)
+			{
+				job_priority_t priority = (job_priority_t)(JobPriority_high + random_choice(entropy, 3));
+
+				add_job_to_queue_ex(queue, &(job_options_t){ .priority = priority, .cancel_token = &token, .run_after = &gate }, stress_tiny_job, &cancelled);
+				add_job_to_queue_ex(queue, &(job_options_t){ .priority = priority, .run_after = &gate }, stress_tiny_job, &kept);
+			}
+
+			cancel_token_cancel(&token);
+			wait_group_done(&gate);
+
+			add_job_to_queue_ex(queue, &(job_options_t){ .cancel_token = &parent_token }, stress_cancel_spawner_job, &cancelled);
+
+			wait_on_queue(queue);
+
+			if (atomic_load(&cancelled.counter) != 0 || atomic_load(&kept.counter) != (uint64_t)job_count)
+			{
+				debug_print("test.jobs: round %lld: %llu cancelled jobs ran, %llu of %lld other jobs ran\n", 
+					round, atomic_load(&cancelled.counter), atomic_load(&kept.counter), job_count);
+				failures += 1;
+			}
+		}
+
+		// continuation chains
+		m_scoped_temp
+		{
+			uint64_t chain_length = 1 + random_choice(entropy, 512);
+
+			atomic uint64_t progress       = 0;
+			atomic uint64_t chain_failures = 0;
+
+			stress_chain_link_t *links = m_alloc_array(temp, chain_length, stress_chain_link_t);
+			wait_group_t        *done  = m_alloc_array(temp, chain_length, wait_group_t);
+
+			for (uint64_t i = 0; i < chain_length; i++)
+			{
+				links[i] = (stress_chain_link_t){
+					.progress = &progress,
+					.index    = i,
+					.failures = &chain_failures,
+				};
+
+				add_job_to_queue_after(queue, i > 0 ? &done[i - 1] : NULL, &done[i], stress_chain_link_job, &links[i]);
+			}
+
+			wait_group_wait(&done[chain_length - 1]);
+			wait_on_queue(queue);
+
+			if (atomic_load(&chain_failures) > 0 || atomic_load(&progress) != chain_length)
+			{
+				debug_print("test.jobs: round %lld: chain of %llu ran out of order\n", round, chain_length);
+				failures += 1;
+			}
+		}
+
+		// parallel_for covers every index exactly once
+		m_scoped_temp
+		{
+			size_t count = random_choice(entropy, 1 << 16);
+			size_t grain = random_choice(entropy, 256);
+
+			stress_parallel_for_t test = {
+				.hits = m_alloc_array(temp, MAX(1, count), atomic uint8_t),
+			};
+
+			parallel_for(queue, count, grain, stress_parallel_for_proc, &test);
+
+			for (size_t i = 0; i < count; i++)
+			{
+				if (atomic_load(&test.hits[i]) != 1)
+				{
+					debug_print("test.jobs: round %lld: parallel_for hit index %zu %u times (count %zu, grain %zu)\n", 
+						round, i, (uint32_t)atomic_load(&test.hits[i]), count, grain);
+					failures += 1;
+					break;
+				}
+			}
+		}
+
+		// parallel_reduce
+		{
+			size_t count = random_choice(entropy, 1 << 20);
+			size_t grain = random_choice(entropy, 4096);
+
+			uint64_t sum = 0;
+			parallel_reduce(queue, count, grain, stress_reduce_proc, stress_combine_proc, NULL, &sum, sizeof(sum));
+
+			uint64_t expected = count > 0 ? (uint64_t)count*(uint64_t)(count - 1) / 2 : 0;
+
+			if (sum != expected)
+			{
+				debug_print("test.jobs: round %lld: parallel_reduce summed to %llu, expected %llu\n", round, sum, expected);
+				failures += 1;
+			}
+		}
+
+		// nested waits
+		{
+			atomic uint64_t counter = 0;
+
+			wait_group_t chains_done = {0};
+
+			int64_t chain_count = 1 + random_choice(entropy, 16);
+			int64_t depth       = 1 + random_choice(entropy, 32);
+
+			for (int64_t i = 0; i < chain_count; i++)
+			{
+				stress_chain_t chain = {
+					.queue   = queue,
+					.depth   = depth,
+					.counter = &counter,
+				};
+
+				add_job_to_queue_after_with_data(queue, NULL, &chains_done, stress_chain_job, chain);
+			}
+
+			wait_group_wait(&chains_done);
+			wait_on_queue(queue);
+
+			if (atomic_load(&counter) != (uint64_t)(chain_count*depth))
+			{
+				debug_print("test.jobs: round %lld: nested waits ran %llu jobs, expected %llu\n", 
+					round, atomic_load(&counter), (uint64_t)(chain_count*depth));
+				failures += 1;
+			}
+		}
+	}
+
+	destroy_job_queue(thread_queue);
+	destroy_job_queue(fiber_queue);
+
+	return failures;
+}
+
+uint64_t job_stress_test(int64_t round_count, uint32_t seed)
+{
+	random_series_t entropy = { .state = seed | 1 };
+
+	uint64_t failures = 0;
+
+	for (int64_t round = 0; round < round_count; round++)
+	{
+		failures += stress_test_round(&entropy, round);
+	}
+
+	return failures;
+}
@@ -0,0 +1,45 @@
+// ============================================================
+// Copyright 2024 by Daniël Cornelisse, All Rights Reserved.
+// ============================================================
+
+// Standalone runner for job_stress_test, so the scheduler and the platform backends can be tested without
+// the engine, e.g. on linux where there's nothing else to run yet.
+//
+// usage: thread_stress_test [rounds] [seed]
+
+#include "core.c"
+
+int main(int argc, char **argv)
+{
+	int64_t round_count = 64;
+	int64_t seed        = (int64_t)(os_hires_time().value & 0x7FFFFFFF);
+
+	if (argc > 1)
+	{
+		string_t argument = string_from_cstr(argv[1]);
+		string_parse_int(&argument, &round_count);
+	}
+
+	if (argc > 2)
+	{
+		string_t argument = string_from_cstr(argv[2]);
+		string_parse_int(&argument, &seed);
+	}
+
+	debug_print("test.jobs: %lld rounds, seed %lld\n", round_count, seed);
+
+	hires_time_t start = os_hires_time();
+
+	uint64_t failures = job_stress_test(round_count, (uint32_t)seed);
+
+	double seconds = os_seconds_elapsed(start, os_hires_time());
+
+	if (failures > 0)
+	{
+		debug_print("test.jobs: %llu failures in %lld rounds (seed %lld)\n", failures, round_count, seed);
+		return 1;
+	}
+
+	debug_print("test.jobs: passed %lld rounds in %.2f s\n", round_count, seconds);
+	return 0;
+}
@@ -18,6 +18,52 @@ void wake_all_by_address(void *address)
 	WakeByAddressAll(address);
 }
 
+//
+// fiber
+//
+
+fiber_t convert_thread_to_fiber(void)
+{
+	void *fiber = ConvertThreadToFiber(NULL);
+
+	if (!fiber)
+	{
+		win32_output_last_error(strlit16("convert_thread_to_fiber failed"));
+	}
+
+	fiber_t result = { fiber };
+	return result;
+}
+
+void convert_fiber_to_thread(void)
+{
+	ConvertFiberToThread();
+}
+
+fiber_t create_fiber(size_t stack_size, fiber_proc_t proc, void *userdata)
+{
+	// fiber_proc_t matches LPFIBER_START_ROUTINE, x64 only has the one calling convention
+	void *fiber = CreateFiber(stack_size, (LPFIBER_START_ROUTINE)proc, userdata);
+
+	if (!fiber)
+	{
+		win32_output_last_error(strlit16("create_fiber failed"));
+	}
+
+	fiber_t result = { fiber };
+	return result;
+}
+
+void destroy_fiber(fiber_t fiber)
+{
+	DeleteFiber(fiber.opaque);
+}
+
+void switch_to_fiber(fiber_t fiber)
+{
+	SwitchToFiber(fiber.opaque);
+}
+
 //
 // mutex
 //
@@ -92,203 +138,176 @@ void cond_wake_all(cond_t *cond)
 //
 //
 
-size_t query_processor_count(void)
+// logical processors are numbered by going through the processor groups in order
+fn_local uint32_t win32_first_logical_processor_in_group(WORD group)
 {
-	SYSTEM_INFO info;
-	GetSystemInfo(&info);
+	uint32_t result = 0;
 
-	// boldly presume hyperthreading
-	size_t actual_processor_count = info.dwNumberOfProcessors / 2;
-	return actual_processor_count;
-}
+	for (WORD i = 0; i < group; i++)
+	{
+		result += GetActiveProcessorCount(i);
+	}
 
-typedef struct job_thread_t
-{
-    HANDLE handle;
-} job_thread_t;
+	return result;
+}
 
-typedef struct job_queue_entry_t
+void detect_cpu_topology(cpu_topology_t *topology)
 {
-    job_proc_t proc;
+	DWORD size = 0;
+	GetLogicalProcessorInformationEx(RelationAll, NULL, &size);
 
-	bool userdata_is_ptr;
-
-	union
+	if (GetLastError() != ERROR_INSUFFICIENT_BUFFER)
 	{
-		char  userdata_u8[64];
-		void *userdata_ptr;
-	};
-} job_queue_entry_t;
-
-typedef struct job_queue_internal_t
-{
-    arena_t arena;
-
-    size_t thread_count;
-    job_thread_t *threads;
-
-    size_t queue_size;
-    job_queue_entry_t *entries;
-
-    volatile uint32_t next_read;
-    volatile uint32_t next_write;
-    volatile uint32_t jobs_in_flight;
+		win32_output_last_error(strlit16("GetLogicalProcessorInformationEx failed"));
+		return;
+	}
 
-    HANDLE event_stop;
-    HANDLE event_done;
+	char *buffer = HeapAlloc(GetProcessHeap(), 0, size);
 
-    HANDLE semaphore;
-} job_queue_internal_t;
+	if (!GetLogicalProcessorInformationEx(RelationAll, (SYSTEM_LOGICAL_PROCESSOR_INFORMATION_EX *)buffer, &size))
+	{
+		win32_output_last_error(strlit16("GetLogicalProcessorInformationEx failed"));
+		HeapFree(GetProcessHeap(), 0, buffer);
+		return;
+	}
 
-typedef struct job_proc_params_t
-{
-    job_queue_internal_t *queue;
-    int thread_index;
-} job_proc_params_t;
+	for (DWORD at = 0; at < size;)
+	{
+		SYSTEM_LOGICAL_PROCESSOR_INFORMATION_EX *info = (SYSTEM_LOGICAL_PROCESSOR_INFORMATION_EX *)(buffer + at);
+
+		switch (info->Relationship)
+		{
+			case RelationProcessorCore:
+			{
+				uint32_t core      = topology->core_count++;
+				uint32_t smt_index = 0;
+
+				for (WORD group_index = 0; group_index < info->Processor.GroupCount; group_index++)
+				{
+					const GROUP_AFFINITY *affinity = &info->Processor.GroupMask[group_index];
+					uint32_t base = win32_first_logical_processor_in_group(affinity->Group);
+
+					for (KAFFINITY mask = affinity->Mask; mask; mask &= mask - 1)
+					{
+						unsigned long bit;
+						bit_scan_forward64(&bit, mask);
+
+						uint32_t index = base + bit;
+
+						if (index < CPU_MAX_LOGICAL_PROCESSORS)
+						{
+							topology->logical_processors[index].core      = core;
+							topology->logical_processors[index].smt_index = smt_index++;
+							topology->logical_processor_count = MAX(topology->logical_processor_count, index + 1);
+						}
+					}
+				}
+			} break;
+
+			case RelationCache:
+			{
+				const CACHE_RELATIONSHIP *cache = &info->Cache;
+
+				if ((cache->Level == 2 || cache->Level == 3) && cache->Type != CacheInstruction)
+				{
+					uint32_t *group_count = cache->Level == 2 ? &topology->l2_group_count : &topology->l3_group_count;
+					uint32_t  group       = (*group_count)++;
+
+					uint32_t base = win32_first_logical_processor_in_group(cache->GroupMask.Group);
+
+					for (KAFFINITY mask = cache->GroupMask.Mask; mask; mask &= mask - 1)
+					{
+						unsigned long bit;
+						bit_scan_forward64(&bit, mask);
+
+						uint32_t index = base + bit;
+
+						if (index < CPU_MAX_LOGICAL_PROCESSORS)
+						{
+							if (cache->Level == 2) topology->logical_processors[index].l2_group = group;
+							else                   topology->logical_processors[index].l3_group = group;
+						}
+					}
+				}
+			} break;
+		}
+
+		at += info->Size;
+	}
 
-static DWORD WINAPI job_queue_thread_proc(void *params_)
-{
-    job_proc_params_t    *params = params_;
-    job_queue_internal_t *queue  = params->queue;
-
-    job_context_t context = {
-        .thread_index = params->thread_index,
-    };
-
-    for (;;)
-    {
-        uint32_t entry_index = queue->next_read;
-        if (entry_index != queue->next_write)
-        {
-            uint32_t next_entry_index = entry_index + 1;
-            uint32_t exchanged_index = InterlockedCompareExchange((volatile long *)&queue->next_read, next_entry_index, entry_index);
-
-            if (exchanged_index == entry_index)
-            {
-                job_queue_entry_t *entry = &queue->entries[entry_index % queue->queue_size];
-
-				void *userdata = entry->userdata_is_ptr ? entry->userdata_ptr : entry->userdata_u8;
-                entry->proc(&context, userdata);
-
-				m_reset_temp_arenas();
-
-                uint32_t jobs_count = InterlockedDecrement((volatile long *)&queue->jobs_in_flight);
-
-                // TODO: Looks questionable to me. Is this right?
-                if (jobs_count == 0)
-                    SetEvent(queue->event_done);
-            }
-        }
-        else
-        {
-            HANDLE handles[] = { queue->event_stop, queue->semaphore };
-
-            if (WaitForMultipleObjects(2, handles, FALSE, INFINITE) == WAIT_OBJECT_0)
-                break;
-        }
-    }
-
-    return 0;
+	HeapFree(GetProcessHeap(), 0, buffer);
 }
 
-job_queue_t create_job_queue(size_t thread_count, size_t queue_size)
+bool pin_current_thread(uint32_t logical_processor)
 {
-    job_queue_internal_t *queue = m_bootstrap(job_queue_internal_t, arena);
-
-    queue->thread_count = thread_count;
-    queue->threads = m_alloc_array(&queue->arena, thread_count, job_thread_t);
+	WORD group_count = GetActiveProcessorGroupCount();
 
-    queue->queue_size = queue_size;
-    queue->entries = m_alloc_array(&queue->arena, queue_size, job_queue_entry_t);
+	uint32_t base = 0;
 
-    queue->event_stop  = CreateEventA(NULL, TRUE, FALSE, NULL);
-    queue->event_done  = CreateEventA(NULL, TRUE, TRUE, NULL);
-
-    queue->semaphore = CreateSemaphoreA(NULL, 0, (LONG)thread_count, NULL);
+	for (WORD group = 0; group < group_count; group++)
+	{
+		uint32_t count = GetActiveProcessorCount(group);
 
-    // just keep these around who cares
-    job_proc_params_t *params = m_alloc_array(&queue->arena, thread_count, job_proc_params_t);
+		if (logical_processor < base + count)
+		{
+			GROUP_AFFINITY affinity = {
+				.Mask  = (KAFFINITY)1 << (logical_processor - base),
+				.Group = group,
+			};
 
-    for (size_t thread_index = 0; thread_index < thread_count; thread_index++)
-    {
-        job_proc_params_t *param = &params[thread_index];
-        param->queue        = queue;
-        param->thread_index = (int)thread_index;
+			return !!SetThreadGroupAffinity(GetCurrentThread(), &affinity, NULL);
+		}
 
-        job_thread_t *thread = &queue->threads[thread_index];
-        thread->handle = CreateThread(NULL, 0, job_queue_thread_proc, param, 0, NULL);
-    }
+		base += count;
+	}
 
-    job_queue_t result = { queue };
-    return result;
+	return false;
 }
 
-size_t get_job_queue_thread_count(job_queue_t handle)
+typedef struct win32_thread_params_t
 {
-    job_queue_internal_t *queue = handle.opaque;
-	return queue->thread_count;
-}
+	thread_proc_t proc;
+	void         *userdata;
+} win32_thread_params_t;
 
-void destroy_job_queue(job_queue_t handle)
+static DWORD WINAPI win32_thread_proc(void *params_)
 {
-    job_queue_internal_t *queue = handle.opaque;
-
-    SetEvent(queue->event_stop);
-    for (size_t thread_index = 0; thread_index < queue->thread_count; thread_index++)
-    {
-        job_thread_t *thread = &queue->threads[thread_index];
-        WaitForSingleObject(thread->handle, INFINITE);
-        CloseHandle(thread->handle);
-    }
-    CloseHandle(queue->event_stop);
-    CloseHandle(queue->event_done);
-    CloseHandle(queue->semaphore);
-
-    m_release(&queue->arena);
+	win32_thread_params_t params = *(win32_thread_params_t *)params_;
+	HeapFree(GetProcessHeap(), 0, params_);
+
+	params.proc(params.userdata);
+
+	// for threads that aren't job workers, which give back their magazines themselves
+	pool_release_thread();
+
+	return 0;
 }
 
-void add_job_to_queue_internal(job_queue_t handle, job_proc_t proc, void *userdata, size_t userdata_size, bool userdata_is_ptr)
+thread_t create_thread(thread_proc_t proc, void *userdata)
 {
-    job_queue_internal_t *queue = handle.opaque;
-
-    uint32_t write      = queue->next_write;
-    uint32_t next_write = write + 1;
+	win32_thread_params_t *params = HeapAlloc(GetProcessHeap(), 0, sizeof(win32_thread_params_t));
+	params->proc     = proc;
+	params->userdata = userdata;
 
-    job_queue_entry_t *entry = &queue->entries[write % queue->queue_size];
+	HANDLE handle = CreateThread(NULL, 0, win32_thread_proc, params, 0, NULL);
 
-	if (userdata_size > sizeof(entry->userdata_u8))
+	if (!handle)
 	{
-		FATAL_ERROR("Tried to add job with userdata that was larger than 64 bytes!");
+		HeapFree(GetProcessHeap(), 0, params);
+		win32_output_last_error(strlit16("create_thread failed"));
 	}
 
-    entry->proc = proc;
-	copy_memory(entry->userdata_u8, userdata, userdata_size);
-	entry->userdata_is_ptr = userdata_is_ptr;
-
-    MemoryBarrier();
-
-    queue->next_write = next_write;
-
-    InterlockedIncrement((volatile long *)&queue->jobs_in_flight);
-    ResetEvent(queue->event_done);
-
-    ReleaseSemaphore(queue->semaphore, 1, NULL);
+	thread_t result = { handle };
+	return result;
 }
 
-void add_job_to_queue(job_queue_t queue, job_proc_t proc, void *userdata)
+void join_thread(thread_t thread)
 {
-	add_job_to_queue_internal(queue, proc, &userdata, sizeof(userdata), true);
-}
-
-void add_job_to_queue_with_data_(job_queue_t queue, job_proc_t proc, void *userdata, size_t userdata_size)
-{
-	add_job_to_queue_internal(queue, proc, userdata, userdata_size, false);
-}
+	HANDLE handle = thread.opaque;
 
-void wait_on_queue(job_queue_t handle)
-{
-    job_queue_internal_t *queue = handle.opaque;
-
-    if (queue->jobs_in_flight > 0)
-        WaitForSingleObject(queue->event_done, INFINITE);
+	if (handle)
+	{
+		WaitForSingleObject(handle, INFINITE);
+		CloseHandle(handle);
+	}
 }
@@ -16,7 +16,7 @@ void cvar_register(cvar_t *cvar)
 		m_scoped_temp
 		{
 			string_t key_lower = string_to_lower(temp, cvar->key);
-			table_insert_object(&g_cvars->cvar_table, string_hash(key_lower), cvar);
+			concurrent_table_insert_object(&g_cvars->cvar_table, string_hash(key_lower), cvar);
 		}
 
 		cvar->flags |= CVarFlag_registered;
@@ -32,17 +32,29 @@ cvar_t *cvar_find(string_t key)
 	m_scoped_temp
 	{
 		string_t key_lower = string_to_lower(temp, key);
-		result = table_find_object(&g_cvars->cvar_table, string_hash(key_lower));
+		result = concurrent_table_find_object(&g_cvars->cvar_table, string_hash(key_lower));
 
-		DEBUG_ASSERT(string_match_nocase(result->key, key_lower));
+		DEBUG_ASSERT(!result || string_match_nocase(result->key, key_lower));
 	}
 
 	return result;
 }
 
+cvar_t *cvar_find_atom(atom_t key)
+{
+	ASSERT(g_cvars->initialized);
+
+	// the table is keyed by the hash of the lowercase key, which the atom already knows
+	cvar_t *result = concurrent_table_find_object(&g_cvars->cvar_table, atom_hash(key));
+
+	DEBUG_ASSERT(!result || string_match_nocase(result->key, string_from_atom(key)));
+
+	return result;
+}
+
 size_t get_cvar_count(void)
 {
-	return g_cvars->cvar_table.load;
+	return concurrent_table_count(&g_cvars->cvar_table);
 }
 
 null_term_string_t cvar_kind_to_string(cvar_kind_t kind)
@@ -282,9 +294,9 @@ void cvar_reset_to_default(cvar_t *cvar)
 	}
 }
 
-table_iter_t cvar_iter(void)
+concurrent_table_iter_t cvar_iter(void)
 {
-	return table_iter(&g_cvars->cvar_table);
+	return concurrent_table_iter(&g_cvars->cvar_table);
 }
 
 void equip_cvar_state(cvar_state_t *cvar_state)
@@ -77,7 +77,7 @@ typedef struct cvar_state_t
 {
 	bool initialized;
 
-	table_t cvar_table;
+	concurrent_table_t cvar_table;
 
 	arena_t       arena;
 	simple_heap_t string_allocator;
@@ -157,6 +157,7 @@ fn void cvar_state_init(cvar_state_t *cvar_state);
 
 fn void    cvar_register (cvar_t *cvar);
 fn cvar_t *cvar_find     (string_t key);
+fn cvar_t *cvar_find_atom(atom_t key); // key has to be all lowercase, saves cvar_find lowercasing and hashing the key every time
 fn size_t  get_cvar_count(void);
 
 fn bool     cvar_read_bool  (cvar_t *cvar);
@@ -174,4 +175,4 @@ fn void cvar_execute_command(cvar_t *cvar, string_t arguments);
 fn bool cvar_is_default(cvar_t *cvar);
 fn void cvar_reset_to_default(cvar_t *cvar);
 
-fn table_iter_t cvar_iter(void);
+fn concurrent_table_iter_t cvar_iter(void);
@@ -587,6 +587,8 @@ int wWinMain(HINSTANCE instance,
 	bool enable_d3d_debug = false;
 	bool enable_d3d_gbv   = false;
 
+	simd_tier_t simd_tier = query_cpu_features()->best_simd_tier;
+
 	for (int i = 0; i < argc; i++)
 	{
 		if (string_match(argv[i], S("-d3ddebug")))
@@ -598,8 +600,16 @@ int wWinMain(HINSTANCE instance,
 		{
 			enable_d3d_gbv = true;
 		}
+
+		// -simd sse2|avx2|avx512 caps the instruction set used by the simd kernels
+		if (string_match(argv[i], S("-simd")) && i + 1 < argc)
+		{
+			simd_tier_from_name(argv[i + 1], &simd_tier);
+		}
 	}
 
+	simd_select_tier(simd_tier);
+
 	platform_init((size_t)argc, argv, &hooks);
 
 	if (!hooks.tick && !hooks.tick_audio)
@@ -50,6 +50,7 @@ CVAR_COMMAND(ccmd_d3d12_report_live_objects, "rhi.d3d12.report_live_objects")
 rhi_state_t *rhi_init(const rhi_init_params_t *params)
 {
 	rhi_state_t *state = m_bootstrap(rhi_state_t, arena);
+	m_register_arena(&state->arena, S("rhi"));
 
 	rhi_equip_state(state);
 	rhi_init_d3d12(&(rhi_init_params_d3d12_t){
@@ -172,10 +173,10 @@ bool rhi_init_d3d12(const rhi_init_params_d3d12_t *params)
 
 	// initialize pools
 
-	g_rhi->windows  = (pool_t)INIT_POOL_EX(d3d12_window_t,  POOL_FLAGS_CONCURRENT);
-	g_rhi->buffers  = (pool_t)INIT_POOL_EX(d3d12_buffer_t,  POOL_FLAGS_CONCURRENT);
-	g_rhi->textures = (pool_t)INIT_POOL_EX(d3d12_texture_t, POOL_FLAGS_CONCURRENT);
-	g_rhi->psos     = (pool_t)INIT_POOL_EX(d3d12_pso_t,     POOL_FLAGS_CONCURRENT);
+	g_rhi->windows  = (pool_t)INIT_POOL_EX(d3d12_window_t,  POOL_FLAGS_LOCK_FREE);
+	g_rhi->buffers  = (pool_t)INIT_POOL_EX(d3d12_buffer_t,  POOL_FLAGS_LOCK_FREE);
+	g_rhi->textures = (pool_t)INIT_POOL_EX(d3d12_texture_t, POOL_FLAGS_LOCK_FREE);
+	g_rhi->psos     = (pool_t)INIT_POOL_EX(d3d12_pso_t,     POOL_FLAGS_LOCK_FREE);
 
 	//
 	//
@@ -56,6 +56,12 @@ typedef struct asset_slot_t
 
 	mutex_t mutex; // this is only used for sanity checking the threading, it shouldn't ever be contended
 
+	wait_group_t   loaded_from_disk; // ASSET_JOB_UPLOAD_TO_GPU runs after this
+	wait_group_t   uploaded;         // for images, asset_finish_load_job runs after this (or loaded_from_disk for anything else)
+	cancel_token_t load_cancel;      // cancelled by reload_asset if the file changes again while it's still loading, or by cancel_asset_loads
+	atomic bool    drop_load;        // set by cancel_asset_loads, so the cancelled load gets dropped instead of started over
+	image_t        pending_image;    // decoded by ASSET_JOB_LOAD_FROM_DISK, waiting to be uploaded
+
 	asset_hash_t hash;
 	asset_kind_t kind;
 
@@ -111,6 +117,7 @@ static void preload_asset_info(asset_slot_t *asset)
 asset_system_t *asset_system_make(void)
 {
 	asset_system_t *assets = m_bootstrap(asset_system_t, arena);
+	m_register_arena(&assets->arena, S("assets"));
 	assets->asset_store = (pool_t)INIT_POOL(asset_slot_t);
 
 	assets->asset_config.mix_sample_rate = DREAM_MIX_SAMPLE_RATE;
@@ -150,7 +157,7 @@ asset_system_t *asset_system_make(void)
 				asset->state = AssetState_on_disk;
 				string_into_storage(asset->path, entry->path);
 
-				table_insert_object(&assets->asset_index, asset->hash.value, asset);
+				concurrent_table_insert_object(&assets->asset_index, asset->hash.value, asset);
 
 				preload_asset_info(asset); // stuff like image dimensions we'd like to know right away
 			}
@@ -187,6 +194,7 @@ typedef enum asset_job_kind_t
 	ASSET_JOB_NONE,
 
 	ASSET_JOB_LOAD_FROM_DISK,
+	ASSET_JOB_UPLOAD_TO_GPU,
 
 	ASSET_JOB_COUNT,
 } asset_job_kind_t;
@@ -229,43 +237,16 @@ static void asset_job_proc(job_context_t *context, void *userdata)
 				break;
 
 			bool loaded_successfully = true;
+			bool needs_upload        = false;
 
 			switch (asset->kind)
 			{
 				case AssetKind_image:
 				{
-					if (RESOURCE_HANDLE_VALID(asset->image.rhi_texture))
-					{
-						rhi_destroy_texture(asset->image.rhi_texture);
-						NULLIFY_HANDLE(&asset->image.rhi_texture);
-					}
-
-					image_t image = load_image_from_disk(&asset->arena, string_from_storage(asset->path), 4);
-
-					asset->image.w         = image.info.w;
-					asset->image.h         = image.info.h;
-					asset->image.format    = PixelFormat_r8g8b8a8_unorm,
-					asset->image.mip_count = 1;
-					asset->image.mips[0]   = (image_mip_t){
-						.w     = image.info.w,
-						.h     = image.info.h,
-						.pitch = image.pitch,
-					};
-
-					asset->image.rhi_texture = rhi_create_texture(&(rhi_create_texture_params_t){
-						.debug_name = string_from_storage(asset->path),
-						.dimension  = RhiTextureDimension_2d,
-						.width      = image.info.w,
-						.height     = image.info.h,
-						.depth      = 1,
-						.mip_levels = 1,
-						.format     = PixelFormat_r8g8b8a8_unorm_srgb,
-						.initial_data = &(rhi_texture_data_t){
-							.subresources      = &image.pixels,
-							.subresource_count = 1,
-							.row_stride        = image.pitch,
-						},
-					});
+					asset->pending_image = load_image_from_disk(&asset->arena, string_from_storage(asset->path), 4);
+
+					// the image becomes resident once ASSET_JOB_UPLOAD_TO_GPU is done with it
+					needs_upload = true;
 				} break;
 
 				case AssetKind_waveform:
@@ -285,10 +266,57 @@ static void asset_job_proc(job_context_t *context, void *userdata)
 				} break;
 			}
 
-			if (loaded_successfully)
+			if (loaded_successfully && !needs_upload)
+			{
+				atomic_fetch_or(&asset->state, AssetState_resident);
+			}
+		} break;
+
+		case ASSET_JOB_UPLOAD_TO_GPU:
+		{
+			asset_state_t state = asset->state;
+
+			if (!(state & AssetState_being_loaded))
+				break;
+
+			ASSERT(asset->kind == AssetKind_image);
+
+			image_t *image = &asset->pending_image;
+
+			if (RESOURCE_HANDLE_VALID(asset->image.rhi_texture))
 			{
-				asset->state = (state & ~AssetState_being_loaded) | AssetState_resident;
+				rhi_destroy_texture(asset->image.rhi_texture);
+				NULLIFY_HANDLE(&asset->image.rhi_texture);
 			}
+
+			asset->image.w         = image->info.w;
+			asset->image.h         = image->info.h;
+			asset->image.format    = PixelFormat_r8g8b8a8_unorm,
+			asset->image.mip_count = 1;
+			asset->image.mips[0]   = (image_mip_t){
+				.w     = image->info.w,
+				.h     = image->info.h,
+				.pitch = image->pitch,
+			};
+
+			asset->image.rhi_texture = rhi_create_texture(&(rhi_create_texture_params_t){
+				.debug_name = string_from_storage(asset->path),
+				.dimension  = RhiTextureDimension_2d,
+				.width      = image->info.w,
+				.height     = image->info.h,
+				.depth      = 1,
+				.mip_levels = 1,
+				.format     = PixelFormat_r8g8b8a8_unorm_srgb,
+				.initial_data = &(rhi_texture_data_t){
+					.subresources      = &image->pixels,
+					.subresource_count = 1,
+					.row_stride        = image->pitch,
+				},
+			});
+
+			zero_struct(&asset->pending_image);
+
+			atomic_fetch_or(&asset->state, AssetState_resident);
 		} break;
 
         INVALID_DEFAULT_CASE;
@@ -302,6 +330,94 @@ static void asset_job_proc(job_context_t *context, void *userdata)
 	}
 }
 
+fn_local void dispatch_asset_load(asset_slot_t *asset, rhi_state_t *rhi_state);
+
+// Runs at the end of every load, cancelled or not, and is the only place AssetState_being_loaded gets cleared
+// for async loads. That way a new load can't start while jobs of the previous one are still around.
+fn_local void asset_finish_load_job(job_context_t *context, void *userdata)
+{
+	(void)context;
+
+	asset_job_t  *job   = userdata;
+	asset_slot_t *asset = job->asset;
+
+	// cancel_asset_loads cancelled this load, so it just ends here. The token stays cancelled until the next
+	// load resets it, which is fine because this was the last job carrying it
+	bool dropped = cancel_token_is_cancelled(&asset->load_cancel) && atomic_exchange(&asset->drop_load, false);
+
+	if (!dropped && cancel_token_is_cancelled(&asset->load_cancel))
+	{
+		// reload_asset cancelled this load, so start over (the asset is still marked as being loaded)
+		dispatch_asset_load(asset, job->rhi_state);
+		return;
+	}
+
+	atomic_fetch_and(&asset->state, ~(uint32_t)AssetState_being_loaded);
+
+	// reload_asset may have cancelled the load right before we cleared the flag, thinking it was still in progress
+	if (!dropped && cancel_token_is_cancelled(&asset->load_cancel) && !atomic_exchange(&asset->drop_load, false))
+	{
+		uint32_t state = atomic_load(&asset->state);
+
+		if (!(state & AssetState_being_loaded) &&
+			atomic_compare_exchange_strong(&asset->state, &state, state | AssetState_being_loaded))
+		{
+			dispatch_asset_load(asset, job->rhi_state);
+		}
+	}
+}
+
+// Loading an asset is a small job graph: images get decoded on one job, and uploaded on another once that's done,
+// then asset_finish_load_job wraps up. Asset loads are what the player is waiting on, so they go in at high priority.
+fn_local void dispatch_asset_load(asset_slot_t *asset, rhi_state_t *rhi_state)
+{
+	// asset_finish_load_job is the last job of a load, so whatever the previous load left in the queue is gone by now
+	cancel_token_reset(&asset->load_cancel);
+
+	asset_job_t load_job = {
+		.rhi_state = rhi_state,
+		.kind      = ASSET_JOB_LOAD_FROM_DISK,
+		.asset     = asset,
+	};
+	job_options_t load_options = {
+		.priority     = JobPriority_high,
+		.cancel_token = &asset->load_cancel,
+		.signal       = &asset->loaded_from_disk,
+	};
+	add_job_to_queue_ex_with_data(game_job_queue, &load_options, asset_job_proc, load_job);
+
+	wait_group_t *last_step = &asset->loaded_from_disk;
+
+	if (asset->kind == AssetKind_image)
+	{
+		asset_job_t upload_job = {
+			.rhi_state = rhi_state,
+			.kind      = ASSET_JOB_UPLOAD_TO_GPU,
+			.asset     = asset,
+		};
+		job_options_t upload_options = {
+			.priority     = JobPriority_high,
+			.cancel_token = &asset->load_cancel,
+			.run_after    = &asset->loaded_from_disk,
+			.signal       = &asset->uploaded,
+		};
+		add_job_to_queue_ex_with_data(game_job_queue, &upload_options, asset_job_proc, upload_job);
+
+		last_step = &asset->uploaded;
+	}
+
+	job_options_t finish_options = {
+		.priority        = JobPriority_high,
+		.run_after       = last_step,
+		.not_cancellable = true,
+	};
+	asset_job_t finish_job = {
+		.rhi_state = rhi_state, // for starting the load over, asset_finish_load_job doesn't touch the RHI itself
+		.asset     = asset,
+	};
+	add_job_to_queue_ex_with_data(game_job_queue, &finish_options, asset_finish_load_job, finish_job);
+}
+
 void process_asset_changes(void)
 {
 	asset_system_t *assets = asset_system_get();
@@ -331,7 +447,7 @@ bool asset_exists(asset_hash_t hash, asset_kind_t kind)
 {
 	asset_system_t *assets = asset_system_get();
 
-	asset_slot_t *asset = table_find_object(&assets->asset_index, hash.value);
+	asset_slot_t *asset = concurrent_table_find_object(&assets->asset_index, hash.value);
 	return asset && asset->kind == kind;
 }
 
@@ -341,7 +457,7 @@ string_t get_asset_path_on_disk(asset_hash_t hash)
 
     string_t result = {0};
 
-	asset_slot_t *asset = table_find_object(&assets->asset_index, hash.value);
+	asset_slot_t *asset = concurrent_table_find_object(&assets->asset_index, hash.value);
 
     int64_t state = asset->state;
     if (state >= AssetState_on_disk) // not sure this greater than thing is a great(er than) idea
@@ -356,7 +472,7 @@ static asset_slot_t *get_or_load_asset_async(asset_hash_t hash, asset_kind_t kin
 {
 	asset_system_t *assets = asset_system_get();
 
-	asset_slot_t *asset = table_find_object(&assets->asset_index, hash.value);
+	asset_slot_t *asset = concurrent_table_find_object(&assets->asset_index, hash.value);
 	if (asset && asset->kind == kind)
 	{
 		uint32_t state     = asset->state;
@@ -367,12 +483,7 @@ static asset_slot_t *get_or_load_asset_async(asset_hash_t hash, asset_kind_t kin
 		if (should_load &&
 			atomic_compare_exchange_strong(&asset->state, &state, new_state))
 		{
-			asset_job_t job = {
-				.rhi_state = NON_NULL(g_rhi),
-				.kind  = ASSET_JOB_LOAD_FROM_DISK,
-				.asset = asset,
-			};
-			add_job_to_queue_with_data(low_priority_job_queue, asset_job_proc, job);
+			dispatch_asset_load(asset, NON_NULL(g_rhi));
 		}
 	}
 	return asset;
@@ -382,7 +493,7 @@ static asset_slot_t *get_or_load_asset_blocking(asset_hash_t hash, asset_kind_t
 {
 	asset_system_t *assets = asset_system_get();
 
-	asset_slot_t *asset = table_find_object(&assets->asset_index, hash.value);
+	asset_slot_t *asset = concurrent_table_find_object(&assets->asset_index, hash.value);
 	if (asset && asset->kind == kind)
 	{
 		uint32_t state     = asset->state;
@@ -401,6 +512,14 @@ static asset_slot_t *get_or_load_asset_blocking(asset_hash_t hash, asset_kind_t
 
 			job_context_t context = { 0 };
 			asset_job_proc(&context, &job);
+
+			if (asset->kind == AssetKind_image)
+			{
+				job.kind = ASSET_JOB_UPLOAD_TO_GPU;
+				asset_job_proc(&context, &job);
+			}
+
+			atomic_fetch_and(&asset->state, ~(uint32_t)AssetState_being_loaded);
 		}
 	}
 	return asset;
@@ -410,9 +529,16 @@ void reload_asset(asset_hash_t hash)
 {
 	asset_system_t *assets = asset_system_get();
 
-	asset_slot_t *asset = table_find_object(&assets->asset_index, hash.value);
+	asset_slot_t *asset = concurrent_table_find_object(&assets->asset_index, hash.value);
 	if (asset)
 	{
+		if (asset->state & AssetState_being_loaded)
+		{
+			// the file changed again before the last load finished, asset_finish_load_job will start it over
+			atomic_store(&asset->drop_load, false);
+			cancel_token_cancel(&asset->load_cancel);
+		}
+
 		uint32_t state     = asset->state;
 		uint32_t new_state = state | AssetState_being_loaded;
 
@@ -421,12 +547,26 @@ void reload_asset(asset_hash_t hash)
 		if (should_load &&
 			atomic_compare_exchange_strong(&asset->state, &state, new_state))
 		{
-			asset_job_t job = {
-				.rhi_state = NON_NULL(g_rhi),
-				.kind  = ASSET_JOB_LOAD_FROM_DISK,
-				.asset = asset,
-			};
-			add_job_to_queue_with_data(low_priority_job_queue, asset_job_proc, job);
+			dispatch_asset_load(asset, NON_NULL(g_rhi));
+		}
+	}
+}
+
+void cancel_asset_loads(void)
+{
+	asset_system_t *assets = asset_system_get();
+
+	// assets only get added by asset_system_make, so the store can be walked while jobs are loading
+	for (pool_iter_t it = pool_iter(&assets->asset_store);
+		 pool_iter_valid(&it);
+		 pool_iter_next(&it))
+	{
+		asset_slot_t *asset = it.data;
+
+		if (asset->state & AssetState_being_loaded)
+		{
+			atomic_store(&asset->drop_load, true);
+			cancel_token_cancel(&asset->load_cancel);
 		}
 	}
 }
@@ -450,7 +590,7 @@ image_info_t get_image_info(asset_hash_t hash)
 
 	image_info_t result = {0};
 
-	asset_slot_t *asset = table_find_object(&assets->asset_index, hash.value);
+	asset_slot_t *asset = concurrent_table_find_object(&assets->asset_index, hash.value);
 	if (asset && asset->kind == AssetKind_image)
 	{
 		result.w      = asset->image.w;
@@ -121,14 +121,14 @@ typedef struct asset_config_t
 
 typedef struct asset_system_t
 {
-	asset_image_t  missing_image;
-	waveform_t     missing_waveform;
-
-	arena_t        arena;
-	pool_t         asset_store;
-	table_t        asset_index;
-	asset_config_t asset_config;
-	file_watcher_t asset_watcher;
+	asset_image_t      missing_image;
+	waveform_t         missing_waveform;
+
+	arena_t            arena;
+	pool_t             asset_store;
+	concurrent_table_t asset_index; // looked up from job threads
+	asset_config_t     asset_config;
+	file_watcher_t     asset_watcher;
 } asset_system_t;
 
 thread_local asset_system_t *g_assets;
@@ -152,6 +152,9 @@ fn waveform_t    missing_waveform;
 fn bool        asset_exists          (asset_hash_t hash, asset_kind_t kind);
 fn string_t    get_asset_path_on_disk(asset_hash_t hash); 
 fn void        reload_asset          (asset_hash_t hash);
+// Drops every async load that's still in flight. Jobs that haven't started yet never run, and the assets go back
+// to not being loaded, so they get loaded again by the next get_image/get_waveform that wants them.
+fn void        cancel_asset_loads    (void);
 
 fn asset_image_t *get_image            (asset_hash_t hash);
 fn image_info_t   get_image_info       (asset_hash_t hash);
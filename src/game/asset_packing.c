@@ -7,14 +7,6 @@ typedef struct pack_job_t
 	string_t path;
 } pack_job_t;
 
-typedef struct pack_job_group_t
-{
-	pack_context_t *context;
-
-	pack_job_t *jobs;
-	size_t      jobs_count;
-} pack_job_group_t;
-
 typedef struct pack_context_t
 {
 	arena_t arena;
@@ -24,6 +16,8 @@ typedef struct pack_context_t
 	mutex_t pack_file_mutex;
 	pack_file_t *pack_file;
 
+	wait_group_t jobs_done; // write_pack_file_job runs after this
+
 	bool dispatched;
 } pack_context_t;
 
@@ -65,7 +59,8 @@ fn_local pack_job_t *add_pack_job(pack_context_t *context, pack_asset_kind_t kin
 	return job;
 }
 
-fn_local void process_pack_job(job_context_t *job_context, void *userdata);
+fn_local void process_pack_jobs  (job_context_t *job_context, void *userdata, size_t first, size_t one_past_last);
+fn_local void write_pack_file_job(job_context_t *job_context, void *userdata);
 
 fn_local uint64_t get_pointer_offset_u64(void *base, void *data)
 {
@@ -93,38 +88,14 @@ fn_local void dispatch_pack_jobs(pack_context_t *context)
 	header->textures_offset = get_pointer_offset_u64(header, textures);
 	header->sounds_offset   = get_pointer_offset_u64(header, sounds);
 
-	uint32_t jobs_count        = sb_count(context->jobs);
-	uint32_t dispatch_count    = 16;
-	uint32_t jobs_per_dispatch = (jobs_count + dispatch_count - 1) / dispatch_count;
-
-	size_t      jobs_left = jobs_count;
-	pack_job_t *jobs      = context->jobs;
-	for (size_t i = 0; i < dispatch_count; i++)
-	{
-		pack_job_group_t *group = m_alloc_struct(&context->arena, pack_job_group_t);
-		group->context    = context;
-		group->jobs       = jobs;
-		group->jobs_count = MIN(jobs_left, jobs_per_dispatch);
-
-		add_job_to_queue(low_priority_job_queue, process_pack_job, group);
+	// every asset is a decent chunk of work, so let them be split all the way down to single assets
+	parallel_for_async(game_job_queue, sb_count(context->jobs), 1, process_pack_jobs, context, &context->jobs_done);
 
-		jobs_left -= group->jobs_count;
-		jobs      += group->jobs_count;
-	}
+	add_job_to_queue_after(game_job_queue, &context->jobs_done, NULL, write_pack_file_job, context);
 
 	context->dispatched = true;
 }
 
-fn_local void wait_on_pack_jobs(pack_context_t *context)
-{
-	ASSERT(context->dispatched);
-
-	if (sb_count(context->jobs) > 0)
-	{
-		wait_on_queue(low_priority_job_queue);
-	}
-}
-
 void pack_assets(string_t source_directory)
 {
 	pack_context_t *context = create_pack_context();
@@ -155,10 +126,16 @@ void pack_assets(string_t source_directory)
 		}
 	}
 
+	// the pack file gets written by a job once all the assets are processed, so this doesn't block
 	dispatch_pack_jobs(context);
-	wait_on_pack_jobs (context);
+}
 
-	pack_file_t *pack_file = context->pack_file;
+void write_pack_file_job(job_context_t *job_context, void *userdata)
+{
+	(void)job_context;
+
+	pack_context_t *context   = userdata;
+	pack_file_t    *pack_file = context->pack_file;
 
 	uint64_t header_offset = get_pointer_offset_u64(pack_file->arena.buffer, pack_file->header);
 
@@ -168,20 +145,24 @@ void pack_assets(string_t source_directory)
 	};
 
 	fs_write_entire_file(S("pack_test.pak"), pack_file_data);
+
+	log(AssetPacker, Info, "Wrote pack file with %llu assets", pack_file->header->assets_count);
+
+	m_release(&pack_file->arena);
+	m_release(&context->arena);
 }
 
-void process_pack_job(job_context_t *job_context, void *userdata)
+void process_pack_jobs(job_context_t *job_context, void *userdata, size_t first, size_t one_past_last)
 {
 	(void)job_context;
 
-	pack_job_group_t *group   = userdata;
-	pack_context_t   *context = group->context;
+	pack_context_t *context = userdata;
 
-	for (size_t job_index = 0; job_index < group->jobs_count; job_index++)
+	for (size_t job_index = first; job_index < one_past_last; job_index++)
 	{
 		arena_t *temp = m_get_temp_scope_begin(NULL, 0);
 
-		pack_job_t *job = &group->jobs[job_index];
+		pack_job_t *job = &context->jobs[job_index];
 
 		mutex_t       *pack_mutex = &context->pack_file_mutex;
 		arena_t       *pack_arena = &context->pack_file->arena;
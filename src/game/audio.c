@@ -445,6 +445,8 @@ void mix_samples(uint32_t frames_to_mix, float *buffer)
 
     float *mix_buffer = m_alloc_array(temp, mix_channel_count*frames_to_mix, float);
 
+	const simd_kernels_t *simd = simd_kernels();
+
 	for (pool_iter_t it = pool_iter(&mixer.playing_sounds);
 		 pool_iter_valid(&it);
 		 pool_iter_next(&it))
@@ -497,92 +499,93 @@ void mix_samples(uint32_t frames_to_mix, float *buffer)
 		float base_volume = playing->volume;
 		base_volume *= mixer.category_volumes[playing->category];
 
-		for (size_t src_channel_index = 0; src_channel_index < waveform->channel_count; src_channel_index++)
-		{
-			int16_t *start = waveform_channel(waveform, src_channel_index);
-
-			if (NEVER(!start))
-				continue;
+		//
+		// process fades
+		//
 
-			start += playing->at_index;
+		float *volumes = m_alloc_array_nozero(temp, frames_to_write, float);
 
-			int16_t *end = start + waveform->frame_count;
-			int16_t *src = start;
+		for (size_t frame_index = 0; frame_index < frames_to_write; frame_index++)
+		{
+			float volume_mod = 1.0f;
 
-			for (size_t frame_index = 0; frame_index < frames_to_write; frame_index++)
+			for (fade_t *fade = playing->first_fade; fade; fade = fade->next)
 			{
-				// wrap looping sounds
-
-				if (src >= end)
-				{
-					size_t diff = end - src;
-					src = start + diff;
-				}
+				size_t fade_frame_index = fade->frame_index + frame_index;
 
-				//
-				// process fades
-				//
-
-				float volume_mod = 1.0f;
-
-				for (fade_t *fade = playing->first_fade; fade; fade = fade->next)
+				if (fade_frame_index < fade->frame_duration)
 				{
-					size_t fade_frame_index = fade->frame_index + frame_index;
+					float t = (float)fade_frame_index / (float)fade->frame_duration;
 
-					if (fade_frame_index < fade->frame_duration)
+					switch (fade->style)
 					{
-						float t = (float)fade_frame_index / (float)fade->frame_duration;
+						case FADE_STYLE_LINEAR:
+						{
+							// nothing to do
+						} break;
 
-						switch (fade->style)
+						case FADE_STYLE_SMOOTHSTEP:
 						{
-							case FADE_STYLE_LINEAR:
-							{
-								// nothing to do
-							} break;
-
-							case FADE_STYLE_SMOOTHSTEP:
-							{
-								t = smoothstep(t);
-							} break;
-
-							case FADE_STYLE_SMOOTHERSTEP:
-							{
-								t = smootherstep(t);
-							} break;
-						}
-
-						float fade_value = lerp(fade->start, fade->target, t);
-						
-						if (fade->flags & FADE_TARGET_VOLUME)
+							t = smoothstep(t);
+						} break;
+
+						case FADE_STYLE_SMOOTHERSTEP:
 						{
-							volume_mod *= fade_value;
-						}
+							t = smootherstep(t);
+						} break;
 					}
-					else
+
+					float fade_value = lerp(fade->start, fade->target, t);
+					
+					if (fade->flags & FADE_TARGET_VOLUME)
 					{
-						if (fade->flags & FADE_STOP_SOUND_WHEN_FINISHED)
-						{
-							sound_should_stop = true;
-							volume_mod        = 0.0f;
-						}
+						volume_mod *= fade_value;
+					}
+				}
+				else
+				{
+					if (fade->flags & FADE_STOP_SOUND_WHEN_FINISHED)
+					{
+						sound_should_stop = true;
+						volume_mod        = 0.0f;
 					}
 				}
+			}
+
+			volumes[frame_index] = base_volume*volume_mod;
+		}
+
+		//
+		// mix samples
+		//
+
+		for (size_t src_channel_index = 0; src_channel_index < waveform->channel_count; src_channel_index++)
+		{
+			int16_t *channel = waveform_channel(waveform, src_channel_index);
 
-				//
-				// mix samples
-				//
+			if (NEVER(!channel))
+				continue;
+
+			for (size_t dst_channel_index = 0; dst_channel_index < mix_channel_count; dst_channel_index++)
+			{
+				float mix_mapping = channel_matrix.m[src_channel_index][dst_channel_index];
 
-				float sample = snorm_from_s16(*src++);
+				if (mix_mapping == 0.0f)
+					continue;
 
-				float volume = base_volume*volume_mod;
-				sample *= volume;
+				float *dst = mix_buffer + dst_channel_index*frames_to_mix;
 
-				for (size_t dst_channel_index = 0; dst_channel_index < mix_channel_count; dst_channel_index++)
+				// looping sounds wrap around to the start of the channel
+				size_t src_index = playing->at_index;
+
+				for (size_t frame_index = 0; frame_index < frames_to_write;)
 				{
-					float mix_mapping = channel_matrix.m[src_channel_index][dst_channel_index];
+					size_t run = MIN(frames_to_write - frame_index, waveform->frame_count - src_index);
+
+					simd->mix_s16(dst + frame_index, channel + src_index, volumes + frame_index, mix_mapping, run);
 
-					float *dst = mix_buffer + dst_channel_index*frames_to_mix + frame_index;
-					*dst += mix_mapping*sample;
+					frame_index += run;
+					src_index    = 0;
 				}
 			}
         }
@@ -637,14 +640,7 @@ void mix_samples(uint32_t frames_to_mix, float *buffer)
         {
             float *src_l = mix_buffer;
             float *src_r = mix_buffer + frames_to_mix;
-            for (size_t frame_index = 0; frame_index < frames_to_mix; frame_index++)
-            {
-				float l = *src_l++;
-				float r = *src_r++;
-
-                *dst++ = limit(l);
-                *dst++ = limit(r);
-            }
+			simd->clamp_interleave_stereo(dst, src_l, src_r, frames_to_mix);
         }
         else
         {
@@ -0,0 +1,3564 @@
+// ============================================================
+// Copyright 2024 by Daniël Cornelisse, All Rights Reserved.
+// ============================================================
+
+//
+// bench.jobs
+//
+
+typedef struct bench_jobs_t
+{
+	job_queue_t queue;
+	uint32_t    spawn_count;
+
+	alignas(CACHE_LINE_SIZE) atomic uint64_t counter;
+} bench_jobs_t;
+
+fn_local void bench_tiny_job(job_context_t *context, void *userdata)
+{
+	(void)context;
+
+	bench_jobs_t *bench = userdata;
+	atomic_fetch_add_explicit(&bench->counter, 1, memory_order_relaxed);
+}
+
+fn_local void bench_spawner_job(job_context_t *context, void *userdata)
+{
+	(void)context;
+
+	bench_jobs_t *bench = userdata;
+
+	for (size_t i = 0; i < bench->spawn_count; i++)
+	{
+		add_job_to_queue(bench->queue, bench_tiny_job, bench);
+	}
+
+	atomic_fetch_add_explicit(&bench->counter, 1, memory_order_relaxed);
+}
+
+typedef struct bench_producer_t
+{
+	bench_jobs_t *bench;
+	int64_t       job_count;
+	bool          batched;
+} bench_producer_t;
+
+fn_local void bench_producer_thread(void *userdata)
+{
+	bench_producer_t *producer = userdata;
+	bench_jobs_t     *bench    = producer->bench;
+
+	if (producer->batched)
+	{
+		add_jobs_to_queue(bench->queue, NULL, (size_t)producer->job_count, bench_tiny_job, bench, 0);
+	}
+	else
+	{
+		for (int64_t i = 0; i < producer->job_count; i++)
+		{
+			add_job_to_queue(bench->queue, bench_tiny_job, bench);
+		}
+	}
+}
+
+// submits job_count jobs split over producer_count threads that aren't part of the queue
+fn_local void bench_producers(bench_jobs_t *bench, size_t producer_count, int64_t job_count, bool batched)
+{
+	bench_producer_t producers[16];
+	thread_t         threads  [16];
+
+	producer_count = MIN(producer_count, ARRAY_COUNT(producers));
+
+	for (size_t i = 0; i < producer_count; i++)
+	{
+		producers[i] = (bench_producer_t){
+			.bench     = bench,
+			.job_count = job_count / (int64_t)producer_count + ((int64_t)i < job_count % (int64_t)producer_count),
+			.batched   = batched,
+		};
+
+		threads[i] = create_thread(bench_producer_thread, &producers[i]);
+	}
+
+	for (size_t i = 0; i < producer_count; i++)
+	{
+		join_thread(threads[i]);
+	}
+}
+
+CVAR_COMMAND(ccmd_bench_jobs, "bench.jobs")
+{
+	int64_t job_count = 1 << 18;
+
+	string_t first_argument = string_split_word(&arguments);
+
+	if (first_argument.count > 0)
+	{
+		string_parse_int(&first_argument, &job_count);
+	}
+
+	size_t max_thread_count = query_processor_count();
+
+	log(Benchmark, Info, "bench.jobs: %lld jobs per run, up to %zu threads", job_count, max_thread_count);
+
+	for (size_t thread_count = 1; thread_count <= max_thread_count; thread_count *= 2)
+	{
+		bench_jobs_t bench = {
+			.queue       = create_job_queue(thread_count, 1024),
+			.spawn_count = 64,
+		};
+
+		// flat: many tiny jobs submitted from outside the queue, all contending on the submission ring
+		{
+			atomic_store(&bench.counter, 0);
+
+			hires_time_t start = os_hires_time();
+
+			for (int64_t i = 0; i < job_count; i++)
+			{
+				add_job_to_queue(bench.queue, bench_tiny_job, &bench);
+			}
+
+			wait_on_queue(bench.queue);
+
+			double seconds = os_seconds_elapsed(start, os_hires_time());
+
+			ASSERT(atomic_load(&bench.counter) == (uint64_t)job_count);
+
+			log(Benchmark, Info, "  %2zu threads, %-22s %8.2f ms, %6.2f Mjobs/s",
+				thread_count, "flat:", 1000.0*seconds, (double)job_count / seconds / 1000000.0);
+		}
+
+		// batched: the same jobs added with a single call, so the ring is filled in chunks with one wake-up each
+		{
+			atomic_store(&bench.counter, 0);
+
+			hires_time_t start = os_hires_time();
+
+			add_jobs_to_queue(bench.queue, NULL, (size_t)job_count, bench_tiny_job, &bench, 0);
+			wait_on_queue(bench.queue);
+
+			double seconds = os_seconds_elapsed(start, os_hires_time());
+
+			ASSERT(atomic_load(&bench.counter) == (uint64_t)job_count);
+
+			log(Benchmark, Info, "  %2zu threads, %-22s %8.2f ms, %6.2f Mjobs/s",
+				thread_count, "batch:", 1000.0*seconds, (double)job_count / seconds / 1000000.0);
+		}
+
+		// multi-producer: four threads submitting at the same time, one job at a time and batched
+		for (int batched = 0; batched < 2; batched++)
+		{
+			atomic_store(&bench.counter, 0);
+
+			hires_time_t start = os_hires_time();
+
+			bench_producers(&bench, 4, job_count, batched);
+			wait_on_queue(bench.queue);
+
+			double seconds = os_seconds_elapsed(start, os_hires_time());
+
+			ASSERT(atomic_load(&bench.counter) == (uint64_t)job_count);
+
+			log(Benchmark, Info, "  %2zu threads, %-22s %8.2f ms, %6.2f Mjobs/s",
+				thread_count, batched ? "4 producers, batch:" : "4 producers:", 1000.0*seconds, (double)job_count / seconds / 1000000.0);
+		}
+
+		// nested: jobs spawning jobs, which land on the workers' own deques and get spread out by stealing
+		{
+			atomic_store(&bench.counter, 0);
+
+			int64_t spawner_count = MAX(1, job_count / (bench.spawn_count + 1));
+			int64_t total_count   = spawner_count*(bench.spawn_count + 1);
+
+			hires_time_t start = os_hires_time();
+
+			for (int64_t i = 0; i < spawner_count; i++)
+			{
+				add_job_to_queue(bench.queue, bench_spawner_job, &bench);
+			}
+
+			wait_on_queue(bench.queue);
+
+			double seconds = os_seconds_elapsed(start, os_hires_time());
+
+			ASSERT(atomic_load(&bench.counter) == (uint64_t)total_count);
+
+			log(Benchmark, Info, "  %2zu threads, %-22s %8.2f ms, %6.2f Mjobs/s",
+				thread_count, "nested:", 1000.0*seconds, (double)total_count / seconds / 1000000.0);
+		}
+
+		destroy_job_queue(bench.queue);
+	}
+}
+
+//
+// bench.fibers
+//
+
+typedef struct bench_chain_t
+{
+	job_queue_t      queue;
+	int64_t          depth;
+	atomic uint64_t *counter;
+} bench_chain_t;
+
+// every link in the chain waits on the next one, so all of them are alive at the same time
+fn_local void bench_chain_job(job_context_t *context, void *userdata)
+{
+	(void)context;
+
+	bench_chain_t chain = *(bench_chain_t *)userdata;
+
+	if (chain.depth > 1)
+	{
+		wait_group_t child_done = {0};
+
+		bench_chain_t child = chain;
+		child.depth -= 1;
+
+		add_job_to_queue_after_with_data(chain.queue, NULL, &child_done, bench_chain_job, child);
+		job_wait(&child_done);
+	}
+
+	atomic_fetch_add_explicit(chain.counter, 1, memory_order_relaxed);
+}
+
+fn_local void bench_chains(job_queue_t queue, string_t name, int64_t chain_count, int64_t depth)
+{
+	atomic uint64_t counter = 0;
+
+	wait_group_t chains_done = {0};
+
+	hires_time_t start = os_hires_time();
+
+	for (int64_t i = 0; i < chain_count; i++)
+	{
+		bench_chain_t chain = {
+			.queue   = queue,
+			.depth   = depth,
+			.counter = &counter,
+		};
+
+		add_job_to_queue_after_with_data(queue, NULL, &chains_done, bench_chain_job, chain);
+	}
+
+	wait_group_wait(&chains_done);
+
+	double seconds = os_seconds_elapsed(start, os_hires_time());
+
+	ASSERT(atomic_load(&counter) == (uint64_t)(chain_count*depth));
+
+	log(Benchmark, Info, "  %cs: %8.2f ms, %6.2f Mjobs/s",
+		name, 1000.0*seconds, (double)(chain_count*depth) / seconds / 1000000.0);
+}
+
+CVAR_COMMAND(ccmd_bench_fibers, "bench.fibers")
+{
+	int64_t depth = 64;
+
+	string_t first_argument = string_split_word(&arguments);
+
+	if (first_argument.count > 0)
+	{
+		string_parse_int(&first_argument, &depth);
+	}
+
+	size_t  thread_count = query_processor_count();
+	int64_t chain_count  = (int64_t)thread_count;
+
+	// enough fibers for every link of every chain, so nothing falls back to running on the thread
+	size_t fiber_count      = (size_t)(chain_count*depth);
+	size_t fiber_stack_size = KB(64);
+
+	log(Benchmark, Info, "bench.fibers: %lld chains of depth %lld, %zu threads, %zu fibers",
+		chain_count, depth, thread_count, fiber_count);
+
+	job_queue_t thread_queue = create_job_queue(thread_count, 1024);
+	job_queue_t fiber_queue  = create_job_queue_with_fibers(thread_count, 1024, fiber_count, fiber_stack_size);
+
+	// without fibers, job_wait runs other jobs on top of the waiting one, so chains recurse on the worker's stack
+	bench_chains(thread_queue, S("threads"), chain_count, depth);
+	bench_chains(fiber_queue,  S("fibers"),  chain_count, depth);
+
+	destroy_job_queue(thread_queue);
+	destroy_job_queue(fiber_queue);
+}
+
+//
+// test.jobs
+//
+
+// runs the job queue stress test from core (thread_stress_test.c), which can also be built standalone
+CVAR_COMMAND(ccmd_test_jobs, "test.jobs")
+{
+	int64_t round_count = 64;
+	int64_t seed        = (int64_t)(os_hires_time().value & 0x7FFFFFFF);
+
+	string_t first_argument  = string_split_word(&arguments);
+	string_t second_argument = string_split_word(&arguments);
+
+	if (first_argument.count > 0)
+	{
+		string_parse_int(&first_argument, &round_count);
+	}
+
+	if (second_argument.count > 0)
+	{
+		string_parse_int(&second_argument, &seed);
+	}
+
+	log(Benchmark, Info, "test.jobs: %lld rounds, seed %lld", round_count, seed);
+
+	hires_time_t start = os_hires_time();
+
+	uint64_t failures = job_stress_test(round_count, (uint32_t)seed);
+
+	double seconds = os_seconds_elapsed(start, os_hires_time());
+
+	if (failures > 0)
+	{
+		log(Benchmark, Error, "test.jobs: %llu failures in %lld rounds (seed %lld)", failures, round_count, seed);
+	}
+	else
+	{
+		log(Benchmark, Info, "test.jobs: passed %lld rounds in %.2f s", round_count, seconds);
+	}
+}
+
+//
+// bench.pool
+//
+
+typedef struct bench_pool_item_t
+{
+	uint32_t owner;
+	uint32_t payload[7];
+} bench_pool_item_t;
+
+#define BENCH_POOL_LIVE_COUNT    256
+#define BENCH_POOL_MAILBOX_COUNT 64
+
+typedef struct bench_pool_t
+{
+	pool_t pool;
+
+	int64_t ops_per_thread;
+
+	alignas(CACHE_LINE_SIZE) atomic bool     go;
+	alignas(CACHE_LINE_SIZE) atomic uint64_t errors;
+
+	// handles get swapped through here so items also get freed by threads that didn't allocate them
+	alignas(CACHE_LINE_SIZE) atomic uint64_t mailboxes[BENCH_POOL_MAILBOX_COUNT];
+} bench_pool_t;
+
+typedef struct bench_pool_thread_t
+{
+	bench_pool_t *bench;
+	uint32_t      owner;
+} bench_pool_thread_t;
+
+fn_local void bench_pool_thread(void *userdata)
+{
+	bench_pool_thread_t *thread = userdata;
+	bench_pool_t        *bench  = thread->bench;
+	pool_t              *pool   = &bench->pool;
+
+	random_series_t entropy = { .state = 0x9E3779B9u*thread->owner | 1 };
+
+	resource_handle_t live[BENCH_POOL_LIVE_COUNT];
+	size_t live_count = 0;
+
+	uint64_t errors = 0;
+
+	while (!atomic_load_explicit(&bench->go, memory_order_acquire))
+	{
+		_mm_pause();
+	}
+
+	for (int64_t i = 0; i < bench->ops_per_thread; i++)
+	{
+		uint32_t roll = random_choice(&entropy, 16);
+
+		if (live_count == 0 || (live_count < BENCH_POOL_LIVE_COUNT && roll < 8))
+		{
+			bench_pool_item_t *item = pool_add(pool);
+
+			// a fresh item has to be zeroed, anything else means two threads got handed the same one
+			errors += (item->owner != 0);
+
+			item->owner = thread->owner;
+			live[live_count++] = pool_get_handle(pool, item);
+		}
+		else if (roll == 8)
+		{
+			size_t at = random_choice(&entropy, (uint32_t)live_count);
+
+			atomic uint64_t *mailbox = &bench->mailboxes[random_choice(&entropy, BENCH_POOL_MAILBOX_COUNT)];
+
+			resource_handle_t given = live[at];
+
+			bench_pool_item_t *item = pool_get(pool, given);
+			errors += (!item || item->owner != thread->owner);
+
+			if (item) item->owner = 0xFFFFFFFF; // in transit
+
+			resource_handle_t received = { .value = atomic_exchange(mailbox, given.value) };
+
+			if (received.value)
+			{
+				bench_pool_item_t *received_item = pool_get(pool, received);
+				errors += (!received_item || received_item->owner != 0xFFFFFFFF);
+
+				if (received_item) received_item->owner = thread->owner;
+
+				live[at] = received;
+			}
+			else
+			{
+				live[at] = live[--live_count];
+			}
+		}
+		else
+		{
+			size_t at = random_choice(&entropy, (uint32_t)live_count);
+
+			bench_pool_item_t *item = pool_get(pool, live[at]);
+			errors += (!item);
+
+			// removing the same handle twice has to fail the second time
+			errors += !pool_rem(pool, live[at]);
+			errors += (pool_get(pool, live[at]) != NULL);
+
+			live[at] = live[--live_count];
+		}
+	}
+
+	for (size_t i = 0; i < live_count; i++)
+	{
+		errors += !pool_rem(pool, live[i]);
+	}
+
+	atomic_fetch_add(&bench->errors, errors);
+}
+
+// runs ops_per_thread random adds, removes and cross-thread handoffs on each of thread_count threads
+fn_local double bench_pool_run(bench_pool_t *bench, size_t thread_count)
+{
+	bench_pool_thread_t threads_data[64];
+	thread_t            threads     [64];
+
+	thread_count = MIN(thread_count, ARRAY_COUNT(threads));
+
+	atomic_store(&bench->go, false);
+
+	for (size_t i = 0; i < thread_count; i++)
+	{
+		threads_data[i] = (bench_pool_thread_t){
+			.bench = bench,
+			.owner = (uint32_t)i + 1,
+		};
+
+		threads[i] = create_thread(bench_pool_thread, &threads_data[i]);
+	}
+
+	hires_time_t start = os_hires_time();
+
+	atomic_store_explicit(&bench->go, true, memory_order_release);
+
+	for (size_t i = 0; i < thread_count; i++)
+	{
+		join_thread(threads[i]);
+	}
+
+	double seconds = os_seconds_elapsed(start, os_hires_time());
+
+	for (size_t i = 0; i < BENCH_POOL_MAILBOX_COUNT; i++)
+	{
+		resource_handle_t handle = { .value = atomic_exchange(&bench->mailboxes[i], 0) };
+
+		if (handle.value)
+		{
+			bench->errors += !pool_rem(&bench->pool, handle);
+		}
+	}
+
+	// everything was freed again, so iterating should come up empty
+	for (pool_iter_t it = pool_iter(&bench->pool); pool_iter_valid(&it); pool_iter_next(&it))
+	{
+		bench->errors += 1;
+	}
+
+	return seconds;
+}
+
+CVAR_COMMAND(ccmd_bench_pool, "bench.pool")
+{
+	int64_t ops_per_thread = 1 << 20;
+
+	string_t first_argument = string_split_word(&arguments);
+
+	if (first_argument.count > 0)
+	{
+		string_parse_int(&first_argument, &ops_per_thread);
+	}
+
+	size_t max_thread_count = query_processor_count();
+
+	log(Benchmark, Info, "bench.pool: %lld ops per thread, up to %zu threads", ops_per_thread, max_thread_count);
+
+	for (size_t thread_count = 1; thread_count <= max_thread_count; thread_count *= 2)
+	{
+		static const struct { const char *name; uint16_t flags; } modes[] = {
+			{ "mutex:",     POOL_FLAGS_CONCURRENT },
+			{ "lock-free:", POOL_FLAGS_LOCK_FREE  },
+		};
+
+		for (size_t mode_index = 0; mode_index < ARRAY_COUNT(modes); mode_index++)
+		{
+			bench_pool_t bench = {
+				.pool           = INIT_POOL_EX(bench_pool_item_t, modes[mode_index].flags),
+				.ops_per_thread = ops_per_thread,
+			};
+
+			double seconds = bench_pool_run(&bench, thread_count);
+
+			uint64_t total_ops = (uint64_t)ops_per_thread*thread_count;
+
+			if (bench.errors > 0)
+			{
+				log(Benchmark, Error, "  %2zu threads, %-11s %llu errors", thread_count, modes[mode_index].name, bench.errors);
+			}
+
+			log(Benchmark, Info, "  %2zu threads, %-11s %8.2f ms, %6.2f Mops/s",
+				thread_count, modes[mode_index].name, 1000.0*seconds, (double)total_ops / seconds / 1000000.0);
+
+			pool_release(&bench.pool);
+		}
+	}
+}
+
+//
+// bench.heap
+//
+
+// Replays allocation traces against simple_heap_t and heap_t, timing them and tracking how much memory
+// each one needed for the live data. The traces are recorded up front by simulations of the two
+// allocation patterns that matter: UI state churn and asset loading.
+
+typedef struct bench_heap_event_t
+{
+	uint32_t slot;
+	uint16_t size;
+	uint16_t is_free;
+} bench_heap_event_t;
+
+typedef struct bench_heap_trace_t
+{
+	stretchy_buffer(bench_heap_event_t) events;
+	stretchy_buffer(uint16_t)           slot_sizes;
+	stretchy_buffer(uint32_t)           free_slots;
+
+	size_t live_bytes;
+	size_t peak_live_bytes;
+} bench_heap_trace_t;
+
+fn_local uint32_t bench_heap_record_alloc(bench_heap_trace_t *trace, uint16_t size)
+{
+	uint32_t slot;
+
+	if (sb_count(trace->free_slots) > 0)
+	{
+		slot = sb_pop(trace->free_slots);
+		trace->slot_sizes[slot] = size;
+	}
+	else
+	{
+		slot = sb_count(trace->slot_sizes);
+		sb_push(trace->slot_sizes, size);
+	}
+
+	sb_push(trace->events, ((bench_heap_event_t){ .slot = slot, .size = size }));
+
+	trace->live_bytes     += size;
+	trace->peak_live_bytes = MAX(trace->peak_live_bytes, trace->live_bytes);
+
+	return slot;
+}
+
+fn_local void bench_heap_record_free(bench_heap_trace_t *trace, uint32_t slot)
+{
+	uint16_t size = trace->slot_sizes[slot];
+
+	sb_push(trace->events, ((bench_heap_event_t){ .slot = slot, .size = size, .is_free = true }));
+	sb_push(trace->free_slots, slot);
+
+	trace->live_bytes -= size;
+}
+
+#define BENCH_HEAP_UI_WINDOW_COUNT  24
+#define BENCH_HEAP_UI_MAX_WIDGETS   256
+#define BENCH_HEAP_UI_VISIBLE_COUNT 48
+
+// Mimics ui_get_state_raw: widget state is allocated the first frame a widget is touched, and freed at the
+// end of the first frame it isn't. Windows open and close, scrolling brings widgets in and out of view, and
+// tooltips and popups come and go within a frame or two.
+fn_local void bench_heap_record_ui_trace(bench_heap_trace_t *trace, int64_t frame_count)
+{
+	// header plus the sizes of the common widget states, small ones being a lot more common
+	static const uint16_t state_sizes[] = { 24, 24, 24, 32, 32, 40, 48, 64, 80, 128, 256, 528 };
+
+	random_series_t entropy = { .state = 0xC0FFEE };
+
+	typedef struct bench_ui_window_t
+	{
+		bool     open;
+		uint32_t widget_count;
+		uint32_t first_visible;
+		uint32_t slots[BENCH_HEAP_UI_MAX_WIDGETS];
+	} bench_ui_window_t;
+
+	bench_ui_window_t windows[BENCH_HEAP_UI_WINDOW_COUNT] = {0};
+
+	for_array(window_index, windows)
+	{
+		bench_ui_window_t *window = &windows[window_index];
+		window->widget_count = 16 + random_choice(&entropy, BENCH_HEAP_UI_MAX_WIDGETS - 16);
+
+		for_array(widget_index, window->slots)
+		{
+			window->slots[widget_index] = UINT32_MAX;
+		}
+	}
+
+	uint32_t transient_slots[8];
+	uint32_t transient_count = 0;
+
+	for (int64_t frame_index = 0; frame_index < frame_count; frame_index++)
+	{
+		for (uint32_t i = 0; i < transient_count; i++)
+		{
+			bench_heap_record_free(trace, transient_slots[i]);
+		}
+
+		transient_count = random_choice(&entropy, 4);
+
+		for (uint32_t i = 0; i < transient_count; i++)
+		{
+			transient_slots[i] = bench_heap_record_alloc(trace, (uint16_t)(64 + random_choice(&entropy, 2048)));
+		}
+
+		for_array(window_index, windows)
+		{
+			bench_ui_window_t *window = &windows[window_index];
+
+			if (random_choice(&entropy, 300) == 0)
+			{
+				window->open = !window->open;
+			}
+
+			if (window->open && random_choice(&entropy, 8) == 0)
+			{
+				int32_t max_first = (int32_t)window->widget_count - BENCH_HEAP_UI_VISIBLE_COUNT;
+				int32_t first     = (int32_t)window->first_visible + random_range_i32(&entropy, -8, 8);
+
+				window->first_visible = (uint32_t)CLAMP(first, 0, MAX(0, max_first));
+			}
+
+			uint32_t first_visible = window->first_visible;
+			uint32_t last_visible  = MIN(first_visible + BENCH_HEAP_UI_VISIBLE_COUNT, window->widget_count);
+
+			for (uint32_t widget_index = 0; widget_index < window->widget_count; widget_index++)
+			{
+				uint32_t *slot = &window->slots[widget_index];
+
+				bool touched = window->open && widget_index >= first_visible && widget_index < last_visible;
+
+				if (touched && *slot == UINT32_MAX)
+				{
+					// the same widget always has the same kind of state
+					uint32_t hash = (uint32_t)(window_index*BENCH_HEAP_UI_MAX_WIDGETS + widget_index)*0x9E3779B9u;
+					*slot = bench_heap_record_alloc(trace, state_sizes[(hash >> 16) % ARRAY_COUNT(state_sizes)]);
+				}
+				else if (!touched && *slot != UINT32_MAX)
+				{
+					bench_heap_record_free(trace, *slot);
+					*slot = UINT32_MAX;
+				}
+			}
+		}
+	}
+}
+
+#define BENCH_HEAP_ASSET_MAX_ALLOCATIONS 6
+
+// Mimics asset loading: levels load in waves of assets that each come with a handful of allocations of
+// wildly different sizes, hot reloads replace single assets, and unloading a level leaves the assets that
+// are still shared with the next level behind, scattered between the holes.
+fn_local void bench_heap_record_asset_trace(bench_heap_trace_t *trace, int64_t level_count, arena_t *arena)
+{
+	typedef struct bench_asset_t
+	{
+		uint32_t allocation_count;
+		uint32_t slots[BENCH_HEAP_ASSET_MAX_ALLOCATIONS];
+	} bench_asset_t;
+
+	random_series_t entropy = { .state = 0xA55E7 };
+
+	stretchy_buffer(bench_asset_t) assets = sb_init(arena, 1024, bench_asset_t);
+
+	for (int64_t level_index = 0; level_index < level_count; level_index++)
+	{
+		uint32_t load_count = 1500 + random_choice(&entropy, 1000);
+
+		for (uint32_t i = 0; i < load_count; i++)
+		{
+			bench_asset_t asset = { .allocation_count = 1 + random_choice(&entropy, BENCH_HEAP_ASSET_MAX_ALLOCATIONS) };
+
+			for (uint32_t j = 0; j < asset.allocation_count; j++)
+			{
+				// roughly log-uniform between 32 bytes and 8KB
+				uint32_t size = (32u << random_choice(&entropy, 9)) + random_choice(&entropy, 32);
+				asset.slots[j] = bench_heap_record_alloc(trace, (uint16_t)size);
+			}
+
+			sb_push(assets, asset);
+		}
+
+		for (uint32_t i = 0; i < 500; i++)
+		{
+			bench_asset_t *asset = &assets[random_choice(&entropy, sb_count(assets))];
+
+			for (uint32_t j = 0; j < asset->allocation_count; j++)
+			{
+				int32_t size = trace->slot_sizes[asset->slots[j]] + random_range_i32(&entropy, -256, 256);
+				bench_heap_record_free(trace, asset->slots[j]);
+
+				asset->slots[j] = bench_heap_record_alloc(trace, (uint16_t)CLAMP(size, 16, 16000));
+			}
+		}
+
+		// unload everything but the ~15% of assets the next level still uses
+		for (uint32_t i = 0; i < sb_count(assets);)
+		{
+			if (random_choice(&entropy, 100) < 85)
+			{
+				for (uint32_t j = 0; j < assets[i].allocation_count; j++)
+				{
+					bench_heap_record_free(trace, assets[i].slots[j]);
+				}
+
+				assets[i] = sb_pop(assets);
+			}
+			else
+			{
+				i++;
+			}
+		}
+	}
+}
+
+typedef struct bench_heap_result_t
+{
+	double seconds;
+	size_t peak_footprint;
+	size_t final_footprint;
+} bench_heap_result_t;
+
+fn_local bench_heap_result_t bench_heap_replay_simple_heap(bench_heap_trace_t *trace, char **pointers)
+{
+	bench_heap_result_t result = {0};
+
+	arena_t       arena = {0};
+	simple_heap_t heap  = {0};
+	simple_heap_init(&heap, &arena);
+
+	hires_time_t start = os_hires_time();
+
+	for (size_t i = 0; i < sb_count(trace->events); i++)
+	{
+		bench_heap_event_t *event = &trace->events[i];
+
+		if (event->is_free)
+		{
+			simple_heap_free(&heap, pointers[event->slot], event->size);
+		}
+		else
+		{
+			char *pointer = simple_heap_alloc_nozero(&heap, event->size);
+			pointer[0] = 1;
+
+			pointers[event->slot] = pointer;
+
+			// the simple heap's memory is whatever it took from its arena
+			result.peak_footprint = MAX(result.peak_footprint, (size_t)(arena.at - arena.buffer));
+		}
+	}
+
+	result.seconds         = os_seconds_elapsed(start, os_hires_time());
+	result.final_footprint = (size_t)(arena.at - arena.buffer);
+
+	m_release(&arena);
+
+	return result;
+}
+
+fn_local bench_heap_result_t bench_heap_replay_heap(bench_heap_trace_t *trace, char **pointers)
+{
+	bench_heap_result_t result = {0};
+
+	heap_t heap = {0};
+
+	hires_time_t start = os_hires_time();
+
+	for (size_t i = 0; i < sb_count(trace->events); i++)
+	{
+		bench_heap_event_t *event = &trace->events[i];
+
+		if (event->is_free)
+		{
+			heap_free(&heap, pointers[event->slot]);
+		}
+		else
+		{
+			char *pointer = heap_alloc_nozero(&heap, event->size, 16);
+			pointer[0] = 1;
+
+			pointers[event->slot] = pointer;
+
+			result.peak_footprint = MAX(result.peak_footprint, (size_t)(heap.committed - heap.base));
+		}
+	}
+
+	result.seconds         = os_seconds_elapsed(start, os_hires_time());
+	result.final_footprint = (size_t)(heap.committed - heap.base);
+
+	ASSERT_MSG(heap_check(&heap), "heap_check failed after replaying the trace");
+
+	heap_release(&heap);
+
+	return result;
+}
+
+fn_local void bench_heap_report(string_t trace_name, bench_heap_trace_t *trace, char **pointers, int64_t run_count)
+{
+	static const struct { const char *name; bench_heap_result_t (*replay)(bench_heap_trace_t *, char **); } allocators[] = {
+		{ "simple_heap:", bench_heap_replay_simple_heap },
+		{ "heap:",        bench_heap_replay_heap        },
+	};
+
+	size_t event_count = sb_count(trace->events);
+
+	m_scoped_temp
+	{
+		log(Benchmark, Info, "  %cs trace: %zu events, %cs peak live, %cs live at the end", trace_name, event_count,
+			string_format_human_readable_bytes(temp, trace->peak_live_bytes),
+			string_format_human_readable_bytes(temp, trace->live_bytes));
+	}
+
+	for_array(allocator_index, allocators)
+	{
+		bench_heap_result_t best = { .seconds = DBL_MAX };
+
+		for (int64_t run_index = 0; run_index < run_count; run_index++)
+		{
+			bench_heap_result_t result = allocators[allocator_index].replay(trace, pointers);
+
+			if (result.seconds < best.seconds)
+			{
+				best = result;
+			}
+		}
+
+		// footprint over live bytes: 1.0 would mean not a single byte lost to headers, rounding or fragmentation
+		m_scoped_temp
+		{
+			log(Benchmark, Info, "    %-13s %8.2f ms, %6.2f Mops/s, peak %cs (%.2fx live), end %cs (%.2fx live)",
+				allocators[allocator_index].name,
+				1000.0*best.seconds,
+				(double)event_count / best.seconds / 1000000.0,
+				string_format_human_readable_bytes(temp, best.peak_footprint),
+				(double)best.peak_footprint / (double)MAX(1, trace->peak_live_bytes),
+				string_format_human_readable_bytes(temp, best.final_footprint),
+				(double)best.final_footprint / (double)MAX(1, trace->live_bytes));
+		}
+	}
+}
+
+CVAR_COMMAND(ccmd_bench_heap, "bench.heap")
+{
+	int64_t scale = 1;
+
+	string_t first_argument = string_split_word(&arguments);
+
+	if (first_argument.count > 0)
+	{
+		string_parse_int(&first_argument, &scale);
+	}
+
+	int64_t run_count = 5;
+
+	log(Benchmark, Info, "bench.heap: scale %lld, best of %lld runs", scale, run_count);
+
+	arena_t arena = {0};
+
+	bench_heap_trace_t ui_trace = {0};
+	ui_trace.events     = sb_init(&arena, 1 << 16, bench_heap_event_t);
+	ui_trace.slot_sizes = sb_init(&arena, 1 << 12, uint16_t);
+	ui_trace.free_slots = sb_init(&arena, 1 << 12, uint32_t);
+
+	bench_heap_record_ui_trace(&ui_trace, 20000*scale);
+
+	bench_heap_trace_t asset_trace = {0};
+	asset_trace.events     = sb_init(&arena, 1 << 16, bench_heap_event_t);
+	asset_trace.slot_sizes = sb_init(&arena, 1 << 12, uint16_t);
+	asset_trace.free_slots = sb_init(&arena, 1 << 12, uint32_t);
+
+	bench_heap_record_asset_trace(&asset_trace, 8*scale, &arena);
+
+	size_t slot_count = MAX(sb_count(ui_trace.slot_sizes), sb_count(asset_trace.slot_sizes));
+	char **pointers   = m_alloc_array(&arena, slot_count, char *);
+
+	bench_heap_report(S("ui"),    &ui_trace,    pointers, run_count);
+	bench_heap_report(S("asset"), &asset_trace, pointers, run_count);
+
+	m_release(&arena);
+}
+
+//
+// bench.table
+//
+
+// Lookup cost of table_t at different load factors, for hits and misses, once for a table that fits in
+// cache and once for one that doesn't. The table grows before it gets fuller than 7/8, so that's where
+// the sweep ends.
+
+fn_local uint64_t bench_table_random_key(random_series_t *entropy)
+{
+	return ((uint64_t)random_uint32(entropy) << 32)|random_uint32(entropy);
+}
+
+fn_local void bench_table_run(uint64_t capacity, int64_t lookup_count)
+{
+	static const struct { const char *name; uint64_t numerator, denominator; } load_factors[] = {
+		{ "0.500", 1, 2 },
+		{ "0.625", 5, 8 },
+		{ "0.750", 3, 4 },
+		{ "0.800", 4, 5 },
+		{ "0.875", 7, 8 },
+	};
+
+	random_series_t entropy = { .state = 0xDEADBEEF };
+
+	m_scoped_temp
+	{
+		uint64_t *keys      = m_alloc_array_nozero(temp, capacity, uint64_t);
+		uint64_t *hit_keys  = m_alloc_array_nozero(temp, lookup_count, uint64_t);
+		uint64_t *miss_keys = m_alloc_array_nozero(temp, lookup_count, uint64_t);
+
+		for (uint64_t i = 0; i < capacity; i++)
+		{
+			keys[i] = bench_table_random_key(&entropy);
+		}
+
+		for (int64_t i = 0; i < lookup_count; i++)
+		{
+			miss_keys[i] = bench_table_random_key(&entropy);
+		}
+
+		log(Benchmark, Info, "  capacity %llu, %lld lookups", capacity, lookup_count);
+
+		for_array(load_index, load_factors)
+		{
+			uint64_t count = capacity*load_factors[load_index].numerator / load_factors[load_index].denominator;
+
+			table_t table = {0};
+			table_reserve(&table, capacity*TABLE_MAX_LOAD_FACTOR_NUMERATOR / TABLE_MAX_LOAD_FACTOR_DENOMINATOR);
+
+			for (uint64_t i = 0; i < count; i++)
+			{
+				table_insert(&table, keys[i], i);
+			}
+
+			ASSERT(table_capacity(&table) == capacity);
+
+			for (int64_t i = 0; i < lookup_count; i++)
+			{
+				hit_keys[i] = keys[random_choice(&entropy, (uint32_t)count)];
+			}
+
+			uint64_t found = 0;
+			uint64_t sum   = 0;
+
+			hires_time_t hit_start = os_hires_time();
+
+			for (int64_t i = 0; i < lookup_count; i++)
+			{
+				uint64_t value;
+				if (table_find(&table, hit_keys[i], &value))
+				{
+					found += 1;
+					sum   += value;
+				}
+			}
+
+			double hit_seconds = os_seconds_elapsed(hit_start, os_hires_time());
+
+			hires_time_t miss_start = os_hires_time();
+
+			for (int64_t i = 0; i < lookup_count; i++)
+			{
+				found += table_find(&table, miss_keys[i], NULL);
+			}
+
+			double miss_seconds = os_seconds_elapsed(miss_start, os_hires_time());
+
+			if (found != (uint64_t)lookup_count)
+			{
+				log(Benchmark, Error, "    load %s: expected %lld hits, got %llu (checksum %llu)",
+					load_factors[load_index].name, lookup_count, found, sum);
+			}
+
+			log(Benchmark, Info, "    load %s: hit %6.2f ns, miss %6.2f ns",
+				load_factors[load_index].name,
+				1e9*hit_seconds  / (double)lookup_count,
+				1e9*miss_seconds / (double)lookup_count);
+
+			table_release(&table);
+		}
+	}
+}
+
+CVAR_COMMAND(ccmd_bench_table, "bench.table")
+{
+	int64_t lookup_count = 1 << 22;
+
+	string_t first_argument = string_split_word(&arguments);
+
+	if (first_argument.count > 0)
+	{
+		string_parse_int(&first_argument, &lookup_count);
+	}
+
+	log(Benchmark, Info, "bench.table:");
+
+	bench_table_run(1 << 12, lookup_count);
+	bench_table_run(1 << 22, lookup_count);
+}
+
+//
+// test.concurrent_table
+//
+
+// Stable keys are inserted up front and never touched again, so readers have to find every one of them no
+// matter what the writers are doing to the shards around them. Churn keys get inserted, overwritten and
+// removed by the writer that owns them. Values are derived from keys, so readers can tell a torn or stale
+// entry from a good one.
+
+#define CTABLE_STRESS_STABLE_COUNT 4096
+#define CTABLE_STRESS_CHURN_COUNT  8192
+
+typedef struct ctable_stress_t
+{
+	arena_t            arena;
+	concurrent_table_t table;
+
+	atomic bool     go;
+	atomic bool     stop;
+	atomic uint64_t errors;
+	atomic uint64_t reads;
+
+	int64_t ops_per_writer;
+	size_t  writer_count;
+} ctable_stress_t;
+
+typedef struct ctable_stress_thread_t
+{
+	ctable_stress_t *stress;
+	uint32_t         index;
+} ctable_stress_thread_t;
+
+fn_local uint64_t ctable_stress_value(uint64_t key)
+{
+	return hash_u64(key) & ~1ull; // the low bit flips on overwrites
+}
+
+fn_local uint64_t ctable_stress_churn_key(uint32_t writer_index, uint32_t n)
+{
+	return ((uint64_t)(writer_index + 1) << 32)|(n + 1);
+}
+
+fn_local void ctable_stress_writer(void *userdata)
+{
+	ctable_stress_thread_t *thread = userdata;
+	ctable_stress_t        *stress = thread->stress;
+
+	random_series_t entropy = { .state = 0x1234567u*(thread->index + 1) };
+
+	uint8_t present[CTABLE_STRESS_CHURN_COUNT] = {0}; // 0 = absent, 1 = even value, 2 = odd value
+
+	uint64_t errors = 0;
+
+	while (!atomic_load_explicit(&stress->go, memory_order_acquire))
+	{
+		_mm_pause();
+	}
+
+	for (int64_t op = 0; op < stress->ops_per_writer; op++)
+	{
+		uint32_t n   = random_choice(&entropy, CTABLE_STRESS_CHURN_COUNT);
+		uint64_t key = ctable_stress_churn_key(thread->index, n);
+
+		if (!present[n] || random_choice(&entropy, 4) == 0)
+		{
+			uint64_t flip = random_choice(&entropy, 2);
+			concurrent_table_insert(&stress->table, key, ctable_stress_value(key) + flip);
+			present[n] = (uint8_t)(1 + flip);
+		}
+		else
+		{
+			// removing twice has to fail the second time
+			errors += !concurrent_table_remove(&stress->table, key);
+			errors +=  concurrent_table_remove(&stress->table, key);
+			present[n] = 0;
+		}
+	}
+
+	// the table has to agree with what this writer did
+	for (uint32_t n = 0; n < CTABLE_STRESS_CHURN_COUNT; n++)
+	{
+		uint64_t key = ctable_stress_churn_key(thread->index, n);
+
+		uint64_t value = 0;
+		bool     found = concurrent_table_find(&stress->table, key, &value);
+
+		errors += (found != (present[n] != 0));
+		errors += (found && value != ctable_stress_value(key) + (present[n] - 1));
+	}
+
+	atomic_fetch_add(&stress->errors, errors);
+}
+
+fn_local void ctable_stress_reader(void *userdata)
+{
+	ctable_stress_thread_t *thread = userdata;
+	ctable_stress_t        *stress = thread->stress;
+
+	random_series_t entropy = { .state = 0x7654321u*(thread->index + 1) };
+
+	uint64_t errors = 0;
+	uint64_t reads  = 0;
+
+	while (!atomic_load_explicit(&stress->stop, memory_order_acquire))
+	{
+		for (size_t i = 0; i < 256; i++)
+		{
+			uint64_t stable_key = 1 + random_choice(&entropy, CTABLE_STRESS_STABLE_COUNT);
+
+			uint64_t value = 0;
+			errors += !concurrent_table_find(&stress->table, stable_key, &value);
+			errors += (value != ctable_stress_value(stable_key));
+
+			uint32_t writer_index = random_choice(&entropy, (uint32_t)stress->writer_count);
+			uint64_t churn_key    = ctable_stress_churn_key(writer_index, random_choice(&entropy, CTABLE_STRESS_CHURN_COUNT));
+
+			if (concurrent_table_find(&stress->table, churn_key, &value))
+			{
+				errors += ((value & ~1ull) != ctable_stress_value(churn_key));
+			}
+
+			reads += 2;
+		}
+
+		if (random_choice(&entropy, 64) == 0)
+		{
+			for (concurrent_table_iter_t it = concurrent_table_iter(&stress->table); concurrent_table_iter_next(&it);)
+			{
+				errors += ((it.value & ~1ull) != ctable_stress_value(it.key));
+			}
+		}
+	}
+
+	atomic_fetch_add(&stress->errors, errors);
+	atomic_fetch_add(&stress->reads,  reads);
+}
+
+CVAR_COMMAND(ccmd_test_concurrent_table, "test.concurrent_table")
+{
+	int64_t ops_per_writer = 1 << 20;
+
+	string_t first_argument = string_split_word(&arguments);
+
+	if (first_argument.count > 0)
+	{
+		string_parse_int(&first_argument, &ops_per_writer);
+	}
+
+	ctable_stress_thread_t threads_data[34];
+	thread_t               readers     [32];
+	thread_t               writers     [2];
+
+	size_t processor_count = query_processor_count();
+
+	size_t reader_count = MIN(processor_count > 4 ? processor_count - 2 : 2, ARRAY_COUNT(readers));
+	size_t writer_count = ARRAY_COUNT(writers);
+
+	// the shards want cache line alignment, and the table is too big for the stack anyway
+	ctable_stress_t *stress = m_bootstrap(ctable_stress_t, arena);
+	stress->ops_per_writer = ops_per_writer;
+	stress->writer_count   = writer_count;
+
+	for (uint64_t key = 1; key <= CTABLE_STRESS_STABLE_COUNT; key++)
+	{
+		concurrent_table_insert(&stress->table, key, ctable_stress_value(key));
+	}
+
+	log(Benchmark, Info, "test.concurrent_table: %zu readers, %zu writers doing %lld ops each", reader_count, writer_count, ops_per_writer);
+
+	for (size_t i = 0; i < writer_count; i++)
+	{
+		threads_data[i] = (ctable_stress_thread_t){ .stress = stress, .index = (uint32_t)i };
+		writers[i] = create_thread(ctable_stress_writer, &threads_data[i]);
+	}
+
+	for (size_t i = 0; i < reader_count; i++)
+	{
+		threads_data[writer_count + i] = (ctable_stress_thread_t){ .stress = stress, .index = (uint32_t)i };
+		readers[i] = create_thread(ctable_stress_reader, &threads_data[writer_count + i]);
+	}
+
+	hires_time_t start = os_hires_time();
+
+	atomic_store_explicit(&stress->go, true, memory_order_release);
+
+	for (size_t i = 0; i < writer_count; i++)
+	{
+		join_thread(writers[i]);
+	}
+
+	atomic_store_explicit(&stress->stop, true, memory_order_release);
+
+	for (size_t i = 0; i < reader_count; i++)
+	{
+		join_thread(readers[i]);
+	}
+
+	double seconds = os_seconds_elapsed(start, os_hires_time());
+
+	uint64_t errors = atomic_load(&stress->errors);
+
+	if (errors > 0)
+	{
+		log(Benchmark, Error, "test.concurrent_table: %llu errors", errors);
+	}
+	else
+	{
+		log(Benchmark, Info, "test.concurrent_table: passed in %.2f s, %llu reads during the writes",
+			seconds, atomic_load(&stress->reads));
+	}
+
+	concurrent_table_release(&stress->table);
+	m_release(&stress->arena);
+}
+
+//
+// test.atoms
+//
+
+// Every thread interns the same strings in its own random order, and they all have to end up with the same
+// atoms. Each run uses new strings, so running it again still races on inserts instead of just finding them.
+
+typedef struct atom_stress_t
+{
+	size_t    string_count;
+	string_t *strings;
+
+	atomic bool go;
+} atom_stress_t;
+
+typedef struct atom_stress_thread_t
+{
+	atom_stress_t *stress;
+	uint32_t       index;
+	atom_t        *atoms;
+} atom_stress_thread_t;
+
+fn_local void atom_stress_thread(void *userdata)
+{
+	atom_stress_thread_t *thread = userdata;
+	atom_stress_t        *stress = thread->stress;
+
+	random_series_t entropy = { .state = 0x1234567u*(thread->index + 1) };
+
+	size_t count = stress->string_count;
+
+	m_scoped_temp
+	{
+		uint32_t *order = m_alloc_array_nozero(temp, count, uint32_t);
+
+		for (size_t i = 0; i < count; i++)
+		{
+			order[i] = (uint32_t)i;
+		}
+
+		for (size_t i = count - 1; i > 0; i--)
+		{
+			uint32_t j = random_choice(&entropy, (uint32_t)(i + 1));
+			SWAP(uint32_t, order[i], order[j]);
+		}
+
+		while (!atomic_load_explicit(&stress->go, memory_order_acquire))
+		{
+			_mm_pause();
+		}
+
+		for (size_t i = 0; i < count; i++)
+		{
+			uint32_t index = order[i];
+			thread->atoms[index] = atom_from_string(stress->strings[index]);
+		}
+	}
+}
+
+CVAR_COMMAND(ccmd_test_atoms, "test.atoms")
+{
+	int64_t string_count = 1 << 16;
+
+	string_t first_argument = string_split_word(&arguments);
+
+	if (first_argument.count > 0)
+	{
+		string_parse_int(&first_argument, &string_count);
+	}
+
+	local_persist atomic uint32_t run_index;
+	uint32_t run = atomic_fetch_add(&run_index, 1);
+
+	atom_stress_thread_t threads_data[8];
+	thread_t             threads     [8];
+
+	size_t processor_count = query_processor_count();
+	size_t thread_count    = MIN(MAX(processor_count, 2), ARRAY_COUNT(threads));
+
+	atom_stats_t stats_before = atom_get_stats();
+
+	uint64_t errors = 0;
+	double   seconds = 0.0;
+
+	m_scoped_temp
+	{
+		atom_stress_t stress = {
+			.string_count = (size_t)string_count,
+			.strings      = m_alloc_array_nozero(temp, string_count, string_t),
+		};
+
+		for (int64_t i = 0; i < string_count; i++)
+		{
+			stress.strings[i] = string_format(temp, "test.atoms/%u/%lld", run, i);
+		}
+
+		for (size_t i = 0; i < thread_count; i++)
+		{
+			threads_data[i] = (atom_stress_thread_t){
+				.stress = &stress,
+				.index  = (uint32_t)i,
+				.atoms  = m_alloc_array_nozero(temp, string_count, atom_t),
+			};
+			threads[i] = create_thread(atom_stress_thread, &threads_data[i]);
+		}
+
+		hires_time_t start = os_hires_time();
+
+		atomic_store_explicit(&stress.go, true, memory_order_release);
+
+		for (size_t i = 0; i < thread_count; i++)
+		{
+			join_thread(threads[i]);
+		}
+
+		seconds = os_seconds_elapsed(start, os_hires_time());
+
+		atom_t *atoms = threads_data[0].atoms;
+
+		for (int64_t i = 0; i < string_count; i++)
+		{
+			atom_t   atom   = atoms[i];
+			string_t string = stress.strings[i];
+
+			for (size_t thread_index = 1; thread_index < thread_count; thread_index++)
+			{
+				errors += !atom_match(atom, threads_data[thread_index].atoms[i]);
+			}
+
+			errors += !atom.value;
+			errors += !string_match(string_from_atom(atom), string);
+			errors += !atom_match(atom_find(string), atom);
+			errors += atom_hash(atom) != string_hash(string);
+		}
+	}
+
+	// cached atoms and lookups keyed by atom have to agree with their string versions
+	{
+		local_persist atom_cache_t cache;
+
+		atom_t atom = atom_from_string(S("test.atoms"));
+
+		errors += !atom_match(atom_cached(&cache, S("test.atoms")), atom);
+		errors += !atom_match(atom_cached(&cache, S("test.atoms")), atom);
+		errors += cvar_find_atom(atom) != cvar_find(S("TEST.Atoms"));
+		errors += cvar_find_atom(atom) != &ccmd_test_atoms;
+	}
+
+	// all strings were new, so the count only adds up if none of them got interned twice
+	atom_stats_t stats = atom_get_stats();
+
+	errors += (stats.count - stats_before.count) != (uint32_t)string_count;
+
+	if (errors > 0)
+	{
+		log(Benchmark, Error, "test.atoms: %llu errors", errors);
+	}
+	else
+	{
+		log(Benchmark, Info, "test.atoms: passed in %.2f s, %zu threads interning %lld strings", seconds, thread_count, string_count);
+	}
+}
+
+//
+// bench.concurrent_table
+//
+
+// Lookup throughput with one thread writing at full speed in the background, against a table_t behind a
+// reader-writer mutex, which is what you'd reach for otherwise.
+
+#define CTABLE_BENCH_KEY_COUNT (1 << 16)
+
+typedef struct ctable_bench_t
+{
+	arena_t            arena;
+	concurrent_table_t table;
+
+	table_t locked_table;
+	mutex_t locked_table_lock;
+
+	bool use_locked_table;
+
+	atomic bool go;
+	atomic bool stop;
+
+	int64_t         lookups_per_reader;
+	atomic uint64_t writes;
+	atomic uint64_t misses;
+} ctable_bench_t;
+
+typedef struct ctable_bench_thread_t
+{
+	ctable_bench_t *bench;
+	uint32_t        index;
+} ctable_bench_thread_t;
+
+fn_local void ctable_bench_reader(void *userdata)
+{
+	ctable_bench_thread_t *thread = userdata;
+	ctable_bench_t        *bench  = thread->bench;
+
+	random_series_t entropy = { .state = 0xBEEFu*(thread->index + 1) };
+
+	uint64_t misses = 0;
+
+	while (!atomic_load_explicit(&bench->go, memory_order_acquire))
+	{
+		_mm_pause();
+	}
+
+	for (int64_t i = 0; i < bench->lookups_per_reader; i++)
+	{
+		uint64_t key = 1 + random_choice(&entropy, CTABLE_BENCH_KEY_COUNT);
+
+		bool found;
+
+		if (bench->use_locked_table)
+		{
+			mutex_shared_lock(&bench->locked_table_lock);
+			found = table_find(&bench->locked_table, key, NULL);
+			mutex_shared_unlock(&bench->locked_table_lock);
+		}
+		else
+		{
+			found = concurrent_table_find(&bench->table, key, NULL);
+		}
+
+		misses += !found;
+	}
+
+	atomic_fetch_add(&bench->misses, misses);
+}
+
+// keeps replacing the upper half of the keys, so about a quarter of the lookups miss
+fn_local void ctable_bench_writer(void *userdata)
+{
+	ctable_bench_t *bench = userdata;
+
+	random_series_t entropy = { .state = 0xF00D };
+
+	uint64_t writes = 0;
+
+	while (!atomic_load_explicit(&bench->stop, memory_order_acquire))
+	{
+		uint64_t key = 1 + CTABLE_BENCH_KEY_COUNT / 2 + random_choice(&entropy, CTABLE_BENCH_KEY_COUNT / 2);
+
+		bool insert = random_choice(&entropy, 2);
+
+		if (bench->use_locked_table)
+		{
+			mutex_lock(&bench->locked_table_lock);
+			if (insert) table_insert(&bench->locked_table, key, key);
+			else        table_remove(&bench->locked_table, key);
+			mutex_unlock(&bench->locked_table_lock);
+		}
+		else
+		{
+			if (insert) concurrent_table_insert(&bench->table, key, key);
+			else        concurrent_table_remove(&bench->table, key);
+		}
+
+		writes += 1;
+	}
+
+	atomic_store(&bench->writes, writes);
+}
+
+CVAR_COMMAND(ccmd_bench_concurrent_table, "bench.concurrent_table")
+{
+	int64_t lookups_per_reader = 1 << 20;
+
+	string_t first_argument = string_split_word(&arguments);
+
+	if (first_argument.count > 0)
+	{
+		string_parse_int(&first_argument, &lookups_per_reader);
+	}
+
+	size_t processor_count  = query_processor_count();
+	size_t max_reader_count = processor_count > 1 ? processor_count - 1 : 1;
+
+	log(Benchmark, Info, "bench.concurrent_table: %lld lookups per reader, one writer, up to %zu readers", lookups_per_reader, max_reader_count);
+
+	for (size_t reader_count = 1; reader_count <= max_reader_count; reader_count *= 2)
+	{
+		for (size_t mode = 0; mode < 2; mode++)
+		{
+			ctable_bench_t *bench = m_bootstrap(ctable_bench_t, arena);
+			bench->use_locked_table   = (mode == 1);
+			bench->lookups_per_reader = lookups_per_reader;
+
+			for (uint64_t key = 1; key <= CTABLE_BENCH_KEY_COUNT; key++)
+			{
+				concurrent_table_insert(&bench->table, key, key);
+				table_insert(&bench->locked_table, key, key);
+			}
+
+			ctable_bench_thread_t threads_data[64];
+			thread_t              readers     [64];
+
+			reader_count = MIN(reader_count, ARRAY_COUNT(readers));
+
+			for (size_t i = 0; i < reader_count; i++)
+			{
+				threads_data[i] = (ctable_bench_thread_t){ .bench = bench, .index = (uint32_t)i };
+				readers[i] = create_thread(ctable_bench_reader, &threads_data[i]);
+			}
+
+			thread_t writer = create_thread(ctable_bench_writer, bench);
+
+			hires_time_t start = os_hires_time();
+
+			atomic_store_explicit(&bench->go, true, memory_order_release);
+
+			for (size_t i = 0; i < reader_count; i++)
+			{
+				join_thread(readers[i]);
+			}
+
+			double seconds = os_seconds_elapsed(start, os_hires_time());
+
+			atomic_store_explicit(&bench->stop, true, memory_order_release);
+			join_thread(writer);
+
+			uint64_t total_lookups = (uint64_t)lookups_per_reader*reader_count;
+
+			log(Benchmark, Info, "  %2zu readers, %-21s %8.2f ms, %7.2f Mlookups/s, %5.1f%% misses, %llu writes",
+				reader_count, mode ? "table_t + rw mutex:" : "concurrent_table_t:",
+				1000.0*seconds, (double)total_lookups / seconds / 1000000.0,
+				100.0*(double)atomic_load(&bench->misses) / (double)total_lookups, atomic_load(&bench->writes));
+
+			concurrent_table_release(&bench->table);
+			table_release(&bench->locked_table);
+			m_release(&bench->arena);
+		}
+	}
+}
+
+//
+// bench.large_pages
+//
+
+// Loads the same map into an arena with regular pages and one with large pages (see m_init_with_flags), then
+// traces the same random rays through both and bakes lightmaps for both. The map and its BVH are what the
+// rays read all over the place, so that's the memory the large pages are for.
+
+typedef struct bench_large_pages_result_t
+{
+	bool     got_large_pages;
+	double   rays_per_second;
+	uint64_t hit_count;
+	double   bake_seconds;
+} bench_large_pages_result_t;
+
+fn_local void bench_large_pages_trace(map_t *map, int64_t ray_count, bench_large_pages_result_t *result)
+{
+	double best_seconds = DBL_MAX;
+
+	for (size_t run = 0; run < 3; run++)
+	{
+		random_series_t entropy = { .state = 0xC0FFEE };
+
+		uint64_t hit_count = 0;
+
+		hires_time_t start = os_hires_time();
+
+		for (int64_t i = 0; i < ray_count; i++)
+		{
+			v3_t o = add(map->bounds.min, mul(random_unilateral3(&entropy), rect3_dim(map->bounds)));
+			v3_t d = normalize(random_in_unit_sphere(&entropy));
+
+			intersect_result_t hit;
+			hit_count += intersect_map(map, &(intersect_params_t){ .o = o, .d = d }, &hit);
+		}
+
+		double seconds = os_seconds_elapsed(start, os_hires_time());
+		best_seconds = MIN(best_seconds, seconds);
+
+		result->hit_count = hit_count;
+	}
+
+	result->rays_per_second = (double)ray_count / best_seconds;
+}
+
+fn_local void bench_large_pages_bake(map_t *map, int ray_count, bench_large_pages_result_t *result)
+{
+	lum_bake_state_t *state = bake_lighting(&(lum_params_t){
+		.map                    = map,
+		.sun_direction          = make_v3(0.25f, 0.75f, 1),
+		.sun_color              = make_v3(1, 1, 1),
+		.sky_color              = make_v3(0.1f, 0.1f, 0.1f),
+		.ray_count              = ray_count,
+		.ray_recursion          = 2,
+		.fog_light_sample_count = 2,
+		.fogmap_scale           = 16,
+	});
+
+	while (!bake_finalize(state))
+	{
+		os_sleep(1.0f);
+	}
+
+	result->bake_seconds = state->final_bake_time;
+
+	for (size_t poly_index = 0; poly_index < map->poly_count; poly_index++)
+	{
+		map_poly_t *poly = &map->polys[poly_index];
+
+		if (RESOURCE_HANDLE_VALID(poly->lightmap_rhi))
+		{
+			rhi_destroy_texture(poly->lightmap_rhi);
+		}
+	}
+
+	if (RESOURCE_HANDLE_VALID(map->fogmap))
+	{
+		rhi_destroy_texture(map->fogmap);
+	}
+
+	release_bake_state(state);
+}
+
+CVAR_COMMAND(ccmd_bench_large_pages, "bench.large_pages")
+{
+	string_t map_name = string_split_word(&arguments);
+
+	if (map_name.count == 0)
+	{
+		map_name = S("test");
+	}
+
+	int64_t ray_count      = 1 << 20;
+	int64_t bake_ray_count = 2;
+
+	string_t ray_count_argument = string_split_word(&arguments);
+	if (ray_count_argument.count > 0) string_parse_int(&ray_count_argument, &ray_count);
+
+	string_t bake_argument = string_split_word(&arguments);
+	if (bake_argument.count > 0) string_parse_int(&bake_argument, &bake_ray_count);
+
+	log(Benchmark, Info, "bench.large_pages: large page size is %zu bytes, %lld rays, bake with %lld rays per pixel",
+		vm_large_page_size(), ray_count, bake_ray_count);
+
+	bench_large_pages_result_t results[2] = {0};
+
+	// load_map puts the triangle BVH on large pages if map.large_pages says so
+	cvar_t *large_pages_cvar = cvar_find(S("map.large_pages"));
+
+	if (!large_pages_cvar)
+	{
+		log(Benchmark, Error, "bench.large_pages: map.large_pages isn't registered");
+		return;
+	}
+
+	bool loaded_large_pages = cvar_read_bool(large_pages_cvar);
+	bool loaded_maps        = true;
+
+	for (size_t large_pages = 0; large_pages < 2; large_pages++)
+	{
+		bench_large_pages_result_t *result = &results[large_pages];
+
+		cvar_write_bool(large_pages_cvar, large_pages);
+
+		arena_t arena = {0};
+		map_t *map = load_map(&arena, Sf("gamedata/maps/%cs.map", map_name));
+
+		if (map)
+		{
+			result->got_large_pages = !!(map->triangle_bvh.arena.flags & ArenaFlag_large_pages);
+
+			bench_large_pages_trace(map, ray_count, result);
+
+			if (bake_ray_count > 0)
+			{
+				bench_large_pages_bake(map, (int)bake_ray_count, result);
+			}
+		}
+		else
+		{
+			log(Benchmark, Error, "bench.large_pages: failed to load map '%cs'", map_name);
+		}
+
+		release_map(map);
+		m_release(&arena);
+
+		if (!map)
+		{
+			loaded_maps = false;
+			break;
+		}
+	}
+
+	cvar_write_bool(large_pages_cvar, loaded_large_pages);
+
+	if (!loaded_maps)
+	{
+		return;
+	}
+
+	if (!results[1].got_large_pages)
+	{
+		log(Benchmark, Warning, "bench.large_pages: large pages aren't available, both runs used regular pages");
+	}
+
+	log(Benchmark, Info, "bench.large_pages: %-14s %8.2f Mrays/s (%llu hits), bake %.2f s", "regular pages",
+		results[0].rays_per_second / 1e6, results[0].hit_count, results[0].bake_seconds);
+	log(Benchmark, Info, "bench.large_pages: %-14s %8.2f Mrays/s (%llu hits), bake %.2f s", "large pages",
+		results[1].rays_per_second / 1e6, results[1].hit_count, results[1].bake_seconds);
+
+	log(Benchmark, Info, "bench.large_pages: large pages are %+.1f%% on rays, %+.1f%% on the bake (higher is better)",
+		100.0*(results[1].rays_per_second / results[0].rays_per_second - 1.0),
+		bake_ray_count > 0 ? 100.0*(results[0].bake_seconds / results[1].bake_seconds - 1.0) : 0.0);
+}
+
+//
+// test.simd
+//
+
+typedef struct simd_test_data_t
+{
+	size_t   sample_count;
+	int16_t *samples;
+	float   *volumes;
+	float   *l;
+	float   *r;
+
+	triangle_soa_t triangles;
+	v3_t          *a, *b, *c;
+
+	size_t ray_count;
+	v3_t  *ray_o, *ray_d;
+} simd_test_data_t;
+
+fn_local simd_test_data_t simd_test_data_generate(arena_t *arena, size_t sample_count, size_t triangle_count, size_t ray_count)
+{
+	random_series_t entropy = { .state = 0xC0FFEE };
+
+	simd_test_data_t data = {
+		.sample_count = sample_count,
+		.samples      = m_alloc_array_nozero(arena, sample_count, int16_t),
+		.volumes      = m_alloc_array_nozero(arena, sample_count, float),
+		.l            = m_alloc_array_nozero(arena, sample_count, float),
+		.r            = m_alloc_array_nozero(arena, sample_count, float),
+		.a            = m_alloc_array_nozero(arena, triangle_count, v3_t),
+		.b            = m_alloc_array_nozero(arena, triangle_count, v3_t),
+		.c            = m_alloc_array_nozero(arena, triangle_count, v3_t),
+		.ray_count    = ray_count,
+		.ray_o        = m_alloc_array_nozero(arena, ray_count, v3_t),
+		.ray_d        = m_alloc_array_nozero(arena, ray_count, v3_t),
+	};
+
+	for (size_t i = 0; i < sample_count; i++)
+	{
+		data.samples[i] = (int16_t)random_uint32(&entropy);
+		data.volumes[i] = random_unilateral(&entropy);
+		data.l[i]       = 3.0f*random_bilateral(&entropy); // plenty outside of [-1, 1] to clamp
+		data.r[i]       = 3.0f*random_bilateral(&entropy);
+	}
+
+	size_t array_size = sizeof(float)*(triangle_count + TRIANGLE_SOA_PADDING);
+
+	triangle_soa_t *triangles = &data.triangles;
+	triangles->count = (uint32_t)triangle_count;
+	triangles->ax    = m_alloc(arena, array_size, 64);
+	triangles->ay    = m_alloc(arena, array_size, 64);
+	triangles->az    = m_alloc(arena, array_size, 64);
+	triangles->e1x   = m_alloc(arena, array_size, 64);
+	triangles->e1y   = m_alloc(arena, array_size, 64);
+	triangles->e1z   = m_alloc(arena, array_size, 64);
+	triangles->e2x   = m_alloc(arena, array_size, 64);
+	triangles->e2y   = m_alloc(arena, array_size, 64);
+	triangles->e2z   = m_alloc(arena, array_size, 64);
+
+	for (size_t i = 0; i < triangle_count; i++)
+	{
+		if (i > 0 && i % 37 == 0)
+		{
+			// exact duplicates, so ties have to be broken the same way
+			data.a[i] = data.a[i - 1];
+			data.b[i] = data.b[i - 1];
+			data.c[i] = data.c[i - 1];
+		}
+		else
+		{
+			v3_t a = { 10.0f*random_bilateral(&entropy), 10.0f*random_bilateral(&entropy), 10.0f*random_bilateral(&entropy) };
+			data.a[i] = a;
+			data.b[i] = add(a, make_v3(8.0f*random_bilateral(&entropy), 8.0f*random_bilateral(&entropy), 8.0f*random_bilateral(&entropy)));
+			data.c[i] = add(a, make_v3(8.0f*random_bilateral(&entropy), 8.0f*random_bilateral(&entropy), 8.0f*random_bilateral(&entropy)));
+		}
+
+		v3_t edge1 = sub(data.b[i], data.a[i]);
+		v3_t edge2 = sub(data.c[i], data.a[i]);
+
+		triangles->ax [i] = data.a[i].x;
+		triangles->ay [i] = data.a[i].y;
+		triangles->az [i] = data.a[i].z;
+		triangles->e1x[i] = edge1.x;
+		triangles->e1y[i] = edge1.y;
+		triangles->e1z[i] = edge1.z;
+		triangles->e2x[i] = edge2.x;
+		triangles->e2y[i] = edge2.y;
+		triangles->e2z[i] = edge2.z;
+	}
+
+	for (size_t i = 0; i < ray_count; i++)
+	{
+		data.ray_o[i] = make_v3(15.0f*random_bilateral(&entropy), 15.0f*random_bilateral(&entropy), 15.0f*random_bilateral(&entropy));
+		data.ray_d[i] = normalize(make_v3(random_bilateral(&entropy), random_bilateral(&entropy), random_bilateral(&entropy)));
+	}
+
+	return data;
+}
+
+// compares bytes rather than floats, so a -0 where there should be a 0 or a differently signed NaN counts as wrong
+fn_local bool simd_test_bits_match(const void *a, const void *b, size_t size)
+{
+	const uint8_t *a_bytes = a;
+	const uint8_t *b_bytes = b;
+
+	for (size_t i = 0; i < size; i++)
+	{
+		if (a_bytes[i] != b_bytes[i])
+			return false;
+	}
+
+	return true;
+}
+
+// Odd counts and offsets so every tier goes through its tail handling.
+fn_local uint64_t simd_test_check_tier(arena_t *arena, const simd_test_data_t *data, const simd_kernels_t *simd, uint64_t *hit_count)
+{
+	uint64_t errors = 0;
+
+	size_t count = data->sample_count - 5;
+
+	float *expected = m_alloc_array_nozero(arena, 2*count, float);
+	float *actual   = m_alloc_array_nozero(arena, 2*count, float);
+
+	for (size_t i = 0; i < count; i++)
+	{
+		expected[i] = actual[i] = 0.001f*(float)i;
+	}
+
+	for (size_t i = 0; i < count; i++)
+	{
+		float sample = snorm_from_s16(data->samples[i + 3]);
+		sample *= data->volumes[i + 2];
+		expected[i] += 0.7f*sample;
+	}
+
+	simd->mix_s16(actual, data->samples + 3, data->volumes + 2, 0.7f, count);
+
+	errors += !simd_test_bits_match(expected, actual, sizeof(float)*count);
+
+	for (size_t i = 0; i < count; i++)
+	{
+		expected[2*i + 0] = max(-1.0f, min(1.0f, data->l[i + 1]));
+		expected[2*i + 1] = max(-1.0f, min(1.0f, data->r[i + 2]));
+	}
+
+	simd->clamp_interleave_stereo(actual, data->l + 1, data->r + 2, count);
+
+	errors += !simd_test_bits_match(expected, actual, sizeof(float)*2*count);
+
+	const triangle_soa_t *triangles = &data->triangles;
+
+	for (size_t ray_index = 0; ray_index < data->ray_count; ray_index++)
+	{
+		v3_t o = data->ray_o[ray_index];
+		v3_t d = data->ray_d[ray_index];
+
+		uint32_t first = (uint32_t)(ray_index % 41);
+		uint32_t triangle_count = (uint32_t)(triangles->count - first - (ray_index % 23));
+
+		float    expected_t   = FLT_MAX;
+		v3_t     expected_uvw = {0};
+		uint32_t expected_hit = UINT32_MAX;
+
+		for (uint32_t i = first; i < first + triangle_count; i++)
+		{
+			v3_t  uvw;
+			float t = ray_intersect_triangle(o, d, data->a[i], data->b[i], data->c[i], &uvw);
+
+			if (t >= 0.001f && t < expected_t)
+			{
+				expected_t   = t;
+				expected_uvw = uvw;
+				expected_hit = i;
+			}
+		}
+
+		float    actual_t   = FLT_MAX;
+		v3_t     actual_uvw = {0};
+		uint32_t actual_hit = simd->ray_intersect_triangles(triangles, first, triangle_count, o, d, 0.001f, &actual_t, &actual_uvw);
+
+		errors += actual_hit != expected_hit;
+		errors += !simd_test_bits_match(&actual_t,   &expected_t,   sizeof(actual_t));
+		errors += !simd_test_bits_match(&actual_uvw, &expected_uvw, sizeof(actual_uvw));
+
+		*hit_count += actual_hit != UINT32_MAX;
+	}
+
+	return errors;
+}
+
+// Forces every tier the CPU supports in turn and checks each kernel against the scalar code it replaced, bit for bit.
+CVAR_COMMAND(ccmd_test_simd, "test.simd")
+{
+	(void)arguments;
+
+	simd_tier_t previous_tier = simd_kernels()->tier;
+
+	bool failed = false;
+
+	m_scoped_temp
+	{
+		simd_test_data_t data = simd_test_data_generate(temp, 4099, 1031, 4096);
+
+		for (size_t tier = 0; tier < SimdTier_COUNT; tier++)
+		{
+			if (!cpu_supports_simd_tier((simd_tier_t)tier))
+			{
+				log(Benchmark, Warning, "test.simd: %cs isn't supported by this CPU, skipped", simd_tier_name((simd_tier_t)tier));
+				continue;
+			}
+
+			simd_select_tier((simd_tier_t)tier);
+
+			const simd_kernels_t *simd = simd_kernels();
+
+			uint64_t hit_count = 0;
+			uint64_t errors    = 0;
+
+			if (simd->tier != tier)
+			{
+				errors += 1;
+			}
+			else
+			{
+				errors += simd_test_check_tier(temp, &data, simd, &hit_count);
+			}
+
+			if (errors > 0)
+			{
+				log(Benchmark, Error, "test.simd: %cs: %llu errors", simd_tier_name((simd_tier_t)tier), errors);
+				failed = true;
+			}
+			else
+			{
+				log(Benchmark, Info, "test.simd: %cs matches scalar (%llu of %zu rays hit)", simd_tier_name((simd_tier_t)tier), hit_count, data.ray_count);
+			}
+		}
+	}
+
+	simd_select_tier(previous_tier);
+
+	if (!failed)
+	{
+		log(Benchmark, Info, "test.simd: passed");
+	}
+}
+
+//
+// test.wide_math
+//
+
+// Runs every f32x4_t and v3x4_t function, and the f32x8_t and v3x8_t ones if the CPU has AVX2, over random inputs
+// and checks each lane against the scalar code. Most have to match it bit for bit. rsqrt has to stay within its
+// documented relative error, and the transcendentals within 2 ulps of the correctly rounded result. The 8 wide
+// versions also have to match the 4 wide ones exactly.
+
+typedef enum wide_test_op_t
+{
+	WideTestOp_add,
+	WideTestOp_sub,
+	WideTestOp_mul,
+	WideTestOp_div,
+	WideTestOp_min,
+	WideTestOp_max,
+	WideTestOp_sqrt,
+	WideTestOp_abs,
+	WideTestOp_negate,
+	WideTestOp_lerp,
+	WideTestOp_cmplt,
+	WideTestOp_cmple,
+	WideTestOp_cmpgt,
+	WideTestOp_cmpge,
+	WideTestOp_cmpeq,
+	WideTestOp_cmpneq,
+	WideTestOp_select,
+	WideTestOp_v3_add,
+	WideTestOp_v3_sub,
+	WideTestOp_v3_mul,
+	WideTestOp_v3_min,
+	WideTestOp_v3_max,
+	WideTestOp_v3_muls,
+	WideTestOp_v3_dot,
+	WideTestOp_v3_cross,
+	WideTestOp_v3_len,
+	WideTestOp_v3_normalize,
+	WideTestOp_v3_lerp,
+	WideTestOp_v3_select,
+
+	WideTestOp_FIRST_APPROXIMATE,
+
+	WideTestOp_rsqrt = WideTestOp_FIRST_APPROXIMATE,
+	WideTestOp_log,
+	WideTestOp_exp,
+	WideTestOp_sin,
+	WideTestOp_cos,
+	WideTestOp_sincos_sin,
+	WideTestOp_sincos_cos,
+
+	WideTestOp_COUNT,
+} wide_test_op_t;
+
+global const char *g_wide_test_op_names[WideTestOp_COUNT] = {
+	[WideTestOp_add]          = "add",
+	[WideTestOp_sub]          = "sub",
+	[WideTestOp_mul]          = "mul",
+	[WideTestOp_div]          = "div",
+	[WideTestOp_min]          = "min",
+	[WideTestOp_max]          = "max",
+	[WideTestOp_sqrt]         = "sqrt",
+	[WideTestOp_abs]          = "abs",
+	[WideTestOp_negate]       = "negate",
+	[WideTestOp_lerp]         = "lerp",
+	[WideTestOp_cmplt]        = "cmplt",
+	[WideTestOp_cmple]        = "cmple",
+	[WideTestOp_cmpgt]        = "cmpgt",
+	[WideTestOp_cmpge]        = "cmpge",
+	[WideTestOp_cmpeq]        = "cmpeq",
+	[WideTestOp_cmpneq]       = "cmpneq",
+	[WideTestOp_select]       = "select",
+	[WideTestOp_v3_add]       = "v3 add",
+	[WideTestOp_v3_sub]       = "v3 sub",
+	[WideTestOp_v3_mul]       = "v3 mul",
+	[WideTestOp_v3_min]       = "v3 min",
+	[WideTestOp_v3_max]       = "v3 max",
+	[WideTestOp_v3_muls]      = "v3 muls",
+	[WideTestOp_v3_dot]       = "v3 dot",
+	[WideTestOp_v3_cross]     = "v3 cross",
+	[WideTestOp_v3_len]       = "v3 len",
+	[WideTestOp_v3_normalize] = "v3 normalize",
+	[WideTestOp_v3_lerp]      = "v3 lerp",
+	[WideTestOp_v3_select]    = "v3 select",
+	[WideTestOp_rsqrt]        = "rsqrt",
+	[WideTestOp_log]          = "log",
+	[WideTestOp_exp]          = "exp",
+	[WideTestOp_sin]          = "sin",
+	[WideTestOp_cos]          = "cos",
+	[WideTestOp_sincos_sin]   = "sincos (sin)",
+	[WideTestOp_sincos_cos]   = "sincos (cos)",
+};
+
+// the most ulps the transcendentals can be off by, sse_mathfun stays within 1 over these input ranges
+global uint32_t g_wide_test_max_ulps[WideTestOp_COUNT] = {
+	[WideTestOp_log]        = 2,
+	[WideTestOp_exp]        = 2,
+	[WideTestOp_sin]        = 2,
+	[WideTestOp_cos]        = 2,
+	[WideTestOp_sincos_sin] = 2,
+	[WideTestOp_sincos_cos] = 2,
+};
+
+typedef struct wide_test_data_t
+{
+	size_t count; // a multiple of 8
+
+	float *a, *b;     // [-100, 100], every 8th b equal to its a to test ties
+	float *t;         // [0, 1]
+	float *positive;  // [2^-20, 2^20]
+	float *exponent;  // [-87, 87]
+	float *angle;     // [-100, 100]
+	v3_t  *va, *vb;   // components in [-100, 100]
+} wide_test_data_t;
+
+fn_local wide_test_data_t wide_test_data_generate(arena_t *arena, size_t count)
+{
+	wide_test_data_t data = {
+		.count    = count,
+		.a        = m_alloc_array_nozero(arena, count, float),
+		.b        = m_alloc_array_nozero(arena, count, float),
+		.t        = m_alloc_array_nozero(arena, count, float),
+		.positive = m_alloc_array_nozero(arena, count, float),
+		.exponent = m_alloc_array_nozero(arena, count, float),
+		.angle    = m_alloc_array_nozero(arena, count, float),
+		.va       = m_alloc_array_nozero(arena, count, v3_t),
+		.vb       = m_alloc_array_nozero(arena, count, v3_t),
+	};
+
+	random_series_t entropy = { .state = 0x3A7F };
+
+	for (size_t i = 0; i < count; i++)
+	{
+		data.a       [i] = 100.0f*random_bilateral(&entropy);
+		data.b       [i] = i % 8 == 5 ? data.a[i] : 100.0f*random_bilateral(&entropy);
+		data.t       [i] = random_unilateral(&entropy);
+		data.positive[i] = exp2f(20.0f*random_bilateral(&entropy));
+		data.exponent[i] = 87.0f*random_bilateral(&entropy);
+		data.angle   [i] = 100.0f*random_bilateral(&entropy);
+		data.va      [i] = mul(100.0f, make_v3(random_bilateral(&entropy), random_bilateral(&entropy), random_bilateral(&entropy)));
+		data.vb      [i] = mul(100.0f, make_v3(random_bilateral(&entropy), random_bilateral(&entropy), random_bilateral(&entropy)));
+	}
+
+	return data;
+}
+
+fn_local float wide_test_mask_from_bool(bool x)
+{
+	uint32_t bits = x ? 0xFFFFFFFF : 0;
+
+	float result;
+	copy_memory(&result, &bits, sizeof(result));
+
+	return result;
+}
+
+// The scalar result for element i. Single float results go in x. Comparisons put their mask in x and the lane's
+// bit from mask_bits in y.
+fn_local v3_t wide_test_expected(wide_test_op_t op, const wide_test_data_t *data, size_t i)
+{
+	float a = data->a[i], b = data->b[i], t = data->t[i];
+	v3_t va = data->va[i], vb = data->vb[i];
+
+	v3_t result = {0};
+
+	switch (op)
+	{
+		case WideTestOp_add:          result.x = a + b; break;
+		case WideTestOp_sub:          result.x = a - b; break;
+		case WideTestOp_mul:          result.x = a*b; break;
+		case WideTestOp_div:          result.x = a / b; break;
+		case WideTestOp_min:          result.x = flt_min(a, b); break;
+		case WideTestOp_max:          result.x = flt_max(a, b); break;
+		case WideTestOp_sqrt:         result.x = sqrt_ss(data->positive[i]); break;
+		case WideTestOp_abs:          result.x = abs_ss(a); break;
+		case WideTestOp_negate:       result.x = -a; break;
+		case WideTestOp_lerp:         result.x = lerp(a, b, t); break;
+		case WideTestOp_cmplt:        result = make_v3(wide_test_mask_from_bool(a <  b), a <  b, 0); break;
+		case WideTestOp_cmple:        result = make_v3(wide_test_mask_from_bool(a <= b), a <= b, 0); break;
+		case WideTestOp_cmpgt:        result = make_v3(wide_test_mask_from_bool(a >  b), a >  b, 0); break;
+		case WideTestOp_cmpge:        result = make_v3(wide_test_mask_from_bool(a >= b), a >= b, 0); break;
+		case WideTestOp_cmpeq:        result = make_v3(wide_test_mask_from_bool(a == b), a == b, 0); break;
+		case WideTestOp_cmpneq:       result = make_v3(wide_test_mask_from_bool(a != b), a != b, 0); break;
+		case WideTestOp_select:       result.x = t < 0.5f ? a : b; break;
+		case WideTestOp_v3_add:       result = add(va, vb); break;
+		case WideTestOp_v3_sub:       result = sub(va, vb); break;
+		case WideTestOp_v3_mul:       result = mul(va, vb); break;
+		case WideTestOp_v3_min:       result = min(va, vb); break;
+		case WideTestOp_v3_max:       result = max(va, vb); break;
+		case WideTestOp_v3_muls:      result = mul(va, t); break;
+		case WideTestOp_v3_dot:       result.x = dot(va, vb); break;
+		case WideTestOp_v3_cross:     result = cross(va, vb); break;
+		case WideTestOp_v3_len:       result.x = vlen(va); break;
+		case WideTestOp_v3_normalize: result = normalize(va); break;
+		case WideTestOp_v3_lerp:      result = v3_lerps(va, vb, t); break;
+		case WideTestOp_v3_select:    result = t < 0.5f ? va : vb; break;
+
+		// the correctly rounded result, as far as double precision goes. log is taken by the logging macro
+		case WideTestOp_rsqrt:        result.x = (float)(1.0 / sqrt((double)data->positive[i])); break;
+		case WideTestOp_log:          result.x = (float)(log2((double)data->positive[i])*0.69314718055994531); break;
+		case WideTestOp_exp:          result.x = (float)exp((double)data->exponent[i]); break;
+		case WideTestOp_sin:          result.x = (float)sin((double)data->angle[i]); break;
+		case WideTestOp_cos:          result.x = (float)cos((double)data->angle[i]); break;
+		case WideTestOp_sincos_sin:   result.x = (float)sin((double)data->angle[i]); break;
+		case WideTestOp_sincos_cos:   result.x = (float)cos((double)data->angle[i]); break;
+
+		INVALID_DEFAULT_CASE;
+	}
+
+	return result;
+}
+
+fn_local void wide_test_run_x4(wide_test_op_t op, const wide_test_data_t *data, v3_t *out)
+{
+	for (size_t i = 0; i < data->count; i += 4)
+	{
+		f32x4_t a = f32x4_load(data->a + i);
+		f32x4_t b = f32x4_load(data->b + i);
+		f32x4_t t = f32x4_load(data->t + i);
+
+		v3x4_t va = v3x4_from_v3s(data->va + i);
+		v3x4_t vb = v3x4_from_v3s(data->vb + i);
+
+		f32x4_t select_mask = f32x4_cmplt(t, f32x4_set1(0.5f));
+
+		f32x4_t r  = f32x4_zero();
+		v3x4_t  rv = { r, r, r };
+
+		switch (op)
+		{
+			case WideTestOp_add:          r  = f32x4_add(a, b); break;
+			case WideTestOp_sub:          r  = f32x4_sub(a, b); break;
+			case WideTestOp_mul:          r  = f32x4_mul(a, b); break;
+			case WideTestOp_div:          r  = f32x4_div(a, b); break;
+			case WideTestOp_min:          r  = f32x4_min(a, b); break;
+			case WideTestOp_max:          r  = f32x4_max(a, b); break;
+			case WideTestOp_sqrt:         r  = f32x4_sqrt(f32x4_load(data->positive + i)); break;
+			case WideTestOp_abs:          r  = f32x4_abs(a); break;
+			case WideTestOp_negate:       r  = f32x4_negate(a); break;
+			case WideTestOp_lerp:         r  = f32x4_lerp(a, b, t); break;
+			case WideTestOp_cmplt:        r  = f32x4_cmplt(a, b); break;
+			case WideTestOp_cmple:        r  = f32x4_cmple(a, b); break;
+			case WideTestOp_cmpgt:        r  = f32x4_cmpgt(a, b); break;
+			case WideTestOp_cmpge:        r  = f32x4_cmpge(a, b); break;
+			case WideTestOp_cmpeq:        r  = f32x4_cmpeq(a, b); break;
+			case WideTestOp_cmpneq:       r  = f32x4_cmpneq(a, b); break;
+			case WideTestOp_select:       r  = f32x4_select(select_mask, a, b); break;
+			case WideTestOp_v3_add:       rv = v3x4_add(va, vb); break;
+			case WideTestOp_v3_sub:       rv = v3x4_sub(va, vb); break;
+			case WideTestOp_v3_mul:       rv = v3x4_mul(va, vb); break;
+			case WideTestOp_v3_min:       rv = v3x4_min(va, vb); break;
+			case WideTestOp_v3_max:       rv = v3x4_max(va, vb); break;
+			case WideTestOp_v3_muls:      rv = v3x4_muls(va, t); break;
+			case WideTestOp_v3_dot:       r  = v3x4_dot(va, vb); break;
+			case WideTestOp_v3_cross:     rv = v3x4_cross(va, vb); break;
+			case WideTestOp_v3_len:       r  = v3x4_len(va); break;
+			case WideTestOp_v3_normalize: rv = v3x4_normalize(va); break;
+			case WideTestOp_v3_lerp:      rv = v3x4_lerp(va, vb, t); break;
+			case WideTestOp_v3_select:    rv = v3x4_select(select_mask, va, vb); break;
+			case WideTestOp_rsqrt:        r  = f32x4_rsqrt(f32x4_load(data->positive + i)); break;
+			case WideTestOp_log:          r  = f32x4_log(f32x4_load(data->positive + i)); break;
+			case WideTestOp_exp:          r  = f32x4_exp(f32x4_load(data->exponent + i)); break;
+			case WideTestOp_sin:          r  = f32x4_sin(f32x4_load(data->angle + i)); break;
+			case WideTestOp_cos:          r  = f32x4_cos(f32x4_load(data->angle + i)); break;
+			case WideTestOp_sincos_sin:   { f32x4_t c; f32x4_sincos(f32x4_load(data->angle + i), &r, &c); } break;
+			case WideTestOp_sincos_cos:   { f32x4_t s; f32x4_sincos(f32x4_load(data->angle + i), &s, &r); } break;
+
+			INVALID_DEFAULT_CASE;
+		}
+
+		bool is_v3      = op >= WideTestOp_v3_add && op <= WideTestOp_v3_select && op != WideTestOp_v3_dot && op != WideTestOp_v3_len;
+		bool is_compare = op >= WideTestOp_cmplt  && op <= WideTestOp_cmpneq;
+
+		uint32_t mask_bits = f32x4_mask_bits(r);
+
+		for (uint32_t lane = 0; lane < 4; lane++)
+		{
+			if (is_v3)
+			{
+				out[i + lane] = v3x4_get(rv, lane);
+			}
+			else
+			{
+				out[i + lane] = make_v3(f32x4_get(r, lane), is_compare ? (float)((mask_bits >> lane) & 1) : 0.0f, 0.0f);
+			}
+		}
+	}
+}
+
+TARGET_AVX2
+fn_local void wide_test_run_x8(wide_test_op_t op, const wide_test_data_t *data, v3_t *out)
+{
+	for (size_t i = 0; i < data->count; i += 8)
+	{
+		f32x8_t a = f32x8_load(data->a + i);
+		f32x8_t b = f32x8_load(data->b + i);
+		f32x8_t t = f32x8_load(data->t + i);
+
+		v3x8_t va = v3x8_from_v3s(data->va + i);
+		v3x8_t vb = v3x8_from_v3s(data->vb + i);
+
+		f32x8_t select_mask = f32x8_cmplt(t, f32x8_set1(0.5f));
+
+		f32x8_t r  = f32x8_zero();
+		v3x8_t  rv = { r, r, r };
+
+		switch (op)
+		{
+			case WideTestOp_add:          r  = f32x8_add(a, b); break;
+			case WideTestOp_sub:          r  = f32x8_sub(a, b); break;
+			case WideTestOp_mul:          r  = f32x8_mul(a, b); break;
+			case WideTestOp_div:          r  = f32x8_div(a, b); break;
+			case WideTestOp_min:          r  = f32x8_min(a, b); break;
+			case WideTestOp_max:          r  = f32x8_max(a, b); break;
+			case WideTestOp_sqrt:         r  = f32x8_sqrt(f32x8_load(data->positive + i)); break;
+			case WideTestOp_abs:          r  = f32x8_abs(a); break;
+			case WideTestOp_negate:       r  = f32x8_negate(a); break;
+			case WideTestOp_lerp:         r  = f32x8_lerp(a, b, t); break;
+			case WideTestOp_cmplt:        r  = f32x8_cmplt(a, b); break;
+			case WideTestOp_cmple:        r  = f32x8_cmple(a, b); break;
+			case WideTestOp_cmpgt:        r  = f32x8_cmpgt(a, b); break;
+			case WideTestOp_cmpge:        r  = f32x8_cmpge(a, b); break;
+			case WideTestOp_cmpeq:        r  = f32x8_cmpeq(a, b); break;
+			case WideTestOp_cmpneq:       r  = f32x8_cmpneq(a, b); break;
+			case WideTestOp_select:       r  = f32x8_select(select_mask, a, b); break;
+			case WideTestOp_v3_add:       rv = v3x8_add(va, vb); break;
+			case WideTestOp_v3_sub:       rv = v3x8_sub(va, vb); break;
+			case WideTestOp_v3_mul:       rv = v3x8_mul(va, vb); break;
+			case WideTestOp_v3_min:       rv = v3x8_min(va, vb); break;
+			case WideTestOp_v3_max:       rv = v3x8_max(va, vb); break;
+			case WideTestOp_v3_muls:      rv = v3x8_muls(va, t); break;
+			case WideTestOp_v3_dot:       r  = v3x8_dot(va, vb); break;
+			case WideTestOp_v3_cross:     rv = v3x8_cross(va, vb); break;
+			case WideTestOp_v3_len:       r  = v3x8_len(va); break;
+			case WideTestOp_v3_normalize: rv = v3x8_normalize(va); break;
+			case WideTestOp_v3_lerp:      rv = v3x8_lerp(va, vb, t); break;
+			case WideTestOp_v3_select:    rv = v3x8_select(select_mask, va, vb); break;
+			case WideTestOp_rsqrt:        r  = f32x8_rsqrt(f32x8_load(data->positive + i)); break;
+			case WideTestOp_log:          r  = f32x8_log(f32x8_load(data->positive + i)); break;
+			case WideTestOp_exp:          r  = f32x8_exp(f32x8_load(data->exponent + i)); break;
+			case WideTestOp_sin:          r  = f32x8_sin(f32x8_load(data->angle + i)); break;
+			case WideTestOp_cos:          r  = f32x8_cos(f32x8_load(data->angle + i)); break;
+			case WideTestOp_sincos_sin:   { f32x8_t c; f32x8_sincos(f32x8_load(data->angle + i), &r, &c); } break;
+			case WideTestOp_sincos_cos:   { f32x8_t s; f32x8_sincos(f32x8_load(data->angle + i), &s, &r); } break;
+
+			INVALID_DEFAULT_CASE;
+		}
+
+		bool is_v3      = op >= WideTestOp_v3_add && op <= WideTestOp_v3_select && op != WideTestOp_v3_dot && op != WideTestOp_v3_len;
+		bool is_compare = op >= WideTestOp_cmplt  && op <= WideTestOp_cmpneq;
+
+		uint32_t mask_bits = f32x8_mask_bits(r);
+
+		for (uint32_t lane = 0; lane < 8; lane++)
+		{
+			if (is_v3)
+			{
+				out[i + lane] = v3x8_get(rv, lane);
+			}
+			else
+			{
+				out[i + lane] = make_v3(f32x8_get(r, lane), is_compare ? (float)((mask_bits >> lane) & 1) : 0.0f, 0.0f);
+			}
+		}
+	}
+}
+
+// how many representable floats lie between a and b
+fn_local uint32_t wide_test_ulp_distance(float a, float b)
+{
+	if (a == b)
+		return 0;
+
+	if (flt_is_nan(a) || flt_is_nan(b))
+		return UINT32_MAX;
+
+	int32_t ia, ib;
+	copy_memory(&ia, &a, sizeof(ia));
+	copy_memory(&ib, &b, sizeof(ib));
+
+	// map the sign and magnitude bits onto a line where neighbouring floats are neighbouring integers
+	if (ia < 0) ia = INT32_MIN - ia;
+	if (ib < 0) ib = INT32_MIN - ib;
+
+	int64_t distance = (int64_t)ia - (int64_t)ib;
+	return (uint32_t)MIN(distance < 0 ? -distance : distance, UINT32_MAX);
+}
+
+// returns the number of lanes that are off, and the worst error in *worst (ulps, or relative error for rsqrt)
+fn_local uint64_t wide_test_check(wide_test_op_t op, const wide_test_data_t *data, const v3_t *actual, double *worst)
+{
+	uint64_t errors = 0;
+
+	*worst = 0.0;
+
+	for (size_t i = 0; i < data->count; i++)
+	{
+		v3_t expected = wide_test_expected(op, data, i);
+
+		if (op == WideTestOp_rsqrt)
+		{
+			double error = fabs((double)actual[i].x - (double)expected.x) / (double)expected.x;
+			*worst = MAX(*worst, error);
+
+			errors += !(error <= 1.5 / 4096.0);
+		}
+		else if (op >= WideTestOp_FIRST_APPROXIMATE)
+		{
+			uint32_t ulps = wide_test_ulp_distance(actual[i].x, expected.x);
+			*worst = MAX(*worst, (double)ulps);
+
+			errors += ulps > g_wide_test_max_ulps[op];
+		}
+		else
+		{
+			errors += !simd_test_bits_match(&actual[i], &expected, sizeof(expected));
+		}
+	}
+
+	return errors;
+}
+
+CVAR_COMMAND(ccmd_test_wide_math, "test.wide_math")
+{
+	(void)arguments;
+
+	bool has_avx2 = cpu_supports_simd_tier(SimdTier_avx2);
+
+	if (!has_avx2)
+	{
+		log(Benchmark, Warning, "test.wide_math: the CPU doesn't have AVX2, only testing the 4 wide functions");
+	}
+
+	bool failed = false;
+
+	m_scoped_temp
+	{
+		wide_test_data_t data = wide_test_data_generate(temp, 1 << 16);
+
+		v3_t *actual_x4 = m_alloc_array_nozero(temp, data.count, v3_t);
+		v3_t *actual_x8 = m_alloc_array_nozero(temp, data.count, v3_t);
+
+		for (size_t op_index = 0; op_index < WideTestOp_COUNT; op_index++)
+		{
+			wide_test_op_t op = (wide_test_op_t)op_index;
+
+			if (op == WideTestOp_FIRST_APPROXIMATE && !failed)
+			{
+				log(Benchmark, Info, "test.wide_math: %d functions match scalar on %zu inputs", (int)WideTestOp_FIRST_APPROXIMATE, data.count);
+			}
+
+			wide_test_run_x4(op, &data, actual_x4);
+
+			double   worst;
+			uint64_t errors = wide_test_check(op, &data, actual_x4, &worst);
+
+			// the x8 versions do the same operations as the x4 ones, they should agree to the bit
+			uint64_t x8_mismatches = 0;
+
+			if (has_avx2)
+			{
+				wide_test_run_x8(op, &data, actual_x8);
+
+				for (size_t i = 0; i < data.count; i++)
+				{
+					x8_mismatches += !simd_test_bits_match(&actual_x8[i], &actual_x4[i], sizeof(v3_t));
+				}
+			}
+
+			if (errors > 0 || x8_mismatches > 0)
+			{
+				log(Benchmark, Error, "test.wide_math: %s: %llu lanes wrong, %llu lanes where x8 and x4 disagree",
+					g_wide_test_op_names[op], errors, x8_mismatches);
+				failed = true;
+			}
+			else if (op == WideTestOp_rsqrt)
+			{
+				log(Benchmark, Info, "test.wide_math: %-12s worst relative error %.3g (limit %.3g)", g_wide_test_op_names[op], worst, 1.5 / 4096.0);
+			}
+			else if (op > WideTestOp_FIRST_APPROXIMATE)
+			{
+				log(Benchmark, Info, "test.wide_math: %-12s worst error %.0f ulps (limit %u)", g_wide_test_op_names[op], worst, g_wide_test_max_ulps[op]);
+			}
+		}
+	}
+
+	if (!failed)
+	{
+		log(Benchmark, Info, "test.wide_math: passed");
+	}
+}
+
+//
+// bench.sort
+//
+
+// Sorts the same keys with merge_sort, the radix sort as it used to be (every pass, one thread), radix_sort_u64
+// and radix_sort_u64_parallel on the game job queue. Once with random 64 bit keys, and once with keys that only
+// use their low 40 bits like our sort keys tend to, where pass skipping gets to drop three passes. Sizes go up
+// by 10x from 10K to the given maximum (100M by default). merge_sort sits out above 10M keys, where it takes minutes.
+
+fn_local void bench_sort_radix_every_pass(uint64_t *array, size_t count)
+{
+	m_scoped_temp
+	{
+		uint64_t *src = array;
+		uint64_t *dst = m_alloc_array_nozero(temp, count, uint64_t);
+
+		for (size_t byte_index = 0; byte_index < sizeof(*array); byte_index++)
+		{
+			size_t offsets[256] = { 0 };
+
+			for (size_t i = 0; i < count; i++)
+			{
+				offsets[(uint8_t)(src[i] >> 8*byte_index)]++;
+			}
+
+			size_t total = 0;
+			for (size_t i = 0; i < ARRAY_COUNT(offsets); i++)
+			{
+				size_t piece_count = offsets[i];
+				offsets[i] = total;
+				total += piece_count;
+			}
+
+			for (size_t i = 0; i < count; i++)
+			{
+				dst[offsets[(uint8_t)(src[i] >> 8*byte_index)]++] = src[i];
+			}
+
+			SWAP(uint64_t *, dst, src);
+		}
+	}
+}
+
+fn_local int bench_sort_compare_u64(const void *l, const void *r, void *user_data)
+{
+	(void)user_data;
+
+	uint64_t a = *(const uint64_t *)l;
+	uint64_t b = *(const uint64_t *)r;
+
+	return (a > b) - (a < b);
+}
+
+typedef enum bench_sort_method_t
+{
+	BenchSortMethod_merge_sort,
+	BenchSortMethod_radix_every_pass,
+	BenchSortMethod_radix,
+	BenchSortMethod_radix_parallel,
+
+	BenchSortMethod_COUNT,
+} bench_sort_method_t;
+
+// returns the seconds it took per sort, or a negative number if the result was wrong
+fn_local double bench_sort_run(bench_sort_method_t method, const uint64_t *keys, uint64_t *work, size_t count, size_t repeat_count)
+{
+	double seconds = 0.0;
+	bool   sorted  = true;
+
+	for (size_t repeat = 0; repeat < repeat_count; repeat++)
+	{
+		copy_array(work, keys, count);
+
+		hires_time_t start = os_hires_time();
+
+		switch (method)
+		{
+			case BenchSortMethod_merge_sort:       merge_sort_array(work, count, bench_sort_compare_u64, NULL); break;
+			case BenchSortMethod_radix_every_pass: bench_sort_radix_every_pass(work, count);                    break;
+			case BenchSortMethod_radix:            radix_sort_u64(work, count);                                 break;
+			case BenchSortMethod_radix_parallel:   radix_sort_u64_parallel(game_job_queue, work, count);        break;
+			INVALID_DEFAULT_CASE;
+		}
+
+		seconds += os_seconds_elapsed(start, os_hires_time());
+
+		for (size_t i = 1; i < count; i++)
+		{
+			sorted &= work[i - 1] <= work[i];
+		}
+	}
+
+	return sorted ? seconds / (double)repeat_count : -1.0;
+}
+
+CVAR_COMMAND(ccmd_bench_sort, "bench.sort")
+{
+	int64_t max_count = 100000000;
+
+	string_t first_argument = string_split_word(&arguments);
+
+	if (first_argument.count > 0)
+	{
+		string_parse_int(&first_argument, &max_count);
+	}
+
+	static const char *method_names[BenchSortMethod_COUNT] = {
+		[BenchSortMethod_merge_sort]       = "merge_sort",
+		[BenchSortMethod_radix_every_pass] = "radix (all passes)",
+		[BenchSortMethod_radix]            = "radix",
+		[BenchSortMethod_radix_parallel]   = "radix parallel",
+	};
+
+	log(Benchmark, Info, "bench.sort: up to %lld keys, radix parallel on %zu threads + the calling thread, milliseconds per sort",
+		max_count, get_job_queue_thread_count(game_job_queue));
+
+	random_series_t entropy = { .state = 0x50F7 };
+
+	static const size_t key_bit_counts[] = { 64, 40 };
+
+	for_array(key_bits_index, key_bit_counts)
+	{
+		size_t   key_bits = key_bit_counts[key_bits_index];
+		uint64_t key_mask = key_bits == 64 ? UINT64_MAX : (1ull << key_bits) - 1;
+
+		log(Benchmark, Info, "  %zu bit keys:", key_bits);
+
+		for (size_t count = 10000; count <= (size_t)max_count; count *= 10)
+		{
+			// small sorts get repeated so there's something to measure
+			size_t repeat_count = MAX(1, 1000000 / count);
+
+			m_scoped_temp
+			{
+				uint64_t *keys = m_alloc_array_nozero(temp, count, uint64_t);
+				uint64_t *work = m_alloc_array_nozero(temp, count, uint64_t);
+
+				for (size_t i = 0; i < count; i++)
+				{
+					keys[i] = (((uint64_t)random_uint32(&entropy) << 32)|random_uint32(&entropy)) & key_mask;
+				}
+
+				string_list_t line = {0};
+
+				for (size_t method = 0; method < BenchSortMethod_COUNT; method++)
+				{
+					if (method == BenchSortMethod_merge_sort && count > 10000000)
+					{
+						slist_appendf(&line, temp, "%s %9s", method_names[method], "-");
+						continue;
+					}
+
+					double seconds = bench_sort_run((bench_sort_method_t)method, keys, work, count, repeat_count);
+
+					if (seconds < 0.0)
+					{
+						log(Benchmark, Error, "bench.sort: %s didn't sort %zu keys", method_names[method], count);
+					}
+
+					slist_appendf(&line, temp, "%s %9.3f", method_names[method], 1000.0*seconds);
+				}
+
+				log(Benchmark, Info, "  %10zu keys: %cs", count, slist_flatten_with_separator(&line, temp, S(", "), 0));
+			}
+		}
+	}
+}
+
+//
+// bench.sort_payload
+//
+
+// Sorts keys that need to drag an index along, the way we used to (the index packed into the low bits of the key,
+// with radix_sort_u32 for 16 bit keys like the UI's layers and radix_sort_u64 for 32 bit keys), against
+// radix_sort_u64_with_payload and radix_sort_u64_permutation. The sizes are those of a UI command list, and
+// of draw streams and lightmap bake work lists. Only the sort is timed: packing the index in or filling in the
+// payloads happens as things get pushed, and unpacking the index is a mask where it's read.
+
+typedef enum bench_payload_method_t
+{
+	BenchPayloadMethod_packed,
+	BenchPayloadMethod_with_payload,
+	BenchPayloadMethod_permutation,
+
+	BenchPayloadMethod_COUNT,
+} bench_payload_method_t;
+
+typedef struct bench_payload_t
+{
+	size_t          count;
+	size_t          key_bits;
+	const uint64_t *keys;
+
+	uint64_t *work_u64;
+	uint32_t *work_u32;
+	uint32_t *indices; // the sorted order when done
+} bench_payload_t;
+
+// returns the seconds it took per sort, or a negative number if the result was wrong
+fn_local double bench_sort_payload_run(bench_payload_method_t method, bench_payload_t *bench, size_t repeat_count)
+{
+	size_t count = bench->count;
+
+	double seconds = 0.0;
+	bool   sorted  = true;
+
+	for (size_t repeat = 0; repeat < repeat_count; repeat++)
+	{
+		switch (method)
+		{
+			case BenchPayloadMethod_packed:
+			{
+				if (bench->key_bits <= 16)
+				{
+					for (size_t i = 0; i < count; i++)
+					{
+						bench->work_u32[i] = (uint32_t)(bench->keys[i] << 16)|(uint32_t)i;
+					}
+				}
+				else
+				{
+					for (size_t i = 0; i < count; i++)
+					{
+						bench->work_u64[i] = (bench->keys[i] << 32)|i;
+					}
+				}
+			} break;
+
+			case BenchPayloadMethod_with_payload:
+			{
+				copy_array(bench->work_u64, bench->keys, count);
+
+				for (size_t i = 0; i < count; i++)
+				{
+					bench->indices[i] = (uint32_t)i;
+				}
+			} break;
+
+			case BenchPayloadMethod_permutation: break;
+
+			INVALID_DEFAULT_CASE;
+		}
+
+		hires_time_t start = os_hires_time();
+
+		switch (method)
+		{
+			case BenchPayloadMethod_packed:
+			{
+				if (bench->key_bits <= 16) radix_sort_u32(bench->work_u32, count);
+				else                       radix_sort_u64(bench->work_u64, count);
+			} break;
+
+			case BenchPayloadMethod_with_payload: radix_sort_u64_with_payload(bench->work_u64, bench->indices, count); break;
+			case BenchPayloadMethod_permutation:  radix_sort_u64_permutation(bench->keys, bench->indices, count);      break;
+
+			INVALID_DEFAULT_CASE;
+		}
+
+		seconds += os_seconds_elapsed(start, os_hires_time());
+
+		if (method == BenchPayloadMethod_packed)
+		{
+			if (bench->key_bits <= 16)
+			{
+				for (size_t i = 0; i < count; i++)
+				{
+					bench->indices[i] = bench->work_u32[i] & 0xFFFF;
+				}
+			}
+			else
+			{
+				for (size_t i = 0; i < count; i++)
+				{
+					bench->indices[i] = (uint32_t)bench->work_u64[i];
+				}
+			}
+		}
+
+		// equal keys have to keep their order, so there's exactly one right answer
+		for (size_t i = 1; i < count; i++)
+		{
+			uint64_t prev_key = bench->keys[bench->indices[i - 1]];
+			uint64_t key      = bench->keys[bench->indices[i]];
+
+			sorted &= prev_key < key || (prev_key == key && bench->indices[i - 1] < bench->indices[i]);
+		}
+	}
+
+	return sorted ? seconds / (double)repeat_count : -1.0;
+}
+
+CVAR_COMMAND(ccmd_bench_sort_payload, "bench.sort_payload")
+{
+	(void)arguments;
+
+	static const char *method_names[BenchPayloadMethod_COUNT] = {
+		[BenchPayloadMethod_packed]       = "packed index",
+		[BenchPayloadMethod_with_payload] = "with payload",
+		[BenchPayloadMethod_permutation]  = "permutation",
+	};
+
+	typedef struct bench_payload_case_t
+	{
+		const char *name;
+		size_t      key_bits;
+		uint64_t    distinct_keys;
+		size_t      counts[3];
+	} bench_payload_case_t;
+
+	static const bench_payload_case_t cases[] = {
+		{ "ui commands, 16 bit layer keys",          16, 64,                 { 1024,  16384,   65536   } },
+		{ "draw streams and bake work, 32 bit keys", 32, (uint64_t)1 << 32, { 65536, 1 << 20, 1 << 22 } },
+	};
+
+	log(Benchmark, Info, "bench.sort_payload: milliseconds per sort");
+
+	random_series_t entropy = { .state = 0xB1A5 };
+
+	for_array(case_index, cases)
+	{
+		const bench_payload_case_t *bench_case = &cases[case_index];
+
+		log(Benchmark, Info, "  %s:", bench_case->name);
+
+		for_array(count_index, bench_case->counts)
+		{
+			size_t count = bench_case->counts[count_index];
+
+			// small sorts get repeated so there's something to measure
+			size_t repeat_count = MAX(1, 4000000 / count);
+
+			m_scoped_temp
+			{
+				uint64_t *keys = m_alloc_array_nozero(temp, count, uint64_t);
+
+				for (size_t i = 0; i < count; i++)
+				{
+					uint64_t key = (uint64_t)random_uint32(&entropy) % bench_case->distinct_keys;
+
+					if (bench_case->key_bits <= 16)
+					{
+						// spread the distinct keys out like layers and sub layers are
+						key = ((key / 8) << 8)|(key % 8);
+					}
+
+					keys[i] = key;
+				}
+
+				bench_payload_t bench = {
+					.count    = count,
+					.key_bits = bench_case->key_bits,
+					.keys     = keys,
+					.work_u64 = m_alloc_array_nozero(temp, count, uint64_t),
+					.work_u32 = m_alloc_array_nozero(temp, count, uint32_t),
+					.indices  = m_alloc_array_nozero(temp, count, uint32_t),
+				};
+
+				string_list_t line = {0};
+
+				for (size_t method = 0; method < BenchPayloadMethod_COUNT; method++)
+				{
+					double seconds = bench_sort_payload_run((bench_payload_method_t)method, &bench, repeat_count);
+
+					if (seconds < 0.0)
+					{
+						log(Benchmark, Error, "bench.sort_payload: %s didn't sort %zu keys", method_names[method], count);
+					}
+
+					slist_appendf(&line, temp, "%s %8.3f", method_names[method], 1000.0*seconds);
+				}
+
+				log(Benchmark, Info, "  %8zu keys: %cs", count, slist_flatten_with_separator(&line, temp, S(", "), 0));
+			}
+		}
+	}
+}
+
+//
+// test.ui_sort
+//
+
+// Render command keys only name .layer, so whatever is left in the rest of the key (stack garbage, in the real
+// call sites) must not change the order commands come out in. Within a layer, commands keep the order they were
+// pushed in.
+
+CVAR_COMMAND(ccmd_test_ui_sort, "test.ui_sort")
+{
+	int64_t command_count = 1 << 12;
+
+	string_t first_argument = string_split_word(&arguments);
+
+	if (first_argument.count > 0)
+	{
+		string_parse_int(&first_argument, &command_count);
+	}
+
+	command_count = CLAMP(command_count, 1, UI_RENDER_COMMANDS_CAPACITY);
+
+	random_series_t entropy = { .state = 0xDEADBEEF };
+
+	uint64_t errors = 0;
+
+	m_scoped_temp
+	{
+		ui_t *old_ui  = ui;
+		ui_t *test_ui = m_alloc_struct(temp, ui_t);
+
+		ui_render_command_list_t *list = &test_ui->render_commands;
+		list->capacity        = (size_t)command_count;
+		list->keys            = m_alloc_array_nozero(temp, list->capacity, ui_render_command_key_t);
+		list->command_indices = m_alloc_array_nozero(temp, list->capacity, uint32_t);
+		list->commands        = m_alloc_array_nozero(temp, list->capacity, ui_render_command_t);
+
+		ui = test_ui;
+
+		for (int64_t i = 0; i < command_count; i++)
+		{
+			ui_layer_t layer = {
+				.layer     = (uint8_t)(random_uint32(&entropy) % 4),
+				.sub_layer = (uint8_t)(random_uint32(&entropy) % 4),
+			};
+
+			ui_render_command_key_t key;
+			key.u64   = 0xCDCDCDCDCDCDCDCDull | random_uint32(&entropy);
+			key.layer = layer;
+
+			ui_push_command(key, &(ui_render_command_t){ .rect.color_00 = layer.value });
+		}
+
+		ui_sort_render_commands();
+
+		ui = old_ui;
+
+		for (size_t i = 0; i < list->count; i++)
+		{
+			ui_render_command_key_t key     = list->keys[i];
+			ui_render_command_t    *command = &list->commands[list->command_indices[i]];
+
+			errors += key.u64 != key.layer.value;
+			errors += command->rect.color_00 != key.layer.value;
+
+			if (i > 0)
+			{
+				ui_render_command_key_t prev_key = list->keys[i - 1];
+
+				errors += prev_key.u64 > key.u64;
+				errors += prev_key.u64 == key.u64 && list->command_indices[i - 1] > list->command_indices[i];
+			}
+		}
+
+		errors += list->count != (size_t)command_count;
+	}
+
+	if (errors > 0)
+	{
+		log(Benchmark, Error, "test.ui_sort: %llu errors", errors);
+	}
+	else
+	{
+		log(Benchmark, Info, "test.ui_sort: passed, %lld commands", command_count);
+	}
+}
+
+//
+// bench.rays
+//
+
+// Traces the same rays through a map one at a time with intersect_map, and in packets with intersect_map_packet
+// for each SIMD tier the CPU has. Coherent rays come in batches of 8 leaving the same point within a cone of
+// about 15 degrees, like the baker's shadow and hemisphere rays. Incoherent rays each start somewhere random and
+// go somewhere random, which is the worst case for packets. Every method has to agree on which rays hit.
+
+typedef struct bench_rays_t
+{
+	map_t  *map;
+	size_t  ray_count;
+	v3_t   *o;
+	v3_t   *d;
+	bool   *hits;
+	bool    occlusion_test;
+} bench_rays_t;
+
+fn_local void bench_rays_generate(bench_rays_t *rays, bool coherent, random_series_t *entropy)
+{
+	rect3_t bounds = rays->map->bounds;
+
+	for (size_t first = 0; first < rays->ray_count; first += 8)
+	{
+		v3_t o = add(bounds.min, mul(random_unilateral3(entropy), rect3_dim(bounds)));
+		v3_t d = normalize(random_in_unit_sphere(entropy));
+
+		for (size_t i = first; i < MIN(first + 8, rays->ray_count); i++)
+		{
+			if (coherent)
+			{
+				rays->o[i] = o;
+				rays->d[i] = normalize(add(d, mul(0.25f, random_in_unit_sphere(entropy))));
+			}
+			else
+			{
+				rays->o[i] = add(bounds.min, mul(random_unilateral3(entropy), rect3_dim(bounds)));
+				rays->d[i] = normalize(random_in_unit_sphere(entropy));
+			}
+		}
+	}
+}
+
+// returns the best rays per second out of 3 runs, packet_tier < 0 traces the rays one at a time
+fn_local double bench_rays_run(bench_rays_t *rays, int packet_tier, uint64_t *hit_count)
+{
+	double best_seconds = DBL_MAX;
+
+	for (size_t run = 0; run < 3; run++)
+	{
+		hires_time_t start = os_hires_time();
+
+		if (packet_tier < 0)
+		{
+			for (size_t i = 0; i < rays->ray_count; i++)
+			{
+				rays->hits[i] = intersect_map(rays->map, &(intersect_params_t){
+					.o              = rays->o[i],
+					.d              = rays->d[i],
+					.occlusion_test = rays->occlusion_test,
+				}, NULL);
+			}
+		}
+		else
+		{
+			for (size_t first = 0; first < rays->ray_count; first += 8)
+			{
+				intersect_map_packet(rays->map, &(intersect_packet_params_t){
+					.count          = (uint32_t)MIN(8, rays->ray_count - first),
+					.o              = rays->o + first,
+					.d              = rays->d + first,
+					.occlusion_test = rays->occlusion_test,
+				}, rays->hits + first, NULL);
+			}
+		}
+
+		double seconds = os_seconds_elapsed(start, os_hires_time());
+		best_seconds = MIN(best_seconds, seconds);
+	}
+
+	*hit_count = 0;
+
+	for (size_t i = 0; i < rays->ray_count; i++)
+	{
+		*hit_count += rays->hits[i];
+	}
+
+	return (double)rays->ray_count / best_seconds;
+}
+
+CVAR_COMMAND(ccmd_bench_rays, "bench.rays")
+{
+	string_t map_name = string_split_word(&arguments);
+
+	if (map_name.count == 0)
+	{
+		map_name = S("test");
+	}
+
+	int64_t ray_count = 1 << 20;
+
+	string_t ray_count_argument = string_split_word(&arguments);
+	if (ray_count_argument.count > 0) string_parse_int(&ray_count_argument, &ray_count);
+
+	arena_t arena = {0};
+
+	map_t *map = load_map(&arena, Sf("gamedata/maps/%cs.map", map_name));
+
+	if (!map)
+	{
+		log(Benchmark, Error, "bench.rays: failed to load map '%cs'", map_name);
+		m_release(&arena);
+		return;
+	}
+
+	log(Benchmark, Info, "bench.rays: %lld rays through '%cs' (%u brushes, %u triangles), Mrays/s on one thread",
+		ray_count, map_name, map->brush_count, map->triangles.count);
+
+	bench_rays_t rays = {
+		.map       = map,
+		.ray_count = (size_t)ray_count,
+		.o         = m_alloc_array_nozero(&arena, ray_count, v3_t),
+		.d         = m_alloc_array_nozero(&arena, ray_count, v3_t),
+		.hits      = m_alloc_array_nozero(&arena, ray_count, bool),
+	};
+
+	simd_tier_t selected_tier = simd_kernels()->tier;
+
+	random_series_t entropy = { .state = 0x8A75 };
+
+	for (size_t incoherent = 0; incoherent < 2; incoherent++)
+	{
+		bool coherent = !incoherent;
+
+		bench_rays_generate(&rays, coherent, &entropy);
+
+		for (size_t occlusion_test = 0; occlusion_test < 2; occlusion_test++)
+		{
+			rays.occlusion_test = occlusion_test;
+
+			m_scoped_temp
+			{
+				string_list_t line = {0};
+
+				uint64_t single_hit_count;
+				double   single_rays_per_second = bench_rays_run(&rays, -1, &single_hit_count);
+
+				slist_appendf(&line, temp, "single ray %7.2f", single_rays_per_second / 1e6);
+
+				const simd_kernels_t *previous = NULL;
+
+				for (int tier = 0; tier < SimdTier_COUNT; tier++)
+				{
+					const simd_kernels_t *kernels = simd_kernels_for_tier((simd_tier_t)tier);
+
+					// AVX-512 traces packets with the AVX2 kernels, no need to time them twice
+					if (!kernels || (previous && kernels->ray_packet_intersect_box == previous->ray_packet_intersect_box))
+					{
+						continue;
+					}
+
+					previous = kernels;
+
+					simd_select_tier((simd_tier_t)tier);
+
+					uint64_t packet_hit_count;
+					double   packet_rays_per_second = bench_rays_run(&rays, tier, &packet_hit_count);
+
+					if (packet_hit_count != single_hit_count)
+					{
+						log(Benchmark, Error, "bench.rays: %cs packets hit %llu times, single rays %llu times",
+							simd_tier_name((simd_tier_t)tier), packet_hit_count, single_hit_count);
+					}
+
+					slist_appendf(&line, temp, "%cs packets of %u %7.2f (%.2fx)", simd_tier_name((simd_tier_t)tier), kernels->ray_packet_width,
+								  packet_rays_per_second / 1e6, packet_rays_per_second / single_rays_per_second);
+				}
+
+				simd_select_tier(selected_tier);
+
+				string_t label = Sf("%s, %s:", coherent ? "coherent" : "incoherent", occlusion_test ? "occlusion" : "closest hit");
+
+				log(Benchmark, Info, "  %-24.*s %cs", Sx(label), slist_flatten_with_separator(&line, temp, S(", "), 0));
+			}
+		}
+	}
+
+	release_map(map);
+	m_release(&arena);
+}
+
+//
+// bench.bvh
+//
+
+// Compares the brush BVH load_map has always built (midpoint splits over whole brushes) with the per-triangle BVH
+// from bvh_build_sah at a range of leaf sizes: how long each takes to build, what the tree looks like, and how fast
+// incoherent rays get traced through it on one thread. SAH costs of both are in units of testing one triangle, a
+// brush leaf costing as much as the triangles of its brushes. The triangle BVH is also timed in its 4-wide form, which
+// is what intersect_map walks. Every walk has to agree on which rays hit.
+
+STATIC_ASSERT(sizeof(map_bvh_node_t) == sizeof(bvh_node_t), "bvh_compute_stats reads map_bvh_node_t as bvh_node_t");
+
+typedef enum bench_bvh_walk_t
+{
+	BenchBvhWalk_brushes, // intersect_map_brushes
+	BenchBvhWalk_binary,  // intersect_map_binary
+	BenchBvhWalk_4_wide,  // intersect_map
+} bench_bvh_walk_t;
+
+// returns the best rays per second out of 3 runs
+fn_local double bench_bvh_trace(bench_rays_t *rays, bench_bvh_walk_t walk, uint64_t *hit_count)
+{
+	double best_seconds = DBL_MAX;
+
+	for (size_t run = 0; run < 3; run++)
+	{
+		hires_time_t start = os_hires_time();
+
+		for (size_t i = 0; i < rays->ray_count; i++)
+		{
+			intersect_params_t params = {
+				.o              = rays->o[i],
+				.d              = rays->d[i],
+				.occlusion_test = rays->occlusion_test,
+			};
+
+			switch (walk)
+			{
+				case BenchBvhWalk_brushes: rays->hits[i] = intersect_map_brushes(rays->map, &params, NULL); break;
+				case BenchBvhWalk_binary:  rays->hits[i] = intersect_map_binary (rays->map, &params, NULL); break;
+				case BenchBvhWalk_4_wide:  rays->hits[i] = intersect_map        (rays->map, &params, NULL); break;
+			}
+		}
+
+		double seconds = os_seconds_elapsed(start, os_hires_time());
+		best_seconds = MIN(best_seconds, seconds);
+	}
+
+	*hit_count = 0;
+
+	for (size_t i = 0; i < rays->ray_count; i++)
+	{
+		*hit_count += rays->hits[i];
+	}
+
+	return (double)rays->ray_count / best_seconds;
+}
+
+fn_local void bench_bvh_report(string_t label, double build_seconds, const bvh_stats_t *stats, double closest_rays_per_second, double occlusion_rays_per_second)
+{
+	m_scoped_temp
+	{
+		string_list_t histogram = {0};
+
+		for (size_t i = 0; i < BVH_STATS_LEAF_SIZE_BUCKETS; i++)
+		{
+			bool last = i == BVH_STATS_LEAF_SIZE_BUCKETS - 1;
+			slist_appendf(&histogram, temp, "%zu%s:%u", i + 1, last ? "+" : "", stats->leaf_size_histogram[i]);
+		}
+
+		log(Benchmark, Info, "  %-16.*s build %8.3f ms, SAH %8.2f, %6u nodes, depth %2u max %5.2f avg, closest hit %6.2f Mrays/s, occlusion %6.2f Mrays/s",
+			Sx(label), 1000.0*build_seconds, stats->sah_cost, stats->node_count, stats->max_depth, stats->average_leaf_depth,
+			closest_rays_per_second / 1e6, occlusion_rays_per_second / 1e6);
+		log(Benchmark, Info, "  %-16s %6u leaves of %u to %u (%.2f avg): %cs",
+			"", stats->leaf_count, stats->min_leaf_size, stats->max_leaf_size, stats->average_leaf_size, 
+			slist_flatten_with_separator(&histogram, temp, S(" "), 0));
+	}
+}
+
+CVAR_COMMAND(ccmd_bench_bvh, "bench.bvh")
+{
+	string_t map_name = string_split_word(&arguments);
+
+	if (map_name.count == 0)
+	{
+		map_name = S("test");
+	}
+
+	int64_t ray_count = 1 << 20;
+
+	string_t ray_count_argument = string_split_word(&arguments);
+	if (ray_count_argument.count > 0) string_parse_int(&ray_count_argument, &ray_count);
+
+	arena_t arena = {0};
+
+	map_t *map = load_map(&arena, Sf("gamedata/maps/%cs.map", map_name));
+
+	if (!map)
+	{
+		log(Benchmark, Error, "bench.bvh: failed to load map '%cs'", map_name);
+		m_release(&arena);
+		return;
+	}
+
+	log(Benchmark, Info, "bench.bvh: %lld incoherent rays through '%cs' (%u brushes, %u triangles), build times are the best of 5",
+		ray_count, map_name, map->brush_count, map->triangles.count);
+
+	bench_rays_t rays = {
+		.map       = map,
+		.ray_count = (size_t)ray_count,
+		.o         = m_alloc_array_nozero(&arena, ray_count, v3_t),
+		.d         = m_alloc_array_nozero(&arena, ray_count, v3_t),
+		.hits      = m_alloc_array_nozero(&arena, ray_count, bool),
+	};
+
+	random_series_t entropy = { .state = 0xB74 };
+	bench_rays_generate(&rays, false, &entropy);
+
+	uint64_t brush_hit_counts[2];
+	
+	// the brush BVH
+	{
+		double build_seconds = DBL_MAX;
+
+		for (size_t run = 0; run < 5; run++)
+		{
+			m_scoped_temp
+			{
+				// build_bvh reorders the brushes, so it gets a copy of them in an otherwise untouched map
+				map_t scratch = *map;
+				scratch.node_count = 0;
+				scratch.brushes    = m_copy_array(temp, map->brushes, map->brush_count);
+
+				hires_time_t start = os_hires_time();
+
+				build_bvh(temp, &scratch);
+
+				build_seconds = MIN(build_seconds, os_seconds_elapsed(start, os_hires_time()));
+			}
+		}
+
+		m_scoped_temp
+		{
+			float *brush_costs = m_alloc_array_nozero(temp, map->brush_count, float);
+
+			for (size_t brush_index = 0; brush_index < map->brush_count; brush_index++)
+			{
+				brush_costs[brush_index] = (float)map->brushes[brush_index].triangle_count;
+			}
+
+			bvh_stats_t stats = bvh_compute_stats((bvh_node_t *)map->nodes, map->node_count, 1.0f, brush_costs);
+
+			rays.occlusion_test = false;
+			double closest_rays_per_second = bench_bvh_trace(&rays, BenchBvhWalk_brushes, &brush_hit_counts[0]);
+
+			rays.occlusion_test = true;
+			double occlusion_rays_per_second = bench_bvh_trace(&rays, BenchBvhWalk_brushes, &brush_hit_counts[1]);
+
+			bench_bvh_report(S("brushes:"), build_seconds, &stats, closest_rays_per_second, occlusion_rays_per_second);
+		}
+	}
+
+	// the triangle BVH, rebuilt in place for each leaf size and put back the way load_map left it after
+	map_triangle_bvh_t loaded_triangle_bvh = map->triangle_bvh;
+
+	uint32_t max_leaf_sizes[] = { 1, 2, 4, 8, 16 };
+
+	for (size_t size_index = 0; size_index < ARRAY_COUNT(max_leaf_sizes); size_index++)
+	{
+		uint32_t max_leaf_size = max_leaf_sizes[size_index];
+
+		m_scoped_temp
+		{
+			double build_seconds = DBL_MAX;
+
+			for (size_t run = 0; run < 5; run++)
+			{
+				m_scoped_temp
+				{
+					hires_time_t start = os_hires_time();
+
+					build_triangle_bvh(temp, map, max_leaf_size, false);
+
+					build_seconds = MIN(build_seconds, os_seconds_elapsed(start, os_hires_time()));
+				}
+			}
+
+			// and once more to keep
+			build_triangle_bvh(temp, map, max_leaf_size, false);
+
+			map_triangle_bvh_t *bvh = &map->triangle_bvh;
+
+			bvh_stats_t stats = bvh_compute_stats(bvh->nodes, bvh->node_count, 1.0f, NULL);
+
+			double convert_seconds = DBL_MAX;
+
+			for (size_t run = 0; run < 5; run++)
+			{
+				m_scoped_temp
+				{
+					hires_time_t start = os_hires_time();
+
+					bvh4_from_bvh(temp, bvh->nodes, bvh->node_count);
+
+					convert_seconds = MIN(convert_seconds, os_seconds_elapsed(start, os_hires_time()));
+				}
+			}
+
+			double rays_per_second[2][2]; // [walk][occlusion_test]
+
+			for (size_t walk = 0; walk < 2; walk++)
+			{
+				for (size_t occlusion_test = 0; occlusion_test < 2; occlusion_test++)
+				{
+					rays.occlusion_test = occlusion_test;
+
+					uint64_t hit_count;
+					rays_per_second[walk][occlusion_test] = bench_bvh_trace(&rays, walk ? BenchBvhWalk_4_wide : BenchBvhWalk_binary, &hit_count);
+
+					if (hit_count != brush_hit_counts[occlusion_test])
+					{
+						log(Benchmark, Error, "bench.bvh: %s rays hit %llu times through the %s triangle BVH with leaves of up to %u, %llu times through the brush BVH",
+							occlusion_test ? "occlusion" : "closest hit", hit_count, walk ? "4-wide" : "binary", max_leaf_size, brush_hit_counts[occlusion_test]);
+					}
+				}
+			}
+
+			bench_bvh_report(Sf("SAH, leaf <= %u:", max_leaf_size), build_seconds, &stats, rays_per_second[0][0], rays_per_second[0][1]);
+
+			log(Benchmark, Info, "  %-16s 4-wide: convert %6.3f ms, %6u nodes, closest hit %6.2f Mrays/s (%.2fx), occlusion %6.2f Mrays/s (%.2fx)",
+				"", 1000.0*convert_seconds, bvh->node4_count, 
+				rays_per_second[1][0] / 1e6, rays_per_second[1][0] / rays_per_second[0][0],
+				rays_per_second[1][1] / 1e6, rays_per_second[1][1] / rays_per_second[0][1]);
+		}
+	}
+
+	map->triangle_bvh = loaded_triangle_bvh;
+
+	release_map(map);
+	m_release(&arena);
+}
+
+//
+// bench.bvh_build
+//
+
+// Times bvh_build_sah against bvh_build_sah_parallel on job queues of 1 up to as many threads as there are
+// processors (or as many as the second argument asks for), doubling each step and ending on the maximum, and checks
+// that every parallel build comes out bit for bit the same as the serial one. The primitives are small boxes
+// bunched up in clusters, a bit like the triangles of detailed props scattered over a level.
+
+fn_local void bench_bvh_build_generate(rect3_t *bounds, size_t count, random_series_t *entropy)
+{
+	size_t cluster_size = 256;
+
+	for (size_t first = 0; first < count; first += cluster_size)
+	{
+		v3_t  cluster_center = mul(4096.0f, random_unilateral3(entropy));
+		float cluster_radius = random_range_f32(entropy, 16.0f, 256.0f);
+
+		for (size_t i = first; i < MIN(first + cluster_size, count); i++)
+		{
+			v3_t center  = add(cluster_center, mul(cluster_radius, random_in_unit_sphere(entropy)));
+			v3_t extents = mul(random_range_f32(entropy, 0.5f, 8.0f), random_unilateral3(entropy));
+
+			bounds[i] = (rect3_t){
+				.min = sub(center, extents),
+				.max = add(center, extents),
+			};
+		}
+	}
+}
+
+fn_local bool bench_bvh_build_match(const bvh_t *a, const bvh_t *b, uint32_t count)
+{
+	if (a->node_count != b->node_count)
+		return false;
+
+	// node 1 is never written to besides being zeroed, so it's safe to compare too
+	return memcmp(a->nodes,   b->nodes,   a->node_count*sizeof(bvh_node_t)) == 0 &&
+		   memcmp(a->indices, b->indices, count*sizeof(uint32_t))            == 0;
+}
+
+CVAR_COMMAND(ccmd_bench_bvh_build, "bench.bvh_build")
+{
+	int64_t count = 1 << 20;
+
+	int64_t max_thread_count = (int64_t)query_processor_count();
+
+	string_t count_argument = string_split_word(&arguments);
+	if (count_argument.count > 0) string_parse_int(&count_argument, &count);
+
+	string_t thread_argument = string_split_word(&arguments);
+	if (thread_argument.count > 0) string_parse_int(&thread_argument, &max_thread_count);
+
+	max_thread_count = MAX(max_thread_count, 1);
+
+	// more threads than processors only measures oversubscription, so say how many there are
+	log(Benchmark, Info, "bench.bvh_build: %lld primitives, leaves of up to 4, best of 3 builds, up to %lld threads on %zu processors",
+		count, max_thread_count, query_processor_count());
+
+	arena_t arena = {0};
+
+	rect3_t *bounds = m_alloc_array_nozero(&arena, count, rect3_t);
+
+	random_series_t entropy = { .state = 0xB1D };
+	bench_bvh_build_generate(bounds, (size_t)count, &entropy);
+
+	bvh_build_params_t params = {
+		.count         = (uint32_t)count,
+		.bounds        = bounds,
+		.max_leaf_size = 4,
+	};
+
+	double serial_seconds = DBL_MAX;
+
+	for (size_t run = 0; run < 3; run++)
+	{
+		m_scoped(&arena)
+		{
+			hires_time_t start = os_hires_time();
+
+			bvh_build_sah(&arena, &params);
+
+			serial_seconds = MIN(serial_seconds, os_seconds_elapsed(start, os_hires_time()));
+		}
+	}
+
+	// kept around to compare the parallel builds against
+	bvh_t serial = bvh_build_sah(&arena, &params);
+
+	log(Benchmark, Info, "  serial:     %8.2f ms, %u nodes", 1000.0*serial_seconds, serial.node_count);
+
+	for (size_t thread_count = 1;; thread_count = MIN(2*thread_count, (size_t)max_thread_count))
+	{
+		job_queue_t queue = create_job_queue(thread_count, 1024);
+
+		double parallel_seconds = DBL_MAX;
+		bool   matches          = true;
+
+		for (size_t run = 0; run < 3; run++)
+		{
+			m_scoped(&arena)
+			{
+				hires_time_t start = os_hires_time();
+
+				bvh_t parallel = bvh_build_sah_parallel(&arena, queue, &params);
+
+				parallel_seconds = MIN(parallel_seconds, os_seconds_elapsed(start, os_hires_time()));
+
+				matches &= bench_bvh_build_match(&serial, &parallel, params.count);
+			}
+		}
+
+		destroy_job_queue(queue);
+
+		if (!matches)
+		{
+			log(Benchmark, Error, "bench.bvh_build: the tree built with %zu threads doesn't match the serial one", thread_count);
+		}
+
+		log(Benchmark, Info, "  %2zu threads: %8.2f ms, %5.2fx serial", thread_count, 1000.0*parallel_seconds, serial_seconds / parallel_seconds);
+
+		if (thread_count == (size_t)max_thread_count)
+			break;
+	}
+
+	m_release(&arena);
+}
+
+void register_benchmark_cvars(void)
+{
+	cvar_register(&ccmd_bench_jobs);
+	cvar_register(&ccmd_bench_fibers);
+	cvar_register(&ccmd_bench_pool);
+	cvar_register(&ccmd_bench_heap);
+	cvar_register(&ccmd_bench_table);
+	cvar_register(&ccmd_bench_concurrent_table);
+	cvar_register(&ccmd_test_concurrent_table);
+	cvar_register(&ccmd_test_atoms);
+	cvar_register(&ccmd_test_jobs);
+	cvar_register(&ccmd_bench_large_pages);
+	cvar_register(&ccmd_test_simd);
+	cvar_register(&ccmd_test_wide_math);
+	cvar_register(&ccmd_bench_sort);
+	cvar_register(&ccmd_bench_sort_payload);
+	cvar_register(&ccmd_test_ui_sort);
+	cvar_register(&ccmd_bench_rays);
+	cvar_register(&ccmd_bench_bvh);
+	cvar_register(&ccmd_bench_bvh_build);
+}
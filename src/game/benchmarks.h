@@ -0,0 +1,10 @@
+// ============================================================
+// Copyright 2024 by Daniël Cornelisse, All Rights Reserved.
+// ============================================================
+
+#pragma once
+
+// Benchmarks and stress tests are exposed as console commands ("bench.*" and "test.*") and log their results
+// under LogCat_Benchmark.
+
+fn void register_benchmark_cvars(void);
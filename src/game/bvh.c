@@ -18,3 +18,954 @@ bool bvh_iter_valid(bvh_iter_t *it)
 
 void bvh_iter_next(
 #endif
+
+//
+// binned SAH builder
+//
+
+typedef struct bvh_sah_bin_t
+{
+	rect3_t  bounds;
+	uint32_t count;
+} bvh_sah_bin_t;
+
+typedef struct bvh_sah_bins_t
+{
+	bvh_sah_bin_t bins[3][BVH_SAH_BIN_COUNT];
+} bvh_sah_bins_t;
+
+typedef struct bvh_sah_builder_t
+{
+	const rect3_t *bounds;
+	v3_t          *centroids;
+	uint32_t      *indices;
+	uint32_t      *scratch_indices; // as many as indices, for bvh_sah_partition
+
+	uint32_t max_leaf_size;
+	float    traversal_cost;
+
+	bvh_node_t *nodes;
+	uint32_t    node_count;
+} bvh_sah_builder_t;
+
+typedef struct bvh_sah_split_t
+{
+	uint32_t axis;
+	uint32_t bin;   // primitives in bins below this one go left
+	float    cost;  // FLT_MAX if no split puts primitives on both sides
+} bvh_sah_split_t;
+
+fn_local uint32_t bvh_sah_bin_index(float centroid, float centroid_min, float bin_scale)
+{
+	int32_t bin = (int32_t)((centroid - centroid_min)*bin_scale);
+	return (uint32_t)CLAMP(bin, 0, BVH_SAH_BIN_COUNT - 1);
+}
+
+fn_local float bvh_sah_bin_scale(rect3_t centroid_bounds, uint32_t axis)
+{
+	return (float)BVH_SAH_BIN_COUNT / (centroid_bounds.max.e[axis] - centroid_bounds.min.e[axis]);
+}
+
+// Everything below only takes unions of bounds and sums of counts, which come out the same whatever order the
+// primitives are visited in. That's what lets the parallel builder split the work up and still make the same tree.
+
+fn_local void bvh_sah_accumulate_bounds(bvh_sah_builder_t *builder, uint32_t first, uint32_t count, rect3_t *bounds, rect3_t *centroid_bounds)
+{
+	for (uint32_t i = first; i < first + count; i++)
+	{
+		uint32_t primitive = builder->indices[i];
+
+		*bounds          = rect3_union(*bounds, builder->bounds[primitive]);
+		*centroid_bounds = rect3_grow_to_contain(*centroid_bounds, builder->centroids[primitive]);
+	}
+}
+
+fn_local void bvh_sah_clear_bins(bvh_sah_bins_t *bins)
+{
+	for (size_t axis = 0; axis < 3; axis++)
+	for (size_t bin_index = 0; bin_index < BVH_SAH_BIN_COUNT; bin_index++)
+	{
+		bins->bins[axis][bin_index].bounds = rect3_inverted_infinity();
+		bins->bins[axis][bin_index].count  = 0;
+	}
+}
+
+fn_local void bvh_sah_merge_bins(bvh_sah_bins_t *bins, const bvh_sah_bins_t *other)
+{
+	for (size_t axis = 0; axis < 3; axis++)
+	for (size_t bin_index = 0; bin_index < BVH_SAH_BIN_COUNT; bin_index++)
+	{
+		bvh_sah_bin_t *bin = &bins->bins[axis][bin_index];
+		bin->bounds = rect3_union(bin->bounds, other->bins[axis][bin_index].bounds);
+		bin->count += other->bins[axis][bin_index].count;
+	}
+}
+
+// axes along which all centroids are in the same spot get no bins, since there's nothing to split there
+fn_local void bvh_sah_accumulate_bins(bvh_sah_builder_t *builder, uint32_t first, uint32_t count, rect3_t centroid_bounds, bvh_sah_bins_t *bins)
+{
+	for (uint32_t axis = 0; axis < 3; axis++)
+	{
+		float centroid_min = centroid_bounds.min.e[axis];
+
+		if (centroid_bounds.max.e[axis] - centroid_min <= 0.0f)
+			continue;
+
+		float bin_scale = bvh_sah_bin_scale(centroid_bounds, axis);
+
+		for (uint32_t i = first; i < first + count; i++)
+		{
+			uint32_t primitive = builder->indices[i];
+
+			bvh_sah_bin_t *bin = &bins->bins[axis][bvh_sah_bin_index(builder->centroids[primitive].e[axis], centroid_min, bin_scale)];
+			bin->bounds = rect3_union(bin->bounds, builder->bounds[primitive]);
+			bin->count += 1;
+		}
+	}
+}
+
+fn_local bvh_sah_split_t bvh_sah_find_split(bvh_sah_builder_t *builder, const bvh_sah_bins_t *bins, rect3_t bounds, rect3_t centroid_bounds)
+{
+	bvh_sah_split_t result = {
+		.cost = FLT_MAX,
+	};
+
+	float rcp_area = 1.0f / rect3_surface_area(bounds);
+
+	for (uint32_t axis = 0; axis < 3; axis++)
+	{
+		if (centroid_bounds.max.e[axis] - centroid_bounds.min.e[axis] <= 0.0f)
+			continue;
+
+		const bvh_sah_bin_t *axis_bins = bins->bins[axis];
+
+		// sweep from the right to get the cost of everything right of each plane, then from the left to finish it
+		float right_cost[BVH_SAH_BIN_COUNT];
+
+		rect3_t  right_bounds = rect3_inverted_infinity();
+		uint32_t right_count  = 0;
+
+		for (size_t bin_index = BVH_SAH_BIN_COUNT - 1; bin_index > 0; bin_index--)
+		{
+			right_bounds = rect3_union(right_bounds, axis_bins[bin_index].bounds);
+			right_count += axis_bins[bin_index].count;
+
+			right_cost[bin_index] = right_count > 0 ? rect3_surface_area(right_bounds)*(float)right_count : -1.0f;
+		}
+
+		rect3_t  left_bounds = rect3_inverted_infinity();
+		uint32_t left_count  = 0;
+
+		for (uint32_t bin_index = 1; bin_index < BVH_SAH_BIN_COUNT; bin_index++)
+		{
+			left_bounds = rect3_union(left_bounds, axis_bins[bin_index - 1].bounds);
+			left_count += axis_bins[bin_index - 1].count;
+
+			if (left_count == 0 || right_cost[bin_index] < 0.0f)
+				continue;
+
+			float cost = builder->traversal_cost + rcp_area*(rect3_surface_area(left_bounds)*(float)left_count + right_cost[bin_index]);
+
+			if (cost < result.cost)
+			{
+				result.axis = axis;
+				result.bin  = bin_index;
+				result.cost = cost;
+			}
+		}
+	}
+
+	return result;
+}
+
+fn_local bool bvh_sah_is_leaf(bvh_sah_builder_t *builder, uint32_t count, bvh_sah_split_t split)
+{
+	return count == 1 || (count <= builder->max_leaf_size && (float)count <= split.cost);
+}
+
+fn_local bool bvh_sah_goes_left(bvh_sah_builder_t *builder, uint32_t primitive, bvh_sah_split_t split, float centroid_min, float bin_scale)
+{
+	return bvh_sah_bin_index(builder->centroids[primitive].e[split.axis], centroid_min, bin_scale) < split.bin;
+}
+
+// Stable, so the parallel builder can partition blocks of the range independently and get the same order.
+fn_local uint32_t bvh_sah_partition(bvh_sah_builder_t *builder, uint32_t first, uint32_t count, rect3_t centroid_bounds, bvh_sah_split_t split)
+{
+	float centroid_min = centroid_bounds.min.e[split.axis];
+	float bin_scale    = bvh_sah_bin_scale(centroid_bounds, split.axis);
+
+	uint32_t *indices = builder->indices;
+	uint32_t *right   = builder->scratch_indices + first;
+
+	uint32_t left_at  = first;
+	uint32_t right_at = 0;
+
+	for (uint32_t i = first; i < first + count; i++)
+	{
+		uint32_t primitive = indices[i];
+
+		if (bvh_sah_goes_left(builder, primitive, split, centroid_min, bin_scale))
+		{
+			indices[left_at++] = primitive;
+		}
+		else
+		{
+			right[right_at++] = primitive;
+		}
+	}
+
+	copy_array(indices + left_at, right, right_at);
+
+	return left_at - first;
+}
+
+fn_local void bvh_sah_build_node(bvh_sah_builder_t *builder, uint32_t node_index, uint32_t first, uint32_t count, uint32_t depth)
+{
+	rect3_t bounds          = rect3_inverted_infinity();
+	rect3_t centroid_bounds = rect3_inverted_infinity();
+	bvh_sah_accumulate_bounds(builder, first, count, &bounds, &centroid_bounds);
+
+	bvh_node_t *node = &builder->nodes[node_index];
+	node->bounds = bounds;
+
+	bvh_sah_split_t split = {
+		.cost = FLT_MAX,
+	};
+
+	// past BVH_SAH_MAX_DEPTH there's no split to find, nodes just get halved until they fit in a leaf
+	if (count > 1 && depth < BVH_SAH_MAX_DEPTH)
+	{
+		bvh_sah_bins_t bins;
+		bvh_sah_clear_bins(&bins);
+		bvh_sah_accumulate_bins(builder, first, count, centroid_bounds, &bins);
+
+		split = bvh_sah_find_split(builder, &bins, bounds, centroid_bounds);
+	}
+
+	if (bvh_sah_is_leaf(builder, count, split))
+	{
+		node->left_first = first;
+		node->count      = (uint16_t)count;
+		node->split_axis = 0;
+	}
+	else
+	{
+		uint32_t left_count;
+
+		if (split.cost < FLT_MAX)
+		{
+			left_count = bvh_sah_partition(builder, first, count, centroid_bounds, split);
+		}
+		else
+		{
+			// every centroid is in the same spot (or the node is too deep), but there are too many primitives for one leaf
+			split.axis = rect3_largest_axis(bounds);
+			left_count = count / 2;
+		}
+
+		uint32_t left_index = builder->node_count;
+		builder->node_count += 2;
+
+		node->left_first = left_index;
+		node->count      = 0;
+		node->split_axis = (uint16_t)split.axis;
+
+		bvh_sah_build_node(builder, left_index,     first,              left_count,         depth + 1);
+		bvh_sah_build_node(builder, left_index + 1, first + left_count, count - left_count, depth + 1);
+	}
+}
+
+// Sets up everything but the nodes, which parallel builds hand out per subtree. Centroids and scratch indices
+// come from temp, which has to outlive the build.
+fn_local bvh_sah_builder_t bvh_sah_begin_build(arena_t *arena, arena_t *temp, const bvh_build_params_t *params, bvh_t *result)
+{
+	uint32_t count = params->count;
+
+	uint32_t max_leaf_size = params->max_leaf_size ? params->max_leaf_size : 4;
+	max_leaf_size = MIN(max_leaf_size, UINT16_MAX);
+
+	// a binary tree with at most one primitive per leaf has 2*count - 1 nodes, plus the unused node 1
+	result->nodes   = m_alloc_nozero(arena, 2ull*count*sizeof(bvh_node_t), 64);
+	result->indices = m_alloc_array_nozero(arena, count, uint32_t);
+
+	bvh_sah_builder_t builder = {
+		.bounds          = params->bounds,
+		.centroids       = m_alloc_array_nozero(temp, count, v3_t),
+		.indices         = result->indices,
+		.scratch_indices = m_alloc_array_nozero(temp, count, uint32_t),
+		.max_leaf_size   = max_leaf_size,
+		.traversal_cost  = params->traversal_cost > 0.0f ? params->traversal_cost : 1.0f,
+	};
+
+	zero_struct(&result->nodes[1]);
+
+	return builder;
+}
+
+bvh_t bvh_build_sah(arena_t *arena, const bvh_build_params_t *params)
+{
+	bvh_t result = {0};
+
+	uint32_t count = params->count;
+
+	if (count == 0)
+		return result;
+
+	arena_t *temp = m_get_temp_scope_begin(&arena, 1);
+	{
+		bvh_sah_builder_t builder = bvh_sah_begin_build(arena, temp, params, &result);
+
+		for (uint32_t i = 0; i < count; i++)
+		{
+			builder.indices  [i] = i;
+			builder.centroids[i] = rect3_center(params->bounds[i]);
+		}
+
+		builder.nodes      = result.nodes;
+		builder.node_count = 2; // the root and the gap after it
+
+		bvh_sah_build_node(&builder, 0, 0, count, 0);
+
+		result.node_count = builder.node_count;
+	}
+	m_scope_end(temp);
+
+	return result;
+}
+
+//
+// parallel SAH builder
+//
+
+// Nodes with at least this many primitives get their bounds, bins and partition worked out by parallel_for over
+// blocks of primitives, smaller ones are built as a whole by one job. A node has to be big before the parallel_fors
+// pay for themselves, and by then there are enough subtrees to keep every thread busy.
+#define BVH_PARALLEL_MIN_SPLIT_COUNT (1 << 14)
+#define BVH_PARALLEL_BLOCK_SIZE      (1 << 12)
+
+// A node from the top of the tree. Their node indices depend on the sizes of subtrees that haven't been built yet
+// when they're split, so they're kept aside and laid out once everything is done.
+typedef struct bvh_parallel_top_node_t
+{
+	rect3_t  bounds;
+	uint32_t first;
+	uint32_t count;
+	uint32_t depth;
+	uint32_t split_axis;
+
+	// top nodes are either split further, with children in the top node array
+	uint32_t left;
+	uint32_t right;
+
+	// or built as a whole by a subtree job, into nodes + 2*first in the subtree node array with its root at 0
+	bool     subtree;
+	uint32_t subtree_node_count;
+	uint32_t node_index;             // where the layout put the subtree's root
+	uint32_t subtree_base;           // and the rest of its nodes, from subtree node 1 on
+} bvh_parallel_top_node_t;
+
+typedef struct bvh_parallel_block_t
+{
+	// bounds pass
+	rect3_t bounds;
+	rect3_t centroid_bounds;
+
+	// binning pass
+	bvh_sah_bins_t bins;
+
+	// partition passes
+	uint32_t left_count;
+	uint32_t left_offset;
+	uint32_t right_offset;
+} bvh_parallel_block_t;
+
+typedef struct bvh_parallel_build_t
+{
+	job_queue_t       queue;
+	bvh_sah_builder_t builder;
+
+	stretchy_buffer(bvh_parallel_top_node_t) top_nodes;
+	bvh_node_t *subtree_nodes;
+
+	bvh_node_t *nodes;
+	uint32_t    node_count;
+
+	// the node whose work is currently being split into blocks
+	uint32_t              first;
+	uint32_t              count;
+	rect3_t               centroid_bounds;
+	bvh_sah_split_t       split;
+	uint32_t              left_count;
+	bvh_parallel_block_t *blocks;
+} bvh_parallel_build_t;
+
+fn_local void bvh_parallel_block_range(bvh_parallel_build_t *build, size_t block, uint32_t *first, uint32_t *count)
+{
+	uint32_t block_first = (uint32_t)(block*BVH_PARALLEL_BLOCK_SIZE);
+
+	*first = build->first + block_first;
+	*count = MIN(BVH_PARALLEL_BLOCK_SIZE, build->count - block_first);
+}
+
+fn_local void bvh_parallel_bounds_proc(job_context_t *context, void *userdata, size_t first_block, size_t one_past_last_block)
+{
+	(void)context;
+
+	bvh_parallel_build_t *build = userdata;
+
+	for (size_t block_index = first_block; block_index < one_past_last_block; block_index++)
+	{
+		bvh_parallel_block_t *block = &build->blocks[block_index];
+
+		uint32_t first, count;
+		bvh_parallel_block_range(build, block_index, &first, &count);
+
+		block->bounds          = rect3_inverted_infinity();
+		block->centroid_bounds = rect3_inverted_infinity();
+		bvh_sah_accumulate_bounds(&build->builder, first, count, &block->bounds, &block->centroid_bounds);
+	}
+}
+
+fn_local void bvh_parallel_bins_proc(job_context_t *context, void *userdata, size_t first_block, size_t one_past_last_block)
+{
+	(void)context;
+
+	bvh_parallel_build_t *build = userdata;
+
+	for (size_t block_index = first_block; block_index < one_past_last_block; block_index++)
+	{
+		bvh_parallel_block_t *block = &build->blocks[block_index];
+
+		uint32_t first, count;
+		bvh_parallel_block_range(build, block_index, &first, &count);
+
+		bvh_sah_clear_bins(&block->bins);
+		bvh_sah_accumulate_bins(&build->builder, first, count, build->centroid_bounds, &block->bins);
+	}
+}
+
+fn_local void bvh_parallel_count_left_proc(job_context_t *context, void *userdata, size_t first_block, size_t one_past_last_block)
+{
+	(void)context;
+
+	bvh_parallel_build_t *build   = userdata;
+	bvh_sah_builder_t    *builder = &build->builder;
+
+	float centroid_min = build->centroid_bounds.min.e[build->split.axis];
+	float bin_scale    = bvh_sah_bin_scale(build->centroid_bounds, build->split.axis);
+
+	for (size_t block_index = first_block; block_index < one_past_last_block; block_index++)
+	{
+		bvh_parallel_block_t *block = &build->blocks[block_index];
+
+		uint32_t first, count;
+		bvh_parallel_block_range(build, block_index, &first, &count);
+
+		block->left_count = 0;
+
+		for (uint32_t i = first; i < first + count; i++)
+		{
+			block->left_count += bvh_sah_goes_left(builder, builder->indices[i], build->split, centroid_min, bin_scale);
+		}
+	}
+}
+
+// scatters into scratch_indices in the order bvh_sah_partition would leave the indices in
+fn_local void bvh_parallel_scatter_proc(job_context_t *context, void *userdata, size_t first_block, size_t one_past_last_block)
+{
+	(void)context;
+
+	bvh_parallel_build_t *build   = userdata;
+	bvh_sah_builder_t    *builder = &build->builder;
+
+	float centroid_min = build->centroid_bounds.min.e[build->split.axis];
+	float bin_scale    = bvh_sah_bin_scale(build->centroid_bounds, build->split.axis);
+
+	uint32_t *dst = builder->scratch_indices + build->first;
+
+	for (size_t block_index = first_block; block_index < one_past_last_block; block_index++)
+	{
+		bvh_parallel_block_t *block = &build->blocks[block_index];
+
+		uint32_t first, count;
+		bvh_parallel_block_range(build, block_index, &first, &count);
+
+		uint32_t left_at  = block->left_offset;
+		uint32_t right_at = build->left_count + block->right_offset;
+
+		for (uint32_t i = first; i < first + count; i++)
+		{
+			uint32_t primitive = builder->indices[i];
+
+			if (bvh_sah_goes_left(builder, primitive, build->split, centroid_min, bin_scale))
+			{
+				dst[left_at++] = primitive;
+			}
+			else
+			{
+				dst[right_at++] = primitive;
+			}
+		}
+	}
+}
+
+fn_local void bvh_parallel_copy_back_proc(job_context_t *context, void *userdata, size_t first_block, size_t one_past_last_block)
+{
+	(void)context;
+
+	bvh_parallel_build_t *build   = userdata;
+	bvh_sah_builder_t    *builder = &build->builder;
+
+	for (size_t block_index = first_block; block_index < one_past_last_block; block_index++)
+	{
+		uint32_t first, count;
+		bvh_parallel_block_range(build, block_index, &first, &count);
+
+		copy_array(builder->indices + first, builder->scratch_indices + first, count);
+	}
+}
+
+// Splits a node the way bvh_sah_build_node would, with the work spread over the queue. Returns its top node index.
+fn_local uint32_t bvh_parallel_split_node(bvh_parallel_build_t *build, uint32_t first, uint32_t count, uint32_t depth)
+{
+	uint32_t top_index = sb_count(build->top_nodes);
+
+	bvh_parallel_top_node_t *top = sb_add(build->top_nodes);
+	zero_struct(top);
+
+	top->first = first;
+	top->count = count;
+	top->depth = depth;
+
+	// anything that could turn out to be a leaf (or gets halved instead of split) is left to a subtree job too
+	if (count < BVH_PARALLEL_MIN_SPLIT_COUNT || count <= build->builder.max_leaf_size || depth >= BVH_SAH_MAX_DEPTH)
+	{
+		top->subtree = true;
+		return top_index;
+	}
+
+	size_t block_count = (count + BVH_PARALLEL_BLOCK_SIZE - 1) / BVH_PARALLEL_BLOCK_SIZE;
+
+	build->first = first;
+	build->count = count;
+
+	rect3_t bounds = rect3_inverted_infinity();
+	rect3_t centroid_bounds = rect3_inverted_infinity();
+
+	parallel_for(build->queue, block_count, 1, bvh_parallel_bounds_proc, build);
+
+	for (size_t block_index = 0; block_index < block_count; block_index++)
+	{
+		bounds          = rect3_union(bounds,          build->blocks[block_index].bounds);
+		centroid_bounds = rect3_union(centroid_bounds, build->blocks[block_index].centroid_bounds);
+	}
+
+	build->centroid_bounds = centroid_bounds;
+
+	parallel_for(build->queue, block_count, 1, bvh_parallel_bins_proc, build);
+
+	bvh_sah_bins_t bins;
+	bvh_sah_clear_bins(&bins);
+
+	for (size_t block_index = 0; block_index < block_count; block_index++)
+	{
+		bvh_sah_merge_bins(&bins, &build->blocks[block_index].bins);
+	}
+
+	bvh_sah_split_t split = bvh_sah_find_split(&build->builder, &bins, bounds, centroid_bounds);
+
+	uint32_t left_count;
+
+	if (split.cost < FLT_MAX)
+	{
+		build->split = split;
+
+		parallel_for(build->queue, block_count, 1, bvh_parallel_count_left_proc, build);
+
+		left_count = 0;
+
+		for (size_t block_index = 0; block_index < block_count; block_index++)
+		{
+			left_count += build->blocks[block_index].left_count;
+		}
+
+		uint32_t left_offset  = 0;
+		uint32_t right_offset = 0;
+
+		for (size_t block_index = 0; block_index < block_count; block_index++)
+		{
+			uint32_t block_first, block_size;
+			bvh_parallel_block_range(build, block_index, &block_first, &block_size);
+
+			bvh_parallel_block_t *block = &build->blocks[block_index];
+			block->left_offset  = left_offset;
+			block->right_offset = right_offset;
+
+			left_offset  += block->left_count;
+			right_offset += block_size - block->left_count;
+		}
+
+		build->left_count = left_count;
+
+		parallel_for(build->queue, block_count, 1, bvh_parallel_scatter_proc,   build);
+		parallel_for(build->queue, block_count, 1, bvh_parallel_copy_back_proc, build);
+	}
+	else
+	{
+		split.axis = rect3_largest_axis(bounds);
+		left_count = count / 2;
+	}
+
+	uint32_t left  = bvh_parallel_split_node(build, first,              left_count,         depth + 1);
+	uint32_t right = bvh_parallel_split_node(build, first + left_count, count - left_count, depth + 1);
+
+	// the stretchy buffer may have moved while splitting the children
+	top = &build->top_nodes[top_index];
+
+	top->bounds     = bounds;
+	top->split_axis = split.axis;
+	top->left       = left;
+	top->right      = right;
+
+	return top_index;
+}
+
+fn_local void bvh_parallel_subtree_proc(job_context_t *context, void *userdata, size_t first_top, size_t one_past_last_top)
+{
+	(void)context;
+
+	bvh_parallel_build_t *build = userdata;
+
+	for (size_t top_index = first_top; top_index < one_past_last_top; top_index++)
+	{
+		bvh_parallel_top_node_t *top = &build->top_nodes[top_index];
+
+		if (!top->subtree)
+			continue;
+
+		bvh_sah_builder_t builder = build->builder;
+		builder.nodes      = build->subtree_nodes + 2ull*top->first;
+		builder.node_count = 1;
+
+		bvh_sah_build_node(&builder, 0, top->first, top->count, top->depth);
+
+		top->subtree_node_count = builder.node_count;
+	}
+}
+
+// hands out node indices in the same order bvh_sah_build_node does: a node's children go at the end when it's
+// split, and its left subtree gets everything after that before its right subtree does
+fn_local void bvh_parallel_layout(bvh_parallel_build_t *build, uint32_t top_index, uint32_t node_index)
+{
+	bvh_parallel_top_node_t *top = &build->top_nodes[top_index];
+
+	if (top->subtree)
+	{
+		top->node_index   = node_index;
+		top->subtree_base = build->node_count;
+
+		build->node_count += top->subtree_node_count - 1;
+	}
+	else
+	{
+		uint32_t left_index = build->node_count;
+		build->node_count += 2;
+
+		build->nodes[node_index] = (bvh_node_t){
+			.bounds     = top->bounds,
+			.left_first = left_index,
+			.split_axis = (uint16_t)top->split_axis,
+		};
+
+		bvh_parallel_layout(build, top->left,  left_index);
+		bvh_parallel_layout(build, top->right, left_index + 1);
+	}
+}
+
+fn_local void bvh_parallel_copy_subtree_proc(job_context_t *context, void *userdata, size_t first_top, size_t one_past_last_top)
+{
+	(void)context;
+
+	bvh_parallel_build_t *build = userdata;
+
+	for (size_t top_index = first_top; top_index < one_past_last_top; top_index++)
+	{
+		bvh_parallel_top_node_t *top = &build->top_nodes[top_index];
+
+		if (!top->subtree)
+			continue;
+
+		bvh_node_t *src = build->subtree_nodes + 2ull*top->first;
+
+		for (uint32_t i = 0; i < top->subtree_node_count; i++)
+		{
+			bvh_node_t node = src[i];
+
+			if (node.count == 0)
+			{
+				node.left_first = top->subtree_base + node.left_first - 1;
+			}
+
+			uint32_t dst_index = i == 0 ? top->node_index : top->subtree_base + i - 1;
+			build->nodes[dst_index] = node;
+		}
+	}
+}
+
+fn_local void bvh_parallel_centroids_proc(job_context_t *context, void *userdata, size_t first, size_t one_past_last)
+{
+	(void)context;
+
+	bvh_parallel_build_t *build   = userdata;
+	bvh_sah_builder_t    *builder = &build->builder;
+
+	for (size_t i = first; i < one_past_last; i++)
+	{
+		builder->indices  [i] = (uint32_t)i;
+		builder->centroids[i] = rect3_center(builder->bounds[i]);
+	}
+}
+
+bvh_t bvh_build_sah_parallel(arena_t *arena, job_queue_t queue, const bvh_build_params_t *params)
+{
+	bvh_t result = {0};
+
+	uint32_t count = params->count;
+
+	if (count == 0)
+		return result;
+
+	arena_t *temp = m_get_temp_scope_begin(&arena, 1);
+	{
+		bvh_parallel_build_t build = {
+			.queue   = queue,
+			.builder = bvh_sah_begin_build(arena, temp, params, &result),
+			.nodes   = result.nodes,
+		};
+
+		parallel_for(queue, count, BVH_PARALLEL_BLOCK_SIZE, bvh_parallel_centroids_proc, &build);
+
+		build.top_nodes     = sb_init(temp, 64, bvh_parallel_top_node_t);
+		build.subtree_nodes = m_alloc_nozero(temp, 2ull*count*sizeof(bvh_node_t), 64);
+		build.blocks        = m_alloc_array_nozero(temp, (count + BVH_PARALLEL_BLOCK_SIZE - 1) / BVH_PARALLEL_BLOCK_SIZE, bvh_parallel_block_t);
+
+		bvh_parallel_split_node(&build, 0, count, 0);
+
+		size_t top_node_count = sb_count(build.top_nodes);
+
+		parallel_for(queue, top_node_count, 1, bvh_parallel_subtree_proc, &build);
+
+		build.node_count = 2; // the root and the gap after it
+		bvh_parallel_layout(&build, 0, 0);
+
+		parallel_for(queue, top_node_count, 1, bvh_parallel_copy_subtree_proc, &build);
+
+		result.node_count = build.node_count;
+	}
+	m_scope_end(temp);
+
+	return result;
+}
+
+//
+// 4-wide BVH
+//
+
+STATIC_ASSERT(sizeof(bvh4_node_t) == 128, "bvh4_node_t is meant to fill two cache lines");
+
+typedef struct bvh4_builder_t
+{
+	const bvh_node_t *nodes;
+
+	bvh4_node_t *nodes4;
+	uint32_t     node4_count;
+} bvh4_builder_t;
+
+fn_local void bvh4_set_child_bounds(bvh4_node_t *node, uint32_t slot, rect3_t bounds)
+{
+	node->min_x[slot] = bounds.min.x;
+	node->min_y[slot] = bounds.min.y;
+	node->min_z[slot] = bounds.min.z;
+	node->max_x[slot] = bounds.max.x;
+	node->max_y[slot] = bounds.max.y;
+	node->max_z[slot] = bounds.max.z;
+}
+
+// collapses the binary node binary_index, which has to be an interior node, into a new 4-wide node
+fn_local uint32_t bvh4_collapse_node(bvh4_builder_t *builder, uint32_t binary_index)
+{
+	const bvh_node_t *nodes  = builder->nodes;
+	const bvh_node_t *binary = &nodes[binary_index];
+
+	uint32_t     node_index = builder->node4_count++;
+	bvh4_node_t *node       = &builder->nodes4[node_index];
+
+	zero_struct(node);
+
+	node->split_axis[0] = (uint8_t)binary->split_axis;
+
+	// which binary node ends up in each slot
+	uint32_t slots[4] = { UINT32_MAX, UINT32_MAX, UINT32_MAX, UINT32_MAX };
+
+	for (uint32_t side = 0; side < 2; side++)
+	{
+		uint32_t          child_index = binary->left_first + side;
+		const bvh_node_t *child       = &nodes[child_index];
+
+		if (child->count > 0)
+		{
+			slots[2*side] = child_index;
+		}
+		else
+		{
+			slots[2*side + 0] = child->left_first;
+			slots[2*side + 1] = child->left_first + 1;
+
+			node->split_axis[1 + side] = (uint8_t)child->split_axis;
+		}
+	}
+
+	for (uint32_t slot = 0; slot < 4; slot++)
+	{
+		if (slots[slot] == UINT32_MAX)
+			continue;
+
+		const bvh_node_t *child = &nodes[slots[slot]];
+
+		bvh4_set_child_bounds(node, slot, child->bounds);
+		node->child_mask |= 1u << slot;
+
+		if (child->count > 0)
+		{
+			node->child[slot] = child->left_first;
+			node->count[slot] = child->count;
+		}
+		else
+		{
+			// the new node goes after this one in the array, which is preallocated, so node stays valid
+			node->child[slot] = bvh4_collapse_node(builder, slots[slot]);
+			node->count[slot] = 0;
+		}
+	}
+
+	return node_index;
+}
+
+bvh4_t bvh4_from_bvh(arena_t *arena, const bvh_node_t *nodes, uint32_t node_count)
+{
+	bvh4_t result = {0};
+
+	if (node_count == 0)
+		return result;
+
+	// every 4-wide node takes the place of at least one binary interior node, except for a root that is a leaf
+	result.nodes = m_alloc_array_nozero(arena, node_count, bvh4_node_t);
+
+	if (nodes[0].count > 0)
+	{
+		bvh4_node_t *root = &result.nodes[0];
+		zero_struct(root);
+
+		bvh4_set_child_bounds(root, 0, nodes[0].bounds);
+		root->child_mask = 1;
+		root->child[0]   = nodes[0].left_first;
+		root->count[0]   = nodes[0].count;
+
+		result.node_count = 1;
+	}
+	else
+	{
+		bvh4_builder_t builder = {
+			.nodes  = nodes,
+			.nodes4 = result.nodes,
+		};
+
+		bvh4_collapse_node(&builder, 0);
+
+		result.node_count = builder.node4_count;
+	}
+
+	return result;
+}
+
+//
+// stats
+//
+
+typedef struct bvh_stats_walk_t
+{
+	const bvh_node_t *nodes;
+	const float      *leaf_slot_costs;
+	float             traversal_cost;
+	float             rcp_root_area;
+
+	uint64_t     leaf_depth_sum;
+	uint64_t     leaf_size_sum;
+	bvh_stats_t *stats;
+} bvh_stats_walk_t;
+
+fn_local void bvh_stats_walk(bvh_stats_walk_t *walk, uint32_t node_index, uint32_t depth)
+{
+	const bvh_node_t *node  = &walk->nodes[node_index];
+	bvh_stats_t      *stats = walk->stats;
+
+	float relative_area = walk->rcp_root_area*rect3_surface_area(node->bounds);
+
+	stats->node_count += 1;
+
+	if (node->count > 0)
+	{
+		float leaf_cost = 0.0f;
+
+		for (uint32_t i = node->left_first; i < node->left_first + node->count; i++)
+		{
+			leaf_cost += walk->leaf_slot_costs ? walk->leaf_slot_costs[i] : 1.0f;
+		}
+
+		stats->sah_cost += relative_area*leaf_cost;
+
+		stats->leaf_count    += 1;
+		stats->max_depth      = MAX(stats->max_depth, depth);
+		stats->min_leaf_size  = MIN(stats->min_leaf_size, node->count);
+		stats->max_leaf_size  = MAX(stats->max_leaf_size, node->count);
+		stats->leaf_size_histogram[MIN(node->count, BVH_STATS_LEAF_SIZE_BUCKETS) - 1] += 1;
+
+		walk->leaf_depth_sum += depth;
+		walk->leaf_size_sum  += node->count;
+	}
+	else
+	{
+		stats->sah_cost += relative_area*walk->traversal_cost;
+
+		bvh_stats_walk(walk, node->left_first,     depth + 1);
+		bvh_stats_walk(walk, node->left_first + 1, depth + 1);
+	}
+}
+
+bvh_stats_t bvh_compute_stats(const bvh_node_t *nodes, uint32_t node_count, float traversal_cost, const float *leaf_slot_costs)
+{
+	bvh_stats_t stats = {
+		.min_leaf_size = UINT32_MAX,
+	};
+
+	if (node_count == 0)
+	{
+		stats.min_leaf_size = 0;
+		return stats;
+	}
+
+	bvh_stats_walk_t walk = {
+		.nodes           = nodes,
+		.leaf_slot_costs = leaf_slot_costs,
+		.traversal_cost  = traversal_cost > 0.0f ? traversal_cost : 1.0f,
+		.rcp_root_area   = 1.0f / rect3_surface_area(nodes[0].bounds),
+		.stats           = &stats,
+	};
+
+	bvh_stats_walk(&walk, 0, 0);
+
+	stats.average_leaf_depth = (float)walk.leaf_depth_sum / (float)stats.leaf_count;
+	stats.average_leaf_size  = (float)walk.leaf_size_sum  / (float)stats.leaf_count;
+
+	return stats;
+}
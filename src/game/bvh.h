@@ -27,3 +27,105 @@ typedef struct bvh_iter_t
 } bvh_iter_t;
 
 fn void bvh_iter_init(bvh_iter_t *it, bvh_node_t *nodes, uint32_t node_count);
+
+//
+// binned SAH builder
+//
+
+// Builds a BVH over any kind of primitive from just their bounds. Each node is split along whichever of
+// BVH_SAH_BIN_COUNT evenly spaced planes per axis (over the centroids of its primitives) the surface area
+// heuristic says is cheapest to trace. A node becomes a leaf once splitting it costs more than testing all of its
+// primitives, as long as it has at most max_leaf_size of them.
+//
+// The nodes are laid out like the map's: node 0 is the root, node 1 is left unused so siblings share a cache line,
+// and the children of an interior node are left_first and left_first + 1. Leaves hold the primitives in leaf slots
+// [left_first, left_first + count), and indices says which primitive is in each slot.
+
+#define BVH_SAH_BIN_COUNT 16
+
+// Below BVH_SAH_MAX_DEPTH the builders stop looking for SAH splits and just halve nodes until they fit in a leaf,
+// which takes at most another 32 levels. So no tree gets deeper than BVH_MAX_DEPTH, and walks can use fixed stacks.
+#define BVH_SAH_MAX_DEPTH 48
+#define BVH_MAX_DEPTH     (BVH_SAH_MAX_DEPTH + 32)
+
+#define BVH_STACK_SIZE    (BVH_MAX_DEPTH + 1)   // a binary walk pushes two children and pops one per level
+#define BVH4_STACK_SIZE   (3*BVH_MAX_DEPTH + 1) // a 4-wide walk pushes up to four and pops one
+
+typedef struct bvh_build_params_t
+{
+	uint32_t       count;          // number of primitives
+	const rect3_t *bounds;         // bounds of each primitive
+
+	uint32_t max_leaf_size;        // (default: 4)
+	float    traversal_cost;       // cost of visiting a node, relative to testing one primitive (default: 1)
+} bvh_build_params_t;
+
+typedef struct bvh_t
+{
+	uint32_t    node_count;        // 0 if there were no primitives
+	bvh_node_t *nodes;
+	uint32_t   *indices;           // the primitive in each leaf slot
+} bvh_t;
+
+fn bvh_t bvh_build_sah(arena_t *arena, const bvh_build_params_t *params);
+
+// Builds the exact same tree as bvh_build_sah, spread over the threads of queue: nodes near the top get their
+// primitives binned and partitioned in parallel blocks, and once nodes get small enough each one's subtree is built by
+// a job of its own. Blocks until the tree is done. Can be called from inside a job on the same queue.
+fn bvh_t bvh_build_sah_parallel(arena_t *arena, job_queue_t queue, const bvh_build_params_t *params);
+
+// What a BVH built like the above looks like, to compare builders.
+#define BVH_STATS_LEAF_SIZE_BUCKETS 9
+
+typedef struct bvh_stats_t
+{
+	uint32_t node_count;           // not counting the unused node 1
+	uint32_t leaf_count;
+
+	uint32_t max_depth;            // the root is at depth 0
+	float    average_leaf_depth;
+
+	uint32_t min_leaf_size;
+	uint32_t max_leaf_size;
+	float    average_leaf_size;
+	uint32_t leaf_size_histogram[BVH_STATS_LEAF_SIZE_BUCKETS]; // leaves of 1, 2, .. 8 and more than 8 primitives
+
+	// The expected cost of tracing a ray that hits the root, in units of testing one primitive: every node's
+	// surface area relative to the root's times its cost. Lower is better.
+	float sah_cost;
+} bvh_stats_t;
+
+// leaf_slot_costs (optional, default: 1 for every slot) is the cost of testing the primitive in each leaf slot
+fn bvh_stats_t bvh_compute_stats(const bvh_node_t *nodes, uint32_t node_count, float traversal_cost, const float *leaf_slot_costs);
+
+//
+// 4-wide BVH
+//
+
+// A binary BVH collapsed so each node holds up to four children: the grandchildren of a binary node, or a child
+// itself where that child is a leaf. The children's bounds are stored as separate arrays of floats so a ray can test
+// all four with one SSE slab test, and a node fills exactly two cache lines. Leaves are the binary tree's leaves, so
+// leaf slots and whatever indices came with the binary tree stay valid.
+//
+// Children are in the order of the binary tree, so a ray that wants to visit the nearest one first can get there from
+// the three binary splits the node came from.
+
+typedef struct bvh4_node_t
+{
+	alignas(64) float min_x[4];
+	float min_y[4], min_z[4];
+	float max_x[4], max_y[4], max_z[4];
+
+	uint32_t child[4];      // node index of node children, first leaf slot of leaf children
+	uint16_t count[4];      // leaf slot count of leaf children, 0 for node children
+	uint8_t  split_axis[3]; // between children {0, 1} and {2, 3}, between 0 and 1, between 2 and 3
+	uint8_t  child_mask;    // a bit for each child in use
+} bvh4_node_t;
+
+typedef struct bvh4_t
+{
+	uint32_t     node_count;   // 0 if the binary BVH was empty
+	bvh4_node_t *nodes;        // node 0 is the root
+} bvh4_t;
+
+fn bvh4_t bvh4_from_bvh(arena_t *arena, const bvh_node_t *nodes, uint32_t node_count);
@@ -68,6 +68,40 @@ void editor_toggle_window_openness(editor_t *editor, editor_window_t *window)
 	}
 }
 
+void editor_do_arena_window(editor_window_t *window)
+{
+	rect2_t window_rect = rect2_cut_margins(window->window.rect, ui_sz_pix(ui_scalar(UiScalar_outer_window_margin)));
+
+	ui_row_builder_t builder = ui_make_row_builder(ui_scrollable_region_begin(&window->scroll_region, window_rect));
+
+	arena_t *temp = m_get_temp_scope_begin(NULL, 0);
+
+	if (ui_row_button(&builder, S("Dump To Log")))
+	{
+		log(Memory, Info, "Arena stats:\n%cs", m_format_arena_stats(temp));
+	}
+
+	for (arena_stats_t *stats = m_get_first_arena_stats(); stats; stats = stats->next)
+	{
+		ui_row_header(&builder, Sf("%s%s", stats->name, stats->released ? " (released)" : ""));
+
+		float fraction_used = stats->reserved ? (float)((double)stats->used_high_water / (double)stats->reserved) : 0.0f;
+
+		ui_row_labels2(&builder, S("Used:"), Sf("%cs (peak %cs)", 
+												string_format_human_readable_bytes(temp, stats->used),
+												string_format_human_readable_bytes(temp, stats->used_high_water)));
+		ui_row_labels2(&builder, S("Committed:"), Sf("%cs (peak %cs)", 
+													 string_format_human_readable_bytes(temp, stats->committed),
+													 string_format_human_readable_bytes(temp, stats->committed_high_water)));
+		ui_row_labels2(&builder, S("Commits / Decommits / Resets:"), Sf("%llu / %llu / %llu", stats->commit_count, stats->decommit_count, stats->reset_count));
+		ui_row_progress_bar(&builder, Sf("Peak of %cs reserved:", string_format_human_readable_bytes(temp, stats->reserved)), fraction_used);
+	}
+
+	m_scope_end(temp);
+
+	ui_scrollable_region_end(&window->scroll_region, builder.rect);
+}
+
 void editor_process_windows(editor_t *editor)
 {
 	uint8_t window_index = 0;
@@ -108,6 +142,11 @@ void editor_process_windows(editor_t *editor)
 				{
 					editor_texture_viewer_ui(&editor->texture_viewer, window->window.rect);
 				} break;
+
+				case EditorWindow_arenas:
+				{
+					editor_do_arena_window(window);
+				} break;
 			}
 
 			ui_window_end(window_id, &window->window);
@@ -145,6 +184,7 @@ void editor_init(editor_t *editor)
 	string_into_storage(editor->windows[EditorWindow_ui_test].title,        S("UI Test Window"));
 	string_into_storage(editor->windows[EditorWindow_cvars].title,          S("Console Variables"));
 	string_into_storage(editor->windows[EditorWindow_texture_viewer].title, S("Texture Viewer"));
+	string_into_storage(editor->windows[EditorWindow_arenas].title,         S("Arenas"));
 
 	editor_init_lightmap_stuff(&editor->lightmap);
 	editor_init_convex_hull_debugger(&editor->convex_hull);
@@ -326,6 +366,11 @@ void editor_update_and_render(editor_t *editor)
 		editor_toggle_window_openness(editor, &editor->windows[EditorWindow_texture_viewer]);
 	}
 
+    if (ui_key_pressed(Key_f7, true))
+	{
+		editor_toggle_window_openness(editor, &editor->windows[EditorWindow_arenas]);
+	}
+
     if (editor->show_timings)
     {
         editor_show_timings(editor);
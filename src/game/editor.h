@@ -15,6 +15,7 @@ typedef enum editor_window_kind_t
 	EditorWindow_ui_test,
 	EditorWindow_cvars,
 	EditorWindow_texture_viewer,
+	EditorWindow_arenas,
 
 	EditorWindow_COUNT,
 } editor_window_kind_t;
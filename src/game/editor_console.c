@@ -30,7 +30,7 @@ void update_and_draw_console(console_t *console, v2_t resolution, float dt)
 			.flow           = Flow_south,
 			.push_clip_rect = true)
 		{
-			for (table_iter_t iter = cvar_iter(); table_iter_next(&iter);)
+			for (concurrent_table_iter_t iter = cvar_iter(); concurrent_table_iter_next(&iter);)
 			{
 				cvar_t *cvar = iter.ptr;
 
@@ -81,7 +81,7 @@ void update_and_draw_console(console_t *console, v2_t resolution, float dt)
 				{
 					string_t text = console->input.string;
 
-					for (table_iter_t iter = cvar_iter(); table_iter_next(&iter);)
+					for (concurrent_table_iter_t iter = cvar_iter(); concurrent_table_iter_next(&iter);)
 					{
 						cvar_t *cvar = iter.ptr;
 
@@ -211,7 +211,7 @@ void editor_do_cvar_window(cvar_window_state_t *state, editor_window_t *window)
 	size_t cvar_count = get_cvar_count();
 	cvar_t **cvars = m_alloc_array_nozero(temp, cvar_count, cvar_t *);
 
-	for (table_iter_t iter = cvar_iter(); table_iter_next(&iter);)
+	for (concurrent_table_iter_t iter = cvar_iter(); concurrent_table_iter_next(&iter);)
 	{
 		cvars[iter.i] = iter.ptr;
 	}
@@ -18,6 +18,7 @@ static float g_next_frame_delay_ms = 0.0f;
 #include "action.c"
 #include "asset.c"
 #include "audio.c"
+#include "benchmarks.c"
 #include "bvh.c"
 #include "camera.c"
 #include "collision_geometry.c"
@@ -138,6 +139,111 @@ fn_local void register_player_cvars(void)
 	cvar_register(&ccmd_respawn_player);
 }
 
+// logs the stats of all registered arenas, or writes them to the given path
+CVAR_COMMAND(ccmd_arenas_dump, "arenas.dump")
+{
+	string_t path = string_split_word(&arguments);
+
+	m_scoped_temp
+	{
+		string_t dump = m_format_arena_stats(temp);
+
+		if (path.count > 0)
+		{
+			if (fs_write_entire_file(path, dump))
+			{
+				log(Memory, Info, "Wrote arena stats to '%cs'", path);
+			}
+			else
+			{
+				log(Memory, Error, "Failed to write arena stats to '%cs'", path);
+			}
+		}
+		else
+		{
+			log(Memory, Info, "Arena stats:\n%cs", dump);
+		}
+	}
+}
+
+// logs how many strings have been interned and what they cost
+CVAR_COMMAND(ccmd_atoms_stats, "atoms.stats")
+{
+	(void)arguments;
+
+	atom_stats_t stats = atom_get_stats();
+
+	m_scoped_temp
+	{
+		log(Memory, Info, "%u interned strings, %cs of characters, %cs of storage, %zu bytes per string",
+			stats.count,
+			string_format_human_readable_bytes(temp, stats.string_bytes),
+			string_format_human_readable_bytes(temp, stats.storage_bytes),
+			stats.count ? stats.storage_bytes / stats.count : 0);
+	}
+}
+
+// logs what the CPU supports and which simd tier the kernels are running
+CVAR_COMMAND(ccmd_cpu_features, "cpu.features")
+{
+	(void)arguments;
+
+	const cpu_features_t *features = query_cpu_features();
+
+	static const struct { cpu_feature_flags_t flag; const char *name; } feature_names[] = {
+		{ CpuFeature_sse2,     "sse2"     },
+		{ CpuFeature_sse3,     "sse3"     },
+		{ CpuFeature_ssse3,    "ssse3"    },
+		{ CpuFeature_sse41,    "sse4.1"   },
+		{ CpuFeature_sse42,    "sse4.2"   },
+		{ CpuFeature_popcnt,   "popcnt"   },
+		{ CpuFeature_avx,      "avx"      },
+		{ CpuFeature_fma,      "fma"      },
+		{ CpuFeature_avx2,     "avx2"     },
+		{ CpuFeature_bmi1,     "bmi1"     },
+		{ CpuFeature_bmi2,     "bmi2"     },
+		{ CpuFeature_avx512f,  "avx512f"  },
+		{ CpuFeature_avx512dq, "avx512dq" },
+		{ CpuFeature_avx512bw, "avx512bw" },
+		{ CpuFeature_avx512vl, "avx512vl" },
+	};
+
+	m_scoped_temp
+	{
+		string_list_t list = {0};
+
+		for_array(i, feature_names)
+		{
+			if (features->flags & feature_names[i].flag)
+			{
+				slist_appends(&list, temp, string_from_cstr((char *)feature_names[i].name));
+			}
+		}
+
+		log(Misc, Info, "%s (%s): %cs", features->brand, features->vendor, slist_flatten_with_separator(&list, temp, S(" "), 0));
+		log(Misc, Info, "simd kernels: %cs (best supported: %cs)",
+			simd_tier_name(simd_kernels()->tier),
+			simd_tier_name(features->best_simd_tier));
+	}
+}
+
+// switches the simd kernels to the given tier (sse2, avx2 or avx512), as far as the CPU supports it
+CVAR_COMMAND(ccmd_simd_tier, "simd.tier")
+{
+	string_t name = string_split_word(&arguments);
+
+	simd_tier_t tier;
+	if (simd_tier_from_name(name, &tier))
+	{
+		simd_tier_t selected = simd_select_tier(tier);
+		log(Misc, Info, "simd kernels: %cs", simd_tier_name(selected));
+	}
+	else
+	{
+		log(Misc, Error, "Unknown simd tier '%cs', expected sse2, avx2 or avx512", name);
+	}
+}
+
 void player_noclip(player_t *player, float dt)
 {
     camera_t *camera = player->attached_camera;
@@ -401,6 +507,9 @@ void app_init(platform_init_io_t *io)
 	app_state_t *app = m_bootstrap(app_state_t, arena);
 	io->app_state = app;
 
+	m_register_arena(&app->arena, S("app"));
+	m_register_temp_arenas(S("main"));
+
 	cvar_state_init(&app->cvar_state);
 	equip_cvar_state(&app->cvar_state);
 
@@ -413,6 +522,13 @@ void app_init(platform_init_io_t *io)
 	app->rhi_window = rhi_init_window(io->os_window_handle);
 
 	register_player_cvars();
+	register_benchmark_cvars();
+	register_job_queue_cvars();
+	register_map_cvars();
+	cvar_register(&ccmd_arenas_dump);
+	cvar_register(&ccmd_atoms_stats);
+	cvar_register(&ccmd_cpu_features);
+	cvar_register(&ccmd_simd_tier);
 
 	app->ui = m_alloc_struct(&app->arena, ui_t);
 
@@ -454,6 +570,7 @@ void app_init(platform_init_io_t *io)
 	asset_system_equip(app->assets);
 
 	gamestate_t *game = app->game = m_bootstrap(gamestate_t, arena);
+	m_register_arena(&game->arena, S("game"));
 	equip_gamestate(game);
 
     game->fade_t = 1.0f;
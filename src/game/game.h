@@ -9,6 +9,7 @@ fn void delay_next_frame(float milliseconds);
 #include "action.h"
 #include "asset.h"
 #include "audio.h"
+#include "benchmarks.h"
 #include "bvh.h"
 #include "camera.h"
 #include "collision_geometry.h"
@@ -65,6 +65,31 @@ bool ray_intersect_rect3_bvh(v3_t o, v3_t d, rect3_t rect, float max_t)
 }
 #pragma warning(pop)
 
+// ray_intersect_rect3_bvh for when the reciprocal of the direction has already been worked out, so that walking a
+// BVH doesn't pay for three divides per node. Also rejects boxes entirely behind the ray.
+bool ray_intersect_rect3_bvh_rcp(v3_t o, v3_t rcp_d, rect3_t rect, float max_t)
+{
+    float tx1 = rcp_d.x*(rect.min.x - o.x);
+    float tx2 = rcp_d.x*(rect.max.x - o.x);
+
+    float t_min = min(tx1, tx2);
+    float t_max = max(tx1, tx2);
+
+    float ty1 = rcp_d.y*(rect.min.y - o.y);
+    float ty2 = rcp_d.y*(rect.max.y - o.y);
+
+    t_min = max(t_min, min(ty1, ty2));
+    t_max = min(t_max, max(ty1, ty2));
+
+    float tz1 = rcp_d.z*(rect.min.z - o.z);
+    float tz2 = rcp_d.z*(rect.max.z - o.z);
+
+    t_min = max(t_min, min(tz1, tz2));
+    t_max = min(t_max, max(tz1, tz2));
+
+    return (t_max >= t_min) && (t_max >= 0.0f) && (t_min <= max_t);
+}
+
 float ray_intersect_triangle(v3_t o, v3_t d, v3_t a, v3_t b, v3_t c, v3_t *uvw)
 {
     float epsilon = 0.000000001f;
@@ -129,7 +154,303 @@ v3_t get_normal_rect3(v3_t hit_p, rect3_t rect)
     return result;
 }
 
+static bool brush_is_ignored(map_brush_t *brush, size_t ignore_brush_count, map_brush_t **ignore_brushes)
+{
+    for (size_t i = 0; i < ignore_brush_count; i++)
+    {
+        if (ignore_brushes[i] == brush)
+            return true;
+    }
+
+    return false;
+}
+
+// triangle_index is into map->triangle_bvh.triangles
+static void intersect_result_from_triangle(map_t *map, uint32_t triangle_index, float t, v3_t uvw, intersect_result_t *result)
+{
+    map_triangle_bvh_t *bvh = &map->triangle_bvh;
+
+    uint32_t source_index = bvh->triangle_indices[triangle_index];
+    uint32_t poly_index   = map->triangle_polys[source_index];
+
+    result->t               = t;
+    result->brush           = &map->brushes[bvh->triangle_brushes[triangle_index]];
+    result->plane           = &map->planes[poly_index];
+    result->poly            = &map->polys[poly_index];
+    result->triangle_offset = map->triangle_offsets[source_index];
+    result->uvw             = uvw;
+}
+
+// Tests the ray against the triangles in leaf slots [first, first + count) of the triangle BVH, in runs between the
+// ones belonging to ignored brushes. Returns the nearest hit like ray_intersect_triangles, or UINT32_MAX.
+static uint32_t intersect_leaf(map_t *map, const simd_kernels_t *simd, const intersect_params_t *params, uint32_t first, uint32_t count,
+                               float *t, v3_t *uvw)
+{
+    map_triangle_bvh_t *bvh = &map->triangle_bvh;
+
+    uint32_t result = UINT32_MAX;
+
+    uint32_t run_first = first;
+    uint32_t end       = first + count;
+
+    for (uint32_t triangle_index = run_first; triangle_index <= end; triangle_index++)
+    {
+        if (triangle_index < end && 
+            !brush_is_ignored(&map->brushes[bvh->triangle_brushes[triangle_index]], params->ignore_brush_count, params->ignore_brushes))
+        {
+            continue;
+        }
+
+        if (triangle_index > run_first)
+        {
+            uint32_t hit = simd->ray_intersect_triangles(&bvh->triangles, run_first, triangle_index - run_first,
+                                                         params->o, params->d, params->min_t, t, uvw);
+
+            if (hit != UINT32_MAX)
+            {
+                result = hit;
+
+                if (params->occlusion_test)
+                    break;
+            }
+        }
+
+        run_first = triangle_index + 1;
+    }
+
+    return result;
+}
+
+// The order to visit the children of a bvh4_node_t in, nearest first going by the splits the node came from.
+static void bvh4_child_order(const bvh4_node_t *node, const bool d_is_negative[3], uint32_t order[4])
+{
+    uint32_t pair = d_is_negative[node->split_axis[0]] ? 2 : 0;
+
+    order[0] = pair     + (d_is_negative[node->split_axis[1 + pair / 2]] ? 1 : 0);
+    order[1] = pair     + (d_is_negative[node->split_axis[1 + pair / 2]] ? 0 : 1);
+    order[2] = 2 - pair + (d_is_negative[node->split_axis[2 - pair / 2]] ? 1 : 0);
+    order[3] = 2 - pair + (d_is_negative[node->split_axis[2 - pair / 2]] ? 0 : 1);
+}
+
 bool intersect_map(map_t *map, const intersect_params_t *params, intersect_result_t *result)
+{
+    map_triangle_bvh_t *bvh = &map->triangle_bvh;
+
+    float max_t = params->max_t;
+
+    if (max_t == 0.0f)
+        max_t = FLT_MAX;
+
+    float t = max_t;
+
+    v3_t o = params->o;
+    v3_t d = params->d;
+
+    v3_t     hit_uvw      = {0};
+    uint32_t hit_triangle = UINT32_MAX;
+
+    const simd_kernels_t *simd = simd_kernels();
+
+    f32x4_t ox = f32x4_set1(o.x);
+    f32x4_t oy = f32x4_set1(o.y);
+    f32x4_t oz = f32x4_set1(o.z);
+
+    f32x4_t rcp_dx = f32x4_set1(1.0f / d.x);
+    f32x4_t rcp_dy = f32x4_set1(1.0f / d.y);
+    f32x4_t rcp_dz = f32x4_set1(1.0f / d.z);
+
+    bool d_is_negative[3] = {
+        d.x < 0.0f,
+        d.y < 0.0f,
+        d.z < 0.0f,
+    };
+
+    // children that still have to be visited, count > 0 being leaves like in bvh4_node_t
+    uint32_t node_stack_at = 0;
+    uint32_t node_stack      [BVH4_STACK_SIZE];
+    uint16_t node_stack_count[BVH4_STACK_SIZE];
+
+    if (bvh->node4_count > 0)
+    {
+        node_stack      [node_stack_at] = 0;
+        node_stack_count[node_stack_at] = 0;
+        node_stack_at++;
+    }
+
+    while (node_stack_at > 0)
+    {
+        node_stack_at--;
+
+        uint32_t child = node_stack      [node_stack_at];
+        uint16_t leaf_count = node_stack_count[node_stack_at];
+
+        if (leaf_count > 0)
+        {
+            v3_t uvw;
+            uint32_t hit = intersect_leaf(map, simd, params, child, leaf_count, &t, &uvw);
+
+            if (hit != UINT32_MAX)
+            {
+                hit_triangle = hit;
+                hit_uvw      = uvw;
+
+                if (params->occlusion_test)
+                    goto early_exit;
+            }
+
+            continue;
+        }
+
+        bvh4_node_t *node = &bvh->nodes4[child];
+
+        // the slab test of ray_intersect_rect3_bvh_rcp for all four children at once
+        f32x4_t tx1 = f32x4_mul(rcp_dx, f32x4_sub(f32x4_load(node->min_x), ox));
+        f32x4_t tx2 = f32x4_mul(rcp_dx, f32x4_sub(f32x4_load(node->max_x), ox));
+        f32x4_t ty1 = f32x4_mul(rcp_dy, f32x4_sub(f32x4_load(node->min_y), oy));
+        f32x4_t ty2 = f32x4_mul(rcp_dy, f32x4_sub(f32x4_load(node->max_y), oy));
+        f32x4_t tz1 = f32x4_mul(rcp_dz, f32x4_sub(f32x4_load(node->min_z), oz));
+        f32x4_t tz2 = f32x4_mul(rcp_dz, f32x4_sub(f32x4_load(node->max_z), oz));
+
+        f32x4_t t_min = f32x4_max(f32x4_max(f32x4_min(tx1, tx2), f32x4_min(ty1, ty2)), f32x4_min(tz1, tz2));
+        f32x4_t t_max = f32x4_min(f32x4_min(f32x4_max(tx1, tx2), f32x4_max(ty1, ty2)), f32x4_max(tz1, tz2));
+
+        f32x4_t hit_mask = f32x4_and(f32x4_and(f32x4_cmpge(t_max, t_min), f32x4_cmpge(t_max, f32x4_zero())),
+                                     f32x4_cmple(t_min, f32x4_set1(t)));
+
+        uint32_t hit_children = f32x4_mask_bits(hit_mask) & node->child_mask;
+
+        if (!hit_children)
+            continue;
+
+        uint32_t order[4];
+        bvh4_child_order(node, d_is_negative, order);
+
+        // pushed far to near, so the nearest child gets popped first
+        for (int32_t i = 3; i >= 0; i--)
+        {
+            uint32_t slot = order[i];
+
+            if (hit_children & (1u << slot))
+            {
+                DEBUG_ASSERT(node_stack_at < BVH4_STACK_SIZE);
+
+                node_stack      [node_stack_at] = node->child[slot];
+                node_stack_count[node_stack_at] = node->count[slot];
+                node_stack_at++;
+            }
+        }
+    }
+
+early_exit:
+
+    if (result)
+    {
+        zero_struct(result);
+        result->t = t;
+
+        if (hit_triangle != UINT32_MAX)
+        {
+            intersect_result_from_triangle(map, hit_triangle, t, hit_uvw, result);
+        }
+    }
+    
+    return t < max_t;
+}
+
+bool intersect_map_binary(map_t *map, const intersect_params_t *params, intersect_result_t *result)
+{
+    map_triangle_bvh_t *bvh = &map->triangle_bvh;
+
+    float max_t = params->max_t;
+
+    if (max_t == 0.0f)
+        max_t = FLT_MAX;
+
+    float t = max_t;
+
+    v3_t o = params->o;
+    v3_t d = params->d;
+
+    v3_t rcp_d = { 1.0f / d.x, 1.0f / d.y, 1.0f / d.z };
+
+    v3_t     hit_uvw      = {0};
+    uint32_t hit_triangle = UINT32_MAX;
+
+    const simd_kernels_t *simd = simd_kernels();
+
+    bool d_is_negative[3] = {
+        d.x < 0.0f,
+        d.y < 0.0f,
+        d.z < 0.0f,
+    };
+
+    uint32_t node_stack_at = 0;
+    uint32_t node_stack[BVH_STACK_SIZE];
+
+    if (bvh->node_count > 0)
+    {
+        node_stack[node_stack_at++] = 0;
+    }
+
+    while (node_stack_at > 0)
+    {
+        uint32_t node_index = node_stack[--node_stack_at];
+
+        bvh_node_t *node = &bvh->nodes[node_index];
+
+        if (ray_intersect_rect3_bvh_rcp(o, rcp_d, node->bounds, t))
+        {
+            if (node->count > 0)
+            {
+                v3_t uvw;
+                uint32_t hit = intersect_leaf(map, simd, params, node->left_first, node->count, &t, &uvw);
+
+                if (hit != UINT32_MAX)
+                {
+                    hit_triangle = hit;
+                    hit_uvw      = uvw;
+
+                    if (params->occlusion_test)
+                        goto early_exit;
+                }
+            }
+            else
+            {
+                uint32_t left = node->left_first;
+
+                DEBUG_ASSERT(node_stack_at + 2 <= BVH_STACK_SIZE);
+
+                if (d_is_negative[node->split_axis])
+                {
+                    node_stack[node_stack_at++] = left;
+                    node_stack[node_stack_at++] = left + 1;
+                }
+                else
+                {
+                    node_stack[node_stack_at++] = left + 1;
+                    node_stack[node_stack_at++] = left;
+                }
+            }
+        }
+    }
+
+early_exit:
+
+    if (result)
+    {
+        zero_struct(result);
+        result->t = t;
+
+        if (hit_triangle != UINT32_MAX)
+        {
+            intersect_result_from_triangle(map, hit_triangle, t, hit_uvw, result);
+        }
+    }
+    
+    return t < max_t;
+}
+
+bool intersect_map_brushes(map_t *map, const intersect_params_t *params, intersect_result_t *result)
 {
     float min_t = params->min_t;
     float max_t = params->max_t;
@@ -142,6 +463,8 @@ bool intersect_map(map_t *map, const intersect_params_t *params, intersect_resul
     v3_t o = params->o;
     v3_t d = params->d;
 
+    v3_t rcp_d = { 1.0f / d.x, 1.0f / d.y, 1.0f / d.z };
+
     v3_t hit_uvw = {0};
     uint32_t hit_triangle_offset = 0;
 
@@ -149,6 +472,8 @@ bool intersect_map(map_t *map, const intersect_params_t *params, intersect_resul
     map_plane_t *hit_plane = NULL;
     map_poly_t  *hit_poly  = NULL;
 
+    const simd_kernels_t *simd = simd_kernels();
+
     bool d_is_negative[3] = {
         d.x < 0.0f,
         d.y < 0.0f,
@@ -156,7 +481,7 @@ bool intersect_map(map_t *map, const intersect_params_t *params, intersect_resul
     };
 
     uint32_t node_stack_at = 0;
-    uint32_t node_stack[64];
+    uint32_t node_stack[BVH_STACK_SIZE];
 
     node_stack[node_stack_at++] = 0;
 
@@ -166,7 +491,7 @@ bool intersect_map(map_t *map, const intersect_params_t *params, intersect_resul
 
         map_bvh_node_t *node = &map->nodes[node_index];
 
-        if (ray_intersect_rect3_bvh(o, d, node->bounds, t))
+        if (ray_intersect_rect3_bvh_rcp(o, rcp_d, node->bounds, t))
         {
             if (node->count > 0)
             {
@@ -177,50 +502,25 @@ bool intersect_map(map_t *map, const intersect_params_t *params, intersect_resul
                 {
                     map_brush_t *brush = &map->brushes[first + brush_index];
 
-                    bool ignored = false;
-                    for (size_t ignored_brush_index = 0; ignored_brush_index < params->ignore_brush_count; ignored_brush_index++)
-                    {
-                        if (params->ignore_brushes[ignored_brush_index] == brush)
-                        {
-                            ignored = true;
-                            break;
-                        }
-                    }
-
-                    if (ignored)
+                    if (brush_is_ignored(brush, params->ignore_brush_count, params->ignore_brushes))
                         continue;
 
-                    for (size_t poly_index = 0; poly_index < brush->plane_poly_count; poly_index++)
+                    v3_t uvw;
+                    uint32_t triangle_index = simd->ray_intersect_triangles(&map->triangles, brush->first_triangle, brush->triangle_count,
+                                                                            o, d, min_t, &t, &uvw);
+
+                    if (triangle_index != UINT32_MAX)
                     {
-                        map_poly_t *poly = &map->polys[brush->first_plane_poly + poly_index];
-
-                        uint16_t *indices   = map->indices          + poly->first_index;
-                        v3_t     *positions = map->vertex.positions + poly->first_vertex;
-
-                        uint32_t triangle_count = poly->index_count / 3;
-                        for (size_t triangle_index = 0; triangle_index < triangle_count; triangle_index++)
-                        {
-                            v3_t a = positions[indices[3*triangle_index + 0]];
-                            v3_t b = positions[indices[3*triangle_index + 1]];
-                            v3_t c = positions[indices[3*triangle_index + 2]];
-
-                            v3_t uvw;
-                            float triangle_hit_t = ray_intersect_triangle(o, d, a, b, c, &uvw);
-
-                            if (triangle_hit_t >= min_t &&
-                                triangle_hit_t < t)
-                            {
-                                t                   = triangle_hit_t;
-                                hit_brush           = brush;
-                                hit_plane           = &map->planes[brush->first_plane_poly + poly_index];
-                                hit_poly            = poly;
-                                hit_triangle_offset = (uint32_t)(3*triangle_index);
-                                hit_uvw             = uvw;
-
-                                if (params->occlusion_test)
-                                    goto early_exit;
-                            }
-                        }
+                        uint32_t poly_index = map->triangle_polys[triangle_index];
+
+                        hit_brush           = brush;
+                        hit_plane           = &map->planes[poly_index];
+                        hit_poly            = &map->polys[poly_index];
+                        hit_triangle_offset = map->triangle_offsets[triangle_index];
+                        hit_uvw             = uvw;
+
+                        if (params->occlusion_test)
+                            goto early_exit;
                     }
                 }
             }
@@ -228,6 +528,8 @@ bool intersect_map(map_t *map, const intersect_params_t *params, intersect_resul
             {
                 uint32_t left = node->left_first;
 
+                DEBUG_ASSERT(node_stack_at + 2 <= BVH_STACK_SIZE);
+
                 if (d_is_negative[node->split_axis])
                 {
                     node_stack[node_stack_at++] = left;
@@ -256,3 +558,204 @@ early_exit:
     
     return t < max_t;
 }
+
+// intersect_leaf for the active rays of a packet. Returns the rays that found a nearer hit.
+static uint32_t intersect_leaf_packet(map_t *map, const simd_kernels_t *simd, const intersect_packet_params_t *params, uint32_t first, uint32_t count,
+                                      ray_packet_t *packet, uint32_t active)
+{
+    map_triangle_bvh_t *bvh = &map->triangle_bvh;
+
+    uint32_t result = 0;
+
+    uint32_t run_first = first;
+    uint32_t end       = first + count;
+
+    for (uint32_t triangle_index = run_first; triangle_index <= end; triangle_index++)
+    {
+        if (triangle_index < end && 
+            !brush_is_ignored(&map->brushes[bvh->triangle_brushes[triangle_index]], params->ignore_brush_count, params->ignore_brushes))
+        {
+            continue;
+        }
+
+        if (triangle_index > run_first)
+        {
+            uint32_t run_hits = simd->ray_packet_intersect_triangles(&bvh->triangles, run_first, triangle_index - run_first,
+                                                                     packet, active);
+            result |= run_hits;
+
+            // rays that are only looking for any hit are done
+            if (params->occlusion_test)
+            {
+                active &= ~run_hits;
+
+                if (!active)
+                    break;
+            }
+        }
+
+        run_first = triangle_index + 1;
+    }
+
+    return result;
+}
+
+static void intersect_map_one_packet(map_t *map, const simd_kernels_t *simd, const intersect_packet_params_t *params,
+                                     uint32_t first, uint32_t count, bool *hits, intersect_result_t *results)
+{
+    ray_packet_t packet;
+    zero_struct(&packet);
+
+    float max_t[RAY_PACKET_MAX_WIDTH];
+
+    for (uint32_t lane = 0; lane < count; lane++)
+    {
+        v3_t o = params->o[first + lane];
+        v3_t d = params->d[first + lane];
+
+        packet.ox[lane] = o.x;
+        packet.oy[lane] = o.y;
+        packet.oz[lane] = o.z;
+
+        packet.dx[lane] = d.x;
+        packet.dy[lane] = d.y;
+        packet.dz[lane] = d.z;
+
+        packet.rcp_dx[lane] = 1.0f / d.x;
+        packet.rcp_dy[lane] = 1.0f / d.y;
+        packet.rcp_dz[lane] = 1.0f / d.z;
+
+        max_t[lane] = params->max_t ? params->max_t[first + lane] : 0.0f;
+
+        if (max_t[lane] == 0.0f)
+            max_t[lane] = FLT_MAX;
+
+        packet.min_t   [lane] = params->min_t;
+        packet.t       [lane] = max_t[lane];
+        packet.triangle[lane] = UINT32_MAX;
+    }
+
+    map_triangle_bvh_t *bvh = &map->triangle_bvh;
+
+    uint32_t active = (1u << count) - 1;
+
+    // the packet goes down the tree in one order, so it's picked by the first ray and the rest hopefully agree
+    bool d_is_negative[3] = {
+        packet.dx[0] < 0.0f,
+        packet.dy[0] < 0.0f,
+        packet.dz[0] < 0.0f,
+    };
+
+    // children that still have to be visited and the rays that hit them, count > 0 being leaves like in bvh4_node_t
+    uint32_t node_stack_at = 0;
+    uint32_t node_stack      [BVH4_STACK_SIZE];
+    uint16_t node_stack_count[BVH4_STACK_SIZE];
+    uint32_t node_stack_rays [BVH4_STACK_SIZE];
+
+    if (bvh->node4_count > 0)
+    {
+        node_stack      [node_stack_at] = 0;
+        node_stack_count[node_stack_at] = 0;
+        node_stack_rays [node_stack_at] = active;
+        node_stack_at++;
+    }
+
+    while (node_stack_at > 0)
+    {
+        node_stack_at--;
+
+        uint32_t child = node_stack      [node_stack_at];
+        uint16_t leaf_count = node_stack_count[node_stack_at];
+
+        // rays that stopped at an occluder since the child got pushed drop out
+        uint32_t node_active = node_stack_rays[node_stack_at] & active;
+
+        if (!node_active)
+            continue;
+
+        if (leaf_count > 0)
+        {
+            uint32_t leaf_hits = intersect_leaf_packet(map, simd, params, child, leaf_count, &packet, node_active);
+
+            if (params->occlusion_test)
+            {
+                active &= ~leaf_hits;
+
+                if (!active)
+                    goto early_exit;
+            }
+
+            continue;
+        }
+
+        bvh4_node_t *node = &bvh->nodes4[child];
+
+        uint32_t order[4];
+        bvh4_child_order(node, d_is_negative, order);
+
+        // pushed far to near, so the nearest child gets popped first
+        for (int32_t i = 3; i >= 0; i--)
+        {
+            uint32_t slot = order[i];
+
+            if (!(node->child_mask & (1u << slot)))
+                continue;
+
+            rect3_t bounds = {
+                .min = { node->min_x[slot], node->min_y[slot], node->min_z[slot] },
+                .max = { node->max_x[slot], node->max_y[slot], node->max_z[slot] },
+            };
+
+            // rays that already found something nearer than the child drop out for its whole subtree
+            uint32_t child_active = simd->ray_packet_intersect_box(&packet, node_active, bounds);
+
+            if (child_active)
+            {
+                DEBUG_ASSERT(node_stack_at < BVH4_STACK_SIZE);
+
+                node_stack      [node_stack_at] = node->child[slot];
+                node_stack_count[node_stack_at] = node->count[slot];
+                node_stack_rays [node_stack_at] = child_active;
+                node_stack_at++;
+            }
+        }
+    }
+
+early_exit:
+
+    for (uint32_t lane = 0; lane < count; lane++)
+    {
+        hits[first + lane] = packet.t[lane] < max_t[lane];
+
+        if (results)
+        {
+            intersect_result_t *result = &results[first + lane];
+            zero_struct(result);
+
+            result->t = packet.t[lane];
+
+            uint32_t triangle_index = packet.triangle[lane];
+
+            if (triangle_index != UINT32_MAX)
+            {
+                float v = packet.v[lane];
+                float w = packet.w[lane];
+
+                intersect_result_from_triangle(map, triangle_index, packet.t[lane], make_v3(1.0f - v - w, v, w), result);
+            }
+        }
+    }
+}
+
+void intersect_map_packet(map_t *map, const intersect_packet_params_t *params, bool *hits, intersect_result_t *results)
+{
+    const simd_kernels_t *simd = simd_kernels();
+
+    uint32_t width = simd->ray_packet_width;
+
+    for (uint32_t first = 0; first < params->count; first += width)
+    {
+        uint32_t count = MIN(width, params->count - first);
+        intersect_map_one_packet(map, simd, params, first, count, hits, results);
+    }
+}
@@ -4,8 +4,12 @@
 
 #pragma once
 
+struct map_t;
+struct map_brush_t;
+
 float ray_intersect_rect3    (v3_t o, v3_t d, rect3_t rect);
 bool  ray_intersect_rect3_bvh(v3_t o, v3_t d, rect3_t rect, float max_t);
+bool  ray_intersect_rect3_bvh_rcp(v3_t o, v3_t rcp_d, rect3_t rect, float max_t); // rcp_d = 1 / d
 float ray_intersect_triangle (v3_t o, v3_t d, v3_t a, v3_t b, v3_t c, v3_t *uvw);
 
 v3_t get_normal_rect3(v3_t hit_p, rect3_t rect);
@@ -36,3 +40,33 @@ typedef struct intersect_params_t
 } intersect_params_t;
 
 bool intersect_map(struct map_t *map, const intersect_params_t *params, intersect_result_t *result);
+
+// Same as intersect_map, but walks the binary triangle BVH (map_triangle_bvh_t.nodes) rather than its 4-wide version.
+// Kept around to compare the two, see bench.bvh.
+bool intersect_map_binary(struct map_t *map, const intersect_params_t *params, intersect_result_t *result);
+
+// Same as intersect_map, but walks the brush BVH (map_t.nodes) and tests whole brushes in the leaves instead of going
+// through the per-triangle BVH. Kept around to compare the two, see bench.bvh.
+bool intersect_map_brushes(struct map_t *map, const intersect_params_t *params, intersect_result_t *result);
+
+typedef struct intersect_packet_params_t
+{
+    uint32_t     count;                  // number of rays
+    const v3_t  *o;                      // ray origins
+    const v3_t  *d;                      // ray directions
+    const float *max_t;                  // max hit distance per ray, 0 meaning FLT_MAX (optional, default: FLT_MAX for every ray)
+
+    bool occlusion_test;                 // rays stop at their first hit, as for intersect_params_t
+
+    float min_t;                         // min hit distance of every ray
+
+    size_t ignore_brush_count;          
+    struct map_brush_t **ignore_brushes; // brushes every ray ignores
+} intersect_packet_params_t;
+
+// Traces a batch of rays the way intersect_map would trace each of them, in packets of simd_kernels()->ray_packet_width
+// rays that go through the BVH together. Only worth it if the rays are coherent, e.g. all leaving the same point in
+// similar directions, and even then intersect_map walking the 4-wide BVH one ray at a time can be faster (see bench.rays). Every ray hits or misses just like it would with intersect_map, but where a ray hits two
+// triangles within rounding error of each other (e.g. on a shared edge) either one could be reported.
+// hits gets a bool per ray, results (optional) an intersect_result_t per ray.
+void intersect_map_packet(struct map_t *map, const intersect_packet_params_t *params, bool *hits, intersect_result_t *results);
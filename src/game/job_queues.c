@@ -2,17 +2,183 @@
 // Copyright 2024 by Daniël Cornelisse, All Rights Reserved.
 // ============================================================
 
-job_queue_t high_priority_job_queue;
-job_queue_t low_priority_job_queue;
+job_queue_t game_job_queue;
 
-void init_game_job_queues(void)
+// 0 picks a thread count based on the CPU topology
+CVAR_I32_EX(cvar_jobs_threads, "jobs.threads", 0, 0, CPU_MAX_LOGICAL_PROCESSORS);
+// put SMT siblings to work as well (only affects the automatic thread count)
+CVAR_BOOL(cvar_jobs_use_smt,     "jobs.use_smt",     false);
+CVAR_BOOL(cvar_jobs_pin_threads, "jobs.pin_threads", false);
+
+typedef struct job_queue_layout_t
+{
+	size_t   thread_count;
+	uint32_t affinity[CPU_MAX_LOGICAL_PROCESSORS];
+} job_queue_layout_t;
+
+// Cores are ordered so that cores sharing an L3 (and then an L2) are next to each other, so workers that
+// are close together in the queue end up sharing caches. The first core is left for the main thread and
+// the queue takes the cores after it. Once every core has a thread, further threads go on the SMT siblings.
+fn_local void compute_job_queue_layout(const cpu_topology_t *topology, job_queue_layout_t *layout)
+{
+	uint32_t core_count = topology->core_count;
+
+	uint32_t ordered_cores      [CPU_MAX_LOGICAL_PROCESSORS];
+	uint32_t core_l2_group      [CPU_MAX_LOGICAL_PROCESSORS];
+	uint32_t core_l3_group      [CPU_MAX_LOGICAL_PROCESSORS];
+	uint32_t core_smt_count     [CPU_MAX_LOGICAL_PROCESSORS] = {0};
+	uint32_t core_processors    [CPU_MAX_LOGICAL_PROCESSORS][4];
+
+	for (uint32_t processor_index = 0; processor_index < topology->logical_processor_count; processor_index++)
+	{
+		const cpu_logical_processor_t *processor = &topology->logical_processors[processor_index];
+
+		uint32_t core = processor->core;
+
+		core_l2_group[core] = processor->l2_group;
+		core_l3_group[core] = processor->l3_group;
+
+		if (core_smt_count[core] < ARRAY_COUNT(core_processors[core]))
+		{
+			core_processors[core][core_smt_count[core]++] = processor_index;
+		}
+	}
+
+	// insertion sort, there aren't going to be that many cores
+	for (uint32_t i = 0; i < core_count; i++)
+	{
+		uint32_t core = i;
+		uint32_t j    = i;
+
+		while (j > 0)
+		{
+			uint32_t other = ordered_cores[j - 1];
+
+			bool before = (core_l3_group[core] <  core_l3_group[other] ||
+						   (core_l3_group[core] == core_l3_group[other] && core_l2_group[core] < core_l2_group[other]));
+
+			if (!before) break;
+
+			ordered_cores[j] = other;
+			j -= 1;
+		}
+
+		ordered_cores[j] = core;
+	}
+
+	uint32_t max_smt_count = MAX(1, topology->logical_processor_count / core_count);
+
+	uint32_t first_core = core_count > 1 ? 1 : 0;
+	uint32_t cores      = core_count - first_core;
+
+	size_t thread_count = (size_t)cvar_read_i32(&cvar_jobs_threads);
+
+	if (thread_count == 0)
+	{
+		thread_count = cores;
+
+		if (cvar_read_bool(&cvar_jobs_use_smt))
+		{
+			thread_count *= max_smt_count;
+		}
+	}
+
+	layout->thread_count = MIN(thread_count, CPU_MAX_LOGICAL_PROCESSORS);
+
+	for (size_t i = 0; i < layout->thread_count; i++)
+	{
+		uint32_t core = ordered_cores[(first_core + i % cores) % core_count];
+		uint32_t smt  = (uint32_t)(i / cores) % core_smt_count[core];
+
+		layout->affinity[i] = core_processors[core][smt];
+	}
+}
+
+fn_local void log_job_queue_layout(const job_queue_layout_t *layout, bool pinned)
 {
-	size_t core_count = query_processor_count();
+	m_scoped_temp
+	{
+		string_list_t affinity = {0};
+
+		for (size_t i = 0; i < layout->thread_count; i++)
+			slist_appendf(&affinity, temp, "%u ", layout->affinity[i]);
 
-	// FIXME: dumb code for idiots all of this sucks dont worry about it
-	// FIXME: dumb code for idiots all of this sucks dont worry about it
-	// FIXME: dumb code for idiots all of this sucks dont worry about it
-	// FIXME: dumb code for idiots all of this sucks dont worry about it
-	high_priority_job_queue = create_job_queue(core_count - 2, 1024);
-	low_priority_job_queue  = create_job_queue(2, 1024);
+		log(Jobs, Info, "game job queue: %zu threads%s%cs", layout->thread_count,
+			pinned ? ", pinned to " : "", pinned ? slist_flatten(&affinity, temp) : S(""));
+	}
+}
+
+fn_local void create_game_job_queues(void)
+{
+	const cpu_topology_t *topology = query_cpu_topology();
+
+	job_queue_layout_t layout = {0};
+	compute_job_queue_layout(topology, &layout);
+
+	bool pin = cvar_read_bool(&cvar_jobs_pin_threads);
+
+	log(Jobs, Info, "%u logical processors, %u cores, %u L2 groups, %u L3 groups",
+		topology->logical_processor_count, topology->core_count, topology->l2_group_count, topology->l3_group_count);
+	log_job_queue_layout(&layout, pin);
+
+	game_job_queue = create_job_queue_ex(&(job_queue_params_t){
+		.thread_count    = layout.thread_count,
+		.queue_size      = 1024,
+		.thread_affinity = pin ? layout.affinity : NULL,
+		.name            = "game",
+	});
+}
+
+// applies changes to the jobs.* cvars, waits for all outstanding jobs first
+CVAR_COMMAND(ccmd_jobs_restart, "jobs.restart")
+{
+	(void)arguments;
+
+	wait_on_queue(game_job_queue);
+	destroy_job_queue(game_job_queue);
+
+	create_game_job_queues();
+}
+
+CVAR_COMMAND(ccmd_jobs_trace_start, "jobs.trace_start")
+{
+	(void)arguments;
+
+	job_tracing_start();
+	log(Jobs, Info, "Started recording a job trace, use jobs.trace_stop to write it out");
+}
+
+// writes the trace recorded since jobs.trace_start to the given path, or job_trace.json
+CVAR_COMMAND(ccmd_jobs_trace_stop, "jobs.trace_stop")
+{
+	string_t path = string_split_word(&arguments);
+
+	if (path.count == 0)
+	{
+		path = S("job_trace.json");
+	}
+
+	if (job_tracing_stop(path))
+	{
+		log(Jobs, Info, "Wrote job trace to '%cs', open it in chrome://tracing or ui.perfetto.dev", path);
+	}
+	else
+	{
+		log(Jobs, Error, "Failed to write job trace to '%cs'", path);
+	}
+}
+
+void register_job_queue_cvars(void)
+{
+	cvar_register(&cvar_jobs_threads);
+	cvar_register(&cvar_jobs_use_smt);
+	cvar_register(&cvar_jobs_pin_threads);
+	cvar_register(&ccmd_jobs_restart);
+	cvar_register(&ccmd_jobs_trace_start);
+	cvar_register(&ccmd_jobs_trace_stop);
+}
+
+void init_game_job_queues(void)
+{
+	create_game_job_queues();
 }
@@ -8,8 +8,10 @@
 #include "core/api_types.h"
 #include "core/thread.h"
 
+fn void register_job_queue_cvars(void);
 fn void init_game_job_queues(void);
-fn job_queue_t high_priority_job_queue;
-fn job_queue_t low_priority_job_queue;
+// The one queue all game work goes on. Pick a job_priority_t per job instead of a separate queue:
+// asset streaming runs at high priority, asset packing at normal and light baking at low priority.
+fn job_queue_t game_job_queue;
 
 #endif
@@ -25,6 +25,24 @@ static v3_t random_point_on_light(random_series_t *entropy, map_point_light_t *l
     return add(light->p, mul(16.0f, random_in_unit_cube(entropy)));
 }
 
+// Shadow rays go through the map's 4-wide BVH one at a time. Even though all shadow rays of a point leave from that
+// point, a single ray testing four boxes at once outruns tracing them together with intersect_map_packet.
+static void trace_shadow_rays(map_t *map, map_brush_t *ignore_brush, v3_t o, uint32_t count, const v3_t *d, const float *max_t,
+                              bool *occluded, intersect_result_t *hits)
+{
+    for (size_t i = 0; i < count; i++)
+    {
+        occluded[i] = intersect_map(map, &(intersect_params_t) {
+            .o                  = o,
+            .d                  = d[i],
+            .max_t              = max_t[i],
+            .occlusion_test     = true,
+            .ignore_brush_count = ignore_brush ? 1 : 0,
+            .ignore_brushes     = &ignore_brush,
+        }, hits ? &hits[i] : NULL);
+    }
+}
+
 static v3_t evaluate_lighting(lum_thread_context_t *thread, lum_params_t *params, lum_path_vertex_t *path_vertex, v3_t hit_p, v3_t hit_n, bool ignore_sun)
 {
     map_t *map = params->map;
@@ -39,76 +57,79 @@ static v3_t evaluate_lighting(lum_thread_context_t *thread, lum_params_t *params
     unsigned sample_count = 0;
     lum_light_sample_t *samples = m_alloc_array(&thread->arena, map->light_count + 1, lum_light_sample_t);
 
-    for (size_t i = 0; i < map->light_count; i++)
+    m_scoped_temp
     {
-        map_point_light_t *light = &map->lights[i];
+        uint32_t             shadow_ray_count     = 0;
+        v3_t                *shadow_d             = m_alloc_array_nozero(temp, map->light_count + 1, v3_t);
+        float               *shadow_max_t         = m_alloc_array_nozero(temp, map->light_count + 1, float);
+        v3_t                *shadow_contributions = m_alloc_array_nozero(temp, map->light_count + 1, v3_t);
+        lum_light_sample_t **shadow_samples       = m_alloc_array_nozero(temp, map->light_count + 1, lum_light_sample_t *);
 
-        v3_t light_p = random_point_on_light(&thread->entropy, light);
+        for (size_t i = 0; i < map->light_count; i++)
+        {
+            map_point_light_t *light = &map->lights[i];
 
-        v3_t  light_vector    = sub(light_p, hit_p);
-        float light_distance  = flt_max(0.0001f, vlen(light_vector));
-        v3_t  light_direction = div(light_vector, light_distance);
-        float light_ndotl     = dot(hit_n, light_direction);
+            v3_t light_p = random_point_on_light(&thread->entropy, light);
 
-        lum_light_sample_t *sample = &samples[sample_count++];
-        sample->d = light_direction;
+            v3_t  light_vector    = sub(light_p, hit_p);
+            float light_distance  = flt_max(0.0001f, vlen(light_vector));
+            v3_t  light_direction = div(light_vector, light_distance);
+            float light_ndotl     = dot(hit_n, light_direction);
 
-        if (light_ndotl > 0.0f)
-        {
-            intersect_result_t shadow_hit;
-            if (!intersect_map(map, &(intersect_params_t) {
-                    .o                  = hit_p,
-                    .d                  = light_direction,
-                    .ignore_brush_count = 1,
-                    .ignore_brushes     = &brush,
-                    .occlusion_test     = true,
-                    .max_t              = light_distance,
-                }, &shadow_hit))
+            lum_light_sample_t *sample = &samples[sample_count++];
+            sample->d = light_direction;
+
+            if (light_ndotl > 0.0f)
             {
                 v3_t contribution = light->color;
 
                 contribution = mul(contribution, light_ndotl);
                 contribution = mul(contribution, 1.0f / (1.0f + light_distance*light_distance));
 
-                lighting = add(lighting, contribution);
-
-                sample->contribution = contribution;
-                sample->shadow_ray_t = FLT_MAX;
-            }
-            else
-            {
-                sample->shadow_ray_t = shadow_hit.t;
+                uint32_t ray_index = shadow_ray_count++;
+                shadow_d            [ray_index] = light_direction;
+                shadow_max_t        [ray_index] = light_distance;
+                shadow_contributions[ray_index] = contribution;
+                shadow_samples      [ray_index] = sample;
             }
         }
-    }
 
-    if (!ignore_sun && sun_ndotl > 0.0f)
-    {
-        v3_t sun_d = sun_direction;
-        // sun_d = add(sun_d, mul(0.1f, random_in_unit_sphere(&thread->entropy)));
-        sun_d = normalize(sun_d);
-
-        lum_light_sample_t *sample = &samples[sample_count++];
-        sample->d = sun_d;
-
-        intersect_result_t shadow_hit;
-        if (!intersect_map(map, &(intersect_params_t) {
-                .o                  = hit_p,
-                .d                  = sun_d,
-                .ignore_brush_count = 1,
-                .ignore_brushes     = &brush,
-                .occlusion_test     = true,
-            }, &shadow_hit))
+        if (!ignore_sun && sun_ndotl > 0.0f)
         {
-            v3_t contribution = mul(params->sun_color, sun_ndotl);
-            lighting = add(lighting, contribution);
-
-            sample->contribution = contribution;
-            sample->shadow_ray_t = FLT_MAX;
+            v3_t sun_d = sun_direction;
+            // sun_d = add(sun_d, mul(0.1f, random_in_unit_sphere(&thread->entropy)));
+            sun_d = normalize(sun_d);
+
+            lum_light_sample_t *sample = &samples[sample_count++];
+            sample->d = sun_d;
+
+            uint32_t ray_index = shadow_ray_count++;
+            shadow_d            [ray_index] = sun_d;
+            shadow_max_t        [ray_index] = 0.0f;
+            shadow_contributions[ray_index] = mul(params->sun_color, sun_ndotl);
+            shadow_samples      [ray_index] = sample;
         }
-        else
+
+        bool               *occluded    = m_alloc_array_nozero(temp, shadow_ray_count, bool);
+        intersect_result_t *shadow_hits = m_alloc_array_nozero(temp, shadow_ray_count, intersect_result_t);
+
+        trace_shadow_rays(map, brush, hit_p, shadow_ray_count, shadow_d, shadow_max_t, occluded, shadow_hits);
+
+        for (size_t i = 0; i < shadow_ray_count; i++)
         {
-            sample->shadow_ray_t = shadow_hit.t;
+            lum_light_sample_t *sample = shadow_samples[i];
+
+            if (!occluded[i])
+            {
+                lighting = add(lighting, shadow_contributions[i]);
+
+                sample->contribution = shadow_contributions[i];
+                sample->shadow_ray_t = FLT_MAX;
+            }
+            else
+            {
+                sample->shadow_ray_t = shadow_hits[i].t;
+            }
         }
     }
 
@@ -118,28 +139,22 @@ static v3_t evaluate_lighting(lum_thread_context_t *thread, lum_params_t *params
     return lighting;
 }
 
-static v3_t pathtrace_recursively(lum_thread_context_t *thread, lum_params_t *params, lum_path_t *path, v3_t o, v3_t d, int recursion)
-{
-    if (recursion >= params->ray_recursion)
-        return (v3_t){0,0,0};
+static v3_t pathtrace_recursively(lum_thread_context_t *thread, lum_params_t *params, lum_path_t *path, v3_t o, v3_t d, int recursion);
 
+// Continues a path from the ray that went from o along d and either hit something or nothing (hit is NULL). Split
+// from pathtrace_recursively so the first ray of each path can be traced in batches by lum_job.
+static v3_t pathtrace_from_hit(lum_thread_context_t *thread, lum_params_t *params, lum_path_t *path, v3_t o, v3_t d, int recursion,
+                               const intersect_result_t *hit)
+{
     map_t *map = params->map;
 
     arena_t *arena = &thread->arena;
     (void)arena;
 
     lum_path_vertex_t *prev_vertex = path->last_vertex;
-    map_brush_t *brush = prev_vertex->brush;
 
     random_series_t *entropy = &thread->entropy;
 
-    intersect_params_t intersect_params = {
-        .o                  = o,
-        .d                  = d,
-        .ignore_brush_count = 1,
-        .ignore_brushes     = &brush,
-    };
-
     v3_t color = { 0, 0, 0 };
 
     lum_path_vertex_t *path_vertex = m_alloc_struct(arena, lum_path_vertex_t);
@@ -153,16 +168,15 @@ static v3_t pathtrace_recursively(lum_thread_context_t *thread, lum_params_t *pa
 		ignore_sun = true;
 	}
 
-    intersect_result_t hit;
-    if (intersect_map(map, &intersect_params, &hit))
+    if (hit)
     {
-        map_poly_t *hit_poly = hit.poly;
+        map_poly_t *hit_poly = hit->poly;
 
-        v3_t uvw = hit.uvw;
-        uint32_t triangle_offset = hit.triangle_offset;
+        v3_t uvw = hit->uvw;
+        uint32_t triangle_offset = hit->triangle_offset;
 
         uint16_t *indices   = map->indices          + hit_poly->first_index;
-        v2_t     *texcoords = map->vertex.texcoords + hit_poly->first_vertex;
+        v2_t     *texcoords = map->vertex.texcoords;
 
         v2_t t0 = texcoords[indices[triangle_offset + 0]];
         v2_t t1 = texcoords[indices[triangle_offset + 1]];
@@ -190,7 +204,7 @@ static v3_t pathtrace_recursively(lum_thread_context_t *thread, lum_params_t *pa
         v3_t t, b;
         get_tangent_vectors(n, &t, &b);
 
-        v3_t hit_p = add(intersect_params.o, mul(hit.t, intersect_params.d));
+        v3_t hit_p = add(o, mul(hit->t, d));
 
         v3_t lighting = evaluate_lighting(thread, params, path_vertex, hit_p, n, ignore_sun);
 
@@ -204,8 +218,8 @@ static v3_t pathtrace_recursively(lum_thread_context_t *thread, lum_params_t *pa
         lighting = add(lighting, mul(albedo, pathtrace_recursively(thread, params, path, hit_p, bounce_dir, recursion + 1)));
         color = mul(albedo, lighting);
 
-        path_vertex->brush        = hit.brush;
-        path_vertex->poly         = hit.poly;
+        path_vertex->brush        = hit->brush;
+        path_vertex->poly         = hit->poly;
         path_vertex->o            = hit_p;
         path_vertex->throughput   = albedo;
         path_vertex->contribution = lighting;
@@ -215,7 +229,7 @@ static v3_t pathtrace_recursively(lum_thread_context_t *thread, lum_params_t *pa
         // TODO: Sample skybox
         color = params->sky_color;
 
-        path_vertex->o            = add(prev_vertex->o, intersect_params.d);
+        path_vertex->o            = add(prev_vertex->o, d);
         path_vertex->contribution = color;
     }
 
@@ -227,6 +241,26 @@ static v3_t pathtrace_recursively(lum_thread_context_t *thread, lum_params_t *pa
     return color;
 }
 
+static v3_t pathtrace_recursively(lum_thread_context_t *thread, lum_params_t *params, lum_path_t *path, v3_t o, v3_t d, int recursion)
+{
+    if (recursion >= params->ray_recursion)
+        return (v3_t){0,0,0};
+
+    map_brush_t *brush = path->last_vertex->brush;
+
+    intersect_params_t intersect_params = {
+        .o                  = o,
+        .d                  = d,
+        .ignore_brush_count = 1,
+        .ignore_brushes     = &brush,
+    };
+
+    intersect_result_t hit;
+    bool did_hit = intersect_map(params->map, &intersect_params, &hit);
+
+    return pathtrace_from_hit(thread, params, path, o, d, recursion, did_hit ? &hit : NULL);
+}
+
 #if 0
 static inline uint32_t pack_lightmap_color(v4_t color)
 {
@@ -263,7 +297,7 @@ static void lum_job(job_context_t *job_context, void *userdata)
 	lum_params_t         *params = &state->params;
     lum_thread_context_t *thread = &job->thread_contexts[job_context->thread_index];
 
-    if (atomic_load(&state->flags) & LumStateFlag_cancel)
+    if (job_is_cancelled(job_context))
         goto done;
 
     map_t *map = params->map;
@@ -299,7 +333,7 @@ static void lum_job(job_context_t *job_context, void *userdata)
     for (size_t y = 0; y < h; y++)
     for (size_t x = 0; x < w; x++)
     {
-		if (atomic_load(&state->flags) & LumStateFlag_cancel)
+		if (job_is_cancelled(job_context))
 			goto done;
 
         float u = ((float)x + 0.5f) / (float)(w);
@@ -312,39 +346,77 @@ static void lum_job(job_context_t *job_context, void *userdata)
         v3_t   direct_lighting = { 0 };
         v3_t indirect_lighting = { 0 };
 
-        for (int i = 0; i < ray_count; i++)
+        // the first rays of the paths all leave world_p, so they get traced a batch at a time
+        for (int first_ray = 0; first_ray < ray_count; first_ray += RAY_PACKET_MAX_WIDTH)
         {
-            lum_path_t *path = m_alloc_struct(thread_arena, lum_path_t);
-            path->source_pixel = (v2i_t){ (int)x, (int)y };
-            sll_push_back(thread->debug.first_path, thread->debug.last_path, path);
+            uint32_t batch_count = (uint32_t)MIN(RAY_PACKET_MAX_WIDTH, ray_count - first_ray);
+
+            lum_path_t *paths           [RAY_PACKET_MAX_WIDTH];
+            v3_t        direct_lightings[RAY_PACKET_MAX_WIDTH];
+            v3_t        origins         [RAY_PACKET_MAX_WIDTH];
+            v3_t        directions      [RAY_PACKET_MAX_WIDTH];
+
+            for (uint32_t i = 0; i < batch_count; i++)
+            {
+                lum_path_t *path = m_alloc_struct(thread_arena, lum_path_t);
+                path->source_pixel = (v2i_t){ (int)x, (int)y };
+                sll_push_back(thread->debug.first_path, thread->debug.last_path, path);
+
+                lum_path_vertex_t *path_vertex = m_alloc_struct(thread_arena, lum_path_vertex_t);
+                path->vertex_count++;
+                dll_push_back(path->first_vertex, path->last_vertex, path_vertex);
+
+                path_vertex->brush        = brush;
+                path_vertex->poly         = poly;
+                path_vertex->o            = world_p;
+                path_vertex->throughput   = make_v3(1, 1, 1);
+
+                v3_t this_direct_lighting = evaluate_lighting(thread, params, path_vertex, world_p, n, params->use_dynamic_sun_shadows);
+
+                path_vertex->contribution = this_direct_lighting;
 
-            lum_path_vertex_t *path_vertex = m_alloc_struct(thread_arena, lum_path_vertex_t);
-            path->vertex_count++;
-            dll_push_back(path->first_vertex, path->last_vertex, path_vertex);
+                direct_lighting = add(direct_lighting, this_direct_lighting);
 
-            path_vertex->brush        = brush;
-            path_vertex->poly         = poly;
-            path_vertex->o            = world_p;
-            path_vertex->throughput   = make_v3(1, 1, 1);
+                v2_t sample = random_unilateral2(entropy);
+                v3_t unrotated_dir = map_to_cosine_weighted_hemisphere(sample);
 
-            v3_t this_direct_lighting = evaluate_lighting(thread, params, path_vertex, world_p, n, params->use_dynamic_sun_shadows);
+                v3_t dir = mul(unrotated_dir.x, t);
+                dir = add(dir, mul(unrotated_dir.y, b));
+                dir = add(dir, mul(unrotated_dir.z, n));
 
-            path_vertex->contribution = this_direct_lighting;
+                paths           [i] = path;
+                direct_lightings[i] = this_direct_lighting;
+                origins         [i] = world_p;
+                directions      [i] = dir;
+            }
 
-            direct_lighting = add(direct_lighting, this_direct_lighting);
+            bool               hits   [RAY_PACKET_MAX_WIDTH];
+            intersect_result_t results[RAY_PACKET_MAX_WIDTH];
 
-            v2_t sample = random_unilateral2(entropy);
-            v3_t unrotated_dir = map_to_cosine_weighted_hemisphere(sample);
+            if (params->ray_recursion > 0)
+            {
+                intersect_map_packet(map, &(intersect_packet_params_t) {
+                    .count              = batch_count,
+                    .o                  = origins,
+                    .d                  = directions,
+                    .ignore_brush_count = 1,
+                    .ignore_brushes     = &brush,
+                }, hits, results);
+            }
 
-            v3_t dir = mul(unrotated_dir.x, t);
-            dir = add(dir, mul(unrotated_dir.y, b));
-            dir = add(dir, mul(unrotated_dir.z, n));
+            for (uint32_t i = 0; i < batch_count; i++)
+            {
+                v3_t this_indirect_lighting = { 0 };
 
-            v3_t this_indirect_lighting = pathtrace_recursively(thread, params, path, world_p, dir, 0);
+                if (params->ray_recursion > 0)
+                {
+                    this_indirect_lighting = pathtrace_from_hit(thread, params, paths[i], world_p, directions[i], 0, hits[i] ? &results[i] : NULL);
+                }
 
-            path->contribution = add(this_direct_lighting, this_indirect_lighting);
+                paths[i]->contribution = add(direct_lightings[i], this_indirect_lighting);
 
-            indirect_lighting = add(indirect_lighting, this_indirect_lighting);
+                indirect_lighting = add(indirect_lighting, this_indirect_lighting);
+            }
         }
 
 		DEBUG_ASSERT(!v3_contains_nan(  direct_lighting));
@@ -357,7 +429,7 @@ static void lum_job(job_context_t *job_context, void *userdata)
         indirect_lighting_pixels[y*w + x] = indirect_lighting;
     }
 
-	if (atomic_load(&state->flags) & LumStateFlag_cancel)
+	if (job_is_cancelled(job_context))
         goto done;
 
 #if  1
@@ -409,7 +481,7 @@ static void lum_job(job_context_t *job_context, void *userdata)
     }
 #endif
 
-	if (atomic_load(&state->flags) & LumStateFlag_cancel)
+	if (job_is_cancelled(job_context))
         goto done;
 
 #if 1
@@ -461,7 +533,7 @@ static void lum_job(job_context_t *job_context, void *userdata)
     }
 #endif
 
-	if (atomic_load(&state->flags) & LumStateFlag_cancel)
+	if (job_is_cancelled(job_context))
         goto done;
 
     for (int y = 0; y < h; y++)
@@ -470,7 +542,7 @@ static void lum_job(job_context_t *job_context, void *userdata)
         direct_lighting_pixels[y*w + x] = add(direct_lighting_pixels[y*w + x], indirect_lighting_pixels[y*w + x]);
     }
 
-	if (atomic_load(&state->flags) & LumStateFlag_cancel)
+	if (job_is_cancelled(job_context))
         goto done;
 
     uint32_t *packed = m_alloc_array(temp, w*h, uint32_t);
@@ -506,11 +578,6 @@ static void lum_job(job_context_t *job_context, void *userdata)
 done:
 	atomic_fetch_add(&state->jobs_completed, 1);
 
-	if (bake_jobs_completed(state))
-	{
-		bake_finalize(state);
-	}
-
 	m_scope_end(temp);
 }
 
@@ -544,8 +611,6 @@ static inline lum_voxel_cluster_t *lum_allocate_cluster(const lum_params_t *para
 
 static void trace_volumetric_lighting_job(job_context_t *job_context, void *userdata)
 {
-	(void)job_context;
-
 	arena_t *temp = m_get_temp(NULL, 0);
 	m_scope_begin(temp);
 
@@ -553,7 +618,7 @@ static void trace_volumetric_lighting_job(job_context_t *job_context, void *user
 	lum_params_t     *params = &state->params;
 	map_t            *map    = params->map;
 
-	if (atomic_load(&state->flags) & LumStateFlag_cancel)
+	if (job_is_cancelled(job_context))
         goto done;
 
     rect3_t fogmap_bounds = map->bounds;
@@ -579,7 +644,7 @@ static void trace_volumetric_lighting_job(job_context_t *job_context, void *user
     for (size_t y = 0; y < height; y++)
     for (size_t x = 0; x < width;  x++)
     {
-		if (atomic_load(&state->flags) & LumStateFlag_cancel)
+		if (job_is_cancelled(job_context))
             goto done;
 
         v3_t uvw = {
@@ -599,44 +664,52 @@ static void trace_volumetric_lighting_job(job_context_t *job_context, void *user
             world_p = add(world_p, variance);
 
             v3_t sample_lighting = { 0 };
-            for (size_t light_index = 0; light_index < map->light_count; light_index++)
+
+            m_scoped_temp
             {
-                map_point_light_t *light = &map->lights[light_index];
+                uint32_t shadow_ray_count     = 0;
+                v3_t    *shadow_d             = m_alloc_array_nozero(temp, map->light_count + 1, v3_t);
+                float   *shadow_max_t         = m_alloc_array_nozero(temp, map->light_count + 1, float);
+                v3_t    *shadow_contributions = m_alloc_array_nozero(temp, map->light_count + 1, v3_t);
 
-                v3_t light_p = random_point_on_light(&entropy, light);
+                for (size_t light_index = 0; light_index < map->light_count; light_index++)
+                {
+                    map_point_light_t *light = &map->lights[light_index];
 
-                v3_t  light_vector   = sub(light_p, world_p);
-                float light_distance = vlen(light_vector);
-                v3_t light_direction = div(light_vector, light_distance);
+                    v3_t light_p = random_point_on_light(&entropy, light);
+
+                    v3_t  light_vector   = sub(light_p, world_p);
+                    float light_distance = vlen(light_vector);
+                    v3_t light_direction = div(light_vector, light_distance);
 
-                intersect_result_t shadow_hit;
-                if (!intersect_map(map, &(intersect_params_t) {
-                        .o              = world_p,
-                        .d              = light_direction,
-                        .occlusion_test = true,
-                        .max_t          = light_distance,
-                    }, &shadow_hit))
-                {
                     v3_t contribution = light->color;
 
                     float biased_light_distance = light_distance + 1;
                     contribution = mul(contribution, 1.0f / (biased_light_distance*biased_light_distance));
 
-                    sample_lighting = add(sample_lighting, contribution);
+                    uint32_t ray_index = shadow_ray_count++;
+                    shadow_d            [ray_index] = light_direction;
+                    shadow_max_t        [ray_index] = light_distance;
+                    shadow_contributions[ray_index] = contribution;
                 }
-            }
 
-            if (!params->use_dynamic_sun_shadows)
-            {
-                intersect_result_t shadow_hit;
-                if (!intersect_map(map, &(intersect_params_t) {
-                        .o              = world_p,
-                        .d              = params->sun_direction,
-                        .occlusion_test = true,
-                    }, &shadow_hit))
+                if (!params->use_dynamic_sun_shadows)
                 {
-                    v3_t contribution = params->sun_color;
-                    sample_lighting = add(sample_lighting, contribution);
+                    uint32_t ray_index = shadow_ray_count++;
+                    shadow_d            [ray_index] = params->sun_direction;
+                    shadow_max_t        [ray_index] = 0.0f;
+                    shadow_contributions[ray_index] = params->sun_color;
+                }
+
+                bool *occluded = m_alloc_array_nozero(temp, shadow_ray_count, bool);
+                trace_shadow_rays(map, NULL, world_p, shadow_ray_count, shadow_d, shadow_max_t, occluded, NULL);
+
+                for (size_t i = 0; i < shadow_ray_count; i++)
+                {
+                    if (!occluded[i])
+                    {
+                        sample_lighting = add(sample_lighting, shadow_contributions[i]);
+                    }
                 }
             }
 
@@ -678,17 +751,65 @@ static void trace_volumetric_lighting_job(job_context_t *job_context, void *user
 done:
 	atomic_fetch_add(&state->jobs_completed, 1);
 
-	if (bake_jobs_completed(state))
+	m_scope_end(temp);
+}
+
+static void lum_jobs(job_context_t *job_context, void *userdata, size_t first, size_t one_past_last)
+{
+	lum_bake_state_t *state = userdata;
+
+	for (size_t job_index = first; job_index < one_past_last; job_index++)
 	{
-		bake_finalize(state);
+		lum_job(job_context, &state->jobs[job_index]);
 	}
+}
 
-	m_scope_end(temp);
+// runs once all other jobs of the bake are done
+static void lum_finalize_job(job_context_t *job_context, void *userdata)
+{
+	(void)job_context;
+
+	lum_bake_state_t *state = userdata;
+
+	if (atomic_load(&state->flags) & LumStateFlag_cancel)
+	{
+		// nobody is holding on to a cancelled bake anymore
+		m_release(&state->arena);
+		return;
+	}
+
+	/*
+	lum_debug_data_t *debug = &state->results.debug;
+
+	for (size_t i = 0; i < state->thread_count; i++)
+	{
+		lum_thread_context_t *thread_context = &state->thread_contexts[i];
+		lum_debug_data_t *thread_debug = &thread_context->debug;
+
+		sll_append(       debug->first_path,        debug->last_path,
+				   thread_debug->first_path, thread_debug->last_path);
+
+		// TODO: Copy debug data to state arena
+		// m_release(&thread_context->arena);
+	}
+	*/
+
+	state->end_time = os_hires_time();
+	state->final_bake_time = os_seconds_elapsed(state->start_time, state->end_time);
+
+	lum_state_flags_t flags = atomic_fetch_or(&state->flags, LumStateFlag_finalized);
+
+	if (flags & LumStateFlag_cancel)
+	{
+		// cancelled while finishing up, bake_cancel saw we weren't finalized yet and left it to us
+		m_release(&state->arena);
+	}
 }
 
 lum_bake_state_t *bake_lighting(const lum_params_t *in_params)
 {
 	lum_bake_state_t *state = m_bootstrap(lum_bake_state_t, arena);
+	m_register_arena(&state->arena, S("light baker"));
 	copy_struct(&state->params, in_params);
 
 	state->start_time = os_hires_time();
@@ -700,11 +821,20 @@ lum_bake_state_t *bake_lighting(const lum_params_t *in_params)
 
     map_t *map = params->map;
 
-	job_queue_t queue = high_priority_job_queue;
+	job_queue_t queue = game_job_queue;
+
+	// bakes take a while and nobody is waiting on them in the meantime, so they stay out of the way of other work.
+	// lum_finalize_job doesn't get the cancel token, it has to run to clean up after a cancelled bake.
+	job_options_t bake_options = {
+		.priority     = JobPriority_low,
+		.cancel_token = &state->cancel,
+		.signal       = &state->jobs_done,
+	};
 
 	lum_job_t *jobs = m_alloc_array(arena, map->plane_count, lum_job_t);
 
-	state->thread_count = (uint32_t)get_job_queue_thread_count(queue);
+	// one extra context for a thread that helps out from wait_on_queue
+	state->thread_count = (uint32_t)get_job_queue_thread_count(queue) + 1;
 	state->thread_contexts = m_alloc_array(arena, state->thread_count, lum_thread_context_t);
 
 	for (size_t i = 0; i < state->thread_count; i++)
@@ -714,7 +844,7 @@ lum_bake_state_t *bake_lighting(const lum_params_t *in_params)
 	}
 
 	state->job_count++;
-	add_job_to_queue(queue, trace_volumetric_lighting_job, state);
+	add_job_to_queue_ex(queue, &bake_options, trace_volumetric_lighting_job, state);
 
 	for (size_t brush_index = 0; brush_index < map->brush_count; brush_index++)
 	{
@@ -727,56 +857,40 @@ lum_bake_state_t *bake_lighting(const lum_params_t *in_params)
 			job->state           = state;
 			job->brush_index     = (uint32_t)(brush_index);
 			job->plane_index     = (uint32_t)(brush->first_plane_poly + plane_index);
-
-			add_job_to_queue(queue, lum_job, job);
 		}
 	}
 
+	state->jobs = jobs;
+
+	// planes vary wildly in cost, so let parallel_for split them down to single planes where needed
+	parallel_for_ex(queue, &bake_options, state->job_count - 1, 1, lum_jobs, state);
+
+	add_job_to_queue_ex(queue, &(job_options_t){
+		.priority        = JobPriority_low,
+		.run_after       = &state->jobs_done,
+		.not_cancellable = true,
+	}, lum_finalize_job, state);
+
 	return state;
 }
 
 bool bake_finalize(lum_bake_state_t *state)
 {
-    bool result = false;
-
 	lum_state_flags_t flags = atomic_load(&state->flags);
-
-    if (flags & LumStateFlag_cancel)
-    {
-        release_bake_state(state);
-    } 
-    else if (!(flags & LumStateFlag_finalized) && bake_jobs_completed(state))
-	{
-		/*
-		lum_debug_data_t *debug = &state->results.debug;
-
-		for (size_t i = 0; i < state->thread_count; i++)
-		{
-			lum_thread_context_t *thread_context = &state->thread_contexts[i];
-			lum_debug_data_t *thread_debug = &thread_context->debug;
-
-			sll_append(       debug->first_path,        debug->last_path,
-					   thread_debug->first_path, thread_debug->last_path);
-
-			// TODO: Copy debug data to state arena
-			// m_release(&thread_context->arena);
-		}
-		*/
-
-		state->end_time = os_hires_time();
-		state->final_bake_time = os_seconds_elapsed(state->start_time, state->end_time);
-
-		atomic_fetch_or(&state->flags, LumStateFlag_finalized);
-
-        result = true;
-	}
-
-	return result;
+	return !!(flags & LumStateFlag_finalized);
 }
 
 void bake_cancel(lum_bake_state_t *state)
 {
-	atomic_fetch_or(&state->flags, LumStateFlag_cancel);
+	cancel_token_cancel(&state->cancel);
+
+	lum_state_flags_t flags = atomic_fetch_or(&state->flags, LumStateFlag_cancel);
+
+	if (flags & LumStateFlag_finalized)
+	{
+		// the bake already finished, so lum_finalize_job won't release it
+		m_release(&state->arena);
+	}
 }
 
 bool release_bake_state(lum_bake_state_t *state)
@@ -785,7 +899,8 @@ bool release_bake_state(lum_bake_state_t *state)
 
 	lum_state_flags_t flags = atomic_load(&state->flags);
 
-	if ((flags & LumStateFlag_finalized) || ((flags & LumStateFlag_cancel) && bake_jobs_completed(state)))
+	// cancelled bakes are released by lum_finalize_job
+	if (flags & LumStateFlag_finalized)
 	{
 		result = true;
 		m_release(&state->arena);
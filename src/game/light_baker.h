@@ -119,6 +119,9 @@ typedef struct lum_bake_state_t
 	lum_job_t            *jobs;
 	lum_thread_context_t *thread_contexts;
 
+	wait_group_t   jobs_done; // lum_finalize_job runs after this
+	cancel_token_t cancel;    // carried by all bake jobs except lum_finalize_job
+
 	arena_t      arena;
 	lum_params_t params;
 
@@ -134,8 +137,8 @@ typedef struct lum_bake_state_t
 
 fn lum_bake_state_t *bake_lighting     (const lum_params_t *params);
 fn bool              bake_finalize     (lum_bake_state_t *state); // returns true if the bake completed successfully, can be called as much as you want until it returns true
-fn void              bake_cancel       (lum_bake_state_t *state); // will force all remaining jobs to skip and will release the bake state once they all exit
-fn bool              release_bake_state(lum_bake_state_t *state);
+fn void              bake_cancel       (lum_bake_state_t *state); // will force all remaining jobs to skip and will release the bake state once they all exit, don't touch the state after this
+fn bool              release_bake_state(lum_bake_state_t *state); // releases a finalized bake
 
 fn_local bool bake_jobs_completed(lum_bake_state_t *state)
 {
@@ -28,6 +28,9 @@ string_t log_category_to_string[] = {
 	[LogCat_Game]          = Sc("Game"),
 	[LogCat_CVar]          = Sc("CVar"),
 	[LogCat_Serialize]     = Sc("Serialize"),
+	[LogCat_Benchmark]     = Sc("Benchmark"),
+	[LogCat_Jobs]          = Sc("Jobs"),
+	[LogCat_Memory]        = Sc("Memory"),
 	[LogCat_Max]           = Sc("INVALID LOG CATEGORY"),
 };
 
@@ -36,6 +36,9 @@ typedef enum log_category_t
 	LogCat_Game,
 	LogCat_CVar,
     LogCat_Serialize,
+	LogCat_Benchmark,
+	LogCat_Jobs,
+	LogCat_Memory,
 
 	LogCat_Max,
 } log_category_t;
@@ -2,6 +2,11 @@
 // Copyright 2024 by Daniël Cornelisse, All Rights Reserved.
 // ============================================================
 
+CVAR_I32_EX(cvar_map_bvh_max_leaf_size, "map.bvh_max_leaf_size", 4, 1, 64); // triangles, takes effect on the next map load
+CVAR_BOOL  (cvar_map_large_pages,        "map.large_pages",        true);      // triangle BVH on large pages, takes effect on the next map load
+
+global atom_cache_t g_map_classname_key; // is_class gets called for every entity over and over, this way "classname" is only interned once
+
 //
 // .map parser
 //
@@ -200,7 +205,7 @@ bool map_next_token(map_parser_t *parser)
                 at++;
             }
             parser->token.string_value.count = at - parser->token.string_value.data;
-            if (*at == '"')
+            if (at < end && *at == '"')
             {
                 at++;
             }
@@ -216,16 +221,26 @@ bool map_next_token(map_parser_t *parser)
         {
             parser->token.kind = MTOK_NUMBER;
 
+            // the map file is mapped straight from disk and not null terminated, so strtod gets a bounded copy
+            char number[64];
+            size_t number_length = 0;
+            while (at + number_length < end && number_length < sizeof(number) - 1 && !is_whitespace(at[number_length]))
+            {
+                number[number_length] = at[number_length];
+                number_length++;
+            }
+            number[number_length] = 0;
+
             char *strtod_end;
-            parser->token.num_value = (float)strtod(at, &strtod_end);
+            parser->token.num_value = (float)strtod(number, &strtod_end);
 
             // texture names may (and do) start with symbols like +
-            if (strtod_end == at)
+            if (strtod_end == number)
             {
                 goto parse_text;
             }
 
-            at = strtod_end;
+            at += strtod_end - number;
         } break;
 
         default:
@@ -234,7 +249,7 @@ parse_text:
             parser->token.kind = MTOK_TEXT;
 
             at++;
-            while (!is_whitespace(*at)) at++;
+            while (at < end && !is_whitespace(*at)) at++;
 
             parser->token.string_value = (string_t){
                 .data  = start,
@@ -372,7 +387,7 @@ static bool parse_map(arena_t *arena, string_t path, map_parse_result_t *result)
 	arena_t *temp = m_get_temp(&arena, 1);
 	m_scope_begin(temp);
 
-    string_t map_file = fs_read_entire_file(temp, path);
+    string_t map_file = fs_map_file(path);
 
     map_entity_node_t   *first_entity   = NULL, *last_entity   = NULL;
     map_property_node_t *first_property = NULL, *last_property = NULL;
@@ -415,8 +430,9 @@ static bool parse_map(arena_t *arena, string_t path, map_parse_result_t *result)
                     sll_push_back(first_property, last_property, prop_node);
                     result->property_count += 1;
 
-                    prop->key = m_copy_string(arena, key);
-                    prop->val = m_copy_string(arena, val);
+                    prop->key      = m_copy_string(arena, key);
+                    prop->val      = m_copy_string(arena, val);
+                    prop->key_atom = atom_from_string(key);
                 }
                 else if (map_match_token(&parser, '{'))
                 {
@@ -445,7 +461,8 @@ static bool parse_map(arena_t *arena, string_t path, map_parse_result_t *result)
                         string_t texture;
                         map_parse_texture_name(&parser, &texture);
 
-                        plane->texture = m_copy_string(arena, texture);
+                        plane->texture      = m_copy_string(arena, texture);
+                        plane->texture_atom = atom_from_string(texture);
 
                         map_parse_tex_vec(&parser, &plane->s);
                         map_parse_tex_vec(&parser, &plane->t);
@@ -556,6 +573,9 @@ static bool parse_map(arena_t *arena, string_t path, map_parse_result_t *result)
         result->plane_count    = 0;
     }
 
+    // everything that outlives the parse was copied into the arena, so the file can go
+    fs_unmap_file(map_file);
+
 	m_scope_end(temp);
 
     return parsed_successfully;
@@ -577,6 +597,10 @@ static void generate_map_geometry(arena_t *arena, map_t *map)
     stretchy_buffer(v2_t)     map_texcoords          = NULL;
     stretchy_buffer(v2_t)     map_lightmap_texcoords = NULL;
 
+    // texture atom -> asset hash of the texture (0 if it doesn't exist), so the paths only get formatted
+    // and hashed once per texture instead of once per plane
+    table_t texture_hashes = {0};
+
 	map->poly_count = map->plane_count;
 	map->polys      = m_alloc_array(arena, map->poly_count, map_poly_t);
 
@@ -830,29 +854,32 @@ static void generate_map_geometry(arena_t *arena, map_t *map)
 
             // load texture
 
-			m_scoped_temp
+			if (!table_find(&texture_hashes, plane->texture_atom.value, &poly->texture.value))
 			{
-				// TODO: pretty sad... handle file formats properly...
-				asset_hash_t texture_png = asset_hash_from_string(string_format(temp, "gamedata/textures/%cs.png", plane->texture));
-				asset_hash_t texture_tga = asset_hash_from_string(string_format(temp, "gamedata/textures/%cs.tga", plane->texture));
-				// TODO ALSO: String + formatting helper function for asset hashes
-
-				image_info_t image_info = {0};
-
-				if (asset_exists(texture_png, AssetKind_image))
-				{
-					image_info = get_image_info(texture_png);
-                    poly->texture = texture_png;
-				}
-				else if (asset_exists(texture_tga, AssetKind_image))
+				m_scoped_temp
 				{
-					image_info = get_image_info(texture_tga);
-                    poly->texture = texture_tga;
+					// TODO: pretty sad... handle file formats properly...
+					asset_hash_t texture_png = asset_hash_from_string(string_format(temp, "gamedata/textures/%cs.png", plane->texture));
+					asset_hash_t texture_tga = asset_hash_from_string(string_format(temp, "gamedata/textures/%cs.tga", plane->texture));
+					// TODO ALSO: String + formatting helper function for asset hashes
+
+					if (asset_exists(texture_png, AssetKind_image))
+					{
+						poly->texture = texture_png;
+					}
+					else if (asset_exists(texture_tga, AssetKind_image))
+					{
+						poly->texture = texture_tga;
+					}
 				}
 
-				texscale_x = (float)image_info.w;
-				texscale_y = (float)image_info.h;
-            }
+				table_insert(&texture_hashes, plane->texture_atom.value, poly->texture.value);
+			}
+
+			image_info_t image_info = get_image_info(poly->texture);
+
+			texscale_x = (float)image_info.w;
+			texscale_y = (float)image_info.h;
 
             // triangulate
 
@@ -967,6 +994,8 @@ static void generate_map_geometry(arena_t *arena, map_t *map)
     map->vertex.texcoords = sb_copy(arena, map_texcoords);
     map->vertex.lightmap_texcoords = sb_copy(arena, map_lightmap_texcoords);
 
+    table_release(&texture_hashes);
+
     m_scope_end(temp);
 }
 
@@ -1188,6 +1217,196 @@ static void build_bvh(arena_t *arena, map_t *map)
     }
 }
 
+// Has to happen after build_bvh, since that reorders the brushes.
+static void build_triangle_soa(arena_t *arena, map_t *map)
+{
+    uint32_t triangle_count = 0;
+
+    for (size_t brush_index = 0; brush_index < map->brush_count; brush_index++)
+    {
+        map_brush_t *brush = &map->brushes[brush_index];
+
+        brush->first_triangle = triangle_count;
+
+        for (size_t poly_index = 0; poly_index < brush->plane_poly_count; poly_index++)
+        {
+            map_poly_t *poly = &map->polys[brush->first_plane_poly + poly_index];
+            triangle_count += poly->index_count / 3;
+        }
+
+        brush->triangle_count = triangle_count - brush->first_triangle;
+    }
+
+    // zeroed padding, the kernels read whole vectors past the end
+    size_t array_size = sizeof(float)*(triangle_count + TRIANGLE_SOA_PADDING);
+
+    triangle_soa_t *triangles = &map->triangles;
+    triangles->count = triangle_count;
+    triangles->ax    = m_alloc(arena, array_size, 64);
+    triangles->ay    = m_alloc(arena, array_size, 64);
+    triangles->az    = m_alloc(arena, array_size, 64);
+    triangles->e1x   = m_alloc(arena, array_size, 64);
+    triangles->e1y   = m_alloc(arena, array_size, 64);
+    triangles->e1z   = m_alloc(arena, array_size, 64);
+    triangles->e2x   = m_alloc(arena, array_size, 64);
+    triangles->e2y   = m_alloc(arena, array_size, 64);
+    triangles->e2z   = m_alloc(arena, array_size, 64);
+
+    map->triangle_polys   = m_alloc_array_nozero(arena, triangle_count, uint32_t);
+    map->triangle_offsets = m_alloc_array_nozero(arena, triangle_count, uint32_t);
+
+    uint32_t at = 0;
+
+    for (size_t brush_index = 0; brush_index < map->brush_count; brush_index++)
+    {
+        map_brush_t *brush = &map->brushes[brush_index];
+
+        for (size_t poly_index = 0; poly_index < brush->plane_poly_count; poly_index++)
+        {
+            uint32_t    global_poly_index = (uint32_t)(brush->first_plane_poly + poly_index);
+            map_poly_t *poly              = &map->polys[global_poly_index];
+
+            // the indices already point at the poly's vertices in the map wide arrays
+            uint16_t *indices   = map->indices + poly->first_index;
+            v3_t     *positions = map->vertex.positions;
+
+            uint32_t poly_triangle_count = poly->index_count / 3;
+            for (uint32_t triangle_index = 0; triangle_index < poly_triangle_count; triangle_index++)
+            {
+                v3_t a = positions[indices[3*triangle_index + 0]];
+                v3_t b = positions[indices[3*triangle_index + 1]];
+                v3_t c = positions[indices[3*triangle_index + 2]];
+
+                v3_t edge1 = sub(b, a);
+                v3_t edge2 = sub(c, a);
+
+                triangles->ax [at] = a.x;
+                triangles->ay [at] = a.y;
+                triangles->az [at] = a.z;
+                triangles->e1x[at] = edge1.x;
+                triangles->e1y[at] = edge1.y;
+                triangles->e1z[at] = edge1.z;
+                triangles->e2x[at] = edge2.x;
+                triangles->e2y[at] = edge2.y;
+                triangles->e2z[at] = edge2.z;
+
+                map->triangle_polys  [at] = global_poly_index;
+                map->triangle_offsets[at] = 3*triangle_index;
+
+                at += 1;
+            }
+        }
+    }
+
+    ASSERT(at == triangle_count);
+}
+
+// Has to happen after build_triangle_soa.
+static void build_triangle_bvh(arena_t *arena, map_t *map, uint32_t max_leaf_size, bool large_pages)
+{
+    triangle_soa_t *triangles      = &map->triangles;
+    uint32_t        triangle_count = triangles->count;
+
+    map_triangle_bvh_t *bvh = &map->triangle_bvh;
+    zero_struct(bvh);
+
+    arena_t *temp = m_get_temp_scope_begin(&arena, 1);
+    {
+        rect3_t *bounds = m_alloc_array_nozero(temp, triangle_count, rect3_t);
+
+        for (size_t triangle_index = 0; triangle_index < triangle_count; triangle_index++)
+        {
+            map_poly_t *poly    = &map->polys[map->triangle_polys[triangle_index]];
+            uint16_t   *indices = map->indices + poly->first_index + map->triangle_offsets[triangle_index];
+
+            rect3_t triangle_bounds = rect3_inverted_infinity();
+            triangle_bounds = rect3_grow_to_contain(triangle_bounds, map->vertex.positions[indices[0]]);
+            triangle_bounds = rect3_grow_to_contain(triangle_bounds, map->vertex.positions[indices[1]]);
+            triangle_bounds = rect3_grow_to_contain(triangle_bounds, map->vertex.positions[indices[2]]);
+
+            bounds[triangle_index] = triangle_bounds;
+        }
+
+        // built in temp, so that whatever it ends up in can be sized to fit
+        bvh_t tree = bvh_build_sah_parallel(temp, game_job_queue, &(bvh_build_params_t){
+            .count         = triangle_count,
+            .bounds        = bounds,
+            .max_leaf_size = max_leaf_size,
+        });
+
+        bvh4_t tree4 = bvh4_from_bvh(temp, tree.nodes, tree.node_count);
+
+        size_t array_size = sizeof(float)*(triangle_count + TRIANGLE_SOA_PADDING);
+
+        if (large_pages)
+        {
+            // every allocation below, plus room to align each one
+            size_t size = 0;
+            size += 9*align_forward(array_size, 64);
+            size += 2*align_forward(sizeof(uint32_t)*triangle_count, 64);
+            size += align_forward(sizeof(bvh_node_t)*tree.node_count, 64);
+            size += align_forward(sizeof(bvh4_node_t)*tree4.node_count, 64);
+            size += 13*64;
+
+            m_init_with_flags(&bvh->arena, size, ArenaFlag_large_pages);
+            arena = &bvh->arena;
+        }
+
+        uint32_t *brush_from_triangle = m_alloc_array_nozero(temp, triangle_count, uint32_t);
+
+        for (size_t brush_index = 0; brush_index < map->brush_count; brush_index++)
+        {
+            map_brush_t *brush = &map->brushes[brush_index];
+
+            for (size_t i = 0; i < brush->triangle_count; i++)
+            {
+                brush_from_triangle[brush->first_triangle + i] = (uint32_t)brush_index;
+            }
+        }
+
+        triangle_soa_t *bvh_triangles = &bvh->triangles;
+        bvh_triangles->count = triangle_count;
+        bvh_triangles->ax    = m_alloc(arena, array_size, 64);
+        bvh_triangles->ay    = m_alloc(arena, array_size, 64);
+        bvh_triangles->az    = m_alloc(arena, array_size, 64);
+        bvh_triangles->e1x   = m_alloc(arena, array_size, 64);
+        bvh_triangles->e1y   = m_alloc(arena, array_size, 64);
+        bvh_triangles->e1z   = m_alloc(arena, array_size, 64);
+        bvh_triangles->e2x   = m_alloc(arena, array_size, 64);
+        bvh_triangles->e2y   = m_alloc(arena, array_size, 64);
+        bvh_triangles->e2z   = m_alloc(arena, array_size, 64);
+
+        bvh->triangle_indices = m_copy_array(arena, tree.indices, triangle_count);
+        bvh->triangle_brushes = m_alloc_array_nozero(arena, triangle_count, uint32_t);
+
+        for (size_t at = 0; at < triangle_count; at++)
+        {
+            uint32_t source = tree.indices[at];
+
+            bvh_triangles->ax [at] = triangles->ax [source];
+            bvh_triangles->ay [at] = triangles->ay [source];
+            bvh_triangles->az [at] = triangles->az [source];
+            bvh_triangles->e1x[at] = triangles->e1x[source];
+            bvh_triangles->e1y[at] = triangles->e1y[source];
+            bvh_triangles->e1z[at] = triangles->e1z[source];
+            bvh_triangles->e2x[at] = triangles->e2x[source];
+            bvh_triangles->e2y[at] = triangles->e2y[source];
+            bvh_triangles->e2z[at] = triangles->e2z[source];
+
+            bvh->triangle_brushes[at] = brush_from_triangle[source];
+        }
+
+        bvh->node_count = tree.node_count;
+        bvh->nodes      = m_alloc_nozero(arena, sizeof(bvh_node_t)*tree.node_count, 64);
+        copy_array(bvh->nodes, tree.nodes, tree.node_count);
+
+        bvh->node4_count = tree4.node_count;
+        bvh->nodes4      = m_alloc_nozero(arena, sizeof(bvh4_node_t)*tree4.node_count, 64);
+        copy_array(bvh->nodes4, tree4.nodes, tree4.node_count);
+    }
+    m_scope_end(temp);
+}
+
 static void deserialize_entities(arena_t *arena, map_t *map)
 {
     map_point_light_t *lights = NULL;
@@ -1290,6 +1509,12 @@ static void merge_coplanar_lightmaps(arena_t *arena, map_t *map)
 #endif
 }
 
+void register_map_cvars(void)
+{
+    cvar_register(&cvar_map_bvh_max_leaf_size);
+    cvar_register(&cvar_map_large_pages);
+}
+
 map_t *load_map(arena_t *arena, string_t path)
 {
     map_t *map = NULL;
@@ -1324,6 +1549,9 @@ map_t *load_map(arena_t *arena, string_t path)
         build_bvh(arena, map);
         map->bounds = map->nodes[0].bounds;
 
+        build_triangle_soa(arena, map);
+        build_triangle_bvh(arena, map, (uint32_t)cvar_read_i32(&cvar_map_bvh_max_leaf_size), cvar_read_bool(&cvar_map_large_pages));
+
         deserialize_entities(arena, map);
 
         // map->collision = collision_geometry_from_map(arena, map);
@@ -1370,14 +1598,25 @@ map_t *load_map(arena_t *arena, string_t path)
     return map;
 }
 
+void release_map(map_t *map)
+{
+    if (map)
+    {
+        // whatever the map was still waiting on is of no use to the next one
+        cancel_asset_loads();
+
+        m_release(&map->triangle_bvh.arena);
+    }
+}
+
 bool is_class(map_t *map, map_entity_t *entity, string_t classname)
 {
-    return string_match(value_from_key(map, entity, S("classname")), classname);
+    return string_match(value_from_atom(map, entity, atom_cached(&g_map_classname_key, S("classname"))), classname);
 }
 
 bool expect_class(map_t *map, map_entity_t *entity, string_t expected_class)
 {
-    string_t entity_class = value_from_key(map, entity, S("classname"));
+    string_t entity_class = value_from_atom(map, entity, atom_cached(&g_map_classname_key, S("classname")));
 
     bool result = string_match(entity_class, expected_class);
 
@@ -1407,6 +1646,24 @@ string_t value_from_key(map_t *map, map_entity_t *entity, string_t key)
     return result;
 }
 
+string_t value_from_atom(map_t *map, map_entity_t *entity, atom_t key)
+{
+    string_t result = { 0 };
+
+    for (size_t property_index = 0; property_index < entity->property_count; property_index++)
+    {
+        map_property_t *prop = &map->properties[entity->first_property + property_index];
+
+        if (atom_match(key, prop->key_atom))
+        {
+            result = prop->val;
+            break;
+        }
+    }
+
+    return result;
+}
+
 int int_from_key(map_t *map, map_entity_t *entity, string_t key)
 {
     string_t value = value_from_key(map, entity, key);
@@ -24,6 +24,7 @@ typedef struct map_plane_t
 {
     v3_t a, b, c;
     string_t texture;
+    atom_t   texture_atom; // lots of planes share a texture, generate_map_geometry looks each one up only once by this
     v4_t s, t;
     float rot, scale_x, scale_y;
 
@@ -79,6 +80,7 @@ typedef struct map_property_t
 {
     string_t key;
     string_t val;
+    atom_t   key_atom;
 } map_property_t;
 
 typedef struct map_brush_t
@@ -86,6 +88,9 @@ typedef struct map_brush_t
     uint32_t plane_poly_count;
     uint32_t first_plane_poly;
 
+    uint32_t triangle_count;
+    uint32_t first_triangle; // into map->triangles, the triangles of the brush's polys one after the other
+
     rect3_t bounds;
 } map_brush_t;
 
@@ -112,6 +117,24 @@ typedef struct map_bvh_node_t
     uint16_t split_axis;
 } map_bvh_node_t;
 
+// The map's triangles in a BVH built with bvh_build_sah_parallel, which is what rays get traced against. Leaves refer to
+// ranges of the BVH's own copy of the triangles, reordered so every leaf's triangles are next to each other.
+// Rays walk the 4-wide version of the tree, the binary one is kept around for bench.bvh to compare against.
+typedef struct map_triangle_bvh_t
+{
+    uint32_t    node_count;
+    bvh_node_t *nodes;
+
+    uint32_t     node4_count;
+    bvh4_node_t *nodes4;       // the same tree collapsed with bvh4_from_bvh
+
+    triangle_soa_t triangles;
+    uint32_t      *triangle_indices; // index of each triangle in map->triangles (and triangle_polys, triangle_offsets)
+    uint32_t      *triangle_brushes; // index of the brush each triangle belongs to
+
+    arena_t arena; // holds all of the above if it was built with large_pages, released by release_map
+} map_triangle_bvh_t;
+
 typedef struct map_t
 {
     rect3_t bounds;
@@ -163,13 +186,29 @@ typedef struct map_t
         v2_t *texcoords;
         v2_t *lightmap_texcoords;
     } vertex;
+
+    // every triangle again, laid out for simd_kernels_t.ray_intersect_triangles
+    triangle_soa_t triangles;
+    uint32_t      *triangle_polys;   // index of the poly (and plane) each triangle came from
+    uint32_t      *triangle_offsets; // offset of each triangle into its poly's indices
+
+    map_triangle_bvh_t triangle_bvh;
 } map_t;
 
+fn void   register_map_cvars(void);
 fn map_t *load_map(arena_t *arena, string_t path);
+fn void   release_map(map_t *map); // for leaving a map: cancels the asset loads still in flight, and frees what doesn't live in the arena the map was loaded into
+
+// The steps of load_map that build the BVHs, for bench.bvh to time. build_bvh builds the brush BVH (map->nodes) and
+// reorders the brushes to match, build_triangle_bvh needs the triangles from after that. With large_pages, the
+// triangle BVH goes into an arena of its own that's sized to fit and asks for large pages instead of into arena.
+fn void build_bvh         (arena_t *arena, map_t *map);
+fn void build_triangle_bvh(arena_t *arena, map_t *map, uint32_t max_leaf_size, bool large_pages);
 
 fn bool     is_class         (map_t *map, map_entity_t *entity, string_t classname);
 fn bool     expect_class     (map_t *map, map_entity_t *entity, string_t expected_class);
 fn string_t value_from_key   (map_t *map, map_entity_t *entity, string_t key);
+fn string_t value_from_atom  (map_t *map, map_entity_t *entity, atom_t key); // compares atoms instead of strings, keep the key's atom around (atom_cached) to make use of it
 fn int      int_from_key     (map_t *map, map_entity_t *entity, string_t key);
 fn float    float_from_key_or(map_t *map, map_entity_t *entity, string_t key, float default_value);
 fn v3_t     v3_from_key_or   (map_t *map, map_entity_t *entity, string_t key, v3_t  default_value);
@@ -47,6 +47,7 @@ r1_state_t *r1_make(void)
 	//------------------------------------------------------------------------
 
 	r1_state_t *state = m_bootstrap(r1_state_t, arena);
+	m_register_arena(&state->arena, S("r1"));
 	r1_equip(state);
 
 	r1->debug_drawing_enabled = true;
@@ -824,9 +825,7 @@ void r1_render_ui(rhi_command_list_t *list, r1_view_t *view, ui_render_command_l
 		{
 			for (size_t key_index = 0; key_index < ui_list->count; key_index++)
 			{
-				const ui_render_command_key_t *key = &ui_list->keys[key_index];
-
-				const size_t command_index = key->command_index;
+				const size_t command_index = ui_list->command_indices[key_index];
 				const ui_render_command_t *command = &ui_list->commands[command_index];
 
 				copy_memory(&rects[key_index], &command->rect, sizeof(command->rect));
@@ -1016,11 +1015,11 @@ typedef struct r1_draw_stream_t
 {
 	uint32_t           capacity;
 	uint32_t           count;
-	uint32_t          *sort_keys;
+	uint64_t          *sort_keys;
 	rhi_draw_packet_t *packets;
 } r1_draw_stream_t;
 
-fn void r1_push_draw_packet(r1_draw_stream_t *stream, rhi_draw_packet_t packet, uint32_t sort_key)
+fn void r1_push_draw_packet(r1_draw_stream_t *stream, rhi_draw_packet_t packet, uint64_t sort_key)
 {
 	if (ALWAYS(stream->count < stream->capacity))
 	{
@@ -1098,7 +1097,7 @@ void draw_map(map_t *map, int view_count, view_t *views)
 			args->index_count  = poly->index_count;
 			args->index_offset = poly->first_index;
 
-			uint32_t sort_key = 0;
+			uint64_t sort_key = 0;
 
 			rhi_draw_packet_t packet = {
 				.pso            = r1->psos[DfPso_brush], //r1->psos.map,
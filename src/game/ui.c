@@ -1045,12 +1045,13 @@ void ui_push_command(ui_render_command_key_t key, const ui_render_command_t *com
 	{
 		size_t index = list->count++;
 
-		ASSERT(index <= UINT16_MAX);
+		// keys get built as compound literals that only name .layer, which leaves the rest of u64 unspecified.
+		// the sort goes by u64, so rebuild it from the fields that are actually part of the key
+		key.u64 = key.layer.value;
 
-		key.command_index = (uint16_t)index;
-
-		list->keys    [index] = key;
-		list->commands[index] = *command;
+		list->keys           [index] = key;
+		list->command_indices[index] = (uint32_t)index;
+		list->commands       [index] = *command;
 	}
 }
 
@@ -1058,7 +1059,8 @@ void ui_sort_render_commands(void)
 {
 	PROFILE_FUNC_BEGIN;
 
-	radix_sort_u32(&ui->render_commands.keys[0].u32, ui->render_commands.count);
+	ui_render_command_list_t *list = &ui->render_commands;
+	radix_sort_u64_with_payload(&list->keys[0].u64, list->command_indices, list->count);
 
 	PROFILE_FUNC_END;
 }
@@ -1658,7 +1660,7 @@ void *ui_get_state_raw(ui_id_t id, bool *first_touch, uint16_t size, ui_state_fl
 	{
 		uint16_t real_size = checked_add_u16(sizeof(ui_state_header_t), size);
 
-		state = simple_heap_alloc(&ui->state_allocator, real_size);
+		state = heap_alloc(&ui->state_allocator, real_size, alignof(ui_state_header_t));
 		state->id                  = id;
 		state->size                = real_size;
 		state->flags               = flags;
@@ -1726,7 +1728,7 @@ static void ui_initialize(void)
 	zero_struct(ui);
 	// ui->state = (pool_t)INIT_POOL(ui_state_t);
 
-	simple_heap_init(&ui->state_allocator, &ui->arena);
+	heap_init(&ui->state_allocator, MB(256));
 
 	ASSERT(!ui->initialized);
 
@@ -1797,9 +1799,10 @@ static void ui_initialize(void)
 	ui->style.base_colors [UiColor_scrollbar_active       ] = foreground_hi2;
 	ui->style.base_colors [UiColor_focus_indicator        ] = focus_color;
 
-	ui->render_commands.capacity = UI_RENDER_COMMANDS_CAPACITY;
-	ui->render_commands.keys     = m_alloc_array_nozero(&ui->arena, ui->render_commands.capacity, ui_render_command_key_t);
-	ui->render_commands.commands = m_alloc_array_nozero(&ui->arena, ui->render_commands.capacity, ui_render_command_t);
+	ui->render_commands.capacity        = UI_RENDER_COMMANDS_CAPACITY;
+	ui->render_commands.keys            = m_alloc_array_nozero(&ui->arena, ui->render_commands.capacity, ui_render_command_key_t);
+	ui->render_commands.command_indices = m_alloc_array_nozero(&ui->arena, ui->render_commands.capacity, uint32_t);
+	ui->render_commands.commands        = m_alloc_array_nozero(&ui->arena, ui->render_commands.capacity, ui_render_command_t);
 
 	m_scoped_temp
 	{
@@ -1865,7 +1868,7 @@ bool ui_begin(float dt, rect2_t ui_area)
 			state->last_touched_frame_index < ui->frame_index)
 		{
 			table_remove(&ui->state_index, state->id.value);
-			simple_heap_free(&ui->state_allocator, state, state->size);
+			heap_free(&ui->state_allocator, state);
 		}
 	}
 
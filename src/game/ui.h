@@ -538,16 +538,18 @@ typedef struct ui_layer_t
 	};
 } ui_layer_t;
 
+// The command index isn't part of the key, it's sorted along with it in ui_render_command_list_t.command_indices.
+// Bits above the layer are free for anything else commands should be sorted on, but ui_push_command rebuilds u64
+// from the named fields, so new fields have to be added there too.
 typedef struct ui_render_command_key_t
 {
 	union
 	{
 		struct
 		{
-			uint16_t   command_index;
 			ui_layer_t layer;
 		};
-		uint32_t u32;
+		uint64_t u64;
 	};
 } ui_render_command_key_t;
 
@@ -582,6 +584,7 @@ typedef struct ui_render_command_list_t
 	size_t                   capacity;
 	size_t                   count;
 	ui_render_command_key_t *keys;
+	uint32_t                *command_indices; // after sorting, command_indices[i] is the command that goes with keys[i]
 	ui_render_command_t     *commands;
 } ui_render_command_list_t;
 
@@ -696,7 +699,7 @@ typedef struct ui_t
 	stack_t(ui_responder_t, UI_ID_STACK_COUNT) responder_chain;
 
 	table_t       state_index;
-	simple_heap_t state_allocator;
+	heap_t        state_allocator;
 
 	ui_anim_list_t anim_list;
 